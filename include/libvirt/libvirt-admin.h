@@ -187,6 +187,42 @@ virAdmServerPtr virAdmConnectLookupServer(virAdmConnectPtr conn,
 
 # define VIR_THREADPOOL_JOB_QUEUE_DEPTH "jobQueueDepth"
 
+/**
+ * VIR_THREADPOOL_JOB_COUNT:
+ * Macro for the threadpool jobCount attribute: represents the number of jobs
+ * picked up by workers since the server was started, as
+ * VIR_TYPED_PARAM_ULLONG.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ */
+
+# define VIR_THREADPOOL_JOB_COUNT "jobCount"
+
+/**
+ * VIR_THREADPOOL_JOB_WAIT_TIME:
+ * Macro for the threadpool jobWaitTime attribute: represents the total time
+ * in microseconds the jobs counted by VIR_THREADPOOL_JOB_COUNT spent waiting
+ * in a queue before a worker picked them up, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ */
+
+# define VIR_THREADPOOL_JOB_WAIT_TIME "jobWaitTime"
+
+/**
+ * VIR_THREADPOOL_JOB_STEALS:
+ * Macro for the threadpool jobSteals attribute: represents the number of jobs
+ * a worker took over from the queue of another worker, as
+ * VIR_TYPED_PARAM_ULLONG.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ */
+
+# define VIR_THREADPOOL_JOB_STEALS "jobSteals"
+
 /* Tunables for a server workerpool */
 int virAdmServerGetThreadPoolParameters(virAdmServerPtr srv,
                                         virTypedParameterPtr *params,
@@ -343,6 +379,28 @@ virAdmServerLookupClient(virAdmServerPtr srv,
 
 # define VIR_CLIENT_INFO_SELINUX_CONTEXT "selinux_context"
 
+/**
+ * VIR_CLIENT_INFO_QUEUE_DEPTH:
+ * Macro represents the number of the client's calls waiting for a worker
+ * thread of the server, as VIR_TYPED_PARAM_UINT.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ */
+
+# define VIR_CLIENT_INFO_QUEUE_DEPTH "queue_depth"
+
+/**
+ * VIR_CLIENT_INFO_CALLS_RUNNING:
+ * Macro represents the number of the client's calls currently being processed
+ * by worker threads of the server, as VIR_TYPED_PARAM_UINT.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ */
+
+# define VIR_CLIENT_INFO_CALLS_RUNNING "calls_running"
+
 int virAdmClientGetInfo(virAdmClientPtr client,
                         virTypedParameterPtr *params,
                         int *nparams,
@@ -392,6 +450,35 @@ int virAdmClientClose(virAdmClientPtr client, unsigned int flags);
 
 # define VIR_SERVER_CLIENTS_UNAUTH_CURRENT "nclients_unauth"
 
+/**
+ * VIR_SERVER_CLIENT_WORKERS_MAX:
+ * Macro for per-server client_workers_max limit: represents the upper limit
+ * to number of worker threads processing calls of a single client at the
+ * same time, 0 meaning no limit, as VIR_TYPED_PARAM_UINT.
+ */
+
+# define VIR_SERVER_CLIENT_WORKERS_MAX "client_workers_max"
+
+/**
+ * VIR_SERVER_IDENTITY_WORKERS_MAX:
+ * Macro for per-server identity_workers_max limit: represents the upper limit
+ * to number of worker threads processing calls of all clients authenticated
+ * as the same user at the same time, 0 meaning no limit,
+ * as VIR_TYPED_PARAM_UINT.
+ */
+
+# define VIR_SERVER_IDENTITY_WORKERS_MAX "identity_workers_max"
+
+/**
+ * VIR_SERVER_CLIENT_RW_WEIGHT:
+ * Macro for per-server client_rw_weight attribute: represents the number of
+ * calls of a read-write client handed to worker threads in its turn for
+ * every call of a read-only client when clients compete for workers,
+ * as VIR_TYPED_PARAM_UINT.
+ */
+
+# define VIR_SERVER_CLIENT_RW_WEIGHT "client_rw_weight"
+
 int virAdmServerGetClientLimits(virAdmServerPtr srv,
                                 virTypedParameterPtr *params,
                                 int *nparams,
@@ -421,6 +508,11 @@ int virAdmConnectSetLoggingFilters(virAdmConnectPtr conn,
                                    const char *filters,
                                    unsigned int flags);
 
+int virAdmServerGetProcedureStats(virAdmServerPtr srv,
+                                  virTypedParameterPtr *params,
+                                  int *nparams,
+                                  unsigned int flags);
+
 # ifdef __cplusplus
 }
 # endif
@@ -1065,6 +1065,28 @@ typedef enum {
  */
 # define VIR_MIGRATE_PARAM_TLS_DESTINATION          "tls.destination"
 
+/**
+ * VIR_MIGRATE_PARAM_CONVERGE_TIME:
+ *
+ * virDomainMigrate* params field: the total time in milliseconds pre-copy
+ * migration is expected to finish in. When set, the hypervisor watches the
+ * progress of every iteration and relaxes the downtime limit (up to
+ * VIR_MIGRATE_PARAM_CONVERGE_DOWNTIME) or throttles guest CPUs harder (when
+ * VIR_MIGRATE_AUTO_CONVERGE is used) if the migration is not going to
+ * complete in time. As VIR_TYPED_PARAM_ULLONG.
+ */
+# define VIR_MIGRATE_PARAM_CONVERGE_TIME            "converge.time"
+
+/**
+ * VIR_MIGRATE_PARAM_CONVERGE_DOWNTIME:
+ *
+ * virDomainMigrate* params field: the maximum downtime in milliseconds the
+ * hypervisor may allow when it finds the migration is not converging. The
+ * downtime limit is only ever raised towards this value, never beyond it.
+ * As VIR_TYPED_PARAM_ULLONG.
+ */
+# define VIR_MIGRATE_PARAM_CONVERGE_DOWNTIME        "converge.downtime"
+
 /* Domain migration. */
 virDomainPtr virDomainMigrate (virDomainPtr domain, virConnectPtr dconn,
                                unsigned long flags, const char *dname,
@@ -3604,6 +3626,33 @@ typedef enum {
  */
 # define VIR_DOMAIN_JOB_AUTO_CONVERGE_THROTTLE  "auto_converge_throttle"
 
+/**
+ * VIR_DOMAIN_JOB_CONVERGE_DOWNTIME:
+ *
+ * virDomainGetJobStats field: the downtime limit in milliseconds currently
+ * requested by the migration convergence controller enabled with
+ * VIR_MIGRATE_PARAM_CONVERGE_TIME or VIR_MIGRATE_PARAM_CONVERGE_DOWNTIME,
+ * as VIR_TYPED_PARAM_ULLONG.
+ */
+# define VIR_DOMAIN_JOB_CONVERGE_DOWNTIME        "converge_downtime"
+
+/**
+ * VIR_DOMAIN_JOB_CONVERGE_THROTTLE_INCREMENT:
+ *
+ * virDomainGetJobStats field: the auto-convergence throttle increment
+ * currently requested by the migration convergence controller, as
+ * VIR_TYPED_PARAM_INT.
+ */
+# define VIR_DOMAIN_JOB_CONVERGE_THROTTLE_INCREMENT "converge_throttle_increment"
+
+/**
+ * VIR_DOMAIN_JOB_CONVERGE_ADJUSTMENTS:
+ *
+ * virDomainGetJobStats field: number of times the migration convergence
+ * controller changed migration parameters, as VIR_TYPED_PARAM_ULLONG.
+ */
+# define VIR_DOMAIN_JOB_CONVERGE_ADJUSTMENTS     "converge_adjustments"
+
 /**
  * VIR_DOMAIN_JOB_SUCCESS:
  *
@@ -4613,6 +4662,30 @@ int virConnectDomainEventRegisterAny(virConnectPtr conn,
                                      void *opaque,
                                      virFreeCallback freecb);
 
+/**
+ * virConnectDomainEventRegisterFlags:
+ *
+ * Flags for virConnectDomainEventRegisterAnyFlags() selecting how
+ * high-frequency events are delivered to the callback.
+ */
+typedef enum {
+    /* Within a short time window deliver only the first and the latest
+     * of repeated events such as VIR_DOMAIN_EVENT_ID_RTC_CHANGE or
+     * VIR_DOMAIN_EVENT_ID_BALLOON_CHANGE */
+    VIR_CONNECT_DOMAIN_EVENT_REGISTER_COALESCE = (1 << 0),
+    /* Drop events such as VIR_DOMAIN_EVENT_ID_JOB_COMPLETED arriving
+     * faster than a fixed rate */
+    VIR_CONNECT_DOMAIN_EVENT_REGISTER_RATE_LIMIT = (1 << 1),
+} virConnectDomainEventRegisterFlags;
+
+int virConnectDomainEventRegisterAnyFlags(virConnectPtr conn,
+                                          virDomainPtr dom, /* Optional, to filter */
+                                          int eventID,
+                                          virConnectDomainEventGenericCallback cb,
+                                          void *opaque,
+                                          virFreeCallback freecb,
+                                          unsigned int flags);
+
 int virConnectDomainEventDeregisterAny(virConnectPtr conn,
                                        int callbackID);
 
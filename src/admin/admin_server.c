@@ -81,6 +81,9 @@ adminServerGetThreadPoolParameters(virNetServerPtr srv,
     size_t freeWorkers;
     size_t nPrioWorkers;
     size_t jobQueueDepth;
+    unsigned long long jobCount;
+    unsigned long long jobWaitTime;
+    unsigned long long jobSteals;
     g_autoptr(virTypedParamList) paramlist = g_new0(virTypedParamList, 1);
 
     virCheckFlags(0, -1);
@@ -88,7 +91,8 @@ adminServerGetThreadPoolParameters(virNetServerPtr srv,
     if (virNetServerGetThreadPoolParameters(srv, &minWorkers, &maxWorkers,
                                             &nWorkers, &freeWorkers,
                                             &nPrioWorkers,
-                                            &jobQueueDepth) < 0) {
+                                            &jobQueueDepth, &jobCount,
+                                            &jobWaitTime, &jobSteals) < 0) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                        _("Unable to retrieve threadpool parameters"));
         return -1;
@@ -118,6 +122,18 @@ adminServerGetThreadPoolParameters(virNetServerPtr srv,
                                  "%s", VIR_THREADPOOL_JOB_QUEUE_DEPTH) < 0)
         return -1;
 
+    if (virTypedParamListAddULLong(paramlist, jobCount,
+                                   "%s", VIR_THREADPOOL_JOB_COUNT) < 0)
+        return -1;
+
+    if (virTypedParamListAddULLong(paramlist, jobWaitTime,
+                                   "%s", VIR_THREADPOOL_JOB_WAIT_TIME) < 0)
+        return -1;
+
+    if (virTypedParamListAddULLong(paramlist, jobSteals,
+                                   "%s", VIR_THREADPOOL_JOB_STEALS) < 0)
+        return -1;
+
     *nparams = virTypedParamListStealParams(paramlist, params);
 
     return 0;
@@ -198,7 +214,8 @@ adminServerLookupClient(virNetServerPtr srv,
 }
 
 int
-adminClientGetInfo(virNetServerClientPtr client,
+adminClientGetInfo(virNetServerPtr srv,
+                   virNetServerClientPtr client,
                    virTypedParameterPtr *params,
                    int *nparams,
                    unsigned int flags)
@@ -208,6 +225,8 @@ adminClientGetInfo(virNetServerClientPtr client,
     const char *attr = NULL;
     g_autoptr(virTypedParamList) paramlist = g_new0(virTypedParamList, 1);
     g_autoptr(virIdentity) identity = NULL;
+    size_t queued;
+    size_t running;
     int rc;
 
     virCheckFlags(0, -1);
@@ -285,6 +304,16 @@ adminClientGetInfo(virNetServerClientPtr client,
                                    "%s", VIR_CLIENT_INFO_SELINUX_CONTEXT) < 0)
         return -1;
 
+    virNetServerGetClientJobs(srv, client, &queued, &running);
+
+    if (virTypedParamListAddUInt(paramlist, queued,
+                                 "%s", VIR_CLIENT_INFO_QUEUE_DEPTH) < 0)
+        return -1;
+
+    if (virTypedParamListAddUInt(paramlist, running,
+                                 "%s", VIR_CLIENT_INFO_CALLS_RUNNING) < 0)
+        return -1;
+
     *nparams = virTypedParamListStealParams(paramlist, params);
     return 0;
 }
@@ -328,6 +357,21 @@ adminServerGetClientLimits(virNetServerPtr srv,
                                  "%s", VIR_SERVER_CLIENTS_UNAUTH_CURRENT) < 0)
         return -1;
 
+    if (virTypedParamListAddUInt(paramlist,
+                                 virNetServerGetMaxClientWorkers(srv),
+                                 "%s", VIR_SERVER_CLIENT_WORKERS_MAX) < 0)
+        return -1;
+
+    if (virTypedParamListAddUInt(paramlist,
+                                 virNetServerGetMaxIdentityWorkers(srv),
+                                 "%s", VIR_SERVER_IDENTITY_WORKERS_MAX) < 0)
+        return -1;
+
+    if (virTypedParamListAddUInt(paramlist,
+                                 virNetServerGetClientRWWeight(srv),
+                                 "%s", VIR_SERVER_CLIENT_RW_WEIGHT) < 0)
+        return -1;
+
     *nparams = virTypedParamListStealParams(paramlist, params);
 
     return 0;
@@ -341,6 +385,9 @@ adminServerSetClientLimits(virNetServerPtr srv,
 {
     long long int maxClients = -1;
     long long int maxClientsUnauth = -1;
+    long long int maxClientWorkers = -1;
+    long long int maxIdentityWorkers = -1;
+    long long int rwWeight = -1;
     virTypedParameterPtr param = NULL;
 
     virCheckFlags(0, -1);
@@ -350,6 +397,12 @@ adminServerSetClientLimits(virNetServerPtr srv,
                                VIR_TYPED_PARAM_UINT,
                                VIR_SERVER_CLIENTS_UNAUTH_MAX,
                                VIR_TYPED_PARAM_UINT,
+                               VIR_SERVER_CLIENT_WORKERS_MAX,
+                               VIR_TYPED_PARAM_UINT,
+                               VIR_SERVER_IDENTITY_WORKERS_MAX,
+                               VIR_TYPED_PARAM_UINT,
+                               VIR_SERVER_CLIENT_RW_WEIGHT,
+                               VIR_TYPED_PARAM_UINT,
                                NULL) < 0)
         return -1;
 
@@ -361,10 +414,35 @@ adminServerSetClientLimits(virNetServerPtr srv,
                                    VIR_SERVER_CLIENTS_UNAUTH_MAX)))
         maxClientsUnauth = param->value.ui;
 
+    if ((param = virTypedParamsGet(params, nparams,
+                                   VIR_SERVER_CLIENT_WORKERS_MAX)))
+        maxClientWorkers = param->value.ui;
+
+    if ((param = virTypedParamsGet(params, nparams,
+                                   VIR_SERVER_IDENTITY_WORKERS_MAX)))
+        maxIdentityWorkers = param->value.ui;
+
+    if ((param = virTypedParamsGet(params, nparams,
+                                   VIR_SERVER_CLIENT_RW_WEIGHT)))
+        rwWeight = param->value.ui;
+
+    /* Reject a bad weight before changing anything, so that the limits
+     * are never half applied. virNetServerSetClientLimits is then the only
+     * call which can fail. */
+    if (rwWeight == 0) {
+        virReportError(VIR_ERR_INVALID_ARG, "%s",
+                       _("Read-write client weight must be at least 1"));
+        return -1;
+    }
+
     if (virNetServerSetClientLimits(srv, maxClients,
                                     maxClientsUnauth) < 0)
         return -1;
 
+    if (virNetServerSetClientJobLimits(srv, maxClientWorkers,
+                                       maxIdentityWorkers, rwWeight) < 0)
+        return -1;
+
     return 0;
 }
 
@@ -376,3 +454,93 @@ adminServerUpdateTlsFiles(virNetServerPtr srv,
 
     return virNetServerUpdateTlsFiles(srv);
 }
+
+static int
+adminServerAddProcedureBuckets(virTypedParamListPtr paramlist,
+                               size_t idx,
+                               const char *kind,
+                               unsigned long long total,
+                               unsigned long long *buckets)
+{
+    size_t i;
+
+    if (virTypedParamListAddULLong(paramlist, total,
+                                   "proc.%zu.%s.total", idx, kind) < 0)
+        return -1;
+
+    for (i = 0; i < VIR_NET_SERVER_PROGRAM_STATS_BUCKETS; i++) {
+        if (buckets[i] == 0)
+            continue;
+
+        if (virTypedParamListAddULLong(paramlist, buckets[i],
+                                       "proc.%zu.%s.bucket.%zu",
+                                       idx, kind, i) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+int
+adminServerGetProcedureStats(virNetServerPtr srv,
+                             virTypedParameterPtr *params,
+                             int *nparams,
+                             unsigned int flags)
+{
+    g_autoptr(virTypedParamList) paramlist = g_new0(virTypedParamList, 1);
+    virNetServerProgramPtr *progs = NULL;
+    int nprogs;
+    size_t nprocs = 0;
+    size_t i;
+    size_t j;
+    int ret = -1;
+
+    virCheckFlags(0, -1);
+
+    if ((nprogs = virNetServerGetPrograms(srv, &progs)) < 0)
+        return -1;
+
+    for (i = 0; i < nprogs; i++) {
+        const char *progname = virNetServerProgramGetName(progs[i]);
+
+        for (j = 0; j < virNetServerProgramGetNProcs(progs[i]); j++) {
+            virNetServerProgramProcStats stats;
+            const char *procname;
+            g_autofree char *number = NULL;
+
+            if (!virNetServerProgramGetProcStats(progs[i], j, &stats))
+                continue;
+
+            if (!(procname = virNetServerProgramGetProcName(progs[i], j)))
+                procname = number = g_strdup_printf("%zu", j);
+
+            if (virTypedParamListAddString(paramlist, NULLSTR(progname),
+                                           "proc.%zu.program", nprocs) < 0 ||
+                virTypedParamListAddString(paramlist, procname,
+                                           "proc.%zu.name", nprocs) < 0 ||
+                virTypedParamListAddUInt(paramlist, j,
+                                         "proc.%zu.number", nprocs) < 0 ||
+                virTypedParamListAddULLong(paramlist, stats.calls,
+                                           "proc.%zu.calls", nprocs) < 0 ||
+                adminServerAddProcedureBuckets(paramlist, nprocs, "wait",
+                                               stats.waitTotal,
+                                               stats.wait) < 0 ||
+                adminServerAddProcedureBuckets(paramlist, nprocs, "exec",
+                                               stats.execTotal,
+                                               stats.exec) < 0)
+                goto cleanup;
+
+            nprocs++;
+        }
+    }
+
+    if (virTypedParamListAddUInt(paramlist, nprocs, "proc.count") < 0)
+        goto cleanup;
+
+    *nparams = virTypedParamListStealParams(paramlist, params);
+    ret = 0;
+
+ cleanup:
+    virObjectListFreeCount(progs, nprogs);
+    return ret;
+}
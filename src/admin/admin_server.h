@@ -50,7 +50,8 @@ virNetServerClientPtr adminServerLookupClient(virNetServerPtr srv,
                                               unsigned long long id,
                                               unsigned int flags);
 
-int adminClientGetInfo(virNetServerClientPtr client,
+int adminClientGetInfo(virNetServerPtr srv,
+                       virNetServerClientPtr client,
                        virTypedParameterPtr *params,
                        int *nparams,
                        unsigned int flags);
@@ -70,3 +71,8 @@ int adminServerSetClientLimits(virNetServerPtr srv,
 
 int adminServerUpdateTlsFiles(virNetServerPtr srv,
                               unsigned int flags);
+
+int adminServerGetProcedureStats(virNetServerPtr srv,
+                                 virTypedParameterPtr *params,
+                                 int *nparams,
+                                 unsigned int flags);
@@ -321,7 +321,7 @@ adminDispatchClientGetInfo(virNetServerPtr server G_GNUC_UNUSED,
         goto cleanup;
     }
 
-    if (adminClientGetInfo(clnt, &params, &nparams, args->flags) < 0)
+    if (adminClientGetInfo(srv, clnt, &params, &nparams, args->flags) < 0)
         goto cleanup;
 
     if (virTypedParamsSerialize(params, nparams,
@@ -521,4 +521,41 @@ adminDispatchConnectGetLoggingFilters(virNetServerPtr server G_GNUC_UNUSED,
 
     return 0;
 }
+
+static int
+adminDispatchServerGetProcedureStats(virNetServerPtr server G_GNUC_UNUSED,
+                                     virNetServerClientPtr client,
+                                     virNetMessagePtr msg G_GNUC_UNUSED,
+                                     virNetMessageErrorPtr rerr G_GNUC_UNUSED,
+                                     admin_server_get_procedure_stats_args *args,
+                                     admin_server_get_procedure_stats_ret *ret)
+{
+    int rv = -1;
+    virNetServerPtr srv = NULL;
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+    struct daemonAdmClientPrivate *priv =
+        virNetServerClientGetPrivateData(client);
+
+    if (!(srv = virNetDaemonGetServer(priv->dmn, args->srv.name)))
+        goto cleanup;
+
+    if (adminServerGetProcedureStats(srv, &params, &nparams, args->flags) < 0)
+        goto cleanup;
+
+    if (virTypedParamsSerialize(params, nparams,
+                                ADMIN_SERVER_PROCEDURE_STATS_MAX,
+                                (virTypedParameterRemotePtr *) &ret->params.params_val,
+                                &ret->params.params_len, 0) < 0)
+        goto cleanup;
+
+    rv = 0;
+ cleanup:
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+
+    virTypedParamsFree(params, nparams);
+    virObjectUnref(srv);
+    return rv;
+}
 #include "admin_server_dispatch_stubs.h"
@@ -1266,3 +1266,68 @@ virAdmConnectSetLoggingFilters(virAdmConnectPtr conn,
     virDispatchError(NULL);
     return -1;
 }
+
+/**
+ * virAdmServerGetProcedureStats:
+ * @srv: a valid server object reference
+ * @params: pointer to a list of statistics (return value, allocated
+ *          automatically)
+ * @nparams: pointer to number of parameters returned in @params
+ * @flags: extra flags; not used yet, so callers should always pass 0
+ *
+ * Retrieves per-procedure call statistics of all RPC programs served by
+ * @srv. Only procedures which were called at least once since the daemon
+ * started are reported. The statistics are returned as typed parameters,
+ * with "proc.count" holding the number of reported procedures and the
+ * following parameters for each procedure <num>, indexed from 0:
+ *
+ *  "proc.<num>.program" - name of the RPC program, e.g. "remote" or "qemu"
+ *                         as VIR_TYPED_PARAM_STRING
+ *  "proc.<num>.name" - name of the procedure as VIR_TYPED_PARAM_STRING
+ *  "proc.<num>.number" - procedure number as VIR_TYPED_PARAM_UINT
+ *  "proc.<num>.calls" - number of finished calls as VIR_TYPED_PARAM_ULLONG
+ *  "proc.<num>.wait.total" - total time in microseconds the calls spent
+ *                            waiting for a worker thread
+ *                            as VIR_TYPED_PARAM_ULLONG
+ *  "proc.<num>.wait.bucket.<b>" - number of calls which waited for a
+ *                                 worker thread for a time falling into
+ *                                 bucket <b> as VIR_TYPED_PARAM_ULLONG
+ *  "proc.<num>.exec.total" - total time in microseconds the calls spent
+ *                            executing as VIR_TYPED_PARAM_ULLONG
+ *  "proc.<num>.exec.bucket.<b>" - number of calls whose execution took a
+ *                                 time falling into bucket <b>
+ *                                 as VIR_TYPED_PARAM_ULLONG
+ *
+ * Bucket 0 counts calls shorter than 1 microsecond, bucket <b> in range
+ * 1 to 24 counts calls which took at least 2^(<b>-1) and less than 2^<b>
+ * microseconds and bucket 25 counts everything longer. Empty buckets are
+ * omitted.
+ *
+ * Returns 0 on success, allocating @params to size returned in @nparams, or
+ * -1 in case of an error. Caller is responsible for deallocating @params.
+ */
+int
+virAdmServerGetProcedureStats(virAdmServerPtr srv,
+                              virTypedParameterPtr *params,
+                              int *nparams,
+                              unsigned int flags)
+{
+    int ret = -1;
+
+    VIR_DEBUG("srv=%p, params=%p, nparams=%p, flags=0x%x",
+              srv, params, nparams, flags);
+    virResetLastError();
+
+    virCheckAdmServerGoto(srv, error);
+    virCheckNonNullArgGoto(params, error);
+    virCheckNonNullArgGoto(nparams, error);
+
+    if ((ret = remoteAdminServerGetProcedureStats(srv, params,
+                                                  nparams, flags)) < 0)
+        goto error;
+
+    return ret;
+ error:
+    virDispatchError(NULL);
+    return -1;
+}
@@ -1496,6 +1496,31 @@ bhyveConnectDomainEventRegisterAny(virConnectPtr conn,
     return ret;
 }
 
+static int
+bhyveConnectDomainEventRegisterAnyFlags(virConnectPtr conn,
+                                        virDomainPtr dom,
+                                        int eventID,
+                                        virConnectDomainEventGenericCallback callback,
+                                        void *opaque,
+                                        virFreeCallback freecb,
+                                        unsigned int flags)
+{
+    bhyveConnPtr privconn = conn->privateData;
+    int ret;
+
+    if (virConnectDomainEventRegisterAnyFlagsEnsureACL(conn) < 0)
+        return -1;
+
+    if (virDomainEventStateRegisterIDFlags(conn,
+                                           privconn->domainEventState,
+                                           dom, eventID,
+                                           callback, opaque, freecb,
+                                           flags, &ret) < 0)
+        ret = -1;
+
+    return ret;
+}
+
 static int
 bhyveConnectDomainEventDeregisterAny(virConnectPtr conn,
                                      int callbackID)
@@ -1723,6 +1748,7 @@ static virHypervisorDriver bhyveHypervisorDriver = {
     .connectIsEncrypted = bhyveConnectIsEncrypted, /* 1.3.5 */
     .connectDomainXMLFromNative = bhyveConnectDomainXMLFromNative, /* 2.1.0 */
     .connectGetDomainCapabilities = bhyveConnectGetDomainCapabilities, /* 2.1.0 */
+    .connectDomainEventRegisterAnyFlags = bhyveConnectDomainEventRegisterAnyFlags, /* 6.7.0 */
 };
 
 
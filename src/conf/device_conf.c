@@ -103,6 +103,16 @@ virDomainDeviceInfoFree(virDomainDeviceInfoPtr info)
     }
 }
 
+void
+virDomainDeviceInfoCopy(virDomainDeviceInfoPtr dst,
+                        const virDomainDeviceInfo *src)
+{
+    *dst = *src;
+    dst->alias = g_strdup(src->alias);
+    dst->romfile = g_strdup(src->romfile);
+    dst->loadparm = g_strdup(src->loadparm);
+}
+
 bool
 virDomainDeviceInfoAddressIsEqual(const virDomainDeviceInfo *a,
                                   const virDomainDeviceInfo *b)
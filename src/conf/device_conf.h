@@ -183,6 +183,8 @@ struct _virDomainDeviceInfo {
 
 void virDomainDeviceInfoClear(virDomainDeviceInfoPtr info);
 void virDomainDeviceInfoFree(virDomainDeviceInfoPtr info);
+void virDomainDeviceInfoCopy(virDomainDeviceInfoPtr dst,
+                             const virDomainDeviceInfo *src);
 
 bool virDomainDeviceInfoAddressIsEqual(const virDomainDeviceInfo *a,
                                        const virDomainDeviceInfo *b)
@@ -30828,15 +30828,466 @@ virDomainUSBDeviceDefForeach(virDomainDefPtr def,
 }
 
 
-/* Copy src into a new definition; with the quality of the copy
- * depending on the migratable flag (false for transitions between
- * persistent and active, true for transitions across save files or
- * snapshots).  */
+static virDomainVirtioOptionsPtr
+virDomainVirtioOptionsCopy(const virDomainVirtioOptions *src)
+{
+    virDomainVirtioOptionsPtr ret;
+
+    if (!src)
+        return NULL;
+
+    ret = g_new0(virDomainVirtioOptions, 1);
+    *ret = *src;
+
+    return ret;
+}
+
+
+static virDomainDiskDefPtr
+virDomainDiskDefCopy(const virDomainDiskDef *src,
+                     virDomainXMLOptionPtr xmlopt)
+{
+    virDomainDiskDefPtr def;
+
+    if (!(def = virDomainDiskDefNew(xmlopt)))
+        return NULL;
+
+    virObjectUnref(def->src);
+    if (!(def->src = virStorageSourceCopy(src->src, true))) {
+        virDomainDiskDefFree(def);
+        return NULL;
+    }
+
+    /* block job state is not part of the configuration */
+    def->device = src->device;
+    def->bus = src->bus;
+    def->dst = g_strdup(src->dst);
+    def->tray_status = src->tray_status;
+    def->removable = src->removable;
+    def->geometry = src->geometry;
+    def->blockio = src->blockio;
+    virDomainBlockIoTuneInfoCopy(&src->blkdeviotune, &def->blkdeviotune);
+    def->driverName = g_strdup(src->driverName);
+    def->serial = g_strdup(src->serial);
+    def->wwn = g_strdup(src->wwn);
+    def->vendor = g_strdup(src->vendor);
+    def->product = g_strdup(src->product);
+    def->cachemode = src->cachemode;
+    def->error_policy = src->error_policy;
+    def->rerror_policy = src->rerror_policy;
+    def->iomode = src->iomode;
+    def->ioeventfd = src->ioeventfd;
+    def->event_idx = src->event_idx;
+    def->copy_on_read = src->copy_on_read;
+    def->snapshot = src->snapshot;
+    def->startupPolicy = src->startupPolicy;
+    def->transient = src->transient;
+    virDomainDeviceInfoCopy(&def->info, &src->info);
+    def->rawio = src->rawio;
+    def->sgio = src->sgio;
+    def->discard = src->discard;
+    def->iothread = src->iothread;
+    def->detect_zeroes = src->detect_zeroes;
+    def->domain_name = g_strdup(src->domain_name);
+    def->queues = src->queues;
+    def->model = src->model;
+    def->virtio = virDomainVirtioOptionsCopy(src->virtio);
+    def->diskElementAuth = src->diskElementAuth;
+    def->diskElementEnc = src->diskElementEnc;
+
+    return def;
+}
+
+
+static virDomainControllerDefPtr
+virDomainControllerDefCopy(const virDomainControllerDef *src)
+{
+    virDomainControllerDefPtr def = g_new0(virDomainControllerDef, 1);
+
+    *def = *src;
+    virDomainDeviceInfoCopy(&def->info, &src->info);
+    def->virtio = virDomainVirtioOptionsCopy(src->virtio);
+
+    return def;
+}
+
+
+static virDomainInputDefPtr
+virDomainInputDefCopy(const virDomainInputDef *src)
+{
+    virDomainInputDefPtr def = g_new0(virDomainInputDef, 1);
+
+    *def = *src;
+    def->source.evdev = g_strdup(src->source.evdev);
+    virDomainDeviceInfoCopy(&def->info, &src->info);
+    def->virtio = virDomainVirtioOptionsCopy(src->virtio);
+
+    return def;
+}
+
+
+static virDomainVideoDefPtr
+virDomainVideoDefCopy(const virDomainVideoDef *src,
+                      virDomainXMLOptionPtr xmlopt)
+{
+    virDomainVideoDefPtr def;
+
+    if (!(def = virDomainVideoDefNew(xmlopt)))
+        return NULL;
+
+    def->type = src->type;
+    def->ram = src->ram;
+    def->vram = src->vram;
+    def->vram64 = src->vram64;
+    def->vgamem = src->vgamem;
+    def->heads = src->heads;
+    def->primary = src->primary;
+
+    if (src->accel) {
+        def->accel = g_new0(virDomainVideoAccelDef, 1);
+        *def->accel = *src->accel;
+        def->accel->rendernode = g_strdup(src->accel->rendernode);
+    }
+
+    if (src->res) {
+        def->res = g_new0(virDomainVideoResolutionDef, 1);
+        *def->res = *src->res;
+    }
+
+    if (src->driver) {
+        def->driver = g_new0(virDomainVideoDriverDef, 1);
+        *def->driver = *src->driver;
+        def->driver->vhost_user_binary = g_strdup(src->driver->vhost_user_binary);
+    }
+
+    virDomainDeviceInfoCopy(&def->info, &src->info);
+    def->virtio = virDomainVirtioOptionsCopy(src->virtio);
+    def->backend = src->backend;
+
+    return def;
+}
+
+
+static virDomainMemballoonDefPtr
+virDomainMemballoonDefCopy(const virDomainMemballoonDef *src)
+{
+    virDomainMemballoonDefPtr def = g_new0(virDomainMemballoonDef, 1);
+
+    *def = *src;
+    virDomainDeviceInfoCopy(&def->info, &src->info);
+    def->virtio = virDomainVirtioOptionsCopy(src->virtio);
+
+    return def;
+}
+
+
+static void
+virDomainOSDefCopy(virDomainOSDefPtr dst,
+                   const virDomainOSDef *src)
+{
+    size_t i;
+
+    *dst = *src;
+    dst->machine = g_strdup(src->machine);
+    dst->init = g_strdup(src->init);
+    dst->initargv = g_strdupv(src->initargv);
+    dst->initenv = NULL;
+    if (src->initenv) {
+        size_t n = 0;
+
+        while (src->initenv[n])
+            n++;
+
+        dst->initenv = g_new0(virDomainOSEnvPtr, n + 1);
+        for (i = 0; i < n; i++) {
+            dst->initenv[i] = g_new0(virDomainOSEnv, 1);
+            dst->initenv[i]->name = g_strdup(src->initenv[i]->name);
+            dst->initenv[i]->value = g_strdup(src->initenv[i]->value);
+        }
+    }
+    dst->initdir = g_strdup(src->initdir);
+    dst->inituser = g_strdup(src->inituser);
+    dst->initgroup = g_strdup(src->initgroup);
+    dst->kernel = g_strdup(src->kernel);
+    dst->initrd = g_strdup(src->initrd);
+    dst->cmdline = g_strdup(src->cmdline);
+    dst->dtb = g_strdup(src->dtb);
+    dst->root = g_strdup(src->root);
+    dst->slic_table = g_strdup(src->slic_table);
+    dst->loader = NULL;
+    if (src->loader) {
+        dst->loader = g_new0(virDomainLoaderDef, 1);
+        *dst->loader = *src->loader;
+        dst->loader->path = g_strdup(src->loader->path);
+        dst->loader->nvram = g_strdup(src->loader->nvram);
+        dst->loader->templt = g_strdup(src->loader->templt);
+    }
+    dst->bootloader = g_strdup(src->bootloader);
+    dst->bootloaderArgs = g_strdup(src->bootloaderArgs);
+}
+
+
+/* Whether virDomainDefCopyNative knows how to copy all of @def. Anything
+ * missing here has to go through the XML round trip. */
+static bool
+virDomainDefCopyNativeSupported(const virDomainDef *def)
+{
+    virStorageSourcePtr n;
+    size_t i;
+
+    /* live definitions carry runtime state which the inactive XML drops */
+    if (def->id != -1 ||
+        def->postParseFailed)
+        return false;
+
+    if (def->nresctrls || def->resource ||
+        def->idmap.nuidmap || def->idmap.ngidmap ||
+        virDomainNumaGetNodeCount(def->numa) > 0 ||
+        virDomainNumatuneGetMode(def->numa, -1, NULL) == 0 ||
+        def->nseclabels || def->nsysinfo ||
+        def->namespaceData || def->keywrap || def->sev)
+        return false;
+
+    if (def->ngraphics || def->nfss || def->nnets || def->nsounds ||
+        def->naudios || def->nhostdevs || def->nredirdevs ||
+        def->nsmartcards || def->nserials || def->nparallels ||
+        def->nchannels || def->nconsoles || def->nleases || def->nhubs ||
+        def->nrngs || def->nshmems || def->nmems || def->npanics ||
+        def->ntpms || def->watchdog || def->nvram || def->redirfilter ||
+        def->iommu || def->vsock)
+        return false;
+
+    /* detected backing chains are not formatted into inactive XML */
+    for (i = 0; i < def->ndisks; i++) {
+        for (n = def->disks[i]->src->backingStore; n; n = n->backingStore) {
+            if (n->detected)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ * virDomainDefCopyNative:
+ * @src: inactive definition to copy
+ * @xmlopt: XML parser configuration object
+ * @parseOpaque: opaque data passed to the post parse callbacks
+ * @copy: filled with the copy
+ *
+ * Copies @src structure by structure. The post parse callbacks are run on
+ * the copy just like they would after parsing the XML of @src, so the
+ * result is the same as the one of virDomainDefCopyXML() without
+ * formatting and parsing the whole definition. Definitions of running
+ * domains and those using devices or tunables which are not handled here
+ * are left to virDomainDefCopyXML(), @copy is set to NULL then.
+ *
+ * Returns 0 on success (with @copy set to NULL if @src can't be copied
+ * this way), -1 on error.
+ */
+int
+virDomainDefCopyNative(virDomainDefPtr src,
+                       virDomainXMLOptionPtr xmlopt,
+                       void *parseOpaque,
+                       virDomainDefPtr *copy)
+{
+    g_autoptr(virDomainDef) def = NULL;
+    size_t i;
+
+    *copy = NULL;
+
+    if (!virDomainDefCopyNativeSupported(src))
+        return 0;
+
+    if (!(def = virDomainDefNew()))
+        return -1;
+
+    def->virtType = src->virtType;
+    def->id = -1;
+    memcpy(def->uuid, src->uuid, VIR_UUID_BUFLEN);
+    memcpy(def->genid, src->genid, VIR_UUID_BUFLEN);
+    def->genidRequested = src->genidRequested;
+
+    def->name = g_strdup(src->name);
+    def->title = g_strdup(src->title);
+    def->description = g_strdup(src->description);
+
+    def->blkio.weight = src->blkio.weight;
+    def->blkio.devices = g_new0(virBlkioDevice, src->blkio.ndevices);
+    for (i = 0; i < src->blkio.ndevices; i++) {
+        def->blkio.devices[i] = src->blkio.devices[i];
+        def->blkio.devices[i].path = g_strdup(src->blkio.devices[i].path);
+    }
+    def->blkio.ndevices = src->blkio.ndevices;
+
+    def->mem = src->mem;
+    def->mem.hugepages = NULL;
+    def->mem.nhugepages = 0;
+    if (src->mem.nhugepages)
+        def->mem.hugepages = g_new0(virDomainHugePage, src->mem.nhugepages);
+    for (i = 0; i < src->mem.nhugepages; i++) {
+        virDomainHugePagePtr page = &def->mem.hugepages[i];
+
+        page->size = src->mem.hugepages[i].size;
+        def->mem.nhugepages++;
+        if (src->mem.hugepages[i].nodemask &&
+            !(page->nodemask = virBitmapNewCopy(src->mem.hugepages[i].nodemask)))
+            return -1;
+    }
+
+    if (virDomainDefSetVcpusMax(def, src->maxvcpus, xmlopt) < 0)
+        return -1;
+
+    for (i = 0; i < src->maxvcpus; i++) {
+        virDomainVcpuDefPtr vcpu = def->vcpus[i];
+
+        vcpu->online = src->vcpus[i]->online;
+        vcpu->hotpluggable = src->vcpus[i]->hotpluggable;
+        vcpu->order = src->vcpus[i]->order;
+        vcpu->sched = src->vcpus[i]->sched;
+        if (src->vcpus[i]->cpumask &&
+            !(vcpu->cpumask = virBitmapNewCopy(src->vcpus[i]->cpumask)))
+            return -1;
+    }
+    def->individualvcpus = src->individualvcpus;
+    def->placement_mode = src->placement_mode;
+    if (src->cpumask &&
+        !(def->cpumask = virBitmapNewCopy(src->cpumask)))
+        return -1;
+
+    if (src->niothreadids)
+        def->iothreadids = g_new0(virDomainIOThreadIDDefPtr, src->niothreadids);
+    for (i = 0; i < src->niothreadids; i++) {
+        virDomainIOThreadIDDefPtr iothrid = g_new0(virDomainIOThreadIDDef, 1);
+
+        *iothrid = *src->iothreadids[i];
+        iothrid->cpumask = NULL;
+        def->iothreadids[def->niothreadids++] = iothrid;
+        if (src->iothreadids[i]->cpumask &&
+            !(iothrid->cpumask = virBitmapNewCopy(src->iothreadids[i]->cpumask)))
+            return -1;
+    }
+
+    def->cputune = src->cputune;
+    def->cputune.emulatorpin = NULL;
+    def->cputune.emulatorsched = NULL;
+    if (src->cputune.emulatorpin &&
+        !(def->cputune.emulatorpin = virBitmapNewCopy(src->cputune.emulatorpin)))
+        return -1;
+    if (src->cputune.emulatorsched) {
+        def->cputune.emulatorsched = g_new0(virDomainThreadSchedParam, 1);
+        *def->cputune.emulatorsched = *src->cputune.emulatorsched;
+    }
+
+    def->onReboot = src->onReboot;
+    def->onPoweroff = src->onPoweroff;
+    def->onCrash = src->onCrash;
+    def->onLockFailure = src->onLockFailure;
+    def->pm = src->pm;
+    def->perf = src->perf;
+
+    virDomainOSDefCopy(&def->os, &src->os);
+    def->emulator = g_strdup(src->emulator);
+
+    memcpy(def->features, src->features, sizeof(def->features));
+    memcpy(def->caps_features, src->caps_features, sizeof(def->caps_features));
+    memcpy(def->hyperv_features, src->hyperv_features, sizeof(def->hyperv_features));
+    memcpy(def->kvm_features, src->kvm_features, sizeof(def->kvm_features));
+    memcpy(def->msrs_features, src->msrs_features, sizeof(def->msrs_features));
+    memcpy(def->xen_features, src->xen_features, sizeof(def->xen_features));
+    def->xen_passthrough_mode = src->xen_passthrough_mode;
+    def->hyperv_spinlocks = src->hyperv_spinlocks;
+    def->hyperv_stimer_direct = src->hyperv_stimer_direct;
+    def->gic_version = src->gic_version;
+    def->hpt_resizing = src->hpt_resizing;
+    def->hpt_maxpagesize = src->hpt_maxpagesize;
+    def->hyperv_vendor_id = g_strdup(src->hyperv_vendor_id);
+    def->apic_eoi = src->apic_eoi;
+    def->tseg_specified = src->tseg_specified;
+    def->tseg_size = src->tseg_size;
+
+    def->clock = src->clock;
+    if (src->clock.offset == VIR_DOMAIN_CLOCK_OFFSET_TIMEZONE)
+        def->clock.data.timezone = g_strdup(src->clock.data.timezone);
+    def->clock.timers = NULL;
+    def->clock.ntimers = 0;
+    if (src->clock.ntimers)
+        def->clock.timers = g_new0(virDomainTimerDefPtr, src->clock.ntimers);
+    for (i = 0; i < src->clock.ntimers; i++) {
+        def->clock.timers[i] = g_new0(virDomainTimerDef, 1);
+        *def->clock.timers[i] = *src->clock.timers[i];
+        def->clock.ntimers++;
+    }
+
+    if (src->cpu &&
+        !(def->cpu = virCPUDefCopy(src->cpu)))
+        return -1;
+
+    if (src->ndisks)
+        def->disks = g_new0(virDomainDiskDefPtr, src->ndisks);
+    for (i = 0; i < src->ndisks; i++) {
+        if (!(def->disks[i] = virDomainDiskDefCopy(src->disks[i], xmlopt)))
+            return -1;
+        def->ndisks++;
+    }
+
+    if (src->ncontrollers)
+        def->controllers = g_new0(virDomainControllerDefPtr, src->ncontrollers);
+    for (i = 0; i < src->ncontrollers; i++)
+        def->controllers[def->ncontrollers++] = virDomainControllerDefCopy(src->controllers[i]);
+
+    if (src->ninputs)
+        def->inputs = g_new0(virDomainInputDefPtr, src->ninputs);
+    for (i = 0; i < src->ninputs; i++)
+        def->inputs[def->ninputs++] = virDomainInputDefCopy(src->inputs[i]);
+
+    if (src->nvideos)
+        def->videos = g_new0(virDomainVideoDefPtr, src->nvideos);
+    for (i = 0; i < src->nvideos; i++) {
+        if (!(def->videos[i] = virDomainVideoDefCopy(src->videos[i], xmlopt)))
+            return -1;
+        def->nvideos++;
+    }
+
+    if (src->memballoon)
+        def->memballoon = virDomainMemballoonDefCopy(src->memballoon);
+
+    if (src->metadata &&
+        !(def->metadata = xmlCopyNode(src->metadata, 1))) {
+        virReportOOMError();
+        return -1;
+    }
+
+    def->ns = xmlopt->ns;
+
+    if (virDomainDefPostParse(def,
+                              VIR_DOMAIN_DEF_PARSE_INACTIVE |
+                              VIR_DOMAIN_DEF_PARSE_SKIP_VALIDATE,
+                              xmlopt, parseOpaque) < 0)
+        return -1;
+
+    *copy = g_steal_pointer(&def);
+    return 0;
+}
+
+
+/**
+ * virDomainDefCopyXML:
+ * @src: definition to copy
+ * @xmlopt: XML parser configuration object
+ * @parseOpaque: opaque data passed to the post parse callbacks
+ * @migratable: whether the copy is meant for a save file or snapshot
+ *
+ * Copies @src by formatting it into XML and parsing the result back.
+ *
+ * Returns the copy or NULL on error.
+ */
 virDomainDefPtr
-virDomainDefCopy(virDomainDefPtr src,
-                 virDomainXMLOptionPtr xmlopt,
-                 void *parseOpaque,
-                 bool migratable)
+virDomainDefCopyXML(virDomainDefPtr src,
+                    virDomainXMLOptionPtr xmlopt,
+                    void *parseOpaque,
+                    bool migratable)
 {
     unsigned int format_flags = VIR_DOMAIN_DEF_FORMAT_SECURE;
     unsigned int parse_flags = VIR_DOMAIN_DEF_PARSE_INACTIVE |
@@ -30846,13 +31297,37 @@ virDomainDefCopy(virDomainDefPtr src,
     if (migratable)
         format_flags |= VIR_DOMAIN_DEF_FORMAT_INACTIVE | VIR_DOMAIN_DEF_FORMAT_MIGRATABLE;
 
-    /* Easiest to clone via a round-trip through XML.  */
     if (!(xml = virDomainDefFormat(src, xmlopt, format_flags)))
         return NULL;
 
     return virDomainDefParseString(xml, xmlopt, parseOpaque, parse_flags);
 }
 
+
+/* Copy src into a new definition; with the quality of the copy
+ * depending on the migratable flag (false for transitions between
+ * persistent and active, true for transitions across save files or
+ * snapshots).  */
+virDomainDefPtr
+virDomainDefCopy(virDomainDefPtr src,
+                 virDomainXMLOptionPtr xmlopt,
+                 void *parseOpaque,
+                 bool migratable)
+{
+    virDomainDefPtr ret = NULL;
+
+    if (!migratable) {
+        if (virDomainDefCopyNative(src, xmlopt, parseOpaque, &ret) < 0)
+            return NULL;
+
+        if (ret)
+            return ret;
+    }
+
+    /* Everything else is easiest to clone via a round-trip through XML.  */
+    return virDomainDefCopyXML(src, xmlopt, parseOpaque, migratable);
+}
+
 virDomainDefPtr
 virDomainObjCopyPersistentDef(virDomainObjPtr dom,
                               virDomainXMLOptionPtr xmlopt,
@@ -3141,6 +3141,14 @@ virDomainDefPtr virDomainDefCopy(virDomainDefPtr src,
                                  virDomainXMLOptionPtr xmlopt,
                                  void *parseOpaque,
                                  bool migratable);
+int virDomainDefCopyNative(virDomainDefPtr src,
+                           virDomainXMLOptionPtr xmlopt,
+                           void *parseOpaque,
+                           virDomainDefPtr *copy);
+virDomainDefPtr virDomainDefCopyXML(virDomainDefPtr src,
+                                    virDomainXMLOptionPtr xmlopt,
+                                    void *parseOpaque,
+                                    bool migratable);
 virDomainDefPtr virDomainObjCopyPersistentDef(virDomainObjPtr dom,
                                               virDomainXMLOptionPtr xmlopt,
                                               void *parseOpaque);
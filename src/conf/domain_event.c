@@ -36,6 +36,11 @@
 
 VIR_LOG_INIT("util.domain_event");
 
+G_STATIC_ASSERT((int)VIR_CONNECT_DOMAIN_EVENT_REGISTER_COALESCE ==
+                (int)VIR_OBJECT_EVENT_CALLBACK_COALESCE);
+G_STATIC_ASSERT((int)VIR_CONNECT_DOMAIN_EVENT_REGISTER_RATE_LIMIT ==
+                (int)VIR_OBJECT_EVENT_CALLBACK_RATE_LIMIT);
+
 static virClassPtr virDomainEventClass;
 static virClassPtr virDomainEventLifecycleClass;
 static virClassPtr virDomainEventRTCChangeClass;
@@ -674,6 +679,8 @@ virDomainEventRTCChangeNewFromDom(virDomainPtr dom,
         return NULL;
 
     ev->offset = offset;
+    virObjectEventSetPolicy((virObjectEventPtr)ev,
+                            VIR_OBJECT_EVENT_POLICY_COALESCE, NULL);
 
     return (virObjectEventPtr)ev;
 }
@@ -693,6 +700,8 @@ virDomainEventRTCChangeNewFromObj(virDomainObjPtr obj,
         return NULL;
 
     ev->offset = offset;
+    virObjectEventSetPolicy((virObjectEventPtr)ev,
+                            VIR_OBJECT_EVENT_POLICY_COALESCE, NULL);
 
     return (virObjectEventPtr)ev;
 }
@@ -1208,6 +1217,8 @@ virDomainEventBalloonChangeNewFromDom(virDomainPtr dom,
         return NULL;
 
     ev->actual = actual;
+    virObjectEventSetPolicy((virObjectEventPtr)ev,
+                            VIR_OBJECT_EVENT_POLICY_COALESCE, NULL);
 
     return (virObjectEventPtr)ev;
 }
@@ -1226,6 +1237,8 @@ virDomainEventBalloonChangeNewFromObj(virDomainObjPtr obj,
         return NULL;
 
     ev->actual = actual;
+    virObjectEventSetPolicy((virObjectEventPtr)ev,
+                            VIR_OBJECT_EVENT_POLICY_COALESCE, NULL);
 
     return (virObjectEventPtr)ev;
 }
@@ -1442,6 +1455,8 @@ virDomainEventJobCompletedNew(int id,
 
     ev->params = params;
     ev->nparams = nparams;
+    virObjectEventSetPolicy((virObjectEventPtr)ev,
+                            VIR_OBJECT_EVENT_POLICY_RATE_LIMIT, NULL);
 
     return (virObjectEventPtr) ev;
 
@@ -1578,6 +1593,7 @@ virDomainEventBlockThresholdNew(int id,
                                 unsigned long long excess)
 {
     virDomainEventBlockThresholdPtr ev;
+    g_autofree char *key = NULL;
 
     if (virDomainEventsInitialize() < 0)
         return NULL;
@@ -1592,6 +1608,10 @@ virDomainEventBlockThresholdNew(int id,
     ev->threshold = threshold;
     ev->excess = excess;
 
+    key = g_strdup_printf("%s/%s", ev->parent.parent.meta.key, NULLSTR(dev));
+    virObjectEventSetPolicy((virObjectEventPtr)ev,
+                            VIR_OBJECT_EVENT_POLICY_COALESCE, key);
+
     return (virObjectEventPtr)ev;
 }
 
@@ -2012,7 +2032,7 @@ virDomainEventStateRegister(virConnectPtr conn,
                                          VIR_DOMAIN_EVENT_ID_LIFECYCLE,
                                          VIR_OBJECT_EVENT_CALLBACK(callback),
                                          opaque, freecb,
-                                         true, &callbackID, false);
+                                         true, 0, &callbackID, false);
 }
 
 
@@ -2042,9 +2062,48 @@ virDomainEventStateRegisterID(virConnectPtr conn,
                               void *opaque,
                               virFreeCallback freecb,
                               int *callbackID)
+{
+    return virDomainEventStateRegisterIDFlags(conn, state, dom, eventID,
+                                              cb, opaque, freecb, 0,
+                                              callbackID);
+}
+
+
+/**
+ * virDomainEventStateRegisterIDFlags:
+ * @conn: connection to associate with callback
+ * @state: object event state
+ * @dom: optional domain for filtering the event
+ * @eventID: ID of the event type to register for
+ * @cb: function to invoke when event fires
+ * @opaque: data blob to pass to @callback
+ * @freecb: callback to free @opaque
+ * @flags: bitwise-OR of virConnectDomainEventRegisterFlags
+ * @callbackID: filled with callback ID
+ *
+ * Register the function @cb with connection @conn, from @state, for
+ * events of type @eventID, and return the registration handle in
+ * @callbackID.  High-frequency events delivered to @cb are coalesced
+ * or rate limited as requested by @flags.
+ *
+ * Returns: the number of callbacks now registered, or -1 on error
+ */
+int
+virDomainEventStateRegisterIDFlags(virConnectPtr conn,
+                                   virObjectEventStatePtr state,
+                                   virDomainPtr dom,
+                                   int eventID,
+                                   virConnectDomainEventGenericCallback cb,
+                                   void *opaque,
+                                   virFreeCallback freecb,
+                                   unsigned int flags,
+                                   int *callbackID)
 {
     char uuidstr[VIR_UUID_STRING_BUFLEN];
 
+    virCheckFlags(VIR_CONNECT_DOMAIN_EVENT_REGISTER_COALESCE |
+                  VIR_CONNECT_DOMAIN_EVENT_REGISTER_RATE_LIMIT, -1);
+
     if (virDomainEventsInitialize() < 0)
         return -1;
 
@@ -2055,7 +2114,7 @@ virDomainEventStateRegisterID(virConnectPtr conn,
                                          virDomainEventClass, eventID,
                                          VIR_OBJECT_EVENT_CALLBACK(cb),
                                          opaque, freecb,
-                                         false, callbackID, false);
+                                         false, flags, callbackID, false);
 }
 
 
@@ -2069,6 +2128,7 @@ virDomainEventStateRegisterID(virConnectPtr conn,
  * @opaque: data blob to pass to @callback
  * @freecb: callback to free @opaque
  * @legacy: true if callback is tracked by function instead of callbackID
+ * @flags: bitwise-OR of virConnectDomainEventRegisterFlags
  * @callbackID: filled with callback ID
  * @remoteID: true if server supports filtering
  *
@@ -2088,6 +2148,7 @@ virDomainEventStateRegisterClient(virConnectPtr conn,
                                   void *opaque,
                                   virFreeCallback freecb,
                                   bool legacy,
+                                  unsigned int flags,
                                   int *callbackID,
                                   bool remoteID)
 {
@@ -2103,7 +2164,7 @@ virDomainEventStateRegisterClient(virConnectPtr conn,
                                          virDomainEventClass, eventID,
                                          VIR_OBJECT_EVENT_CALLBACK(cb),
                                          opaque, freecb,
-                                         legacy, callbackID, remoteID);
+                                         legacy, flags, callbackID, remoteID);
 }
 
 
@@ -2277,5 +2338,5 @@ virDomainQemuMonitorEventStateRegisterID(virConnectPtr conn,
                                          virDomainQemuMonitorEventClass, 0,
                                          VIR_OBJECT_EVENT_CALLBACK(cb),
                                          data, freecb,
-                                         false, callbackID, false);
+                                         false, 0, callbackID, false);
 }
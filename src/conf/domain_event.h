@@ -273,6 +273,17 @@ virDomainEventStateRegisterID(virConnectPtr conn,
                               int *callbackID)
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(5);
 int
+virDomainEventStateRegisterIDFlags(virConnectPtr conn,
+                                   virObjectEventStatePtr state,
+                                   virDomainPtr dom,
+                                   int eventID,
+                                   virConnectDomainEventGenericCallback cb,
+                                   void *opaque,
+                                   virFreeCallback freecb,
+                                   unsigned int flags,
+                                   int *callbackID)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(5);
+int
 virDomainEventStateRegisterClient(virConnectPtr conn,
                                   virObjectEventStatePtr state,
                                   virDomainPtr dom,
@@ -281,10 +292,11 @@ virDomainEventStateRegisterClient(virConnectPtr conn,
                                   void *opaque,
                                   virFreeCallback freecb,
                                   bool legacy,
+                                  unsigned int flags,
                                   int *callbackID,
                                   bool remoteID)
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(5)
-    ATTRIBUTE_NONNULL(9);
+    ATTRIBUTE_NONNULL(10);
 
 int
 virDomainEventStateCallbackID(virConnectPtr conn,
@@ -154,7 +154,7 @@ virNetworkEventStateRegisterID(virConnectPtr conn,
                                          virNetworkEventClass, eventID,
                                          VIR_OBJECT_EVENT_CALLBACK(cb),
                                          opaque, freecb,
-                                         false, callbackID, false);
+                                         false, 0, callbackID, false);
 }
 
 
@@ -198,7 +198,7 @@ virNetworkEventStateRegisterClient(virConnectPtr conn,
                                          virNetworkEventClass, eventID,
                                          VIR_OBJECT_EVENT_CALLBACK(cb),
                                          opaque, freecb,
-                                         false, callbackID, true);
+                                         false, 0, callbackID, true);
 }
 
 
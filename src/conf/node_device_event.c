@@ -181,7 +181,7 @@ virNodeDeviceEventStateRegisterID(virConnectPtr conn,
                                          virNodeDeviceEventClass, eventID,
                                          VIR_OBJECT_EVENT_CALLBACK(cb),
                                          opaque, freecb,
-                                         false, callbackID, false);
+                                         false, 0, callbackID, false);
 }
 
 
@@ -221,7 +221,7 @@ virNodeDeviceEventStateRegisterClient(virConnectPtr conn,
                                          virNodeDeviceEventClass, eventID,
                                          VIR_OBJECT_EVENT_CALLBACK(cb),
                                          opaque, freecb,
-                                         false, callbackID, true);
+                                         false, 0, callbackID, true);
 }
 
 
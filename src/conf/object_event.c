@@ -32,11 +32,29 @@
 #include "virerror.h"
 #include "virobject.h"
 #include "virstring.h"
+#include "virhash.h"
+#include "virthread.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
 VIR_LOG_INIT("conf.object_event");
 
+/* Length of the window in milliseconds within which events with a
+ * policy are coalesced or rate limited */
+#define VIR_OBJECT_EVENT_POLICY_WINDOW 1000
+
+/* Maximum number of rate limited events delivered within a window */
+#define VIR_OBJECT_EVENT_RATE_LIMIT 10
+
+struct _virObjectEventThrottle {
+    long long start; /* beginning of the current window */
+    size_t count; /* events delivered within the window */
+    size_t dropped; /* events dropped or superseded within the window */
+    virObjectEventPtr pending; /* latest coalesced event to deliver */
+};
+typedef struct _virObjectEventThrottle virObjectEventThrottle;
+typedef virObjectEventThrottle *virObjectEventThrottlePtr;
+
 struct _virObjectEventCallback {
     int callbackID;
     virClassPtr klass;
@@ -52,6 +70,9 @@ struct _virObjectEventCallback {
     virFreeCallback freecb;
     bool deleted;
     bool legacy; /* true if end user does not know callbackID */
+    unsigned int flags; /* bitwise-OR of virObjectEventCallbackFlags */
+    virHashTablePtr throttle; /* policy key -> virObjectEventThrottle */
+    unsigned long long dropped; /* events dropped by the policies */
 };
 typedef struct _virObjectEventCallback virObjectEventCallback;
 typedef virObjectEventCallback *virObjectEventCallbackPtr;
@@ -79,6 +100,17 @@ struct _virObjectEventState {
     int timer;
     /* Flag if we're in process of dispatching */
     bool isDispatching;
+
+    /* Dispatch thread flushing the queue instead of the timer */
+    char *threadName; /* non-NULL if events are dispatched by a thread */
+    virThread thread;
+    bool running; /* the thread was started and didn't exit yet */
+    bool quit;
+    bool wakeup;
+    virCond cond;
+    size_t maxQueued; /* 0 if the queue is unbounded */
+    bool overflow; /* the queue is full */
+    unsigned long long dropped; /* events dropped on a full queue */
 };
 
 static virClassPtr virObjectEventClass;
@@ -125,6 +157,17 @@ virObjectEventDispose(void *obj)
 
     VIR_FREE(event->meta.name);
     VIR_FREE(event->meta.key);
+    VIR_FREE(event->policyKey);
+}
+
+
+static void
+virObjectEventThrottleFree(void *opaque)
+{
+    virObjectEventThrottlePtr throttle = opaque;
+
+    virObjectUnref(throttle->pending);
+    g_free(throttle);
 }
 
 /**
@@ -140,6 +183,7 @@ virObjectEventCallbackFree(virObjectEventCallbackPtr cb)
         return;
 
     virObjectUnref(cb->conn);
+    virHashFree(cb->throttle);
     VIR_FREE(cb->key);
     VIR_FREE(cb);
 }
@@ -161,6 +205,7 @@ virObjectEventCallbackListFree(virObjectEventCallbackListPtr list)
         virFreeCallback freecb = list->callbacks[i]->freecb;
         if (freecb)
             (*freecb)(list->callbacks[i]->opaque);
+        virHashFree(list->callbacks[i]->throttle);
         VIR_FREE(list->callbacks[i]);
     }
     VIR_FREE(list->callbacks);
@@ -175,6 +220,7 @@ virObjectEventCallbackListFree(virObjectEventCallbackListPtr list)
  * @klass: the base event class
  * @eventID: the event ID
  * @key: optional key of per-object filtering
+ * @flags: bitwise-OR of virObjectEventCallbackFlags
  * @serverFilter: true if server supports object filtering
  *
  * Internal function to count how many callbacks remain registered for
@@ -184,7 +230,7 @@ virObjectEventCallbackListFree(virObjectEventCallbackListPtr list)
  * returns a count that includes both global and per-object callbacks,
  * since the remote side will use a single global event to feed both.
  * When true, the count is limited to the callbacks with the same
- * @key, and where a remoteID has already been set on the callback
+ * @key and @flags, and where a remoteID has already been set on the callback
  * with virObjectEventStateSetRemote().  Note that this function
  * intentionally ignores the legacy field, since RPC calls use only a
  * single callback on the server to manage both legacy and modern
@@ -196,6 +242,7 @@ virObjectEventCallbackListCount(virConnectPtr conn,
                                 virClassPtr klass,
                                 int eventID,
                                 const char *key,
+                                unsigned int flags,
                                 bool serverFilter)
 {
     size_t i;
@@ -212,6 +259,7 @@ virObjectEventCallbackListCount(virConnectPtr conn,
             !cb->deleted &&
             (!serverFilter ||
              (cb->remoteID >= 0 &&
+              cb->flags == flags &&
               ((key && cb->key_filter && STREQ(cb->key, key)) ||
                (!key && !cb->key_filter)))))
             ret++;
@@ -246,6 +294,7 @@ virObjectEventCallbackListRemoveID(virConnectPtr conn,
                 (virObjectEventCallbackListCount(conn, cbList, cb->klass,
                                                  cb->eventID,
                                                  cb->key_filter ? cb->key : NULL,
+                                                 cb->flags,
                                                  cb->remoteID >= 0) - 1);
 
             /* @doFreeCb inhibits calling @freecb from error paths in
@@ -282,6 +331,7 @@ virObjectEventCallbackListMarkDeleteID(virConnectPtr conn,
                 virObjectEventCallbackListCount(conn, cbList, cb->klass,
                                                 cb->eventID,
                                                 cb->key_filter ? cb->key : NULL,
+                                                cb->flags,
                                                 cb->remoteID >= 0);
         }
     }
@@ -321,12 +371,15 @@ virObjectEventCallbackListPurgeMarked(virObjectEventCallbackListPtr cbList)
  * @eventID: the event ID
  * @callback: the callback to locate
  * @legacy: true if callback is tracked by function instead of callbackID
+ * @flags: bitwise-OR of virObjectEventCallbackFlags
  * @remoteID: optionally return a known remoteID
  *
  * Internal function to determine if @callback already has a
  * callbackID in @cbList for the given @conn and other filters.  If
  * @remoteID is non-NULL, and another callback exists that can be
  * serviced by the same remote event, then set it to that remote ID.
+ * Only callbacks registered with the same @flags share a remote event
+ * as the server applies the event policies per remote callback.
  *
  * Return the id if found, or -1 with no error issued if not present.
  */
@@ -338,6 +391,7 @@ virObjectEventCallbackLookup(virConnectPtr conn,
                              int eventID,
                              virConnectObjectEventGenericCallback callback,
                              bool legacy,
+                             unsigned int flags,
                              int *remoteID)
 {
     size_t i;
@@ -353,6 +407,7 @@ virObjectEventCallbackLookup(virConnectPtr conn,
         if (cb->klass == klass &&
             cb->eventID == eventID &&
             cb->conn == conn &&
+            cb->flags == flags &&
             ((key && cb->key_filter && STREQ(cb->key, key)) ||
              (!key && !cb->key_filter))) {
             if (remoteID)
@@ -379,6 +434,7 @@ virObjectEventCallbackLookup(virConnectPtr conn,
  * @opaque: opaque data to pass to @callback
  * @freecb: callback to free @opaque
  * @legacy: true if callback is tracked by function instead of callbackID
+ * @flags: bitwise-OR of virObjectEventCallbackFlags
  * @callbackID: filled with callback ID
  * @serverFilter: true if server supports object filtering
  *
@@ -396,6 +452,7 @@ virObjectEventCallbackListAddID(virConnectPtr conn,
                                 void *opaque,
                                 virFreeCallback freecb,
                                 bool legacy,
+                                unsigned int flags,
                                 int *callbackID,
                                 bool serverFilter)
 {
@@ -405,9 +462,9 @@ virObjectEventCallbackListAddID(virConnectPtr conn,
 
     VIR_DEBUG("conn=%p cblist=%p key=%p filter=%p filter_opaque=%p "
               "klass=%p eventID=%d callback=%p opaque=%p "
-              "legacy=%d callbackID=%p serverFilter=%d",
+              "legacy=%d flags=0x%x callbackID=%p serverFilter=%d",
               conn, cbList, key, filter, filter_opaque, klass, eventID,
-              callback, opaque, legacy, callbackID, serverFilter);
+              callback, opaque, legacy, flags, callbackID, serverFilter);
 
     /* Check incoming */
     if (!cbList)
@@ -417,7 +474,7 @@ virObjectEventCallbackListAddID(virConnectPtr conn,
      * have this callback on our list.  */
     if (!filter &&
         virObjectEventCallbackLookup(conn, cbList, key,
-                                     klass, eventID, callback, legacy,
+                                     klass, eventID, callback, legacy, flags,
                                      serverFilter ? &remoteID : NULL) != -1) {
         virReportError(VIR_ERR_INVALID_ARG, "%s",
                        _("event callback already tracked"));
@@ -442,6 +499,7 @@ virObjectEventCallbackListAddID(virConnectPtr conn,
     cb->filter = filter;
     cb->filter_opaque = filter_opaque;
     cb->legacy = legacy;
+    cb->flags = flags;
 
     if (VIR_APPEND_ELEMENT(cbList->callbacks, cbList->count, cb) < 0)
         goto cleanup;
@@ -452,7 +510,7 @@ virObjectEventCallbackListAddID(virConnectPtr conn,
         ret = 1;
     } else {
         ret = virObjectEventCallbackListCount(conn, cbList, klass, eventID,
-                                              key, serverFilter);
+                                              key, flags, serverFilter);
         if (serverFilter && remoteID < 0)
             ret++;
     }
@@ -526,6 +584,10 @@ virObjectEventStateDispose(void *obj)
 
     if (state->timer != -1)
         virEventRemoveTimeout(state->timer);
+
+    if (state->threadName)
+        virCondDestroy(&state->cond);
+    g_free(state->threadName);
 }
 
 
@@ -546,10 +608,47 @@ virObjectEventTimer(int timer G_GNUC_UNUSED, void *opaque)
 {
     virObjectEventStatePtr state = opaque;
 
+    if (state->threadName) {
+        virObjectLock(state);
+        state->wakeup = true;
+        virCondBroadcast(&state->cond);
+        virObjectUnlock(state);
+        return;
+    }
+
     virObjectEventStateFlush(state);
 }
 
 
+static void
+virObjectEventStateWorker(void *opaque)
+{
+    virObjectEventStatePtr state = opaque;
+
+    virObjectLock(state);
+    while (!state->quit) {
+        if (state->queue->count == 0 && !state->wakeup) {
+            if (virCondWait(&state->cond, &state->parent.lock) < 0) {
+                VIR_WARN("Failed to wait for events");
+                break;
+            }
+            continue;
+        }
+
+        state->wakeup = false;
+        virObjectUnlock(state);
+        virObjectEventStateFlush(state);
+        virObjectLock(state);
+    }
+    state->running = false;
+    virCondBroadcast(&state->cond);
+    virObjectUnlock(state);
+
+    /* Release the reference taken by virObjectEventStateStartThreadLocked */
+    virObjectUnref(state);
+}
+
+
 /**
  * virObjectEventStateNew:
  *
@@ -582,6 +681,110 @@ virObjectEventStateNew(void)
 }
 
 
+/**
+ * virObjectEventStateUseThread:
+ * @state: the event state object
+ * @name: name of the dispatch thread
+ * @maxQueued: maximum number of events waiting for dispatch, or 0
+ *
+ * Dispatch events of @state from a thread of its own rather than from
+ * the event loop, so that slow callbacks don't delay other work done
+ * by the event loop.  The thread is started when the first callback is
+ * registered.  If @maxQueued is not 0, events queued while the queue
+ * already contains @maxQueued events are dropped, see
+ * virObjectEventStateGetDropped().
+ *
+ * The thread keeps a reference on @state until it's stopped by
+ * virObjectEventStateStopThread().
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virObjectEventStateUseThread(virObjectEventStatePtr state,
+                             const char *name,
+                             size_t maxQueued)
+{
+    if (virCondInit(&state->cond) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("cannot initialize condition variable"));
+        return -1;
+    }
+
+    virObjectLock(state);
+    state->threadName = g_strdup(name);
+    state->maxQueued = maxQueued;
+    virObjectUnlock(state);
+
+    return 0;
+}
+
+
+static int
+virObjectEventStateStartThreadLocked(virObjectEventStatePtr state)
+{
+    if (!state->threadName || state->running || state->quit)
+        return 0;
+
+    virObjectRef(state);
+    if (virThreadCreateFull(&state->thread, false, virObjectEventStateWorker,
+                            state->threadName, false, state) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("cannot create event dispatch thread"));
+        virObjectUnref(state);
+        return -1;
+    }
+    state->running = true;
+
+    return 0;
+}
+
+
+/**
+ * virObjectEventStateStopThread:
+ * @state: the event state object
+ *
+ * Stop the dispatch thread requested by virObjectEventStateUseThread()
+ * and wait for it to finish the callback it's running.  Events still
+ * waiting in the queue are discarded.  When called from a callback, the
+ * thread exits once the callback returns.
+ */
+void
+virObjectEventStateStopThread(virObjectEventStatePtr state)
+{
+    virObjectLock(state);
+    if (state->threadName && !state->quit) {
+        state->quit = true;
+        virCondBroadcast(&state->cond);
+    }
+    while (state->running && !virThreadIsSelf(&state->thread)) {
+        if (virCondWait(&state->cond, &state->parent.lock) < 0) {
+            VIR_WARN("Failed to wait for the event dispatch thread");
+            break;
+        }
+    }
+    virObjectUnlock(state);
+}
+
+
+/**
+ * virObjectEventStateGetDropped:
+ * @state: the event state object
+ *
+ * Returns the number of events dropped because the queue was full.
+ */
+unsigned long long
+virObjectEventStateGetDropped(virObjectEventStatePtr state)
+{
+    unsigned long long ret;
+
+    virObjectLock(state);
+    ret = state->dropped;
+    virObjectUnlock(state);
+
+    return ret;
+}
+
+
 /**
  * virObjectEventNew:
  * @klass: subclass of event to be created
@@ -633,6 +836,28 @@ virObjectEventNew(virClassPtr klass,
 }
 
 
+/**
+ * virObjectEventSetPolicy:
+ * @event: the event
+ * @policy: how to throttle the event
+ * @key: key of the events throttled together, or NULL
+ *
+ * Make @event subject to @policy for callbacks which opted in for it
+ * on registration.  Events of the same type are throttled together
+ * when their @key matches; if @key is NULL the key for per-object
+ * filtering is used.
+ */
+void
+virObjectEventSetPolicy(virObjectEventPtr event,
+                        virObjectEventPolicy policy,
+                        const char *key)
+{
+    event->policy = policy;
+    g_free(event->policyKey);
+    event->policyKey = g_strdup(key);
+}
+
+
 /**
  * virObjectEventQueuePush:
  * @evtQueue: the object event queue
@@ -679,6 +904,205 @@ virObjectEventDispatchMatchCallback(virObjectEventPtr event,
 }
 
 
+/**
+ * virObjectEventCallbackAdmit:
+ * @cb: the callback matching @event
+ * @event: the event to deliver
+ *
+ * Apply the policy of @event if @cb opted in for it.  A coalesced
+ * event which is not delivered right away is remembered and delivered
+ * once the current window ends, unless a newer one supersedes it.
+ *
+ * Returns true if @event should be delivered to @cb now.
+ */
+static bool
+virObjectEventCallbackAdmit(virObjectEventCallbackPtr cb,
+                            virObjectEventPtr event)
+{
+    virObjectEventThrottlePtr throttle;
+    const char *key = event->policyKey ? event->policyKey : event->meta.key;
+    long long now;
+
+    switch (event->policy) {
+    case VIR_OBJECT_EVENT_POLICY_COALESCE:
+        if (!(cb->flags & VIR_OBJECT_EVENT_CALLBACK_COALESCE))
+            return true;
+        break;
+    case VIR_OBJECT_EVENT_POLICY_RATE_LIMIT:
+        if (!(cb->flags & VIR_OBJECT_EVENT_CALLBACK_RATE_LIMIT))
+            return true;
+        break;
+    case VIR_OBJECT_EVENT_POLICY_NONE:
+    default:
+        return true;
+    }
+
+    /* Events relayed from a server were already throttled there */
+    if (cb->remoteID >= 0 || !key)
+        return true;
+
+    if (!cb->throttle &&
+        !(cb->throttle = virHashNew(virObjectEventThrottleFree)))
+        return true;
+
+    now = g_get_monotonic_time() / 1000;
+
+    if (!(throttle = virHashLookup(cb->throttle, key))) {
+        throttle = g_new0(virObjectEventThrottle, 1);
+        throttle->start = now;
+        if (virHashAddEntry(cb->throttle, key, throttle) < 0) {
+            virObjectEventThrottleFree(throttle);
+            return true;
+        }
+    } else if (now - throttle->start >= VIR_OBJECT_EVENT_POLICY_WINDOW) {
+        /* @event supersedes an event still waiting for delivery */
+        if (throttle->pending) {
+            virObjectUnref(throttle->pending);
+            throttle->pending = NULL;
+            throttle->dropped++;
+            cb->dropped++;
+        }
+        if (throttle->dropped)
+            VIR_INFO("dropped %zu events of type %d for '%s' on callback %d",
+                     throttle->dropped, event->eventID, key, cb->callbackID);
+        throttle->start = now;
+        throttle->count = 0;
+        throttle->dropped = 0;
+    }
+
+    if (event->policy == VIR_OBJECT_EVENT_POLICY_COALESCE) {
+        if (throttle->count == 0) {
+            throttle->count++;
+            return true;
+        }
+
+        if (throttle->pending) {
+            virObjectUnref(throttle->pending);
+            throttle->dropped++;
+            cb->dropped++;
+        }
+        throttle->pending = virObjectRef(event);
+        return false;
+    }
+
+    if (throttle->count < VIR_OBJECT_EVENT_RATE_LIMIT) {
+        throttle->count++;
+        return true;
+    }
+
+    throttle->dropped++;
+    cb->dropped++;
+    return false;
+}
+
+
+struct virObjectEventThrottleData {
+    long long now;
+    long long deadline; /* earliest end of a window with a pending event */
+    size_t npending;
+    virObjectEventPtr *pending;
+};
+
+
+static int
+virObjectEventThrottleCollect(void *payload,
+                              const void *name G_GNUC_UNUSED,
+                              void *opaque)
+{
+    virObjectEventThrottlePtr throttle = payload;
+    struct virObjectEventThrottleData *data = opaque;
+    long long end = throttle->start + VIR_OBJECT_EVENT_POLICY_WINDOW;
+
+    if (!throttle->pending)
+        return 0;
+
+    if (end > data->now) {
+        if (data->deadline < 0 || end < data->deadline)
+            data->deadline = end;
+        return 0;
+    }
+
+    /* The delivery of the pending event starts a new window */
+    if (VIR_APPEND_ELEMENT(data->pending, data->npending,
+                           throttle->pending) < 0)
+        return -1;
+    throttle->start = data->now;
+    throttle->count = 1;
+    throttle->dropped = 0;
+
+    end = data->now + VIR_OBJECT_EVENT_POLICY_WINDOW;
+    if (data->deadline < 0 || end < data->deadline)
+        data->deadline = end;
+    return 0;
+}
+
+
+static int
+virObjectEventThrottleExpired(const void *payload,
+                              const void *name G_GNUC_UNUSED,
+                              const void *opaque)
+{
+    const virObjectEventThrottle *throttle = payload;
+    const struct virObjectEventThrottleData *data = opaque;
+
+    return !throttle->pending &&
+        data->now - throttle->start >= VIR_OBJECT_EVENT_POLICY_WINDOW;
+}
+
+
+/**
+ * virObjectEventStateDispatchPending:
+ * @state: the event state object
+ *
+ * Deliver coalesced events whose window ended and forget about idle
+ * windows.
+ *
+ * Returns the number of milliseconds until another pending event is
+ * due, or -1 if there is none.
+ */
+static long long
+virObjectEventStateDispatchPending(virObjectEventStatePtr state)
+{
+    struct virObjectEventThrottleData data = { .deadline = -1 };
+    size_t cbCount = state->callbacks->count;
+    size_t i;
+    size_t j;
+
+    data.now = g_get_monotonic_time() / 1000;
+
+    for (i = 0; i < cbCount; i++) {
+        virObjectEventCallbackPtr cb = state->callbacks->callbacks[i];
+
+        if (!cb->throttle || cb->deleted)
+            continue;
+
+        if (virHashForEach(cb->throttle, virObjectEventThrottleCollect,
+                           &data) < 0)
+            VIR_DEBUG("Failed to collect pending events");
+
+        for (j = 0; j < data.npending; j++) {
+            virObjectEventPtr event = data.pending[j];
+
+            if (!cb->deleted) {
+                /* Drop the lock while dispatching, for sake of re-entrance */
+                virObjectUnlock(state);
+                event->dispatch(cb->conn, event, cb->cb, cb->opaque);
+                virObjectLock(state);
+            }
+            virObjectUnref(event);
+        }
+        VIR_FREE(data.pending);
+        data.npending = 0;
+
+        virHashRemoveSet(cb->throttle, virObjectEventThrottleExpired, &data);
+    }
+
+    if (data.deadline < 0)
+        return -1;
+    return data.deadline - data.now;
+}
+
+
 static void
 virObjectEventStateDispatchCallbacks(virObjectEventStatePtr state,
                                      virObjectEventPtr event,
@@ -696,6 +1120,9 @@ virObjectEventStateDispatchCallbacks(virObjectEventStatePtr state,
         if (!virObjectEventDispatchMatchCallback(event, cb))
             continue;
 
+        if (!virObjectEventCallbackAdmit(cb, event))
+            continue;
+
         /* Drop the lock while dispatching, for sake of re-entrance */
         virObjectUnlock(state);
         event->dispatch(cb->conn, event, cb->cb, cb->opaque);
@@ -748,14 +1175,28 @@ virObjectEventStateQueueRemote(virObjectEventStatePtr state,
 
     virObjectLock(state);
 
+    if (state->maxQueued && state->queue->count >= state->maxQueued) {
+        if (!state->overflow)
+            VIR_WARN("Event queue is full, dropping events");
+        state->overflow = true;
+        state->dropped++;
+        virObjectUnref(event);
+        virObjectUnlock(state);
+        return;
+    }
+
     event->remoteID = remoteID;
     if (virObjectEventQueuePush(state->queue, event) < 0) {
         VIR_DEBUG("Error adding event to queue");
         virObjectUnref(event);
     }
 
-    if (state->queue->count == 1)
-        virEventUpdateTimeout(state->timer, 0);
+    if (state->queue->count == 1) {
+        if (state->threadName)
+            virCondBroadcast(&state->cond);
+        else
+            virEventUpdateTimeout(state->timer, 0);
+    }
     virObjectUnlock(state);
 }
 
@@ -800,6 +1241,7 @@ static void
 virObjectEventStateFlush(virObjectEventStatePtr state)
 {
     virObjectEventQueue tempQueue;
+    long long timeout;
 
     /* We need to lock as well as ref due to the fact that we might
      * unref the state we're working on in this very function */
@@ -813,6 +1255,11 @@ virObjectEventStateFlush(virObjectEventStatePtr state)
     tempQueue.events = state->queue->events;
     state->queue->count = 0;
     state->queue->events = NULL;
+    if (state->overflow) {
+        VIR_WARN("Event queue drained, %llu events dropped so far",
+                 state->dropped);
+        state->overflow = false;
+    }
     if (state->timer != -1)
         virEventUpdateTimeout(state->timer, -1);
 
@@ -820,6 +1267,8 @@ virObjectEventStateFlush(virObjectEventStatePtr state)
                                      &tempQueue,
                                      state->callbacks);
 
+    timeout = virObjectEventStateDispatchPending(state);
+
     /* Purge any deleted callbacks */
     virObjectEventCallbackListPurgeMarked(state->callbacks);
 
@@ -827,6 +1276,11 @@ virObjectEventStateFlush(virObjectEventStatePtr state)
      * well like virObjectEventStateDeregisterID() would do. */
     virObjectEventStateCleanupTimer(state, true);
 
+    /* Wake up again when the next coalesced event is due unless events
+     * were queued meanwhile */
+    if (state->timer != -1 && timeout >= 0 && state->queue->count == 0)
+        virEventUpdateTimeout(state->timer, timeout);
+
     state->isDispatching = false;
     virObjectUnlock(state);
     virObjectUnref(state);
@@ -844,12 +1298,14 @@ virObjectEventStateFlush(virObjectEventStatePtr state)
  * @opaque: data blob to pass to @callback
  * @freecb: callback to free @opaque
  * @legacy: true if callback is tracked by function instead of callbackID
+ * @flags: bitwise-OR of virObjectEventCallbackFlags
  * @callbackID: filled with callback ID
  * @serverFilter: true if server supports object filtering
  *
  * Register the function @cb with connection @conn, from @state, for
  * events of type @eventID, and return the registration handle in
- * @callbackID.
+ * @callbackID.  @flags select the event policies applied to events
+ * delivered to @cb, see virObjectEventSetPolicy().
  *
  * The return value is only important when registering client-side
  * mirroring of remote events (since the public API is documented to
@@ -879,6 +1335,7 @@ virObjectEventStateRegisterID(virConnectPtr conn,
                               void *opaque,
                               virFreeCallback freecb,
                               bool legacy,
+                              unsigned int flags,
                               int *callbackID,
                               bool serverFilter)
 {
@@ -902,11 +1359,17 @@ virObjectEventStateRegisterID(virConnectPtr conn,
         virObjectRef(state);
     }
 
+    if (virObjectEventStateStartThreadLocked(state) < 0) {
+        virObjectEventStateCleanupTimer(state, false);
+        goto cleanup;
+    }
+
     ret = virObjectEventCallbackListAddID(conn, state->callbacks,
                                           key, filter, filter_opaque,
                                           klass, eventID,
                                           cb, opaque, freecb,
-                                          legacy, callbackID, serverFilter);
+                                          legacy, flags, callbackID,
+                                          serverFilter);
 
     if (ret < 0)
         virObjectEventStateCleanupTimer(state, false);
@@ -982,7 +1445,7 @@ virObjectEventStateCallbackID(virConnectPtr conn,
 
     virObjectLock(state);
     ret = virObjectEventCallbackLookup(conn, state->callbacks, NULL,
-                                       klass, eventID, callback, true,
+                                       klass, eventID, callback, true, 0,
                                        remoteID);
     virObjectUnlock(state);
 
@@ -994,6 +1457,52 @@ virObjectEventStateCallbackID(virConnectPtr conn,
 }
 
 
+/**
+ * virObjectEventStateCallbackDropped:
+ * @conn: connection associated with the callback
+ * @state: object event state
+ * @callbackID: the callback to query
+ * @dropped: filled with the number of dropped events
+ *
+ * Query how many events were not delivered to the callback @callbackID
+ * for connection @conn because it opted in for coalescing or rate
+ * limiting, see virObjectEventStateRegisterID().
+ *
+ * Returns 0 on success, -1 on error
+ */
+int
+virObjectEventStateCallbackDropped(virConnectPtr conn,
+                                   virObjectEventStatePtr state,
+                                   int callbackID,
+                                   unsigned long long *dropped)
+{
+    int ret = -1;
+    size_t i;
+    virObjectEventCallbackListPtr cbList = state->callbacks;
+
+    virObjectLock(state);
+    for (i = 0; i < cbList->count; i++) {
+        virObjectEventCallbackPtr cb = cbList->callbacks[i];
+
+        if (cb->deleted)
+            continue;
+
+        if (cb->callbackID == callbackID && cb->conn == conn) {
+            *dropped = cb->dropped;
+            ret = 0;
+            break;
+        }
+    }
+    virObjectUnlock(state);
+
+    if (ret < 0)
+        virReportError(VIR_ERR_INVALID_ARG,
+                       _("event callback id %d not registered"),
+                       callbackID);
+    return ret;
+}
+
+
 /**
  * virObjectEventStateEventID:
  * @conn: connection associated with the callback
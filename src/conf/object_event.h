@@ -37,9 +37,30 @@ typedef struct _virObjectEventState virObjectEventState;
 typedef virObjectEventState *virObjectEventStatePtr;
 
 
+/* Flags of a callback selecting which event policies apply to it.
+ * The values match virConnectDomainEventRegisterFlags. */
+typedef enum {
+    VIR_OBJECT_EVENT_CALLBACK_COALESCE = (1 << 0),
+    VIR_OBJECT_EVENT_CALLBACK_RATE_LIMIT = (1 << 1),
+} virObjectEventCallbackFlags;
+
 virObjectEventStatePtr
 virObjectEventStateNew(void);
 
+int
+virObjectEventStateUseThread(virObjectEventStatePtr state,
+                             const char *name,
+                             size_t maxQueued)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) G_GNUC_WARN_UNUSED_RESULT;
+
+void
+virObjectEventStateStopThread(virObjectEventStatePtr state)
+    ATTRIBUTE_NONNULL(1);
+
+unsigned long long
+virObjectEventStateGetDropped(virObjectEventStatePtr state)
+    ATTRIBUTE_NONNULL(1);
+
 /**
  * virConnectObjectEventGenericCallback:
  * @conn: the connection pointer
@@ -74,6 +95,13 @@ virObjectEventStateDeregisterID(virConnectPtr conn,
                                 bool doFreeCb)
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2);
 
+int
+virObjectEventStateCallbackDropped(virConnectPtr conn,
+                                   virObjectEventStatePtr state,
+                                   int callbackID,
+                                   unsigned long long *dropped)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(4);
+
 int
 virObjectEventStateEventID(virConnectPtr conn,
                            virObjectEventStatePtr state,
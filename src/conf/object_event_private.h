@@ -36,6 +36,14 @@ typedef virObjectMeta *virObjectMetaPtr;
 typedef struct _virObjectEventCallbackList virObjectEventCallbackList;
 typedef virObjectEventCallbackList *virObjectEventCallbackListPtr;
 
+typedef enum {
+    VIR_OBJECT_EVENT_POLICY_NONE = 0,
+    VIR_OBJECT_EVENT_POLICY_COALESCE,   /* only the latest event is delivered
+                                           within a window */
+    VIR_OBJECT_EVENT_POLICY_RATE_LIMIT, /* events over a limit within a window
+                                           are dropped */
+} virObjectEventPolicy;
+
 typedef void
 (*virObjectEventDispatchFunc)(virConnectPtr conn,
                               virObjectEventPtr event,
@@ -48,6 +56,8 @@ struct  __attribute__((aligned(8))) _virObjectEvent {
     virObjectMeta meta;
     int remoteID;
     virObjectEventDispatchFunc dispatch;
+    virObjectEventPolicy policy;
+    char *policyKey; /* events with the same key are throttled together */
 };
 
 /**
@@ -79,10 +89,11 @@ virObjectEventStateRegisterID(virConnectPtr conn,
                               void *opaque,
                               virFreeCallback freecb,
                               bool legacy,
+                              unsigned int flags,
                               int *callbackID,
                               bool remoteFilter)
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(6)
-    ATTRIBUTE_NONNULL(8) ATTRIBUTE_NONNULL(12);
+    ATTRIBUTE_NONNULL(8) ATTRIBUTE_NONNULL(13);
 
 int
 virObjectEventStateCallbackID(virConnectPtr conn,
@@ -104,3 +115,9 @@ virObjectEventNew(virClassPtr klass,
                   const char *key)
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(5)
     ATTRIBUTE_NONNULL(7);
+
+void
+virObjectEventSetPolicy(virObjectEventPtr event,
+                        virObjectEventPolicy policy,
+                        const char *key)
+    ATTRIBUTE_NONNULL(1);
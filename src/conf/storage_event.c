@@ -186,7 +186,7 @@ virStoragePoolEventStateRegisterID(virConnectPtr conn,
                                          virStoragePoolEventClass, eventID,
                                          VIR_OBJECT_EVENT_CALLBACK(cb),
                                          opaque, freecb,
-                                         false, callbackID, false);
+                                         false, 0, callbackID, false);
 }
 
 
@@ -230,7 +230,7 @@ virStoragePoolEventStateRegisterClient(virConnectPtr conn,
                                          virStoragePoolEventClass, eventID,
                                          VIR_OBJECT_EVENT_CALLBACK(cb),
                                          opaque, freecb,
-                                         false, callbackID, true);
+                                         false, 0, callbackID, true);
 }
 
 
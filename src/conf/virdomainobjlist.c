@@ -29,6 +29,7 @@
 #include "snapshot_conf.h"
 #include "viralloc.h"
 #include "virfile.h"
+#include "virhostcpu.h"
 #include "virlog.h"
 #include "virstring.h"
 #include "virdomainsnapshotobjlist.h"
@@ -52,6 +53,16 @@ struct _virDomainObjList {
     /* name -> virDomainObj mapping for O(1),
      * lockless lookup-by-name */
     virHashTable *objsName;
+
+    /* id string -> virDomainObj mapping for O(1) lookup-by-id of
+     * active domains. Entries don't hold a reference: a domain is
+     * dropped from here before it leaves @objs. Because drivers
+     * update def->id under the domain lock only, the table is guarded
+     * by @idLock rather than the list lock. Drivers must assign IDs
+     * using virDomainObjListSetID, domains missing from the table are
+     * never found by ID. */
+    virMutex idLock;
+    virHashTable *objsID;
 };
 
 
@@ -75,8 +86,16 @@ virDomainObjListPtr virDomainObjListNew(void)
     if (!(doms = virObjectRWLockableNew(virDomainObjListClass)))
         return NULL;
 
+    if (virMutexInit(&doms->idLock) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("cannot initialize mutex"));
+        virObjectUnref(doms);
+        return NULL;
+    }
+
     if (!(doms->objs = virHashCreate(50, virObjectFreeHashData)) ||
-        !(doms->objsName = virHashCreate(50, virObjectFreeHashData))) {
+        !(doms->objsName = virHashCreate(50, virObjectFreeHashData)) ||
+        !(doms->objsID = virHashCreate(50, NULL))) {
         virObjectUnref(doms);
         return NULL;
     }
@@ -89,25 +108,85 @@ static void virDomainObjListDispose(void *obj)
 {
     virDomainObjListPtr doms = obj;
 
+    virHashFree(doms->objsID);
     virHashFree(doms->objs);
     virHashFree(doms->objsName);
+    virMutexDestroy(&doms->idLock);
 }
 
 
-static int virDomainObjListSearchID(const void *payload,
-                                    const void *name G_GNUC_UNUSED,
-                                    const void *data)
+static void
+virDomainObjListFormatID(int id,
+                         char *idstr)
 {
-    virDomainObjPtr obj = (virDomainObjPtr)payload;
-    const int *id = data;
-    int want = 0;
+    g_snprintf(idstr, VIR_INT64_STR_BUFLEN, "%d", id);
+}
 
-    virObjectLock(obj);
-    if (virDomainObjIsActive(obj) &&
-        obj->def->id == *id)
-        want = 1;
-    virObjectUnlock(obj);
-    return want;
+
+static int
+virDomainObjListSearchPtr(const void *payload,
+                          const void *name G_GNUC_UNUSED,
+                          const void *data)
+{
+    return payload == data;
+}
+
+
+/* The caller must hold @doms->idLock */
+static void
+virDomainObjListIndexIDLocked(virDomainObjListPtr doms,
+                              virDomainObjPtr vm,
+                              int id)
+{
+    char idstr[VIR_INT64_STR_BUFLEN];
+
+    if (id < 0)
+        return;
+
+    virDomainObjListFormatID(id, idstr);
+    if (virHashUpdateEntry(doms->objsID, idstr, vm) < 0)
+        VIR_WARN("Failed to index domain with ID %d", id);
+}
+
+
+/* The caller must hold @doms->idLock */
+static void
+virDomainObjListUnindexIDLocked(virDomainObjListPtr doms,
+                                virDomainObjPtr vm,
+                                int id)
+{
+    char idstr[VIR_INT64_STR_BUFLEN];
+
+    if (id < 0)
+        return;
+
+    virDomainObjListFormatID(id, idstr);
+    if (virHashLookup(doms->objsID, idstr) == vm)
+        virHashRemoveEntry(doms->objsID, idstr);
+}
+
+
+/**
+ * virDomainObjListSetID:
+ * @doms: Domain object list pointer
+ * @vm: Domain object
+ * @id: new ID of the domain, or -1 when it stops running
+ *
+ * Set vm->def->id to @id and update the lookup-by-id table of @doms
+ * accordingly. The caller must hold a lock on @vm. Unlike most of
+ * the list APIs this doesn't take the list lock, hence it is safe to
+ * call from anywhere a driver would assign the ID.
+ */
+void
+virDomainObjListSetID(virDomainObjListPtr doms,
+                      virDomainObjPtr vm,
+                      int id)
+{
+    virMutexLock(&doms->idLock);
+    virDomainObjListUnindexIDLocked(doms, vm, vm->def->id);
+    vm->def->id = id;
+    virDomainObjListIndexIDLocked(doms, vm, id);
+    virMutexUnlock(&doms->idLock);
 }
 
 
@@ -116,19 +195,25 @@ virDomainObjListFindByID(virDomainObjListPtr doms,
                          int id)
 {
     virDomainObjPtr obj;
+    char idstr[VIR_INT64_STR_BUFLEN];
 
-    virObjectRWLockRead(doms);
-    obj = virHashSearch(doms->objs, virDomainObjListSearchID, &id, NULL);
+    virDomainObjListFormatID(id, idstr);
+
+    virMutexLock(&doms->idLock);
+    obj = virHashLookup(doms->objsID, idstr);
     virObjectRef(obj);
-    virObjectRWUnlock(doms);
-    if (obj) {
-        virObjectLock(obj);
-        if (obj->removing) {
-            virObjectUnlock(obj);
-            virObjectUnref(obj);
-            obj = NULL;
-        }
-    }
+    virMutexUnlock(&doms->idLock);
+
+    if (!obj)
+        return NULL;
+
+    /* The entry may be stale if the definition of the domain was
+     * replaced without going through virDomainObjListSetID */
+    virObjectLock(obj);
+    if (obj->removing ||
+        !virDomainObjIsActive(obj) ||
+        obj->def->id != id)
+        virDomainObjEndAPI(&obj);
 
     return obj;
 }
@@ -255,6 +340,10 @@ virDomainObjListAddObjLocked(virDomainObjListPtr doms,
     }
     virObjectRef(vm);
 
+    virMutexLock(&doms->idLock);
+    virDomainObjListIndexIDLocked(doms, vm, vm->def->id);
+    virMutexUnlock(&doms->idLock);
+
     return 0;
 }
 
@@ -323,6 +412,14 @@ virDomainObjListAddLocked(virDomainObjListPtr doms,
                               def,
                               !!(flags & VIR_DOMAIN_OBJ_LIST_ADD_LIVE),
                               oldDef);
+
+        if (flags & VIR_DOMAIN_OBJ_LIST_ADD_LIVE) {
+            /* the new live definition may come with a different ID */
+            virMutexLock(&doms->idLock);
+            virHashRemoveSet(doms->objsID, virDomainObjListSearchPtr, vm);
+            virDomainObjListIndexIDLocked(doms, vm, vm->def->id);
+            virMutexUnlock(&doms->idLock);
+        }
     } else {
         /* UUID does not match, but if a name matches, refuse it */
         if ((vm = virDomainObjListFindByNameLocked(doms, def->name))) {
@@ -380,6 +477,12 @@ virDomainObjListRemoveLocked(virDomainObjListPtr doms,
 
     virUUIDFormat(dom->def->uuid, uuidstr);
 
+    /* The definition may have been replaced since the domain was
+     * indexed, so don't rely on def->id to find the entry. */
+    virMutexLock(&doms->idLock);
+    virHashRemoveSet(doms->objsID, virDomainObjListSearchPtr, dom);
+    virMutexUnlock(&doms->idLock);
+
     virHashRemoveEntry(doms->objs, uuidstr);
     virHashRemoveEntry(doms->objsName, dom->def->name);
 }
@@ -481,20 +584,45 @@ virDomainObjListRename(virDomainObjListPtr doms,
 }
 
 
-static virDomainObjPtr
-virDomainObjListLoadConfig(virDomainObjListPtr doms,
-                           virDomainXMLOptionPtr xmlopt,
-                           const char *configDir,
-                           const char *autostartDir,
-                           const char *name,
-                           virDomainLoadConfigNotify notify,
-                           void *opaque)
+/* Upper bound on the number of threads parsing domain XMLs in
+ * virDomainObjListLoadAllConfigs */
+#define VIR_DOMAIN_OBJ_LIST_LOAD_MAX_WORKERS 16
+
+typedef struct _virDomainObjListLoadEntry virDomainObjListLoadEntry;
+typedef virDomainObjListLoadEntry *virDomainObjListLoadEntryPtr;
+struct _virDomainObjListLoadEntry {
+    char *name;
+
+    /* Results of parsing, filled in by the workers */
+    virDomainDefPtr def;
+    int autostart;
+    virDomainObjPtr obj;
+};
+
+typedef struct _virDomainObjListLoadData virDomainObjListLoadData;
+typedef virDomainObjListLoadData *virDomainObjListLoadDataPtr;
+struct _virDomainObjListLoadData {
+    const char *configDir;
+    const char *autostartDir;
+    bool liveStatus;
+    virDomainXMLOptionPtr xmlopt;
+
+    virDomainObjListLoadEntryPtr entries;
+    size_t nentries;
+    int next; /* index of the next entry to parse, updated atomically */
+};
+
+
+static virDomainDefPtr
+virDomainObjListParseConfig(virDomainXMLOptionPtr xmlopt,
+                            const char *configDir,
+                            const char *autostartDir,
+                            const char *name,
+                            int *autostart)
 {
-    char *configFile = NULL, *autostartLink = NULL;
+    g_autofree char *configFile = NULL;
+    g_autofree char *autostartLink = NULL;
     virDomainDefPtr def = NULL;
-    virDomainObjPtr dom;
-    int autostart;
-    virDomainDefPtr oldDef = NULL;
 
     if ((configFile = virDomainConfigFile(configDir, name)) == NULL)
         goto error;
@@ -507,11 +635,31 @@ virDomainObjListLoadConfig(virDomainObjListPtr doms,
     if ((autostartLink = virDomainConfigFile(autostartDir, name)) == NULL)
         goto error;
 
-    if ((autostart = virFileLinkPointsTo(autostartLink, configFile)) < 0)
+    if ((*autostart = virFileLinkPointsTo(autostartLink, configFile)) < 0)
         goto error;
 
-    if (!(dom = virDomainObjListAddLocked(doms, def, xmlopt, 0, &oldDef)))
-        goto error;
+    return def;
+
+ error:
+    virDomainDefFree(def);
+    return NULL;
+}
+
+
+static virDomainObjPtr
+virDomainObjListLoadConfig(virDomainObjListPtr doms,
+                           virDomainXMLOptionPtr xmlopt,
+                           virDomainDefPtr *def,
+                           int autostart,
+                           virDomainLoadConfigNotify notify,
+                           void *opaque)
+{
+    virDomainObjPtr dom;
+    virDomainDefPtr oldDef = NULL;
+
+    if (!(dom = virDomainObjListAddLocked(doms, *def, xmlopt, 0, &oldDef)))
+        return NULL;
+    *def = NULL;
 
     dom->autostart = autostart;
 
@@ -519,32 +667,24 @@ virDomainObjListLoadConfig(virDomainObjListPtr doms,
         (*notify)(dom, oldDef == NULL, opaque);
 
     virDomainDefFree(oldDef);
-    VIR_FREE(configFile);
-    VIR_FREE(autostartLink);
     return dom;
-
- error:
-    VIR_FREE(configFile);
-    VIR_FREE(autostartLink);
-    virDomainDefFree(def);
-    return NULL;
 }
 
 
+/*
+ * The returned object is unlocked, as it may be handed over to
+ * a different thread.
+ */
 static virDomainObjPtr
-virDomainObjListLoadStatus(virDomainObjListPtr doms,
-                           const char *statusDir,
-                           const char *name,
-                           virDomainXMLOptionPtr xmlopt,
-                           virDomainLoadConfigNotify notify,
-                           void *opaque)
+virDomainObjListParseStatus(virDomainXMLOptionPtr xmlopt,
+                            const char *statusDir,
+                            const char *name)
 {
-    char *statusFile = NULL;
-    virDomainObjPtr obj = NULL;
-    char uuidstr[VIR_UUID_STRING_BUFLEN];
+    g_autofree char *statusFile = NULL;
+    virDomainObjPtr obj;
 
     if ((statusFile = virDomainConfigFile(statusDir, name)) == NULL)
-        goto error;
+        return NULL;
 
     if (!(obj = virDomainObjParseFile(statusFile, xmlopt,
                                       VIR_DOMAIN_DEF_PARSE_STATUS |
@@ -552,7 +692,23 @@ virDomainObjListLoadStatus(virDomainObjListPtr doms,
                                       VIR_DOMAIN_DEF_PARSE_PCI_ORIG_STATES |
                                       VIR_DOMAIN_DEF_PARSE_SKIP_VALIDATE |
                                       VIR_DOMAIN_DEF_PARSE_ALLOW_POST_PARSE_FAIL)))
-        goto error;
+        return NULL;
+
+    virObjectUnlock(obj);
+    return obj;
+}
+
+
+static virDomainObjPtr
+virDomainObjListLoadStatus(virDomainObjListPtr doms,
+                           virDomainObjPtr *parsed,
+                           virDomainLoadConfigNotify notify,
+                           void *opaque)
+{
+    virDomainObjPtr obj = g_steal_pointer(parsed);
+    char uuidstr[VIR_UUID_STRING_BUFLEN];
+
+    virObjectLock(obj);
 
     virUUIDFormat(obj->def->uuid, uuidstr);
 
@@ -569,16 +725,87 @@ virDomainObjListLoadStatus(virDomainObjListPtr doms,
     if (notify)
         (*notify)(obj, 1, opaque);
 
-    VIR_FREE(statusFile);
     return obj;
 
  error:
     virDomainObjEndAPI(&obj);
-    VIR_FREE(statusFile);
     return NULL;
 }
 
 
+static void
+virDomainObjListLoadWorker(void *opaque)
+{
+    virDomainObjListLoadDataPtr data = opaque;
+    int i;
+
+    while ((i = g_atomic_int_add(&data->next, 1)) < (int) data->nentries) {
+        virDomainObjListLoadEntryPtr entry = &data->entries[i];
+
+        /* NB: ignoring errors, so one malformed config doesn't
+           kill the whole process */
+        VIR_INFO("Loading config file '%s.xml'", entry->name);
+        if (data->liveStatus)
+            entry->obj = virDomainObjListParseStatus(data->xmlopt,
+                                                     data->configDir,
+                                                     entry->name);
+        else
+            entry->def = virDomainObjListParseConfig(data->xmlopt,
+                                                     data->configDir,
+                                                     data->autostartDir,
+                                                     entry->name,
+                                                     &entry->autostart);
+    }
+}
+
+
+/*
+ * Parse all entries of @data, using up to
+ * VIR_DOMAIN_OBJ_LIST_LOAD_MAX_WORKERS threads including the calling
+ * one. Returns the number of threads used.
+ */
+static size_t
+virDomainObjListLoadParse(virDomainObjListLoadDataPtr data)
+{
+    g_autofree virThread *threads = NULL;
+    size_t nthreads = 0;
+    size_t maxthreads;
+    int ncpus;
+    size_t i;
+
+    if ((ncpus = virHostCPUGetCount()) < 1) {
+        virResetLastError();
+        ncpus = 1;
+    }
+
+    maxthreads = MIN(data->nentries, VIR_DOMAIN_OBJ_LIST_LOAD_MAX_WORKERS);
+    maxthreads = MIN(maxthreads, ncpus);
+
+    if (maxthreads > 1) {
+        threads = g_new0(virThread, maxthreads - 1);
+
+        for (i = 0; i < maxthreads - 1; i++) {
+            if (virThreadCreateFull(&threads[i], true,
+                                    virDomainObjListLoadWorker,
+                                    "domain-load", false, data) < 0) {
+                /* Not fatal, the remaining threads parse the rest */
+                VIR_WARN("Failed to start thread for loading domain configs");
+                virResetLastError();
+                break;
+            }
+            nthreads++;
+        }
+    }
+
+    virDomainObjListLoadWorker(data);
+
+    for (i = 0; i < nthreads; i++)
+        virThreadJoin(&threads[i]);
+
+    return nthreads + 1;
+}
+
+
 int
 virDomainObjListLoadAllConfigs(virDomainObjListPtr doms,
                                const char *configDir,
@@ -590,6 +817,18 @@ virDomainObjListLoadAllConfigs(virDomainObjListPtr doms,
 {
     DIR *dir;
     struct dirent *entry;
+    virDomainObjListLoadData data = {
+        .configDir = configDir,
+        .autostartDir = autostartDir,
+        .liveStatus = liveStatus,
+        .xmlopt = xmlopt,
+    };
+    unsigned long long start = g_get_monotonic_time();
+    unsigned long long parseStart;
+    unsigned long long insertStart;
+    size_t nthreads = 0;
+    size_t nloaded = 0;
+    size_t i;
     int ret = -1;
     int rc;
 
@@ -598,43 +837,73 @@ virDomainObjListLoadAllConfigs(virDomainObjListPtr doms,
     if ((rc = virDirOpenIfExists(&dir, configDir)) <= 0)
         return rc;
 
-    virObjectRWLockWrite(doms);
-
     while ((ret = virDirRead(dir, &entry, configDir)) > 0) {
-        virDomainObjPtr dom;
+        virDomainObjListLoadEntry loadEntry = { 0 };
 
         if (!virStringStripSuffix(entry->d_name, ".xml"))
             continue;
 
-        /* NB: ignoring errors, so one malformed config doesn't
-           kill the whole process */
-        VIR_INFO("Loading config file '%s.xml'", entry->d_name);
-        if (liveStatus)
-            dom = virDomainObjListLoadStatus(doms,
-                                             configDir,
-                                             entry->d_name,
-                                             xmlopt,
-                                             notify,
-                                             opaque);
-        else
-            dom = virDomainObjListLoadConfig(doms,
-                                             xmlopt,
-                                             configDir,
-                                             autostartDir,
-                                             entry->d_name,
-                                             notify,
-                                             opaque);
+        loadEntry.name = g_strdup(entry->d_name);
+        if (VIR_APPEND_ELEMENT(data.entries, data.nentries, loadEntry) < 0) {
+            VIR_FREE(loadEntry.name);
+            ret = -1;
+            break;
+        }
+    }
+
+    /* NB: even if reading the directory failed, load the configs that
+     * were found so far, as the serial loop always did */
+
+    VIR_DIR_CLOSE(dir);
+
+    /* Parsing is the expensive part and doesn't need the list, so do
+     * it in parallel first and only then add the domains one by one,
+     * in the order they were found in. */
+    parseStart = g_get_monotonic_time();
+    if (data.nentries > 0)
+        nthreads = virDomainObjListLoadParse(&data);
+
+    insertStart = g_get_monotonic_time();
+    virObjectRWLockWrite(doms);
+
+    for (i = 0; i < data.nentries; i++) {
+        virDomainObjListLoadEntryPtr loadEntry = &data.entries[i];
+        virDomainObjPtr dom = NULL;
+
+        if (liveStatus && loadEntry->obj)
+            dom = virDomainObjListLoadStatus(doms, &loadEntry->obj,
+                                             notify, opaque);
+        else if (!liveStatus && loadEntry->def)
+            dom = virDomainObjListLoadConfig(doms, xmlopt, &loadEntry->def,
+                                             loadEntry->autostart,
+                                             notify, opaque);
+
         if (dom) {
             if (!liveStatus)
                 dom->persistent = 1;
             virDomainObjEndAPI(&dom);
+            nloaded++;
         } else {
-            VIR_ERROR(_("Failed to load config for domain '%s'"), entry->d_name);
+            VIR_ERROR(_("Failed to load config for domain '%s'"),
+                      loadEntry->name);
         }
+
+        virObjectUnref(loadEntry->obj);
+        virDomainDefFree(loadEntry->def);
+        VIR_FREE(loadEntry->name);
     }
 
-    VIR_DIR_CLOSE(dir);
     virObjectRWUnlock(doms);
+    VIR_FREE(data.entries);
+
+    VIR_INFO("Loaded %zu of %zu configs from %s in %llu ms "
+             "(scan %llu ms, parse %llu ms using %zu threads, insert %llu ms)",
+             nloaded, data.nentries, configDir,
+             (g_get_monotonic_time() - start) / 1000,
+             (parseStart - start) / 1000,
+             (insertStart - parseStart) / 1000, nthreads,
+             (g_get_monotonic_time() - insertStart) / 1000);
+
     return ret;
 }
 
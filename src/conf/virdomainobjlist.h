@@ -57,6 +57,10 @@ int virDomainObjListRename(virDomainObjListPtr doms,
                            virDomainObjListRenameCallback callback,
                            void *opaque);
 
+void virDomainObjListSetID(virDomainObjListPtr doms,
+                           virDomainObjPtr vm,
+                           int id);
+
 void virDomainObjListRemove(virDomainObjListPtr doms,
                             virDomainObjPtr dom);
 void virDomainObjListRemoveLocked(virDomainObjListPtr doms,
@@ -1387,6 +1387,15 @@ typedef char *
 (*virDrvDomainBackupGetXMLDesc)(virDomainPtr domain,
                                 unsigned int flags);
 
+typedef int
+(*virDrvConnectDomainEventRegisterAnyFlags)(virConnectPtr conn,
+                                            virDomainPtr dom,
+                                            int eventID,
+                                            virConnectDomainEventGenericCallback cb,
+                                            void *opaque,
+                                            virFreeCallback freecb,
+                                            unsigned int flags);
+
 typedef struct _virHypervisorDriver virHypervisorDriver;
 typedef virHypervisorDriver *virHypervisorDriverPtr;
 
@@ -1650,4 +1659,5 @@ struct _virHypervisorDriver {
     virDrvDomainAgentSetResponseTimeout domainAgentSetResponseTimeout;
     virDrvDomainBackupBegin domainBackupBegin;
     virDrvDomainBackupGetXMLDesc domainBackupGetXMLDesc;
+    virDrvConnectDomainEventRegisterAnyFlags connectDomainEventRegisterAnyFlags;
 };
@@ -9310,6 +9310,88 @@ virConnectDomainEventRegisterAny(virConnectPtr conn,
 }
 
 
+/**
+ * virConnectDomainEventRegisterAnyFlags:
+ * @conn: pointer to the connection
+ * @dom: pointer to the domain
+ * @eventID: the event type to receive
+ * @cb: callback to the function handling domain events
+ * @opaque: opaque data to pass on to the callback
+ * @freecb: optional function to deallocate opaque when not used anymore
+ * @flags: bitwise-OR of virConnectDomainEventRegisterFlags
+ *
+ * Adds a callback to receive notifications of arbitrary domain events
+ * occurring on a domain, just like virConnectDomainEventRegisterAny().
+ *
+ * Some events, for example VIR_DOMAIN_EVENT_ID_RTC_CHANGE or
+ * VIR_DOMAIN_EVENT_ID_BALLOON_CHANGE, may be emitted by a guest at a
+ * high rate.  With VIR_CONNECT_DOMAIN_EVENT_REGISTER_COALESCE only the
+ * first of such events within a short time window (about a second) is
+ * delivered right away; the latest of the remaining ones is delivered
+ * when the window ends and the others are dropped.  With
+ * VIR_CONNECT_DOMAIN_EVENT_REGISTER_RATE_LIMIT events such as
+ * VIR_DOMAIN_EVENT_ID_JOB_COMPLETED which cannot be coalesced are
+ * dropped once a fixed number of them was delivered within the window.
+ * Events reporting state transitions, such as lifecycle or block job
+ * events, are always delivered.
+ *
+ * The policies are applied by the server, hence when connected to a
+ * remote daemon the events never cross the network.  The callback is
+ * not told how many events were dropped, their number is only logged
+ * by the server at the info level.
+ *
+ * Returns a callback identifier on success, -1 on failure.
+ */
+int
+virConnectDomainEventRegisterAnyFlags(virConnectPtr conn,
+                                      virDomainPtr dom,
+                                      int eventID,
+                                      virConnectDomainEventGenericCallback cb,
+                                      void *opaque,
+                                      virFreeCallback freecb,
+                                      unsigned int flags)
+{
+    VIR_DOMAIN_DEBUG(dom, "conn=%p, eventID=%d, cb=%p, opaque=%p, freecb=%p, "
+                     "flags=0x%x", conn, eventID, cb, opaque, freecb, flags);
+
+    virResetLastError();
+
+    virCheckConnectReturn(conn, -1);
+    if (dom) {
+        virCheckDomainGoto(dom, error);
+        if (dom->conn != conn) {
+            virReportInvalidArg(dom,
+                                _("domain '%s' must match connection"),
+                                dom->name);
+            goto error;
+        }
+    }
+    virCheckNonNullArgGoto(cb, error);
+    virCheckNonNegativeArgGoto(eventID, error);
+    if (eventID >= VIR_DOMAIN_EVENT_ID_LAST) {
+        virReportInvalidArg(eventID,
+                            _("eventID must be less than %d"),
+                            VIR_DOMAIN_EVENT_ID_LAST);
+        goto error;
+    }
+
+    if (conn->driver && conn->driver->connectDomainEventRegisterAnyFlags) {
+        int ret;
+        ret = conn->driver->connectDomainEventRegisterAnyFlags(conn, dom, eventID,
+                                                               cb, opaque, freecb,
+                                                               flags);
+        if (ret < 0)
+            goto error;
+        return ret;
+    }
+
+    virReportUnsupportedError();
+ error:
+    virDispatchError(conn);
+    return -1;
+}
+
+
 /**
  * virConnectDomainEventDeregisterAny:
  * @conn: pointer to the connection
@@ -527,6 +527,22 @@ virStreamInData(virStreamPtr stream,
 }
 
 
+/*
+ * Size of the chunks the *All helpers transfer at once. Over a remote
+ * connection each one is sent as a single stream packet so use large
+ * ones if the server can take them.
+ */
+static size_t
+virStreamGetPacketSize(virStreamPtr stream)
+{
+    if (VIR_DRV_SUPPORTS_FEATURE(stream->conn->driver, stream->conn,
+                                 VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PACKETS))
+        return VIR_NET_MESSAGE_STREAM_PAYLOAD;
+
+    return VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
+}
+
+
 /**
  * virStreamSendAll:
  * @stream: pointer to the stream object
@@ -573,7 +589,7 @@ virStreamSendAll(virStreamPtr stream,
                  void *opaque)
 {
     g_autofree char *bytes = NULL;
-    size_t want = VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
+    size_t want;
     int ret = -1;
     VIR_DEBUG("stream=%p, handler=%p, opaque=%p", stream, handler, opaque);
 
@@ -588,6 +604,7 @@ virStreamSendAll(virStreamPtr stream,
         goto cleanup;
     }
 
+    want = virStreamGetPacketSize(stream);
     if (VIR_ALLOC_N(bytes, want) < 0)
         goto cleanup;
 
@@ -704,7 +721,7 @@ int virStreamSparseSendAll(virStreamPtr stream,
                            void *opaque)
 {
     g_autofree char *bytes = NULL;
-    size_t bufLen = VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
+    size_t bufLen;
     int ret = -1;
     unsigned long long dataLen = 0;
 
@@ -724,6 +741,7 @@ int virStreamSparseSendAll(virStreamPtr stream,
         goto cleanup;
     }
 
+    bufLen = virStreamGetPacketSize(stream);
     if (VIR_ALLOC_N(bytes, bufLen) < 0)
         goto cleanup;
 
@@ -843,7 +861,7 @@ virStreamRecvAll(virStreamPtr stream,
                  void *opaque)
 {
     g_autofree char *bytes = NULL;
-    size_t want = VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
+    size_t want;
     int ret = -1;
     VIR_DEBUG("stream=%p, handler=%p, opaque=%p", stream, handler, opaque);
 
@@ -859,6 +877,7 @@ virStreamRecvAll(virStreamPtr stream,
     }
 
 
+    want = virStreamGetPacketSize(stream);
     if (VIR_ALLOC_N(bytes, want) < 0)
         goto cleanup;
 
@@ -958,7 +977,7 @@ virStreamSparseRecvAll(virStreamPtr stream,
                        void *opaque)
 {
     g_autofree char *bytes = NULL;
-    size_t want = VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
+    size_t want;
     const unsigned int flags = VIR_STREAM_RECV_STOP_AT_HOLE;
     int ret = -1;
 
@@ -977,6 +996,7 @@ virStreamSparseRecvAll(virStreamPtr stream,
         goto cleanup;
     }
 
+    want = virStreamGetPacketSize(stream);
     if (VIR_ALLOC_N(bytes, want) < 0)
         goto cleanup;
 
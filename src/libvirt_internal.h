@@ -124,6 +124,18 @@ typedef enum {
      * Support for driver close callback rpc
      */
     VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK = 15,
+
+    /*
+     * Remote party accepts stream data packets of up to
+     * VIR_NET_MESSAGE_PAYLOAD_MAX bytes.
+     */
+    VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PACKETS = 16,
+
+    /*
+     * Remote party accepts multiple events packed into a single
+     * REMOTE_PROC_EVENT_BATCH message.
+     */
+    VIR_DRV_FEATURE_REMOTE_EVENT_BATCH = 17,
 } virDrvFeature;
 
 
@@ -426,7 +426,7 @@ libxlReconnectDomain(virDomainObjPtr vm,
     }
 
     /* Update domid in case it changed (e.g. reboot) while we were gone? */
-    vm->def->id = d_info.domid;
+    virDomainObjListSetID(driver->domains, vm, d_info.domid);
 
     libxlLoggerOpenFile(cfg->logger, vm->def->id, vm->def->name, NULL);
 
@@ -1547,7 +1547,7 @@ libxlDomainPMWakeup(virDomainPtr dom, unsigned int flags)
 
  destroy_dom:
     libxlDomainDestroyInternal(driver, vm);
-    vm->def->id = -1;
+    virDomainObjListSetID(driver->domains, vm, -1);
     virDomainObjSetState(vm, VIR_DOMAIN_SHUTOFF, VIR_DOMAIN_SHUTOFF_FAILED);
     event = virDomainEventLifecycleNewFromObj(vm, VIR_DOMAIN_EVENT_STOPPED,
                                               VIR_DOMAIN_EVENT_STOPPED_FAILED);
@@ -5716,6 +5716,32 @@ libxlConnectDomainEventRegisterAny(virConnectPtr conn, virDomainPtr dom, int eve
 }
 
 
+static int
+libxlConnectDomainEventRegisterAnyFlags(virConnectPtr conn,
+                                        virDomainPtr dom,
+                                        int eventID,
+                                        virConnectDomainEventGenericCallback callback,
+                                        void *opaque,
+                                        virFreeCallback freecb,
+                                        unsigned int flags)
+{
+    libxlDriverPrivatePtr driver = conn->privateData;
+    int ret;
+
+    if (virConnectDomainEventRegisterAnyFlagsEnsureACL(conn) < 0)
+        return -1;
+
+    if (virDomainEventStateRegisterIDFlags(conn,
+                                           driver->domainEventState,
+                                           dom, eventID,
+                                           callback, opaque, freecb,
+                                           flags, &ret) < 0)
+        ret = -1;
+
+    return ret;
+}
+
+
 static int
 libxlConnectDomainEventDeregisterAny(virConnectPtr conn, int callbackID)
 {
@@ -5777,7 +5803,9 @@ libxlConnectSupportsFeature(virConnectPtr conn, int feature)
     case VIR_DRV_FEATURE_PROGRAM_KEEPALIVE:
     case VIR_DRV_FEATURE_REMOTE:
     case VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK:
+    case VIR_DRV_FEATURE_REMOTE_EVENT_BATCH:
     case VIR_DRV_FEATURE_REMOTE_EVENT_CALLBACK:
+    case VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PACKETS:
     case VIR_DRV_FEATURE_XML_MIGRATABLE:
     default:
         return 0;
@@ -6764,6 +6792,7 @@ static virHypervisorDriver libxlHypervisorDriver = {
     .domainSetMetadata = libxlDomainSetMetadata, /* 5.7.0 */
     .domainGetMetadata = libxlDomainGetMetadata, /* 5.7.0 */
 
+    .connectDomainEventRegisterAnyFlags = libxlConnectDomainEventRegisterAnyFlags, /* 6.7.0 */
 };
 
 static virConnectDriver libxlConnectDriver = {
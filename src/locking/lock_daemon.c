@@ -1121,6 +1121,7 @@ int main(int argc, char **argv) {
 
     if (!(lockProgram = virNetServerProgramNew(VIR_LOCK_SPACE_PROTOCOL_PROGRAM,
                                                VIR_LOCK_SPACE_PROTOCOL_PROGRAM_VERSION,
+                                               "virtlockd",
                                                virLockSpaceProtocolProcs,
                                                virLockSpaceProtocolNProcs))) {
         ret = VIR_DAEMON_ERR_INIT;
@@ -1135,6 +1136,7 @@ int main(int argc, char **argv) {
     if (adminSrv != NULL) {
         if (!(adminProgram = virNetServerProgramNew(ADMIN_PROGRAM,
                                                     ADMIN_PROTOCOL_VERSION,
+                                                    "admin",
                                                     adminProcs,
                                                     adminNProcs))) {
             ret = VIR_DAEMON_ERR_INIT;
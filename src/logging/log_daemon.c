@@ -901,6 +901,7 @@ int main(int argc, char **argv) {
 
     if (!(logProgram = virNetServerProgramNew(VIR_LOG_MANAGER_PROTOCOL_PROGRAM,
                                               VIR_LOG_MANAGER_PROTOCOL_PROGRAM_VERSION,
+                                              "virtlogd",
                                               virLogManagerProtocolProcs,
                                               virLogManagerProtocolNProcs))) {
         ret = VIR_DAEMON_ERR_INIT;
@@ -914,6 +915,7 @@ int main(int argc, char **argv) {
     if (adminSrv != NULL) {
         if (!(adminProgram = virNetServerProgramNew(ADMIN_PROGRAM,
                                                     ADMIN_PROTOCOL_VERSION,
+                                                    "admin",
                                                     adminProcs,
                                                     adminNProcs))) {
             ret = VIR_DAEMON_ERR_INIT;
@@ -979,6 +979,7 @@ static int virLXCControllerSetupServer(virLXCControllerPtr ctrl)
 
     if (!(ctrl->prog = virNetServerProgramNew(VIR_LXC_MONITOR_PROGRAM,
                                               VIR_LXC_MONITOR_PROGRAM_VERSION,
+                                              "lxc-monitor",
                                               virLXCMonitorProcs,
                                               virLXCMonitorNProcs)))
         goto error;
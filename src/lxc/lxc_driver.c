@@ -1336,6 +1336,32 @@ lxcConnectDomainEventRegisterAny(virConnectPtr conn,
 }
 
 
+static int
+lxcConnectDomainEventRegisterAnyFlags(virConnectPtr conn,
+                                      virDomainPtr dom,
+                                      int eventID,
+                                      virConnectDomainEventGenericCallback callback,
+                                      void *opaque,
+                                      virFreeCallback freecb,
+                                      unsigned int flags)
+{
+    virLXCDriverPtr driver = conn->privateData;
+    int ret;
+
+    if (virConnectDomainEventRegisterAnyFlagsEnsureACL(conn) < 0)
+        return -1;
+
+    if (virDomainEventStateRegisterIDFlags(conn,
+                                           driver->domainEventState,
+                                           dom, eventID,
+                                           callback, opaque, freecb,
+                                           flags, &ret) < 0)
+        ret = -1;
+
+    return ret;
+}
+
+
 static int
 lxcConnectDomainEventDeregisterAny(virConnectPtr conn,
                                    int callbackID)
@@ -1660,7 +1686,9 @@ lxcConnectSupportsFeature(virConnectPtr conn, int feature)
     case VIR_DRV_FEATURE_PROGRAM_KEEPALIVE:
     case VIR_DRV_FEATURE_REMOTE:
     case VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK:
+    case VIR_DRV_FEATURE_REMOTE_EVENT_BATCH:
     case VIR_DRV_FEATURE_REMOTE_EVENT_CALLBACK:
+    case VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PACKETS:
     case VIR_DRV_FEATURE_XML_MIGRATABLE:
     default:
         return 0;
@@ -5163,6 +5191,7 @@ static virHypervisorDriver lxcHypervisorDriver = {
     .nodeGetFreePages = lxcNodeGetFreePages, /* 1.2.6 */
     .nodeAllocPages = lxcNodeAllocPages, /* 1.2.9 */
     .domainHasManagedSaveImage = lxcDomainHasManagedSaveImage, /* 1.2.13 */
+    .connectDomainEventRegisterAnyFlags = lxcConnectDomainEventRegisterAnyFlags, /* 6.7.0 */
 };
 
 static virConnectDriver lxcConnectDriver = {
@@ -562,7 +562,7 @@ openvzDomainShutdownFlags(virDomainPtr dom,
     if (virCommandRun(cmd, NULL) < 0)
         goto cleanup;
 
-    vm->def->id = -1;
+    virDomainObjListSetID(driver->domains, vm, -1);
     virDomainObjSetState(vm, VIR_DOMAIN_SHUTOFF, VIR_DOMAIN_SHUTOFF_SHUTDOWN);
     dom->id = -1;
     ret = 0;
@@ -972,7 +972,7 @@ openvzDomainCreateXML(virConnectPtr conn, const char *xml,
         goto cleanup;
 
     vm->pid = strtoI(vm->def->name);
-    vm->def->id = vm->pid;
+    virDomainObjListSetID(driver->domains, vm, vm->pid);
     virDomainObjSetState(vm, VIR_DOMAIN_RUNNING, VIR_DOMAIN_RUNNING_BOOTED);
 
     if (virDomainDefGetVcpusMax(vm->def) > 0) {
@@ -1029,7 +1029,7 @@ openvzDomainCreateWithFlags(virDomainPtr dom, unsigned int flags)
         goto cleanup;
 
     vm->pid = strtoI(vm->def->name);
-    vm->def->id = vm->pid;
+    virDomainObjListSetID(driver->domains, vm, vm->pid);
     dom->id = vm->pid;
     virDomainObjSetState(vm, VIR_DOMAIN_RUNNING, VIR_DOMAIN_RUNNING_BOOTED);
     ret = 0;
@@ -2003,7 +2003,9 @@ openvzConnectSupportsFeature(virConnectPtr conn G_GNUC_UNUSED, int feature)
     case VIR_DRV_FEATURE_PROGRAM_KEEPALIVE:
     case VIR_DRV_FEATURE_REMOTE:
     case VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK:
+    case VIR_DRV_FEATURE_REMOTE_EVENT_BATCH:
     case VIR_DRV_FEATURE_REMOTE_EVENT_CALLBACK:
+    case VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PACKETS:
     case VIR_DRV_FEATURE_TYPED_PARAM_STRING:
     case VIR_DRV_FEATURE_XML_MIGRATABLE:
     default:
@@ -2252,7 +2254,7 @@ openvzDomainMigrateFinish3Params(virConnectPtr dconn,
         goto cleanup;
     }
 
-    vm->def->id = strtoI(vm->def->name);
+    virDomainObjListSetID(driver->domains, vm, strtoI(vm->def->name));
     virDomainObjSetState(vm, VIR_DOMAIN_RUNNING, VIR_DOMAIN_RUNNING_MIGRATED);
 
     dom = virGetDomain(dconn, vm->def->name, vm->def->uuid, vm->def->id);
@@ -2297,7 +2299,7 @@ openvzDomainMigrateConfirm3Params(virDomainPtr domain,
         goto cleanup;
     }
 
-    vm->def->id = -1;
+    virDomainObjListSetID(driver->domains, vm, -1);
 
     VIR_DEBUG("Domain '%s' successfully migrated", vm->def->name);
 
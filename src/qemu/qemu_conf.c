@@ -272,6 +272,9 @@ virQEMUDriverConfigPtr virQEMUDriverConfigNew(bool privileged,
 
     cfg->keepAliveInterval = 5;
     cfg->keepAliveCount = 5;
+    cfg->statsWorkers = 1;
+    cfg->statsJobTimeout = 30;
+    cfg->monitorEventThreads = -1;
     cfg->seccompSandbox = -1;
 
     cfg->logTimestamp = true;
@@ -609,6 +612,35 @@ virQEMUDriverConfigLoadSaveEntry(virQEMUDriverConfigPtr cfg,
         return -1;
     if (virConfGetValueString(conf, "snapshot_image_format", &cfg->snapshotImageFormat) < 0)
         return -1;
+    if (virConfGetValueUInt(conf, "image_compression_threads", &cfg->imageCompressionThreads) < 0)
+        return -1;
+    if (virConfGetValueUInt(conf, "save_image_streams", &cfg->saveImageStreams) < 0)
+        return -1;
+    if (cfg->saveImageStreams > QEMU_SAVE_IMAGE_STREAMS_MAX) {
+        virReportError(VIR_ERR_CONF_SYNTAX,
+                       _("save_image_streams must not be greater than %d"),
+                       QEMU_SAVE_IMAGE_STREAMS_MAX);
+        return -1;
+    }
+    if (virConfGetValueUInt(conf, "io_helper_buffer_size", &cfg->ioHelperBufferSize) < 0)
+        return -1;
+    if (cfg->ioHelperBufferSize % (VIR_FILE_WRAPPER_BUFFER_ALIGN / 1024) != 0 ||
+        cfg->ioHelperBufferSize > VIR_FILE_WRAPPER_BUFFER_MAX / 1024) {
+        virReportError(VIR_ERR_CONF_SYNTAX,
+                       _("io_helper_buffer_size must be a multiple of %d "
+                         "not greater than %d"),
+                       VIR_FILE_WRAPPER_BUFFER_ALIGN / 1024,
+                       VIR_FILE_WRAPPER_BUFFER_MAX / 1024);
+        return -1;
+    }
+    if (virConfGetValueUInt(conf, "io_helper_queue_depth", &cfg->ioHelperQueueDepth) < 0)
+        return -1;
+    if (cfg->ioHelperQueueDepth > VIR_FILE_WRAPPER_QUEUE_DEPTH_MAX) {
+        virReportError(VIR_ERR_CONF_SYNTAX,
+                       _("io_helper_queue_depth must not be greater than %d"),
+                       VIR_FILE_WRAPPER_QUEUE_DEPTH_MAX);
+        return -1;
+    }
     if (virConfGetValueString(conf, "auto_dump_path", &cfg->autoDumpPath) < 0)
         return -1;
     if (virConfGetValueBool(conf, "auto_dump_bypass_cache", &cfg->autoDumpBypassCache) < 0)
@@ -741,6 +773,28 @@ virQEMUDriverConfigLoadRPCEntry(virQEMUDriverConfigPtr cfg,
 {
     if (virConfGetValueUInt(conf, "max_queued", &cfg->maxQueuedJobs) < 0)
         return -1;
+    if (virConfGetValueUInt(conf, "stats_workers", &cfg->statsWorkers) < 0)
+        return -1;
+    if (cfg->statsWorkers == 0) {
+        virReportError(VIR_ERR_CONF_SYNTAX, "%s",
+                       _("stats_workers must be greater than 0"));
+        return -1;
+    }
+    if (virConfGetValueUInt(conf, "stats_job_timeout", &cfg->statsJobTimeout) < 0)
+        return -1;
+    if (cfg->statsJobTimeout == 0) {
+        virReportError(VIR_ERR_CONF_SYNTAX, "%s",
+                       _("stats_job_timeout must be greater than 0"));
+        return -1;
+    }
+    if (virConfGetValueInt(conf, "monitor_event_threads", &cfg->monitorEventThreads) < 0)
+        return -1;
+    if (virConfGetValueType(conf, "monitor_event_threads") != VIR_CONF_NONE &&
+        cfg->monitorEventThreads < 0) {
+        virReportError(VIR_ERR_CONF_SYNTAX, "%s",
+                       _("monitor_event_threads must not be negative"));
+        return -1;
+    }
     if (virConfGetValueInt(conf, "keepalive_interval", &cfg->keepAliveInterval) < 0)
         return -1;
     if (virConfGetValueUInt(conf, "keepalive_count", &cfg->keepAliveCount) < 0)
@@ -41,6 +41,7 @@
 #include "virportallocator.h"
 #include "vircommand.h"
 #include "virthreadpool.h"
+#include "vireventthread.h"
 #include "locking/lock_manager.h"
 #include "qemu_capabilities.h"
 #include "virclosecallbacks.h"
@@ -51,6 +52,9 @@
 
 #define QEMU_DRIVER_NAME "QEMU"
 
+/* QEMU doesn't allow more than 255 multifd channels */
+#define QEMU_SAVE_IMAGE_STREAMS_MAX 255
+
 typedef struct _virQEMUDriver virQEMUDriver;
 typedef virQEMUDriver *virQEMUDriverPtr;
 
@@ -185,6 +189,9 @@ struct _virQEMUDriverConfig {
     bool dumpGuestCore;
 
     unsigned int maxQueuedJobs;
+    unsigned int statsWorkers;
+    unsigned int statsJobTimeout;
+    int monitorEventThreads;
 
     char **securityDriverNames;
     bool securityDefaultConfined;
@@ -193,6 +200,10 @@ struct _virQEMUDriverConfig {
     char *saveImageFormat;
     char *dumpImageFormat;
     char *snapshotImageFormat;
+    unsigned int imageCompressionThreads;
+    unsigned int saveImageStreams;
+    unsigned int ioHelperBufferSize; /* in KiB */
+    unsigned int ioHelperQueueDepth;
 
     char *autoDumpPath;
     bool autoDumpBypassCache;
@@ -244,6 +255,15 @@ struct _virQEMUDriver {
     /* Immutable pointer, self-locking APIs */
     virThreadPoolPtr workerPool;
 
+    /* Immutable pointer, self-locking APIs. NULL if statistics
+     * of multiple domains are collected sequentially */
+    virThreadPoolPtr statsPool;
+
+    /* Immutable after startup. Event loop threads shared by monitors
+     * and agents of all domains, empty if each domain has its own */
+    virEventThread **monitorEventThreads;
+    size_t nmonitorEventThreads;
+
     /* Atomic increment only */
     int lastvmid;
 
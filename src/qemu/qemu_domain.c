@@ -65,6 +65,7 @@
 #include "backup_conf.h"
 #include "virutil.h"
 #include "virqemu.h"
+#include "virhashcode.h"
 
 #include <sys/time.h>
 #include <fcntl.h>
@@ -1703,12 +1704,31 @@ qemuDomainSetPrivatePaths(virQEMUDriverPtr driver,
 }
 
 
+/**
+ * qemuDomainObjStartWorker:
+ * @dom: domain object
+ *
+ * Assign an event loop thread for the monitor and agent of @dom. If the
+ * driver has a pool of shared threads, the domain is always assigned the
+ * same one based on its UUID, otherwise a dedicated thread is started.
+ */
 int
 qemuDomainObjStartWorker(virDomainObjPtr dom)
 {
     qemuDomainObjPrivatePtr priv = dom->privateData;
+    virQEMUDriverPtr driver = priv->driver;
 
-    if (!priv->eventThread) {
+    if (priv->eventThread)
+        return 0;
+
+    if (driver->nmonitorEventThreads > 0) {
+        uint32_t hash = virHashCodeGen(dom->def->uuid, VIR_UUID_BUFLEN, 0);
+        size_t idx = hash % driver->nmonitorEventThreads;
+
+        VIR_DEBUG("Using shared event thread %zu for domain %s",
+                  idx, dom->def->name);
+        priv->eventThread = g_object_ref(driver->monitorEventThreads[idx]);
+    } else {
         g_autofree char *threadName = g_strdup_printf("vm-%s", dom->def->name);
         if (!(priv->eventThread = virEventThreadNew(threadName)))
             return -1;
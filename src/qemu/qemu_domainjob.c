@@ -550,6 +550,23 @@ qemuDomainMigrationJobInfoToParams(qemuDomainJobInfoPtr jobInfo,
                              stats->cpu_throttle_percentage) < 0)
         goto error;
 
+    if (jobInfo->convergeSet) {
+        qemuMigrationConvergePtr conv = &jobInfo->converge;
+
+        if ((conv->maxDowntime > 0 &&
+             virTypedParamsAddULLong(&par, &npar, &maxpar,
+                                     VIR_DOMAIN_JOB_CONVERGE_DOWNTIME,
+                                     conv->downtime) < 0) ||
+            (conv->throttle &&
+             virTypedParamsAddInt(&par, &npar, &maxpar,
+                                  VIR_DOMAIN_JOB_CONVERGE_THROTTLE_INCREMENT,
+                                  conv->throttleIncrement) < 0) ||
+            virTypedParamsAddULLong(&par, &npar, &maxpar,
+                                    VIR_DOMAIN_JOB_CONVERGE_ADJUSTMENTS,
+                                    conv->adjustments) < 0)
+            goto error;
+    }
+
  done:
     *type = qemuDomainJobStatusToType(jobInfo->status);
     *params = par;
@@ -793,10 +810,11 @@ qemuDomainObjCanSetJob(qemuDomainJobObjPtr job,
  * @job: qemuDomainJob to start
  * @asyncJob: qemuDomainAsyncJob to start
  * @nowait: don't wait trying to acquire @job
+ * @waitTime: how long to wait for @job in milliseconds
  *
  * Acquires job for a domain object which must be locked before
  * calling. If there's already a job running waits up to
- * QEMU_JOB_WAIT_TIME after which the functions fails reporting
+ * @waitTime after which the functions fails reporting
  * an error unless @nowait is set.
  *
  * If @nowait is true this function tries to acquire job and if
@@ -814,7 +832,8 @@ qemuDomainObjBeginJobInternal(virQEMUDriverPtr driver,
                               qemuDomainJob job,
                               qemuDomainAgentJob agentJob,
                               qemuDomainAsyncJob asyncJob,
-                              bool nowait)
+                              bool nowait,
+                              unsigned long long waitTime)
 {
     qemuDomainObjPrivatePtr priv = obj->privateData;
     unsigned long long now;
@@ -843,7 +862,7 @@ qemuDomainObjBeginJobInternal(virQEMUDriverPtr driver,
         return -1;
 
     priv->jobs_queued++;
-    then = now + QEMU_JOB_WAIT_TIME;
+    then = now + waitTime;
 
  retry:
     if ((!async && job != QEMU_JOB_DESTROY) &&
@@ -1029,7 +1048,8 @@ int qemuDomainObjBeginJob(virQEMUDriverPtr driver,
 {
     if (qemuDomainObjBeginJobInternal(driver, obj, job,
                                       QEMU_AGENT_JOB_NONE,
-                                      QEMU_ASYNC_JOB_NONE, false) < 0)
+                                      QEMU_ASYNC_JOB_NONE, false,
+                                      QEMU_JOB_WAIT_TIME) < 0)
         return -1;
     else
         return 0;
@@ -1049,7 +1069,8 @@ qemuDomainObjBeginAgentJob(virQEMUDriverPtr driver,
 {
     return qemuDomainObjBeginJobInternal(driver, obj, QEMU_JOB_NONE,
                                          agentJob,
-                                         QEMU_ASYNC_JOB_NONE, false);
+                                         QEMU_ASYNC_JOB_NONE, false,
+                                         QEMU_JOB_WAIT_TIME);
 }
 
 int qemuDomainObjBeginAsyncJob(virQEMUDriverPtr driver,
@@ -1062,7 +1083,8 @@ int qemuDomainObjBeginAsyncJob(virQEMUDriverPtr driver,
 
     if (qemuDomainObjBeginJobInternal(driver, obj, QEMU_JOB_ASYNC,
                                       QEMU_AGENT_JOB_NONE,
-                                      asyncJob, false) < 0)
+                                      asyncJob, false,
+                                      QEMU_JOB_WAIT_TIME) < 0)
         return -1;
 
     priv = obj->privateData;
@@ -1094,7 +1116,8 @@ qemuDomainObjBeginNestedJob(virQEMUDriverPtr driver,
                                          QEMU_JOB_ASYNC_NESTED,
                                          QEMU_AGENT_JOB_NONE,
                                          QEMU_ASYNC_JOB_NONE,
-                                         false);
+                                         false,
+                                         QEMU_JOB_WAIT_TIME);
 }
 
 /**
@@ -1117,7 +1140,34 @@ qemuDomainObjBeginJobNowait(virQEMUDriverPtr driver,
 {
     return qemuDomainObjBeginJobInternal(driver, obj, job,
                                          QEMU_AGENT_JOB_NONE,
-                                         QEMU_ASYNC_JOB_NONE, true);
+                                         QEMU_ASYNC_JOB_NONE, true, 0);
+}
+
+/**
+ * qemuDomainObjBeginJobTimeout:
+ *
+ * @driver: qemu driver
+ * @obj: domain object
+ * @job: qemuDomainJob to start
+ * @timeout: how long to wait for @job in milliseconds
+ *
+ * Acquires job for a domain object which must be locked before
+ * calling. Works just like qemuDomainObjBeginJob, except that
+ * it gives up waiting for the job after @timeout milliseconds
+ * instead of QEMU_JOB_WAIT_TIME.
+ *
+ * Returns: see qemuDomainObjBeginJobInternal
+ */
+int
+qemuDomainObjBeginJobTimeout(virQEMUDriverPtr driver,
+                             virDomainObjPtr obj,
+                             qemuDomainJob job,
+                             unsigned long long timeout)
+{
+    return qemuDomainObjBeginJobInternal(driver, obj, job,
+                                         QEMU_AGENT_JOB_NONE,
+                                         QEMU_ASYNC_JOB_NONE, false,
+                                         timeout);
 }
 
 /*
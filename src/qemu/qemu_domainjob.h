@@ -20,6 +20,7 @@
 
 #include <glib-object.h>
 #include "qemu_monitor.h"
+#include "qemu_migration_params.h"
 
 #define JOB_MASK(job)                  (job == 0 ? 0 : 1 << (job - 1))
 #define QEMU_JOB_DEFAULT_MASK \
@@ -142,6 +143,10 @@ struct _qemuDomainJobInfo {
         qemuDomainBackupStats backup;
     } stats;
     qemuDomainMirrorStats mirrorStats;
+    unsigned long long statsFetched; /* When stats.mig were last refreshed
+                                        on client's request */
+    bool convergeSet;
+    qemuMigrationConverge converge; /* migration convergence controller */
 
     char *errmsg; /* optional error message for failed completed jobs */
 };
@@ -240,6 +245,11 @@ int qemuDomainObjBeginJobNowait(virQEMUDriverPtr driver,
                                 virDomainObjPtr obj,
                                 qemuDomainJob job)
     G_GNUC_WARN_UNUSED_RESULT;
+int qemuDomainObjBeginJobTimeout(virQEMUDriverPtr driver,
+                                 virDomainObjPtr obj,
+                                 qemuDomainJob job,
+                                 unsigned long long timeout)
+    G_GNUC_WARN_UNUSED_RESULT;
 
 void qemuDomainObjEndJob(virQEMUDriverPtr driver,
                          virDomainObjPtr obj);
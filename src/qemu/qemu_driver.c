@@ -33,6 +33,8 @@
 #include <sys/ioctl.h>
 
 #include "qemu_driver.h"
+#define LIBVIRT_QEMU_DRIVERPRIV_H_ALLOW
+#include "qemu_driverpriv.h"
 #include "qemu_agent.h"
 #include "qemu_alias.h"
 #include "qemu_block.h"
@@ -605,6 +607,38 @@ qemuDomainFindMaxID(virDomainObjPtr vm,
 }
 
 
+static int
+qemuStateInitMonitorEventThreads(virQEMUDriverPtr driver,
+                                 virQEMUDriverConfigPtr cfg)
+{
+    int nthreads = cfg->monitorEventThreads;
+    size_t i;
+
+    if (nthreads < 0 &&
+        (nthreads = virHostCPUGetCount()) < 1) {
+        virResetLastError();
+        nthreads = 1;
+    }
+
+    if (nthreads == 0)
+        return 0;
+
+    VIR_DEBUG("Starting %d shared monitor event threads", nthreads);
+
+    driver->monitorEventThreads = g_new0(virEventThread *, nthreads);
+
+    for (i = 0; i < (size_t) nthreads; i++) {
+        g_autofree char *threadName = g_strdup_printf("qemu-mon-%zu", i);
+
+        if (!(driver->monitorEventThreads[i] = virEventThreadNew(threadName)))
+            return -1;
+        driver->nmonitorEventThreads++;
+    }
+
+    return 0;
+}
+
+
 /**
  * qemuStateInitialize:
  *
@@ -981,6 +1015,16 @@ qemuStateInitialize(bool privileged,
     if (!qemu_driver->workerPool)
         goto error;
 
+    if (cfg->statsWorkers > 1 &&
+        !(qemu_driver->statsPool = virThreadPoolNewFull(0, cfg->statsWorkers, 0,
+                                                        qemuDomainGetStatsParallelWorker,
+                                                        "qemu-stats", qemu_driver)))
+        goto error;
+
+    /* must be initialized before reconnecting to running domains too */
+    if (qemuStateInitMonitorEventThreads(qemu_driver, cfg) < 0)
+        goto error;
+
     qemuProcessReconnectAll(qemu_driver);
 
     if (virDriverShouldAutostart(cfg->stateDir, &autostart) < 0)
@@ -1098,6 +1142,8 @@ qemuStateStop(void)
 static int
 qemuStateCleanup(void)
 {
+    size_t i;
+
     if (!qemu_driver)
         return -1;
 
@@ -1121,6 +1167,10 @@ qemuStateCleanup(void)
     VIR_FREE(qemu_driver->qemuImgBinary);
     virObjectUnref(qemu_driver->domains);
     virThreadPoolFree(qemu_driver->workerPool);
+    virThreadPoolFree(qemu_driver->statsPool);
+    for (i = 0; i < qemu_driver->nmonitorEventThreads; i++)
+        g_object_unref(qemu_driver->monitorEventThreads[i]);
+    VIR_FREE(qemu_driver->monitorEventThreads);
 
     if (qemu_driver->lockFD != -1)
         virPidFileRelease(qemu_driver->config->stateDir, "driver", qemu_driver->lockFD);
@@ -1228,7 +1278,9 @@ qemuConnectSupportsFeature(virConnectPtr conn, int feature)
     case VIR_DRV_FEATURE_PROGRAM_KEEPALIVE:
     case VIR_DRV_FEATURE_REMOTE:
     case VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK:
+    case VIR_DRV_FEATURE_REMOTE_EVENT_BATCH:
     case VIR_DRV_FEATURE_REMOTE_EVENT_CALLBACK:
+    case VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PACKETS:
     default:
         return 0;
     }
@@ -2890,6 +2942,7 @@ qemuDomainSaveFlags(virDomainPtr dom, const char *path, const char *dxml,
 
     cfg = virQEMUDriverGetConfig(driver);
     if ((compressed = qemuSaveImageGetCompressionProgram(cfg->saveImageFormat,
+                                                         cfg->imageCompressionThreads,
                                                          &compressor,
                                                          "save", false)) < 0)
         goto cleanup;
@@ -2961,6 +3014,7 @@ qemuDomainManagedSave(virDomainPtr dom, unsigned int flags)
 
     cfg = virQEMUDriverGetConfig(driver);
     if ((compressed = qemuSaveImageGetCompressionProgram(cfg->saveImageFormat,
+                                                         cfg->imageCompressionThreads,
                                                          &compressor,
                                                          "save", false)) < 0)
         goto cleanup;
@@ -3049,6 +3103,7 @@ qemuDomainManagedSaveRemove(virDomainPtr dom, unsigned int flags)
                              name);
         goto cleanup;
     }
+    qemuSaveImageUnlinkStreams(name);
 
     vm->hasManagedSave = false;
     ret = 0;
@@ -3176,6 +3231,7 @@ doCoreDump(virQEMUDriverPtr driver,
      * program to exist and can ignore the return value - it only cares to
      * get the compressor */
     ignore_value(qemuSaveImageGetCompressionProgram(cfg->dumpImageFormat,
+                                                    cfg->imageCompressionThreads,
                                                     &compressor,
                                                     "dump", true));
 
@@ -3197,7 +3253,9 @@ doCoreDump(virQEMUDriverPtr driver,
                              NULL)) < 0)
         goto cleanup;
 
-    if (!(wrapperFd = virFileWrapperFdNew(&fd, path, flags)))
+    if (!(wrapperFd = virFileWrapperFdNew(&fd, path, flags,
+                                          cfg->ioHelperBufferSize * 1024ULL,
+                                          cfg->ioHelperQueueDepth)))
         goto cleanup;
 
     if (dump_flags & VIR_DUMP_MEMORY_ONLY) {
@@ -6520,6 +6578,7 @@ qemuDomainObjStart(virConnectPtr conn,
                                      managed_save);
                 return ret;
             }
+            qemuSaveImageUnlinkStreams(managed_save);
             vm->hasManagedSave = false;
         } else {
             virDomainJobOperation op = priv->job.current->operation;
@@ -6533,6 +6592,7 @@ qemuDomainObjStart(virConnectPtr conn,
                     VIR_WARN("Failed to remove the managed state %s", managed_save);
                 else
                     vm->hasManagedSave = false;
+                qemuSaveImageUnlinkStreams(managed_save);
 
                 return ret;
             } else if (ret < 0) {
@@ -6783,6 +6843,7 @@ qemuDomainUndefineFlags(virDomainPtr dom,
                                  "save image"));
                 goto endjob;
             }
+            qemuSaveImageUnlinkStreams(name);
         } else {
             virReportError(VIR_ERR_OPERATION_INVALID, "%s",
                            _("Refusing to undefine while domain managed "
@@ -9915,7 +9976,6 @@ qemuDomainBlocksStatsGather(virQEMUDriverPtr driver,
     qemuBlockStatsPtr stats;
     size_t i;
     int nstats;
-    int rc = 0;
     const char *entryname = NULL;
     int ret = -1;
 
@@ -9939,16 +9999,14 @@ qemuDomainBlocksStatsGather(virQEMUDriverPtr driver,
     }
 
     qemuDomainObjEnterMonitor(driver, vm);
-    nstats = qemuMonitorGetAllBlockStatsInfo(priv->mon, &blockstats, false);
-
-    if (capacity && nstats >= 0) {
-        if (blockdev)
-            rc = qemuMonitorBlockStatsUpdateCapacityBlockdev(priv->mon, blockstats);
-        else
-            rc = qemuMonitorBlockStatsUpdateCapacity(priv->mon, blockstats, false);
-    }
+    if (capacity)
+        nstats = qemuMonitorGetAllBlockStatsCapacity(priv->mon, &blockstats,
+                                                     false, blockdev,
+                                                     false, NULL);
+    else
+        nstats = qemuMonitorGetAllBlockStatsInfo(priv->mon, &blockstats, false);
 
-    if (qemuDomainObjExitMonitor(driver, vm) < 0 || nstats < 0 || rc < 0)
+    if (qemuDomainObjExitMonitor(driver, vm) < 0 || nstats < 0)
         goto cleanup;
 
     if (VIR_ALLOC(*retstats) < 0)
@@ -11100,6 +11158,32 @@ qemuConnectDomainEventRegisterAny(virConnectPtr conn,
 }
 
 
+static int
+qemuConnectDomainEventRegisterAnyFlags(virConnectPtr conn,
+                                       virDomainPtr dom,
+                                       int eventID,
+                                       virConnectDomainEventGenericCallback callback,
+                                       void *opaque,
+                                       virFreeCallback freecb,
+                                       unsigned int flags)
+{
+    virQEMUDriverPtr driver = conn->privateData;
+    int ret;
+
+    if (virConnectDomainEventRegisterAnyFlagsEnsureACL(conn) < 0)
+        return -1;
+
+    if (virDomainEventStateRegisterIDFlags(conn,
+                                           driver->domainEventState,
+                                           dom, eventID,
+                                           callback, opaque, freecb,
+                                           flags, &ret) < 0)
+        ret = -1;
+
+    return ret;
+}
+
+
 static int
 qemuConnectDomainEventDeregisterAny(virConnectPtr conn,
                                     int callbackID)
@@ -12524,8 +12608,8 @@ qemuDomainGetJobInfoMigrationStats(virQEMUDriverPtr driver,
         jobInfo->status == QEMU_DOMAIN_JOB_STATUS_POSTCOPY) {
         if (events &&
             jobInfo->status != QEMU_DOMAIN_JOB_STATUS_ACTIVE &&
-            qemuMigrationAnyFetchStats(driver, vm, QEMU_ASYNC_JOB_NONE,
-                                       jobInfo, NULL) < 0)
+            qemuMigrationAnyRefreshStats(driver, vm, QEMU_ASYNC_JOB_NONE,
+                                         jobInfo) < 0)
             return -1;
 
         if (jobInfo->status == QEMU_DOMAIN_JOB_STATUS_ACTIVE &&
@@ -18385,24 +18469,17 @@ qemuDomainGetStatsBlock(virQEMUDriverPtr driver,
     if (HAVE_JOB(privflags) && virDomainObjIsActive(dom)) {
         qemuDomainObjEnterMonitor(driver, dom);
 
-        rc = qemuMonitorGetAllBlockStatsInfo(priv->mon, &stats, visitBacking);
-
-        if (rc >= 0) {
-            if (blockdev)
-                rc = qemuMonitorBlockStatsUpdateCapacityBlockdev(priv->mon, stats);
-            else
-                ignore_value(qemuMonitorBlockStatsUpdateCapacity(priv->mon, stats,
-                                                                 visitBacking));
-        }
-
-        if (fetchnodedata)
-            nodedata = qemuMonitorQueryNamedBlockNodes(priv->mon);
+        /* capacity and node data are optional, the block stats are
+         * reported even if they can't be fetched */
+        rc = qemuMonitorGetAllBlockStatsCapacity(priv->mon, &stats,
+                                                 visitBacking, blockdev, true,
+                                                 fetchnodedata ? &nodedata : NULL);
 
         if (qemuDomainObjExitMonitor(driver, dom) < 0)
             goto cleanup;
 
         /* failure to retrieve stats is fine at this point */
-        if (rc < 0 || (fetchnodedata && !nodedata))
+        if (rc < 0)
             virResetLastError();
     }
 
@@ -18635,6 +18712,286 @@ qemuDomainGetStats(virConnectPtr conn,
 }
 
 
+/**
+ * qemuDomainGetStatsOne:
+ * @conn: connection
+ * @vm: domain object (unlocked)
+ * @stats: requested stats types
+ * @privflags: QEMU_DOMAIN_STATS_* flags common for all domains
+ * @flags: flags passed to virConnectGetAllDomainStats
+ * @record: filled with the statistics record for @vm
+ *
+ * Collects statistics of a single domain as part of
+ * qemuConnectGetAllDomainStats. If the job needed for talking to the
+ * monitor can't be acquired within the configured stats_job_timeout
+ * only the statistics which don't need the monitor are collected.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+static int
+qemuDomainGetStatsOne(virConnectPtr conn,
+                      virDomainObjPtr vm,
+                      unsigned int stats,
+                      unsigned int privflags,
+                      unsigned int flags,
+                      virDomainStatsRecordPtr *record)
+{
+    virQEMUDriverPtr driver = conn->privateData;
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
+    unsigned int domflags = 0;
+    int ret;
+
+    virObjectLock(vm);
+
+    if (HAVE_JOB(privflags)) {
+        int rv;
+
+        if (flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_NOWAIT)
+            rv = qemuDomainObjBeginJobNowait(driver, vm, QEMU_JOB_QUERY);
+        else
+            rv = qemuDomainObjBeginJobTimeout(driver, vm, QEMU_JOB_QUERY,
+                                              cfg->statsJobTimeout * 1000ull);
+
+        if (rv == 0)
+            domflags |= QEMU_DOMAIN_STATS_HAVE_JOB;
+    }
+    /* else: without a job it's still possible to gather some data */
+
+    if (flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_BACKING)
+        domflags |= QEMU_DOMAIN_STATS_BACKING;
+
+    ret = qemuDomainGetStats(conn, vm, stats, record, domflags);
+
+    if (HAVE_JOB(domflags))
+        qemuDomainObjEndJob(driver, vm);
+
+    virObjectUnlock(vm);
+    return ret;
+}
+
+
+typedef struct _qemuDomainGetStatsParallel qemuDomainGetStatsParallel;
+typedef qemuDomainGetStatsParallel *qemuDomainGetStatsParallelPtr;
+struct _qemuDomainGetStatsParallel {
+    virMutex lock;
+    virCond cond;
+    size_t remaining;
+
+    virConnectPtr conn;
+    unsigned int stats;
+    unsigned int privflags;
+    unsigned int flags;
+
+    /* indexed the same way as the array of domain objects */
+    virDomainStatsRecordPtr *records;
+    virErrorPtr err;
+    bool failed;
+};
+
+typedef struct _qemuDomainGetStatsParallelJob qemuDomainGetStatsParallelJob;
+typedef qemuDomainGetStatsParallelJob *qemuDomainGetStatsParallelJobPtr;
+struct _qemuDomainGetStatsParallelJob {
+    qemuDomainGetStatsParallelPtr data;
+    virDomainObjPtr vm;
+    size_t idx;
+};
+
+
+/* Worker function of driver->statsPool */
+void
+qemuDomainGetStatsParallelWorker(void *jobdata,
+                                 void *opaque G_GNUC_UNUSED)
+{
+    g_autofree qemuDomainGetStatsParallelJobPtr job = jobdata;
+    qemuDomainGetStatsParallelPtr data = job->data;
+    virDomainStatsRecordPtr record = NULL;
+    virErrorPtr err = NULL;
+
+    bool failed = false;
+
+    if (qemuDomainGetStatsOne(data->conn, job->vm, data->stats,
+                              data->privflags, data->flags, &record) < 0) {
+        virErrorPreserveLast(&err);
+        failed = true;
+    }
+
+    virMutexLock(&data->lock);
+    data->records[job->idx] = record;
+    if (failed) {
+        data->failed = true;
+        if (!data->err)
+            data->err = g_steal_pointer(&err);
+        else
+            virFreeError(err);
+    }
+    if (--data->remaining == 0)
+        virCondSignal(&data->cond);
+    virMutexUnlock(&data->lock);
+}
+
+
+/**
+ * qemuDomainGetStatsParallel:
+ * @conn: connection
+ * @vms: array of domain objects
+ * @nvms: number of items in @vms
+ * @stats: requested stats types
+ * @privflags: QEMU_DOMAIN_STATS_* flags common for all domains
+ * @flags: flags passed to virConnectGetAllDomainStats
+ * @records: array of at least @nvms items, filled with the records
+ *
+ * Collects statistics of all domains in @vms using the driver's stats
+ * worker pool. The number of domains processed concurrently is limited
+ * by the size of the pool. The records are stored in @records in the
+ * same order as the domains in @vms, domains which didn't produce any
+ * record have NULL in their slot.
+ *
+ * Returns 0 on success, -1 on error in which case the first error
+ * reported by any of the workers is set.
+ */
+static int
+qemuDomainGetStatsParallel(virConnectPtr conn,
+                           virDomainObjPtr *vms,
+                           size_t nvms,
+                           unsigned int stats,
+                           unsigned int privflags,
+                           unsigned int flags,
+                           virDomainStatsRecordPtr *records)
+{
+    virQEMUDriverPtr driver = conn->privateData;
+    qemuDomainGetStatsParallel data = { 0 };
+    size_t i;
+    int ret = -1;
+
+    if (virMutexInit(&data.lock) < 0) {
+        virReportSystemError(errno, "%s", _("unable to init mutex"));
+        return -1;
+    }
+
+    if (virCondInit(&data.cond) < 0) {
+        virReportSystemError(errno, "%s", _("unable to init condition"));
+        virMutexDestroy(&data.lock);
+        return -1;
+    }
+
+    data.conn = conn;
+    data.stats = stats;
+    data.privflags = privflags;
+    data.flags = flags;
+    data.records = records;
+
+    virMutexLock(&data.lock);
+
+    for (i = 0; i < nvms; i++) {
+        qemuDomainGetStatsParallelJobPtr job = g_new0(qemuDomainGetStatsParallelJob, 1);
+
+        job->data = &data;
+        job->vm = vms[i];
+        job->idx = i;
+
+        if (virThreadPoolSendJob(driver->statsPool, 0, job) < 0) {
+            g_free(job);
+            break;
+        }
+
+        data.remaining++;
+    }
+
+    /* Even if we failed to submit some jobs we need to wait for the
+     * submitted ones since they reference @data on our stack. */
+    while (data.remaining > 0)
+        ignore_value(virCondWait(&data.cond, &data.lock));
+
+    virMutexUnlock(&data.lock);
+
+    if (data.failed) {
+        virErrorRestore(&data.err);
+        goto cleanup;
+    }
+
+    if (i < nvms)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virCondDestroy(&data.cond);
+    virMutexDestroy(&data.lock);
+    return ret;
+}
+
+
+/**
+ * qemuDomainGetStatsCollect:
+ * @conn: connection
+ * @vms: array of domain objects
+ * @nvms: number of items in @vms
+ * @stats: requested stats types
+ * @privflags: QEMU_DOMAIN_STATS_* flags common for all domains
+ * @flags: flags passed to virConnectGetAllDomainStats
+ * @retStats: filled with a NULL terminated list of records
+ *
+ * Collects statistics of all domains in @vms, in parallel if the driver
+ * has a stats worker pool. The records are in the order of @vms, domains
+ * which didn't produce any record are left out.
+ *
+ * Returns the number of records or -1 on error.
+ */
+int
+qemuDomainGetStatsCollect(virConnectPtr conn,
+                          virDomainObjPtr *vms,
+                          size_t nvms,
+                          unsigned int stats,
+                          unsigned int privflags,
+                          unsigned int flags,
+                          virDomainStatsRecordPtr **retStats)
+{
+    virQEMUDriverPtr driver = conn->privateData;
+    virDomainStatsRecordPtr *tmpstats = NULL;
+    int nstats = 0;
+    size_t i;
+    int ret = -1;
+
+    if (VIR_ALLOC_N(tmpstats, nvms + 1) < 0)
+        return -1;
+
+    if (driver->statsPool && nvms > 1) {
+        int rc = qemuDomainGetStatsParallel(conn, vms, nvms, stats, privflags,
+                                            flags, tmpstats);
+
+        /* squash the gaps left by domains which didn't produce a record,
+         * even on failure so that all records are freed */
+        for (i = 0; i < nvms; i++) {
+            if (tmpstats[i])
+                tmpstats[nstats++] = tmpstats[i];
+        }
+        for (i = nstats; i < nvms; i++)
+            tmpstats[i] = NULL;
+
+        if (rc < 0)
+            goto cleanup;
+    } else {
+        for (i = 0; i < nvms; i++) {
+            virDomainStatsRecordPtr tmp = NULL;
+
+            if (qemuDomainGetStatsOne(conn, vms[i], stats, privflags,
+                                      flags, &tmp) < 0)
+                goto cleanup;
+
+            if (tmp)
+                tmpstats[nstats++] = tmp;
+        }
+    }
+
+    *retStats = g_steal_pointer(&tmpstats);
+    ret = nstats;
+
+ cleanup:
+    virDomainStatsRecordListFree(tmpstats);
+    return ret;
+}
+
+
 static int
 qemuConnectGetAllDomainStats(virConnectPtr conn,
                              virDomainPtr *doms,
@@ -18646,15 +19003,10 @@ qemuConnectGetAllDomainStats(virConnectPtr conn,
     virQEMUDriverPtr driver = conn->privateData;
     virErrorPtr orig_err = NULL;
     virDomainObjPtr *vms = NULL;
-    virDomainObjPtr vm;
     size_t nvms;
-    virDomainStatsRecordPtr *tmpstats = NULL;
     bool enforce = !!(flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_ENFORCE_STATS);
-    int nstats = 0;
-    size_t i;
     int ret = -1;
     unsigned int privflags = 0;
-    unsigned int domflags = 0;
     unsigned int lflags = flags & (VIR_CONNECT_LIST_DOMAINS_FILTERS_ACTIVE |
                                    VIR_CONNECT_LIST_DOMAINS_FILTERS_PERSISTENT |
                                    VIR_CONNECT_LIST_DOMAINS_FILTERS_STATE);
@@ -18684,59 +19036,13 @@ qemuConnectGetAllDomainStats(virConnectPtr conn,
             return -1;
     }
 
-    if (VIR_ALLOC_N(tmpstats, nvms + 1) < 0)
-        goto cleanup;
-
     if (qemuDomainGetStatsNeedMonitor(stats))
         privflags |= QEMU_DOMAIN_STATS_HAVE_JOB;
 
-    for (i = 0; i < nvms; i++) {
-        virDomainStatsRecordPtr tmp = NULL;
-        domflags = 0;
-        vm = vms[i];
-
-        virObjectLock(vm);
-
-        if (HAVE_JOB(privflags)) {
-            int rv;
-
-            if (flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_NOWAIT)
-                rv = qemuDomainObjBeginJobNowait(driver, vm, QEMU_JOB_QUERY);
-            else
-                rv = qemuDomainObjBeginJob(driver, vm, QEMU_JOB_QUERY);
-
-            if (rv == 0)
-                domflags |= QEMU_DOMAIN_STATS_HAVE_JOB;
-        }
-        /* else: without a job it's still possible to gather some data */
-
-        if (flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_BACKING)
-            domflags |= QEMU_DOMAIN_STATS_BACKING;
-        if (qemuDomainGetStats(conn, vm, stats, &tmp, domflags) < 0) {
-            if (HAVE_JOB(domflags) && vm)
-                qemuDomainObjEndJob(driver, vm);
+    ret = qemuDomainGetStatsCollect(conn, vms, nvms, stats, privflags,
+                                    flags, retStats);
 
-            virObjectUnlock(vm);
-            goto cleanup;
-        }
-
-        if (tmp)
-            tmpstats[nstats++] = tmp;
-
-        if (HAVE_JOB(domflags))
-            qemuDomainObjEndJob(driver, vm);
-
-        virObjectUnlock(vm);
-    }
-
-    *retStats = tmpstats;
-    tmpstats = NULL;
-
-    ret = nstats;
-
- cleanup:
     virErrorPreserveLast(&orig_err);
-    virDomainStatsRecordListFree(tmpstats);
     virObjectListFreeCount(vms, nvms);
     virErrorRestore(&orig_err);
 
@@ -20274,6 +20580,7 @@ static virHypervisorDriver qemuHypervisorDriver = {
     .domainAgentSetResponseTimeout = qemuDomainAgentSetResponseTimeout, /* 5.10.0 */
     .domainBackupBegin = qemuDomainBackupBegin, /* 6.0.0 */
     .domainBackupGetXMLDesc = qemuDomainBackupGetXMLDesc, /* 6.0.0 */
+    .connectDomainEventRegisterAnyFlags = qemuConnectDomainEventRegisterAnyFlags, /* 6.7.0 */
 };
 
 
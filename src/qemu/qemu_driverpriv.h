@@ -0,0 +1,43 @@
+/*
+ * qemu_driverpriv.h: private declarations for the QEMU driver
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LIBVIRT_QEMU_DRIVERPRIV_H_ALLOW
+# error "qemu_driverpriv.h may only be included by qemu_driver.c or test suites"
+#endif /* LIBVIRT_QEMU_DRIVERPRIV_H_ALLOW */
+
+#pragma once
+
+#include "domain_conf.h"
+
+/*
+ * This header file should never be used outside unit tests.
+ */
+
+void
+qemuDomainGetStatsParallelWorker(void *jobdata,
+                                 void *opaque);
+
+int
+qemuDomainGetStatsCollect(virConnectPtr conn,
+                          virDomainObjPtr *vms,
+                          size_t nvms,
+                          unsigned int stats,
+                          unsigned int privflags,
+                          unsigned int flags,
+                          virDomainStatsRecordPtr **retStats);
@@ -1515,6 +1515,65 @@ qemuMigrationAnyFetchStats(virQEMUDriverPtr driver,
 }
 
 
+/* Minimum delay between two query-migrate commands issued on behalf of
+ * clients asking for statistics of a running migration */
+#define QEMU_MIGRATION_STATS_REFRESH_MS 250
+
+/**
+ * qemuMigrationAnyRefreshStats:
+ * @driver: qemu driver
+ * @vm: domain object
+ * @asyncJob: async job the caller is running in
+ * @jobInfo: copy of priv->job.current to be filled with statistics
+ *
+ * Progress of migrations is tracked by QEMU's MIGRATION events, so the
+ * migration statistics are fetched only when a client asks for them. The
+ * fetched statistics are remembered in priv->job.current and reused for
+ * QEMU_MIGRATION_STATS_REFRESH_MS to avoid flooding the monitor with
+ * clients polling job info in a tight loop.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+qemuMigrationAnyRefreshStats(virQEMUDriverPtr driver,
+                             virDomainObjPtr vm,
+                             qemuDomainAsyncJob asyncJob,
+                             qemuDomainJobInfoPtr jobInfo)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    qemuDomainJobInfoPtr current;
+    int status;
+    unsigned long long now;
+
+    if (virTimeMillisNow(&now) < 0)
+        return -1;
+
+    if (jobInfo->statsFetched &&
+        now - jobInfo->statsFetched < QEMU_MIGRATION_STATS_REFRESH_MS) {
+        VIR_DEBUG("Reusing migration statistics fetched %llu ms ago",
+                  now - jobInfo->statsFetched);
+        return 0;
+    }
+
+    if (qemuMigrationAnyFetchStats(driver, vm, asyncJob, jobInfo, NULL) < 0)
+        return -1;
+
+    /* The job may have finished while the monitor was unlocked */
+    if (!(current = priv->job.current))
+        return 0;
+
+    /* The status is driven by MIGRATION events and whoever waits for them
+     * must not see it going back in case an event was processed while we
+     * were waiting for the reply. */
+    status = current->stats.mig.status;
+    current->stats.mig = jobInfo->stats.mig;
+    current->stats.mig.status = status;
+    current->statsFetched = now;
+
+    return 0;
+}
+
+
 static const char *
 qemuMigrationJobName(virDomainObjPtr vm)
 {
@@ -1700,6 +1759,51 @@ qemuMigrationAnyCompleted(virQEMUDriverPtr driver,
 }
 
 
+/**
+ * qemuMigrationSrcConverge:
+ *
+ * Lets the migration convergence controller look at statistics of the last
+ * RAM pass and send adjusted migration parameters to QEMU if needed.
+ *
+ * Returns 1 if the domain was unlocked while talking to QEMU, 0 if there was
+ * no new RAM pass to look at, or -1 on error.
+ */
+static int
+qemuMigrationSrcConverge(virQEMUDriverPtr driver,
+                         virDomainObjPtr vm,
+                         qemuDomainAsyncJob asyncJob)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    qemuDomainJobInfoPtr jobInfo = priv->job.current;
+    qemuMonitorMigrationStats stats = { 0 };
+    int rc;
+
+    if (jobInfo->stats.mig.ram_iteration <= jobInfo->converge.iteration)
+        return 0;
+
+    jobInfo->converge.iteration = jobInfo->stats.mig.ram_iteration;
+
+    if (qemuDomainObjEnterMonitorAsync(driver, vm, asyncJob) < 0)
+        return -1;
+
+    rc = qemuMonitorGetMigrationStats(priv->mon, &stats, NULL);
+
+    if (qemuDomainObjExitMonitor(driver, vm) < 0 || rc < 0)
+        return -1;
+
+    /* too late for any changes */
+    if (stats.status != QEMU_MONITOR_MIGRATION_STATUS_ACTIVE ||
+        !qemuMigrationParamsConvergeUpdate(&jobInfo->converge, &stats))
+        return 1;
+
+    if (qemuMigrationParamsConvergeApply(driver, vm, asyncJob,
+                                         &jobInfo->converge) < 0)
+        return -1;
+
+    return 1;
+}
+
+
 /* Returns 0 on success, -2 when migration needs to be cancelled, or -1 when
  * QEMU reports failed migration.
  */
@@ -1713,6 +1817,7 @@ qemuMigrationSrcWaitForCompletion(virQEMUDriverPtr driver,
     qemuDomainObjPrivatePtr priv = vm->privateData;
     qemuDomainJobInfoPtr jobInfo = priv->job.current;
     bool events = virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_MIGRATION_EVENT);
+    bool converge = jobInfo->convergeSet;
     int rv;
 
     jobInfo->status = QEMU_DOMAIN_JOB_STATUS_MIGRATING;
@@ -1722,6 +1827,22 @@ qemuMigrationSrcWaitForCompletion(virQEMUDriverPtr driver,
         if (rv < 0)
             return rv;
 
+        if (converge) {
+            /* Failing to tune the parameters is no reason to abort a
+             * migration which is otherwise fine, only stop tuning. */
+            if ((rv = qemuMigrationSrcConverge(driver, vm, asyncJob)) < 0) {
+                VIR_WARN("Stopping migration convergence control of domain %s: %s",
+                         vm->def->name, virGetLastErrorMessage());
+                virResetLastError();
+                converge = false;
+                continue;
+            }
+            /* Events may have been processed while we were talking to
+             * QEMU, check the migration status again before waiting. */
+            if (rv > 0)
+                continue;
+        }
+
         if (events) {
             if (virDomainObjWait(vm) < 0) {
                 if (virDomainObjIsActive(vm))
@@ -1755,7 +1876,7 @@ qemuMigrationSrcWaitForCompletion(virQEMUDriverPtr driver,
 }
 
 
-static int
+int
 qemuMigrationDstWaitForCompletion(virQEMUDriverPtr driver,
                                   virDomainObjPtr vm,
                                   qemuDomainAsyncJob asyncJob,
@@ -1958,11 +2079,17 @@ qemuMigrationDstGetURI(const char *migrateFrom,
 }
 
 
+/**
+ * qemuMigrationDstStartIncoming:
+ *
+ * Tells QEMU to start listening for incoming migration on @uri without
+ * waiting for the migration to finish.
+ */
 int
-qemuMigrationDstRun(virQEMUDriverPtr driver,
-                    virDomainObjPtr vm,
-                    const char *uri,
-                    qemuDomainAsyncJob asyncJob)
+qemuMigrationDstStartIncoming(virQEMUDriverPtr driver,
+                              virDomainObjPtr vm,
+                              const char *uri,
+                              qemuDomainAsyncJob asyncJob)
 {
     qemuDomainObjPrivatePtr priv = vm->privateData;
     int rv;
@@ -1983,6 +2110,19 @@ qemuMigrationDstRun(virQEMUDriverPtr driver,
     if (qemuDomainObjExitMonitor(driver, vm) < 0 || rv < 0)
         return -1;
 
+    return 0;
+}
+
+
+int
+qemuMigrationDstRun(virQEMUDriverPtr driver,
+                    virDomainObjPtr vm,
+                    const char *uri,
+                    qemuDomainAsyncJob asyncJob)
+{
+    if (qemuMigrationDstStartIncoming(driver, vm, uri, asyncJob) < 0)
+        return -1;
+
     if (asyncJob == QEMU_ASYNC_JOB_MIGRATION_IN) {
         /* qemuMigrationDstWaitForCompletion is called from the Finish phase */
         return 0;
@@ -2549,7 +2689,7 @@ qemuMigrationDstPrepareAny(virQEMUDriverPtr driver,
     qemuMigrationJobSetPhase(driver, vm, QEMU_MIGRATION_PHASE_PREPARE);
 
     /* Domain starts inactive, even if the domain XML had an id field. */
-    vm->def->id = -1;
+    virDomainObjListSetID(driver->domains, vm, -1);
 
     if (flags & VIR_MIGRATE_OFFLINE)
         goto done;
@@ -3173,6 +3313,8 @@ struct _qemuMigrationSpec {
 };
 
 #define TUNNEL_SEND_BUF_SIZE 65536
+/* Used if the destination accepts large stream packets */
+#define TUNNEL_SEND_BUF_SIZE_LARGE (1024 * 1024)
 
 typedef struct _qemuMigrationIOThread qemuMigrationIOThread;
 typedef qemuMigrationIOThread *qemuMigrationIOThreadPtr;
@@ -3189,14 +3331,19 @@ static void qemuMigrationSrcIOFunc(void *arg)
 {
     qemuMigrationIOThreadPtr data = arg;
     char *buffer = NULL;
+    size_t bufferSize = TUNNEL_SEND_BUF_SIZE;
     struct pollfd fds[2];
     int timeout = -1;
     virErrorPtr err = NULL;
 
-    VIR_DEBUG("Running migration tunnel; stream=%p, sock=%d",
-              data->st, data->sock);
+    if (VIR_DRV_SUPPORTS_FEATURE(data->st->conn->driver, data->st->conn,
+                                 VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PACKETS))
+        bufferSize = TUNNEL_SEND_BUF_SIZE_LARGE;
 
-    if (VIR_ALLOC_N(buffer, TUNNEL_SEND_BUF_SIZE) < 0)
+    VIR_DEBUG("Running migration tunnel; stream=%p, sock=%d, bufferSize=%zu",
+              data->st, data->sock, bufferSize);
+
+    if (VIR_ALLOC_N(buffer, bufferSize) < 0)
         goto abrt;
 
     fds[0].fd = data->sock;
@@ -3248,7 +3395,7 @@ static void qemuMigrationSrcIOFunc(void *arg)
         if (fds[0].revents & (POLLIN | POLLERR | POLLHUP)) {
             int nbytes;
 
-            nbytes = saferead(data->sock, buffer, TUNNEL_SEND_BUF_SIZE);
+            nbytes = saferead(data->sock, buffer, bufferSize);
             if (nbytes > 0) {
                 if (virStreamSend(data->st, buffer, nbytes) < 0)
                     goto error;
@@ -3479,6 +3626,8 @@ qemuMigrationSrcRun(virQEMUDriverPtr driver,
     int ret = -1;
     unsigned int migrate_flags = QEMU_MONITOR_MIGRATE_BACKGROUND;
     qemuDomainObjPrivatePtr priv = vm->privateData;
+    qemuDomainJobPrivatePtr jobPriv = priv->job.privateData;
+    qemuMigrationConvergePtr converge;
     g_autoptr(qemuMigrationCookie) mig = NULL;
     g_autofree char *tlsAlias = NULL;
     qemuMigrationIOThreadPtr iothread = NULL;
@@ -3585,6 +3734,21 @@ qemuMigrationSrcRun(virQEMUDriverPtr driver,
                                  migParams) < 0)
         goto error;
 
+    if ((converge = qemuMigrationParamsGetConverge(migParams))) {
+        if (!events) {
+            virReportError(VIR_ERR_OPERATION_UNSUPPORTED, "%s",
+                           _("Migration convergence targets require QEMU "
+                             "with migration events"));
+            goto error;
+        }
+
+        priv->job.current->converge = *converge;
+        if (qemuMigrationParamsConvergeStart(&priv->job.current->converge,
+                                             jobPriv->migParams) < 0)
+            goto error;
+        priv->job.current->convergeSet = true;
+    }
+
     if (migrate_flags & (QEMU_MONITOR_MIGRATE_NON_SHARED_DISK |
                          QEMU_MONITOR_MIGRATE_NON_SHARED_INC)) {
         if (mig->nbd) {
@@ -5424,6 +5588,114 @@ qemuMigrationSrcToFile(virQEMUDriverPtr driver, virDomainObjPtr vm,
 }
 
 
+/**
+ * qemuMigrationSrcToSocket:
+ * @driver: qemu driver
+ * @vm: domain object
+ * @path: path to a listening UNIX socket
+ * @channels: number of multifd channels
+ * @asyncJob: async job the migration runs in
+ *
+ * Helper function called while vm is active. Migrates the domain into the
+ * UNIX socket at @path using multifd with @channels channels in addition
+ * to the main migration stream. The caller is expected to accept all
+ * connections QEMU makes to @path and store the data.
+ */
+int
+qemuMigrationSrcToSocket(virQEMUDriverPtr driver,
+                         virDomainObjPtr vm,
+                         const char *path,
+                         unsigned int channels,
+                         qemuDomainAsyncJob asyncJob)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    unsigned long saveMigBandwidth = priv->migMaxBandwidth;
+    virErrorPtr orig_err = NULL;
+    g_autoptr(qemuMigrationParams) migParams = NULL;
+    int rc;
+    int ret = -1;
+
+    if (!virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_MIGRATION_PARAM_BANDWIDTH) ||
+        !virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_MIGRATION_EVENT) ||
+        !qemuMigrationCapsGet(vm, QEMU_MIGRATION_CAP_MULTIFD)) {
+        virReportError(VIR_ERR_OPERATION_UNSUPPORTED, "%s",
+                       _("multifd migration is not supported by this QEMU binary"));
+        return -1;
+    }
+
+    if (qemuMigrationSetDBusVMState(driver, vm) < 0)
+        return -1;
+
+    /* The target is local, there's no point in limiting bandwidth. */
+    if (!(migParams = qemuMigrationParamsNewMultifd(channels)))
+        return -1;
+
+    if (qemuMigrationParamsSetULL(migParams,
+                                  QEMU_MIGRATION_PARAM_MAX_BANDWIDTH,
+                                  QEMU_DOMAIN_MIG_BANDWIDTH_MAX * 1024 * 1024) < 0)
+        return -1;
+
+    if (qemuMigrationParamsApply(driver, vm, asyncJob, migParams) < 0)
+        goto cleanup;
+
+    priv->migMaxBandwidth = QEMU_DOMAIN_MIG_BANDWIDTH_MAX;
+
+    if (!virDomainObjIsActive(vm)) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("guest unexpectedly quit"));
+        goto cleanup;
+    }
+
+    if (qemuDomainObjEnterMonitorAsync(driver, vm, asyncJob) < 0)
+        goto cleanup;
+
+    rc = qemuMonitorMigrateToSocket(priv->mon,
+                                    QEMU_MONITOR_MIGRATE_BACKGROUND,
+                                    path);
+
+    if (qemuDomainObjExitMonitor(driver, vm) < 0 || rc < 0)
+        goto cleanup;
+
+    rc = qemuMigrationSrcWaitForCompletion(driver, vm, asyncJob, NULL, 0);
+
+    if (rc < 0) {
+        if (rc == -2) {
+            virErrorPreserveLast(&orig_err);
+            if (virDomainObjIsActive(vm) &&
+                qemuDomainObjEnterMonitorAsync(driver, vm, asyncJob) == 0) {
+                qemuMonitorMigrateCancel(priv->mon);
+                ignore_value(qemuDomainObjExitMonitor(driver, vm));
+            }
+        }
+        goto cleanup;
+    }
+
+    qemuDomainEventEmitJobCompleted(driver, vm);
+    ret = 0;
+
+ cleanup:
+    if (ret < 0 && !orig_err)
+        virErrorPreserveLast(&orig_err);
+
+    /* Turn multifd off again and restore max migration bandwidth */
+    if (virDomainObjIsActive(vm)) {
+        g_autoptr(qemuMigrationParams) resetParams = qemuMigrationParamsNew();
+
+        if (resetParams &&
+            qemuMigrationParamsSetULL(resetParams,
+                                      QEMU_MIGRATION_PARAM_MAX_BANDWIDTH,
+                                      saveMigBandwidth * 1024 * 1024) == 0)
+            ignore_value(qemuMigrationParamsApply(driver, vm, asyncJob,
+                                                  resetParams));
+        priv->migMaxBandwidth = saveMigBandwidth;
+    }
+
+    virErrorRestore(&orig_err);
+
+    return ret;
+}
+
+
 int
 qemuMigrationSrcCancel(virQEMUDriverPtr driver,
                        virDomainObjPtr vm)
@@ -84,6 +84,8 @@
     VIR_MIGRATE_PARAM_BANDWIDTH_POSTCOPY, VIR_TYPED_PARAM_ULLONG, \
     VIR_MIGRATE_PARAM_PARALLEL_CONNECTIONS, VIR_TYPED_PARAM_INT, \
     VIR_MIGRATE_PARAM_TLS_DESTINATION, VIR_TYPED_PARAM_STRING, \
+    VIR_MIGRATE_PARAM_CONVERGE_TIME,    VIR_TYPED_PARAM_ULLONG, \
+    VIR_MIGRATE_PARAM_CONVERGE_DOWNTIME, VIR_TYPED_PARAM_ULLONG, \
     NULL
 
 
@@ -209,6 +211,15 @@ qemuMigrationSrcToFile(virQEMUDriverPtr driver,
                        qemuDomainAsyncJob asyncJob)
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) G_GNUC_WARN_UNUSED_RESULT;
 
+int
+qemuMigrationSrcToSocket(virQEMUDriverPtr driver,
+                         virDomainObjPtr vm,
+                         const char *path,
+                         unsigned int channels,
+                         qemuDomainAsyncJob asyncJob)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(3)
+    G_GNUC_WARN_UNUSED_RESULT;
+
 int
 qemuMigrationSrcCancel(virQEMUDriverPtr driver,
                        virDomainObjPtr vm);
@@ -220,6 +231,12 @@ qemuMigrationAnyFetchStats(virQEMUDriverPtr driver,
                            qemuDomainJobInfoPtr jobInfo,
                            char **error);
 
+int
+qemuMigrationAnyRefreshStats(virQEMUDriverPtr driver,
+                             virDomainObjPtr vm,
+                             qemuDomainAsyncJob asyncJob,
+                             qemuDomainJobInfoPtr jobInfo);
+
 int
 qemuMigrationDstErrorInit(virQEMUDriverPtr driver);
 
@@ -240,6 +257,18 @@ char *
 qemuMigrationDstGetURI(const char *migrateFrom,
                        int migrateFd);
 
+int
+qemuMigrationDstStartIncoming(virQEMUDriverPtr driver,
+                              virDomainObjPtr vm,
+                              const char *uri,
+                              qemuDomainAsyncJob asyncJob);
+
+int
+qemuMigrationDstWaitForCompletion(virQEMUDriverPtr driver,
+                                  virDomainObjPtr vm,
+                                  qemuDomainAsyncJob asyncJob,
+                                  bool postcopy);
+
 int
 qemuMigrationDstRun(virQEMUDriverPtr driver,
                     virDomainObjPtr vm,
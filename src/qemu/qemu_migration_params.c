@@ -63,8 +63,14 @@ struct _qemuMigrationParams {
     unsigned long long compMethods; /* bit-wise OR of qemuMigrationCompressMethod */
     virBitmapPtr caps;
     qemuMigrationParamValue params[QEMU_MIGRATION_PARAM_LAST];
+    qemuMigrationConvergePtr converge; /* NULL unless requested by the caller */
 };
 
+/* QEMU's default cpu-throttle-increment */
+#define QEMU_MIGRATION_CONVERGE_THROTTLE_INCREMENT 10
+/* The convergence controller never asks for a bigger increment */
+#define QEMU_MIGRATION_CONVERGE_THROTTLE_INCREMENT_MAX 40
+
 typedef enum {
     QEMU_MIGRATION_COMPRESS_XBZRLE = 0,
     QEMU_MIGRATION_COMPRESS_MT,
@@ -255,6 +261,30 @@ qemuMigrationParamsNew(void)
 }
 
 
+/**
+ * qemuMigrationParamsNewMultifd:
+ * @channels: number of multifd channels
+ *
+ * Creates migration parameters which enable multifd migration with
+ * @channels channels. Used for local migrations which are not driven by
+ * migration API flags, such as saving a domain into several streams.
+ */
+qemuMigrationParamsPtr
+qemuMigrationParamsNewMultifd(int channels)
+{
+    g_autoptr(qemuMigrationParams) migParams = NULL;
+
+    if (!(migParams = qemuMigrationParamsNew()))
+        return NULL;
+
+    ignore_value(virBitmapSetBit(migParams->caps, QEMU_MIGRATION_CAP_MULTIFD));
+    migParams->params[QEMU_MIGRATION_PARAM_MULTIFD_CHANNELS].value.i = channels;
+    migParams->params[QEMU_MIGRATION_PARAM_MULTIFD_CHANNELS].set = true;
+
+    return g_steal_pointer(&migParams);
+}
+
+
 void
 qemuMigrationParamsFree(qemuMigrationParamsPtr migParams)
 {
@@ -269,6 +299,7 @@ qemuMigrationParamsFree(qemuMigrationParamsPtr migParams)
     }
 
     virBitmapFree(migParams->caps);
+    g_free(migParams->converge);
     VIR_FREE(migParams);
 }
 
@@ -455,6 +486,58 @@ qemuMigrationParamsSetTPString(qemuMigrationParamsPtr migParams,
 
 
 
+static int
+qemuMigrationParamsSetConverge(virTypedParameterPtr params,
+                               int nparams,
+                               unsigned long flags,
+                               qemuMigrationParamsPtr migParams)
+{
+    unsigned long long maxTime = 0;
+    unsigned long long maxDowntime = 0;
+    qemuMigrationParamValuePtr increment;
+
+    if (virTypedParamsGetULLong(params, nparams,
+                                VIR_MIGRATE_PARAM_CONVERGE_TIME,
+                                &maxTime) < 0 ||
+        virTypedParamsGetULLong(params, nparams,
+                                VIR_MIGRATE_PARAM_CONVERGE_DOWNTIME,
+                                &maxDowntime) < 0)
+        return -1;
+
+    if (maxTime == 0 && maxDowntime == 0)
+        return 0;
+
+    if (flags & VIR_MIGRATE_POSTCOPY) {
+        virReportError(VIR_ERR_ARGUMENT_UNSUPPORTED, "%s",
+                       _("Migration convergence targets cannot be used "
+                         "with post-copy migration"));
+        return -1;
+    }
+
+    if (maxDowntime == 0 && !(flags & VIR_MIGRATE_AUTO_CONVERGE)) {
+        virReportError(VIR_ERR_INVALID_ARG, "%s",
+                       _("Migration time target requires either maximum "
+                         "downtime or auto convergence"));
+        return -1;
+    }
+
+    migParams->converge = g_new0(qemuMigrationConverge, 1);
+    migParams->converge->maxTime = maxTime;
+    migParams->converge->maxDowntime = maxDowntime;
+    migParams->converge->throttle = !!(flags & VIR_MIGRATE_AUTO_CONVERGE);
+
+    increment = &migParams->params[QEMU_MIGRATION_PARAM_THROTTLE_INCREMENT];
+    if (increment->set)
+        migParams->converge->throttleIncrement = increment->value.i;
+
+    VIR_DEBUG("Migration convergence targets: time=%llu ms, downtime=%llu ms, "
+              "throttle=%d", maxTime, maxDowntime,
+              migParams->converge->throttle);
+
+    return 0;
+}
+
+
 static int
 qemuMigrationParamsSetCompression(virTypedParameterPtr params,
                                   int nparams,
@@ -604,6 +687,10 @@ qemuMigrationParamsFromFlags(virTypedParameterPtr params,
     if (qemuMigrationParamsSetCompression(params, nparams, flags, migParams) < 0)
         return NULL;
 
+    if (party & QEMU_MIGRATION_SOURCE &&
+        qemuMigrationParamsSetConverge(params, nparams, flags, migParams) < 0)
+        return NULL;
+
     return g_steal_pointer(&migParams);
 }
 
@@ -1427,3 +1514,218 @@ qemuMigrationCapsGet(virDomainObjPtr vm,
 
     return enabled;
 }
+
+
+qemuMigrationConvergePtr
+qemuMigrationParamsGetConverge(qemuMigrationParamsPtr migParams)
+{
+    return migParams->converge;
+}
+
+
+/**
+ * qemuMigrationParamsConvergeStart:
+ * @conv: convergence controller
+ * @origParams: migration parameters fetched from QEMU before migration
+ *
+ * Initializes the controller with the downtime limit and throttle increment
+ * QEMU is going to start the migration with.
+ *
+ * Returns 0 on success, -1 with a libvirt error reported if QEMU is not able
+ * to tune the parameters the controller is supposed to change.
+ */
+int
+qemuMigrationParamsConvergeStart(qemuMigrationConvergePtr conv,
+                                 qemuMigrationParamsPtr origParams)
+{
+    qemuMigrationParamValuePtr downtime;
+    qemuMigrationParamValuePtr increment;
+
+    downtime = &origParams->params[QEMU_MIGRATION_PARAM_DOWNTIME_LIMIT];
+    increment = &origParams->params[QEMU_MIGRATION_PARAM_THROTTLE_INCREMENT];
+
+    if (conv->maxDowntime > 0) {
+        if (!downtime->set) {
+            virReportError(VIR_ERR_OPERATION_UNSUPPORTED, "%s",
+                           _("QEMU does not support changing downtime limit "
+                             "during migration"));
+            return -1;
+        }
+        conv->downtime = downtime->value.ull;
+    }
+
+    if (conv->throttle && !increment->set) {
+        if (conv->maxDowntime == 0) {
+            virReportError(VIR_ERR_OPERATION_UNSUPPORTED, "%s",
+                           _("QEMU does not support changing CPU throttling "
+                             "during migration"));
+            return -1;
+        }
+
+        VIR_DEBUG("QEMU cannot change CPU throttling, using downtime only");
+        conv->throttle = false;
+    }
+
+    if (conv->throttle && conv->throttleIncrement == 0) {
+        conv->throttleIncrement = increment->value.i;
+        if (conv->throttleIncrement <= 0)
+            conv->throttleIncrement = QEMU_MIGRATION_CONVERGE_THROTTLE_INCREMENT;
+    }
+
+    conv->iteration = 0;
+    conv->adjustments = 0;
+
+    return 0;
+}
+
+
+/**
+ * qemuMigrationParamsConvergeUpdate:
+ * @conv: convergence controller
+ * @stats: migration statistics from QEMU
+ *
+ * Looks at the statistics of the last RAM pass and decides whether downtime
+ * limit or CPU throttle increment need to be changed to meet the targets set
+ * in @conv. The new values are stored in @conv.
+ *
+ * Returns true if the parameters need to be sent to QEMU.
+ */
+bool
+qemuMigrationParamsConvergeUpdate(qemuMigrationConvergePtr conv,
+                                  qemuMonitorMigrationStatsPtr stats)
+{
+    unsigned long long downtime = conv->downtime;
+    int increment = conv->throttleIncrement;
+    unsigned long long dirty;
+    unsigned long long needed;
+    bool converging;
+    bool late = false;
+
+    /* The first pass copies all memory and tells nothing about how fast the
+     * guest is dirtying it. */
+    if (stats->ram_iteration > conv->iteration)
+        conv->iteration = stats->ram_iteration;
+
+    if (stats->ram_iteration < 2 || stats->ram_bps == 0)
+        return false;
+
+    dirty = stats->ram_dirty_rate * stats->ram_page_size;
+
+    /* downtime needed for sending the rest of memory at once */
+    needed = stats->ram_remaining * 1000 / stats->ram_bps;
+
+    /* Every pass only shrinks the remaining memory by the difference between
+     * transfer and dirty rates, which is not worth waiting for when the
+     * guest dirties memory at more than 90% of the transfer rate. */
+    converging = dirty < stats->ram_bps / 10 * 9;
+
+    if (conv->maxTime > 0) {
+        if (!converging || stats->total_time >= conv->maxTime) {
+            late = true;
+        } else {
+            unsigned long long eta;
+
+            eta = stats->ram_remaining * 1000 / (stats->ram_bps - dirty);
+            late = stats->total_time + eta > conv->maxTime;
+        }
+    }
+
+    VIR_DEBUG("Migration pass %llu: bps=%llu dirty=%llu remaining=%llu "
+              "needed=%llu ms converging=%d late=%d",
+              stats->ram_iteration, stats->ram_bps, dirty,
+              stats->ram_remaining, needed, converging, late);
+
+    if (converging && !late)
+        return false;
+
+    if (conv->maxDowntime > 0 && needed > downtime)
+        downtime = MIN(needed, conv->maxDowntime);
+
+    /* Throttling is the only option left when the rest of memory does not
+     * fit into the downtime we are allowed to use. */
+    if (conv->throttle &&
+        (!converging || needed > downtime) &&
+        increment < QEMU_MIGRATION_CONVERGE_THROTTLE_INCREMENT_MAX)
+        increment = MIN(increment * 2,
+                        QEMU_MIGRATION_CONVERGE_THROTTLE_INCREMENT_MAX);
+
+    if (downtime == conv->downtime &&
+        increment == conv->throttleIncrement)
+        return false;
+
+    VIR_DEBUG("Changing downtime limit %llu -> %llu ms, "
+              "throttle increment %d -> %d",
+              conv->downtime, downtime, conv->throttleIncrement, increment);
+
+    conv->downtime = downtime;
+    conv->throttleIncrement = increment;
+    conv->adjustments++;
+
+    return true;
+}
+
+
+virJSONValuePtr
+qemuMigrationParamsConvergeToJSON(qemuMigrationConvergePtr conv)
+{
+    g_autoptr(qemuMigrationParams) migParams = NULL;
+    qemuMigrationParamValuePtr increment;
+
+    if (!(migParams = qemuMigrationParamsNew()))
+        return NULL;
+
+    if (conv->maxDowntime > 0 &&
+        qemuMigrationParamsSetULL(migParams,
+                                  QEMU_MIGRATION_PARAM_DOWNTIME_LIMIT,
+                                  conv->downtime) < 0)
+        return NULL;
+
+    if (conv->throttle) {
+        increment = &migParams->params[QEMU_MIGRATION_PARAM_THROTTLE_INCREMENT];
+        increment->value.i = conv->throttleIncrement;
+        increment->set = true;
+    }
+
+    return qemuMigrationParamsToJSON(migParams);
+}
+
+
+/**
+ * qemuMigrationParamsConvergeApply:
+ * @driver: qemu driver
+ * @vm: domain object
+ * @asyncJob: migration job
+ * @conv: convergence controller
+ *
+ * Sends the parameters chosen by qemuMigrationParamsConvergeUpdate to QEMU.
+ * Unlike qemuMigrationParamsApply this leaves migration capabilities alone
+ * and is thus usable while migration is running.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+int
+qemuMigrationParamsConvergeApply(virQEMUDriverPtr driver,
+                                 virDomainObjPtr vm,
+                                 int asyncJob,
+                                 qemuMigrationConvergePtr conv)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    g_autoptr(virJSONValue) params = NULL;
+    int rc;
+
+    if (!(params = qemuMigrationParamsConvergeToJSON(conv)))
+        return -1;
+
+    if (virJSONValueObjectKeysNumber(params) == 0)
+        return 0;
+
+    if (qemuDomainObjEnterMonitorAsync(driver, vm, asyncJob) < 0)
+        return -1;
+
+    rc = qemuMonitorSetMigrationParams(priv->mon, g_steal_pointer(&params));
+
+    if (qemuDomainObjExitMonitor(driver, vm) < 0 || rc < 0)
+        return -1;
+
+    return 0;
+}
@@ -70,6 +70,21 @@ typedef enum {
     QEMU_MIGRATION_DESTINATION = (1 << 1),
 } qemuMigrationParty;
 
+typedef struct _qemuMigrationConverge qemuMigrationConverge;
+typedef qemuMigrationConverge *qemuMigrationConvergePtr;
+struct _qemuMigrationConverge {
+    /* targets requested by the caller, 0 when not set */
+    unsigned long long maxTime;     /* total migration time in ms */
+    unsigned long long maxDowntime; /* upper bound for downtime-limit in ms */
+    bool throttle;                  /* auto-converge is enabled */
+
+    /* decisions made so far */
+    unsigned long long iteration;   /* last RAM pass looked at */
+    unsigned long long downtime;    /* downtime-limit in ms */
+    int throttleIncrement;          /* cpu-throttle-increment */
+    unsigned long long adjustments; /* number of parameter changes */
+};
+
 
 virBitmapPtr
 qemuMigrationParamsGetAlwaysOnCaps(qemuMigrationParty party);
@@ -90,6 +105,9 @@ qemuMigrationParamsDump(qemuMigrationParamsPtr migParams,
 qemuMigrationParamsPtr
 qemuMigrationParamsNew(void);
 
+qemuMigrationParamsPtr
+qemuMigrationParamsNewMultifd(int channels);
+
 void
 qemuMigrationParamsFree(qemuMigrationParamsPtr migParams);
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(qemuMigrationParams, qemuMigrationParamsFree);
@@ -159,3 +177,20 @@ qemuMigrationCapsCheck(virQEMUDriverPtr driver,
 bool
 qemuMigrationCapsGet(virDomainObjPtr vm,
                      qemuMigrationCapability cap);
+
+qemuMigrationConvergePtr
+qemuMigrationParamsGetConverge(qemuMigrationParamsPtr migParams);
+
+int
+qemuMigrationParamsConvergeStart(qemuMigrationConvergePtr conv,
+                                 qemuMigrationParamsPtr origParams);
+
+bool
+qemuMigrationParamsConvergeUpdate(qemuMigrationConvergePtr conv,
+                                  qemuMonitorMigrationStatsPtr stats);
+
+int
+qemuMigrationParamsConvergeApply(virQEMUDriverPtr driver,
+                                 virDomainObjPtr vm,
+                                 int asyncJob,
+                                 qemuMigrationConvergePtr conv);
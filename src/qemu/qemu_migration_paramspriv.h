@@ -34,3 +34,6 @@ qemuMigrationParamsFromJSON(virJSONValuePtr params);
 virJSONValuePtr
 qemuMigrationCapsToJSON(virBitmapPtr caps,
                         virBitmapPtr states);
+
+virJSONValuePtr
+qemuMigrationParamsConvergeToJSON(qemuMigrationConvergePtr conv);
@@ -58,12 +58,18 @@ VIR_LOG_INIT("qemu.qemu_monitor");
 #define DEBUG_IO 0
 #define DEBUG_RAW_IO 0
 
-/* We read from QEMU until seeing a \r\n pair to indicate a
- * completed reply or event. To avoid memory denial-of-service
- * though, we must have a size limit on amount of data we
- * buffer. 10 MB is large enough that it ought to cope with
- * normal QEMU replies, and small enough that we're not
- * consuming unreasonable mem.
+/* Data read from QEMU is passed to an incremental JSON parser
+ * right away, so this only limits how much we read from the
+ * socket at once.
+ */
+#define QEMU_MONITOR_READ_SIZE (64 * 1024)
+
+/* The parser keeps incomplete replies and events in memory. To
+ * avoid memory denial-of-service we must have a size limit on
+ * the amount of data received without completing any message.
+ * 10 MB is large enough that it ought to cope with normal QEMU
+ * replies, and small enough that we're not consuming
+ * unreasonable mem.
  */
 #define QEMU_MONITOR_MAX_RESPONSE (10 * 1024 * 1024)
 
@@ -83,16 +89,21 @@ struct _qemuMonitor {
     qemuMonitorCallbacksPtr cb;
     void *callbackOpaque;
 
-    /* If there's a command being processed this will be
-     * non-NULL */
-    qemuMonitorMessagePtr msg;
+    /* Commands being processed in the order they were sent,
+     * several of them may be waiting for a reply at once */
+    qemuMonitorMessagePtr *msgs;
+    size_t nmsgs;
 
-    /* Buffer incoming data ready for Text/QMP monitor
-     * code to process & find message boundaries */
+    /* Buffer incoming data ready for QMP monitor code
+     * to feed to @parser */
     size_t bufferOffset;
-    size_t bufferLength;
     char *buffer;
 
+    /* Incremental parser of the data received from QEMU */
+    virJSONStreamParserPtr parser;
+    /* Data fed to @parser since the last complete message */
+    size_t parserPending;
+
     /* If anything went wrong, this will be fed back
      * the next monitor msg */
     virError lastError;
@@ -232,6 +243,8 @@ qemuMonitorDispose(void *obj)
     virResetError(&mon->lastError);
     virCondDestroy(&mon->notify);
     VIR_FREE(mon->buffer);
+    virJSONStreamParserFree(mon->parser);
+    VIR_FREE(mon->msgs);
     virJSONValueFree(mon->options);
     VIR_FREE(mon->balloonpath);
 }
@@ -305,6 +318,69 @@ qemuMonitorOpenUnix(const char *monitor,
 }
 
 
+/* Returns the first message which wasn't completely sent yet */
+static qemuMonitorMessagePtr
+qemuMonitorGetTxMessage(qemuMonitorPtr mon)
+{
+    size_t i;
+
+    for (i = 0; i < mon->nmsgs; i++) {
+        if (mon->msgs[i]->txOffset < mon->msgs[i]->txLength)
+            return mon->msgs[i];
+    }
+
+    return NULL;
+}
+
+
+/**
+ * qemuMonitorGetReplyMessage:
+ * @mon: monitor
+ * @id: QMP 'id' of the received reply or NULL
+ *
+ * Returns the message a reply with @id belongs to. Replies without
+ * a known id are matched to the oldest message waiting for a reply,
+ * as QEMU processes commands in order. Returns NULL if no message is
+ * waiting for a reply. The caller has to hold the lock for @mon.
+ */
+qemuMonitorMessagePtr
+qemuMonitorGetReplyMessage(qemuMonitorPtr mon,
+                           const char *id)
+{
+    qemuMonitorMessagePtr oldest = NULL;
+    size_t i;
+
+    for (i = 0; i < mon->nmsgs; i++) {
+        qemuMonitorMessagePtr msg = mon->msgs[i];
+
+        if (msg->finished || msg->txOffset < msg->txLength)
+            continue;
+
+        if (id && STREQ_NULLABLE(msg->id, id))
+            return msg;
+
+        if (!oldest)
+            oldest = msg;
+    }
+
+    return oldest;
+}
+
+
+/* Wakes up everyone waiting for a reply after a fatal error */
+static void
+qemuMonitorFinishMessages(qemuMonitorPtr mon)
+{
+    size_t i;
+
+    for (i = 0; i < mon->nmsgs; i++)
+        mon->msgs[i]->finished = true;
+
+    if (mon->nmsgs > 0)
+        virCondBroadcast(&mon->notify);
+}
+
+
 /* This method processes data that has been received
  * from the monitor. Looking for async events and
  * replies/errors.
@@ -313,20 +389,12 @@ static int
 qemuMonitorIOProcess(qemuMonitorPtr mon)
 {
     int len;
-    qemuMonitorMessagePtr msg = NULL;
-
-    /* See if there's a message & whether its ready for its reply
-     * ie whether its completed writing all its data */
-    if (mon->msg && mon->msg->txOffset == mon->msg->txLength)
-        msg = mon->msg;
 
 #if DEBUG_IO
 # if DEBUG_RAW_IO
-    char *str1 = qemuMonitorEscapeNonPrintable(msg ? msg->txBuffer : "");
-    char *str2 = qemuMonitorEscapeNonPrintable(mon->buffer);
-    VIR_ERROR(_("Process %d %p %p [[[[%s]]][[[%s]]]"), (int)mon->bufferOffset, mon->msg, msg, str1, str2);
-    VIR_FREE(str1);
-    VIR_FREE(str2);
+    char *str = qemuMonitorEscapeNonPrintable(mon->buffer);
+    VIR_ERROR(_("Process %d [[[%s]]]"), (int)mon->bufferOffset, str);
+    VIR_FREE(str);
 # else
     VIR_DEBUG("Process %d", (int)mon->bufferOffset);
 # endif
@@ -335,30 +403,38 @@ qemuMonitorIOProcess(qemuMonitorPtr mon)
     PROBE_QUIET(QEMU_MONITOR_IO_PROCESS, "mon=%p buf=%s len=%zu",
                 mon, mon->buffer, mon->bufferOffset);
 
-    len = qemuMonitorJSONIOProcess(mon,
-                                   mon->buffer, mon->bufferOffset,
-                                   msg);
+    /* The whole buffer is always consumed as incomplete messages are
+     * kept by the parser until the rest of them arrives. */
+    len = qemuMonitorJSONIOProcess(mon, mon->parser,
+                                   mon->buffer, mon->bufferOffset);
     if (len < 0)
         return -1;
 
     if (len && mon->waitGreeting)
         mon->waitGreeting = false;
 
-    if (len < mon->bufferOffset) {
-        memmove(mon->buffer, mon->buffer + len, mon->bufferOffset - len);
-        mon->bufferOffset -= len;
-    } else {
-        VIR_FREE(mon->buffer);
-        mon->bufferOffset = mon->bufferLength = 0;
+    /* Data following the last complete message in this chunk isn't
+     * counted, so the limit may be exceeded by up to one read. */
+    if (len > 0)
+        mon->parserPending = 0;
+    else
+        mon->parserPending += mon->bufferOffset;
+
+    mon->bufferOffset = 0;
+
+    if (mon->parserPending > QEMU_MONITOR_MAX_RESPONSE) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("QEMU monitor reply exceeds buffer size (%d bytes)"),
+                       QEMU_MONITOR_MAX_RESPONSE);
+        return -1;
     }
 #if DEBUG_IO
-    VIR_DEBUG("Process done %d used %d", (int)mon->bufferOffset, len);
+    VIR_DEBUG("Process done, %d messages processed", len);
 #endif
 
-    /* As the monitor mutex was unlocked in qemuMonitorJSONIOProcess()
-     * while dealing with qemu event, mon->msg could be changed which
-     * means the above 'msg' may be invalid, thus we use 'mon->msg' here */
-    if (mon->msg && mon->msg->finished)
+    /* Replies may have finished any of the messages, let the sender
+     * check them */
+    if (len && mon->nmsgs > 0)
         virCondBroadcast(&mon->notify);
     return len;
 }
@@ -413,41 +489,48 @@ qemuMonitorIOWriteWithFD(qemuMonitorPtr mon,
 static int
 qemuMonitorIOWrite(qemuMonitorPtr mon)
 {
-    int done;
-    char *buf;
-    size_t len;
+    qemuMonitorMessagePtr msg;
+    int total = 0;
 
-    /* If no active message, or fully transmitted, the no-op */
-    if (!mon->msg || mon->msg->txOffset == mon->msg->txLength)
-        return 0;
+    /* Send as many of the queued messages as the socket takes, QEMU
+     * reads the next command while still processing the previous */
+    while ((msg = qemuMonitorGetTxMessage(mon))) {
+        int done;
+        char *buf = msg->txBuffer + msg->txOffset;
+        size_t len = msg->txLength - msg->txOffset;
 
-    buf = mon->msg->txBuffer + mon->msg->txOffset;
-    len = mon->msg->txLength - mon->msg->txOffset;
-    if (mon->msg->txFD == -1)
-        done = write(mon->fd, buf, len);
-    else
-        done = qemuMonitorIOWriteWithFD(mon, buf, len, mon->msg->txFD);
+        if (msg->txFD == -1)
+            done = write(mon->fd, buf, len);
+        else
+            done = qemuMonitorIOWriteWithFD(mon, buf, len, msg->txFD);
 
-    PROBE(QEMU_MONITOR_IO_WRITE,
-          "mon=%p buf=%s len=%zu ret=%d errno=%d",
-          mon, buf, len, done, done < 0 ? errno : 0);
+        PROBE(QEMU_MONITOR_IO_WRITE,
+              "mon=%p buf=%s len=%zu ret=%d errno=%d",
+              mon, buf, len, done, done < 0 ? errno : 0);
 
-    if (mon->msg->txFD != -1) {
-        PROBE(QEMU_MONITOR_IO_SEND_FD,
-              "mon=%p fd=%d ret=%d errno=%d",
-              mon, mon->msg->txFD, done, done < 0 ? errno : 0);
-    }
+        if (msg->txFD != -1) {
+            PROBE(QEMU_MONITOR_IO_SEND_FD,
+                  "mon=%p fd=%d ret=%d errno=%d",
+                  mon, msg->txFD, done, done < 0 ? errno : 0);
+        }
 
-    if (done < 0) {
-        if (errno == EAGAIN)
-            return 0;
+        if (done < 0) {
+            if (errno == EAGAIN)
+                break;
 
-        virReportSystemError(errno, "%s",
-                             _("Unable to write to monitor"));
-        return -1;
+            virReportSystemError(errno, "%s",
+                                 _("Unable to write to monitor"));
+            return -1;
+        }
+        msg->txOffset += done;
+        total += done;
+
+        /* the socket is full */
+        if ((size_t) done < len)
+            break;
     }
-    mon->msg->txOffset += done;
-    return done;
+
+    return total;
 }
 
 
@@ -460,22 +543,13 @@ qemuMonitorIOWrite(qemuMonitorPtr mon)
 static int
 qemuMonitorIORead(qemuMonitorPtr mon)
 {
-    size_t avail = mon->bufferLength - mon->bufferOffset;
+    size_t avail;
     int ret = 0;
 
-    if (avail < 1024) {
-        if (mon->bufferLength >= QEMU_MONITOR_MAX_RESPONSE) {
-            virReportError(VIR_ERR_INTERNAL_ERROR,
-                           _("QEMU monitor reply exceeds buffer size (%d bytes)"),
-                           QEMU_MONITOR_MAX_RESPONSE);
-            return -1;
-        }
-        if (VIR_REALLOC_N(mon->buffer,
-                          mon->bufferLength + 1024) < 0)
-            return -1;
-        mon->bufferLength += 1024;
-        avail += 1024;
-    }
+    if (!mon->buffer)
+        mon->buffer = g_new0(char, QEMU_MONITOR_READ_SIZE);
+
+    avail = QEMU_MONITOR_READ_SIZE - mon->bufferOffset;
 
     /* Read as much as we can get into our buffer,
        until we block on EAGAIN, or hit EOF */
@@ -616,12 +690,9 @@ qemuMonitorIO(GSocket *socket G_GNUC_UNUSED,
         }
 
         VIR_DEBUG("Error on monitor %s", NULLSTR(mon->lastError.message));
-        /* If IO process resulted in an error & we have a message,
-         * then wakeup that waiter */
-        if (mon->msg && !mon->msg->finished) {
-            mon->msg->finished = true;
-            virCondSignal(&mon->notify);
-        }
+        /* If IO process resulted in an error & we have messages,
+         * then wakeup the waiters */
+        qemuMonitorFinishMessages(mon);
     }
 
     qemuMonitorUpdateWatch(mon);
@@ -690,6 +761,10 @@ qemuMonitorOpenInternal(virDomainObjPtr vm,
                        _("cannot initialize monitor condition"));
         goto cleanup;
     }
+    /* keys in QMP replies are mostly defined by the QAPI schema; the
+     * table of shared keys is bounded and freed with the parser */
+    if (!(mon->parser = virJSONStreamParserNew(VIR_JSON_STREAM_PARSER_INTERN_KEYS)))
+        goto cleanup;
     mon->fd = fd;
     mon->context = g_main_context_ref(context);
     mon->vm = virObjectRef(vm);
@@ -826,7 +901,7 @@ qemuMonitorRegister(qemuMonitorPtr mon)
     if (mon->lastError.code == VIR_ERR_OK) {
         cond |= G_IO_IN;
 
-        if ((mon->msg && mon->msg->txOffset < mon->msg->txLength) &&
+        if (qemuMonitorGetTxMessage(mon) &&
             !mon->waitGreeting)
             cond |= G_IO_OUT;
     }
@@ -874,10 +949,10 @@ qemuMonitorClose(qemuMonitorPtr mon)
         mon->fd = -1;
     }
 
-    /* In case another thread is waiting for its monitor command to be
+    /* In case another thread is waiting for its monitor commands to be
      * processed, we need to wake it up with appropriate error set.
      */
-    if (mon->msg) {
+    if (mon->nmsgs > 0) {
         if (mon->lastError.code == VIR_ERR_OK) {
             virErrorPtr err;
 
@@ -891,8 +966,7 @@ qemuMonitorClose(qemuMonitorPtr mon)
             else
                 virResetLastError();
         }
-        mon->msg->finished = true;
-        virCondSignal(&mon->notify);
+        qemuMonitorFinishMessages(mon);
     }
 
     /* Propagate existing monitor error in case the current thread has no
@@ -924,11 +998,29 @@ qemuMonitorResetCommandID(qemuMonitorPtr mon)
 }
 
 
-int
-qemuMonitorSend(qemuMonitorPtr mon,
-                qemuMonitorMessagePtr msg)
+static bool
+qemuMonitorMessagesFinished(qemuMonitorMessagePtr *msgs,
+                            size_t nmsgs)
+{
+    size_t i;
+
+    for (i = 0; i < nmsgs; i++) {
+        if (!msgs[i]->finished)
+            return false;
+    }
+
+    return true;
+}
+
+
+static int
+qemuMonitorSendInternal(qemuMonitorPtr mon,
+                        qemuMonitorMessagePtr *msgs,
+                        size_t nmsgs)
 {
     int ret = -1;
+    size_t i;
+    size_t j;
 
     /* Check whether qemu quit unexpectedly */
     if (mon->lastError.code != VIR_ERR_OK) {
@@ -938,14 +1030,17 @@ qemuMonitorSend(qemuMonitorPtr mon,
         return -1;
     }
 
-    mon->msg = msg;
-    qemuMonitorUpdateWatch(mon);
+    for (i = 0; i < nmsgs; i++) {
+        PROBE(QEMU_MONITOR_SEND_MSG,
+              "mon=%p msg=%s fd=%d",
+              mon, msgs[i]->txBuffer, msgs[i]->txFD);
 
-    PROBE(QEMU_MONITOR_SEND_MSG,
-          "mon=%p msg=%s fd=%d",
-          mon, mon->msg->txBuffer, mon->msg->txFD);
+        ignore_value(VIR_APPEND_ELEMENT_COPY(mon->msgs, mon->nmsgs, msgs[i]));
+    }
 
-    while (!mon->msg->finished) {
+    qemuMonitorUpdateWatch(mon);
+
+    while (!qemuMonitorMessagesFinished(msgs, nmsgs)) {
         if (virCondWait(&mon->notify, &mon->parent.lock) < 0) {
             virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                            _("Unable to wait on monitor condition"));
@@ -963,13 +1058,49 @@ qemuMonitorSend(qemuMonitorPtr mon,
     ret = 0;
 
  cleanup:
-    mon->msg = NULL;
+    for (i = 0; i < nmsgs; i++) {
+        for (j = 0; j < mon->nmsgs; j++) {
+            if (mon->msgs[j] == msgs[i]) {
+                VIR_DELETE_ELEMENT(mon->msgs, j, mon->nmsgs);
+                break;
+            }
+        }
+    }
     qemuMonitorUpdateWatch(mon);
 
     return ret;
 }
 
 
+int
+qemuMonitorSend(qemuMonitorPtr mon,
+                qemuMonitorMessagePtr msg)
+{
+    return qemuMonitorSendInternal(mon, &msg, 1);
+}
+
+
+/**
+ * qemuMonitorSendBatch:
+ * @mon: monitor
+ * @msgs: messages to send
+ * @nmsgs: number of @msgs
+ *
+ * Sends all @msgs to QEMU without waiting for the reply to one of them
+ * before sending the next one and waits until all of them are replied
+ * to. This saves a round trip per message for independent commands.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+qemuMonitorSendBatch(qemuMonitorPtr mon,
+                     qemuMonitorMessagePtr *msgs,
+                     size_t nmsgs)
+{
+    return qemuMonitorSendInternal(mon, msgs, nmsgs);
+}
+
+
 /**
  * This function returns a new virError object; the caller is responsible
  * for freeing it.
@@ -2157,6 +2288,56 @@ qemuMonitorGetAllBlockStatsInfo(qemuMonitorPtr mon,
 }
 
 
+/**
+ * qemuMonitorGetAllBlockStatsCapacity:
+ * @mon: monitor object
+ * @ret_stats: pointer that is filled with a hash table containing the stats
+ * @backingChain: recurse into the backing chain of devices
+ * @blockdev: the domain uses -blockdev
+ * @bestEffort: don't fail if only the capacity or @nodedata can't be fetched
+ * @nodedata: if non-NULL, filled with the result of query-named-block-nodes
+ *
+ * Like qemuMonitorGetAllBlockStatsInfo, but also fills the capacity
+ * as qemuMonitorBlockStatsUpdateCapacity or
+ * qemuMonitorBlockStatsUpdateCapacityBlockdev would and optionally
+ * returns the same data as qemuMonitorQueryNamedBlockNodes. All the
+ * queries are sent to QEMU at once.
+ *
+ * Returns < 0 on error, count of supported block stats fields on success.
+ */
+int
+qemuMonitorGetAllBlockStatsCapacity(qemuMonitorPtr mon,
+                                    virHashTablePtr *ret_stats,
+                                    bool backingChain,
+                                    bool blockdev,
+                                    bool bestEffort,
+                                    virJSONValuePtr *nodedata)
+{
+    int ret = -1;
+    VIR_DEBUG("ret_stats=%p, backing=%d, blockdev=%d, bestEffort=%d, nodedata=%p",
+              ret_stats, backingChain, blockdev, bestEffort, nodedata);
+
+    QEMU_CHECK_MONITOR(mon);
+
+    if (!(*ret_stats = virHashCreate(10, virHashValueFree)))
+        goto error;
+
+    ret = qemuMonitorJSONGetAllBlockStatsCapacity(mon, *ret_stats,
+                                                  backingChain, blockdev,
+                                                  bestEffort, nodedata);
+
+    if (ret < 0)
+        goto error;
+
+    return ret;
+
+ error:
+    virHashFree(*ret_stats);
+    *ret_stats = NULL;
+    return -1;
+}
+
+
 /* Updates "stats" to fill virtual and physical size of the image */
 int
 qemuMonitorBlockStatsUpdateCapacity(qemuMonitorPtr mon,
@@ -2531,6 +2712,21 @@ qemuMonitorMigrateToFd(qemuMonitorPtr mon,
 }
 
 
+int
+qemuMonitorMigrateToSocket(qemuMonitorPtr mon,
+                           unsigned int flags,
+                           const char *socketPath)
+{
+    g_autofree char *uri = g_strdup_printf("unix:%s", socketPath);
+
+    VIR_DEBUG("socketPath=%s flags=0x%x", socketPath, flags);
+
+    QEMU_CHECK_MONITOR(mon);
+
+    return qemuMonitorJSONMigrate(mon, flags, uri);
+}
+
+
 int
 qemuMonitorMigrateToHost(qemuMonitorPtr mon,
                          unsigned int flags,
@@ -42,6 +42,9 @@ typedef qemuMonitorMessage *qemuMonitorMessagePtr;
 struct _qemuMonitorMessage {
     int txFD;
 
+    /* QMP 'id' of the command used to match the reply, may be NULL */
+    const char *id;
+
     char *txBuffer;
     int txOffset;
     int txLength;
@@ -409,6 +412,11 @@ int qemuMonitorSetLink(qemuMonitorPtr mon,
 char *qemuMonitorNextCommandID(qemuMonitorPtr mon);
 int qemuMonitorSend(qemuMonitorPtr mon,
                     qemuMonitorMessagePtr msg) G_GNUC_NO_INLINE;
+int qemuMonitorSendBatch(qemuMonitorPtr mon,
+                         qemuMonitorMessagePtr *msgs,
+                         size_t nmsgs) G_GNUC_NO_INLINE;
+qemuMonitorMessagePtr qemuMonitorGetReplyMessage(qemuMonitorPtr mon,
+                                                 const char *id);
 virJSONValuePtr qemuMonitorGetOptions(qemuMonitorPtr mon)
     ATTRIBUTE_NONNULL(1);
 void qemuMonitorSetOptions(qemuMonitorPtr mon, virJSONValuePtr options)
@@ -666,6 +674,14 @@ int qemuMonitorGetAllBlockStatsInfo(qemuMonitorPtr mon,
                                     bool backingChain)
     ATTRIBUTE_NONNULL(2);
 
+int qemuMonitorGetAllBlockStatsCapacity(qemuMonitorPtr mon,
+                                        virHashTablePtr *ret_stats,
+                                        bool backingChain,
+                                        bool blockdev,
+                                        bool bestEffort,
+                                        virJSONValuePtr *nodedata)
+    ATTRIBUTE_NONNULL(2);
+
 int qemuMonitorBlockStatsUpdateCapacity(qemuMonitorPtr mon,
                                         virHashTablePtr stats,
                                         bool backingChain)
@@ -847,6 +863,10 @@ int qemuMonitorMigrateToFd(qemuMonitorPtr mon,
                            unsigned int flags,
                            int fd);
 
+int qemuMonitorMigrateToSocket(qemuMonitorPtr mon,
+                               unsigned int flags,
+                               const char *socketPath);
+
 int qemuMonitorMigrateToHost(qemuMonitorPtr mon,
                              unsigned int flags,
                              const char *protocol,
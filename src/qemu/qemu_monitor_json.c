@@ -50,7 +50,6 @@ VIR_LOG_INIT("qemu.qemu_monitor_json");
 
 #define QOM_CPU_PATH  "/machine/unattached/device[0]"
 
-#define LINE_ENDING "\r\n"
 
 VIR_ENUM_IMPL(qemuMonitorJob,
               QEMU_MONITOR_JOB_TYPE_LAST,
@@ -209,137 +208,246 @@ qemuMonitorJSONIOProcessEvent(qemuMonitorPtr mon,
     return 0;
 }
 
+/**
+ * qemuMonitorJSONIOProcessValue:
+ * @mon: monitor
+ * @obj: parsed message received from QEMU (consumed)
+ *
+ * Dispatches one complete message received from QEMU: the greeting,
+ * an event, or a reply to one of the messages sent to QEMU.
+ *
+ * Returns 0 on success, -1 on error.
+ */
 int
-qemuMonitorJSONIOProcessLine(qemuMonitorPtr mon,
-                             const char *line,
-                             qemuMonitorMessagePtr msg)
+qemuMonitorJSONIOProcessValue(qemuMonitorPtr mon,
+                              virJSONValuePtr obj)
 {
-    virJSONValuePtr obj = NULL;
-    int ret = -1;
+    g_autoptr(virJSONValue) value = obj;
+    g_autofree char *str = NULL;
 
-    VIR_DEBUG("Line [%s]", line);
+    /* The message is formatted back to a string only for logs and probes,
+     * doing so unconditionally would be expensive for large replies */
+    if (virLogSourceIsEnabled(&virLogSelf, VIR_LOG_INFO) ||
+        PROBE_ENABLED(QEMU_MONITOR_RECV_EVENT) ||
+        PROBE_ENABLED(QEMU_MONITOR_RECV_REPLY)) {
+        if (!(str = virJSONValueToString(value, false)))
+            return -1;
 
-    if (!(obj = virJSONValueFromString(line)))
-        goto cleanup;
+        VIR_DEBUG("Line [%s]", str);
+    }
 
-    if (virJSONValueGetType(obj) != VIR_JSON_TYPE_OBJECT) {
+    if (virJSONValueGetType(value) != VIR_JSON_TYPE_OBJECT) {
+        if (!str)
+            str = virJSONValueToString(value, false);
         virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("Parsed JSON reply '%s' isn't an object"), line);
-        goto cleanup;
+                       _("Parsed JSON reply '%s' isn't an object"),
+                       NULLSTR(str));
+        return -1;
     }
 
-    if (virJSONValueObjectHasKey(obj, "QMP") == 1) {
-        ret = 0;
-    } else if (virJSONValueObjectHasKey(obj, "event") == 1) {
+    if (virJSONValueObjectHasKey(value, "QMP") == 1) {
+        return 0;
+    } else if (virJSONValueObjectHasKey(value, "event") == 1) {
         PROBE(QEMU_MONITOR_RECV_EVENT,
-              "mon=%p event=%s", mon, line);
-        ret = qemuMonitorJSONIOProcessEvent(mon, obj);
-    } else if (virJSONValueObjectHasKey(obj, "error") == 1 ||
-               virJSONValueObjectHasKey(obj, "return") == 1) {
+              "mon=%p event=%s", mon, NULLSTR(str));
+        return qemuMonitorJSONIOProcessEvent(mon, value);
+    } else if (virJSONValueObjectHasKey(value, "error") == 1 ||
+               virJSONValueObjectHasKey(value, "return") == 1) {
+        const char *id = virJSONValueObjectGetString(value, "id");
+        qemuMonitorMessagePtr msg = qemuMonitorGetReplyMessage(mon, id);
+
         PROBE(QEMU_MONITOR_RECV_REPLY,
-              "mon=%p reply=%s", mon, line);
+              "mon=%p reply=%s", mon, NULLSTR(str));
         if (msg) {
-            msg->rxObject = obj;
+            msg->rxObject = g_steal_pointer(&value);
             msg->finished = 1;
-            obj = NULL;
-            ret = 0;
+            return 0;
         } else {
+            if (!str)
+                str = virJSONValueToString(value, false);
             virReportError(VIR_ERR_INTERNAL_ERROR,
-                           _("Unexpected JSON reply '%s'"), line);
+                           _("Unexpected JSON reply '%s'"), NULLSTR(str));
         }
     } else {
+        if (!str)
+            str = virJSONValueToString(value, false);
         virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("Unknown JSON reply '%s'"), line);
+                       _("Unknown JSON reply '%s'"), NULLSTR(str));
     }
 
- cleanup:
-    virJSONValueFree(obj);
-    return ret;
+    return -1;
 }
 
+
+/**
+ * qemuMonitorJSONIOProcess:
+ * @mon: monitor
+ * @parser: incremental parser of the data received from @mon
+ * @data: data received from QEMU
+ * @len: length of @data
+ *
+ * Feeds @data into @parser and processes all messages completed by it.
+ * Incomplete messages are kept by @parser until more data arrives.
+ *
+ * Returns the number of processed messages or -1 on error.
+ */
 int qemuMonitorJSONIOProcess(qemuMonitorPtr mon,
+                             virJSONStreamParserPtr parser,
                              const char *data,
-                             size_t len,
-                             qemuMonitorMessagePtr msg)
+                             size_t len)
 {
-    int used = 0;
+    virJSONValuePtr obj;
+    int processed = 0;
     /*VIR_DEBUG("Data %d bytes [%s]", len, data);*/
 
-    while (used < len) {
-        char *nl = strstr(data + used, LINE_ENDING);
-
-        if (nl) {
-            int got = nl - (data + used);
-            char *line;
-            line = g_strndup(data + used, got);
-            used += got + strlen(LINE_ENDING);
-            line[got] = '\0'; /* kill \n */
-            if (qemuMonitorJSONIOProcessLine(mon, line, msg) < 0) {
-                VIR_FREE(line);
-                return -1;
-            }
+    if (virJSONStreamParserFeed(parser, data, len) < 0)
+        return -1;
 
-            VIR_FREE(line);
-        } else {
-            break;
-        }
+    while ((obj = virJSONStreamParserNext(parser))) {
+        if (qemuMonitorJSONIOProcessValue(mon, obj) < 0)
+            return -1;
+        processed++;
     }
 
 #if DEBUG_IO
-    VIR_DEBUG("Total used %d bytes out of %zd available in buffer", used, len);
+    VIR_DEBUG("Processed %d messages out of %zu bytes", processed, len);
 #endif
 
-    return used;
+    return processed;
 }
 
+/*
+ * Prepares @msg for sending @cmd. The caller has to free msg->id and
+ * msg->txBuffer afterwards.
+ */
 static int
-qemuMonitorJSONCommandWithFd(qemuMonitorPtr mon,
-                             virJSONValuePtr cmd,
-                             int scm_fd,
-                             virJSONValuePtr *reply)
+qemuMonitorJSONMessageInit(qemuMonitorPtr mon,
+                           virJSONValuePtr cmd,
+                           int scm_fd,
+                           qemuMonitorMessagePtr msg)
 {
-    int ret = -1;
-    qemuMonitorMessage msg;
     g_auto(virBuffer) cmdbuf = VIR_BUFFER_INITIALIZER;
-    char *id = NULL;
+    g_autofree char *id = NULL;
 
-    *reply = NULL;
-
-    memset(&msg, 0, sizeof(msg));
+    memset(msg, 0, sizeof(*msg));
 
     if (virJSONValueObjectHasKey(cmd, "execute") == 1) {
         if (!(id = qemuMonitorNextCommandID(mon)))
-            goto cleanup;
+            return -1;
         if (virJSONValueObjectAppendString(cmd, "id", id) < 0) {
             virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                            _("Unable to append command 'id' string"));
-            goto cleanup;
+            return -1;
         }
     }
 
     if (virJSONValueToBuffer(cmd, &cmdbuf, false) < 0)
-        goto cleanup;
+        return -1;
     virBufferAddLit(&cmdbuf, "\r\n");
 
-    msg.txLength = virBufferUse(&cmdbuf);
-    msg.txBuffer = virBufferContentAndReset(&cmdbuf);
-    msg.txFD = scm_fd;
+    msg->id = g_steal_pointer(&id);
+    msg->txLength = virBufferUse(&cmdbuf);
+    msg->txBuffer = virBufferContentAndReset(&cmdbuf);
+    msg->txFD = scm_fd;
 
-    ret = qemuMonitorSend(mon, &msg);
+    return 0;
+}
 
-    if (ret == 0) {
-        if (!msg.rxObject) {
+
+static void
+qemuMonitorJSONMessageClear(qemuMonitorMessagePtr msg)
+{
+    g_free((char *) msg->id);
+    msg->id = NULL;
+    VIR_FREE(msg->txBuffer);
+    virJSONValueFree(msg->rxObject);
+    msg->rxObject = NULL;
+}
+
+
+static int
+qemuMonitorJSONCommandWithFd(qemuMonitorPtr mon,
+                             virJSONValuePtr cmd,
+                             int scm_fd,
+                             virJSONValuePtr *reply)
+{
+    int ret = -1;
+    qemuMonitorMessage msg;
+
+    *reply = NULL;
+
+    if (qemuMonitorJSONMessageInit(mon, cmd, scm_fd, &msg) < 0)
+        goto cleanup;
+
+    if (qemuMonitorSend(mon, &msg) < 0)
+        goto cleanup;
+
+    if (!msg.rxObject) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Missing monitor reply object"));
+        goto cleanup;
+    }
+
+    *reply = g_steal_pointer(&msg.rxObject);
+    ret = 0;
+
+ cleanup:
+    qemuMonitorJSONMessageClear(&msg);
+
+    return ret;
+}
+
+
+/**
+ * qemuMonitorJSONCommandBatch:
+ * @mon: monitor
+ * @cmds: commands to execute
+ * @ncmds: number of @cmds
+ * @replies: array of @ncmds elements filled with the replies
+ *
+ * Sends all @cmds to QEMU at once and waits for all the replies. This is
+ * meant for independent commands, the replies are not checked for errors.
+ * The caller has to free the replies.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+static int
+qemuMonitorJSONCommandBatch(qemuMonitorPtr mon,
+                            virJSONValuePtr *cmds,
+                            size_t ncmds,
+                            virJSONValuePtr *replies)
+{
+    g_autofree qemuMonitorMessage *msgs = g_new0(qemuMonitorMessage, ncmds);
+    g_autofree qemuMonitorMessagePtr *msgptrs = g_new0(qemuMonitorMessagePtr, ncmds);
+    int ret = -1;
+    size_t i;
+
+    for (i = 0; i < ncmds; i++) {
+        replies[i] = NULL;
+        msgptrs[i] = &msgs[i];
+        if (qemuMonitorJSONMessageInit(mon, cmds[i], -1, &msgs[i]) < 0)
+            goto cleanup;
+    }
+
+    if (qemuMonitorSendBatch(mon, msgptrs, ncmds) < 0)
+        goto cleanup;
+
+    for (i = 0; i < ncmds; i++) {
+        if (!msgs[i].rxObject) {
             virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                            _("Missing monitor reply object"));
-            ret = -1;
-        } else {
-            *reply = msg.rxObject;
+            goto cleanup;
         }
     }
 
+    for (i = 0; i < ncmds; i++)
+        replies[i] = g_steal_pointer(&msgs[i].rxObject);
+
+    ret = 0;
+
  cleanup:
-    VIR_FREE(id);
-    VIR_FREE(msg.txBuffer);
+    for (i = 0; i < ncmds; i++)
+        qemuMonitorJSONMessageClear(&msgs[i]);
 
     return ret;
 }
@@ -2687,18 +2795,14 @@ qemuMonitorJSONQueryBlockstats(qemuMonitorPtr mon)
 }
 
 
-int
-qemuMonitorJSONGetAllBlockStatsInfo(qemuMonitorPtr mon,
-                                    virHashTablePtr hash,
-                                    bool backingChain)
+static int
+qemuMonitorJSONParseAllBlockStatsInfo(virJSONValuePtr devices,
+                                      virHashTablePtr hash,
+                                      bool backingChain)
 {
     int nstats = 0;
     int rc;
     size_t i;
-    g_autoptr(virJSONValue) devices = NULL;
-
-    if (!(devices = qemuMonitorJSONQueryBlockstats(mon)))
-        return -1;
 
     for (i = 0; i < virJSONValueArraySize(devices); i++) {
         virJSONValuePtr dev = virJSONValueArrayGet(devices, i);
@@ -2735,6 +2839,20 @@ qemuMonitorJSONGetAllBlockStatsInfo(qemuMonitorPtr mon,
 }
 
 
+int
+qemuMonitorJSONGetAllBlockStatsInfo(qemuMonitorPtr mon,
+                                    virHashTablePtr hash,
+                                    bool backingChain)
+{
+    g_autoptr(virJSONValue) devices = NULL;
+
+    if (!(devices = qemuMonitorJSONQueryBlockstats(mon)))
+        return -1;
+
+    return qemuMonitorJSONParseAllBlockStatsInfo(devices, hash, backingChain);
+}
+
+
 static int
 qemuMonitorJSONBlockStatsUpdateCapacityData(virJSONValuePtr image,
                                             const char *name,
@@ -2801,17 +2919,12 @@ qemuMonitorJSONBlockStatsUpdateCapacityOne(virJSONValuePtr image,
 }
 
 
-int
-qemuMonitorJSONBlockStatsUpdateCapacity(qemuMonitorPtr mon,
-                                        virHashTablePtr stats,
-                                        bool backingChain)
+static int
+qemuMonitorJSONBlockStatsUpdateCapacityParse(virJSONValuePtr devices,
+                                             virHashTablePtr stats,
+                                             bool backingChain)
 {
-    int ret = -1;
     size_t i;
-    virJSONValuePtr devices;
-
-    if (!(devices = qemuMonitorJSONQueryBlock(mon)))
-        return -1;
 
     for (i = 0; i < virJSONValueArraySize(devices); i++) {
         virJSONValuePtr dev;
@@ -2820,10 +2933,10 @@ qemuMonitorJSONBlockStatsUpdateCapacity(qemuMonitorPtr mon,
         const char *dev_name;
 
         if (!(dev = qemuMonitorJSONGetBlockDev(devices, i)))
-            goto cleanup;
+            return -1;
 
         if (!(dev_name = qemuMonitorJSONGetBlockDevDevice(dev)))
-            goto cleanup;
+            return -1;
 
         /* drive may be empty */
         if (!(inserted = virJSONValueObjectGetObject(dev, "inserted")) ||
@@ -2833,14 +2946,25 @@ qemuMonitorJSONBlockStatsUpdateCapacity(qemuMonitorPtr mon,
         if (qemuMonitorJSONBlockStatsUpdateCapacityOne(image, dev_name, 0,
                                                        stats,
                                                        backingChain) < 0)
-            goto cleanup;
+            return -1;
     }
 
-    ret = 0;
+    return 0;
+}
 
- cleanup:
-    virJSONValueFree(devices);
-    return ret;
+
+int
+qemuMonitorJSONBlockStatsUpdateCapacity(qemuMonitorPtr mon,
+                                        virHashTablePtr stats,
+                                        bool backingChain)
+{
+    g_autoptr(virJSONValue) devices = NULL;
+
+    if (!(devices = qemuMonitorJSONQueryBlock(mon)))
+        return -1;
+
+    return qemuMonitorJSONBlockStatsUpdateCapacityParse(devices, stats,
+                                                        backingChain);
 }
 
 
@@ -2876,21 +3000,131 @@ int
 qemuMonitorJSONBlockStatsUpdateCapacityBlockdev(qemuMonitorPtr mon,
                                                 virHashTablePtr stats)
 {
-    virJSONValuePtr nodes;
-    int ret = -1;
+    g_autoptr(virJSONValue) nodes = NULL;
 
     if (!(nodes = qemuMonitorJSONQueryNamedBlockNodes(mon, false)))
         return -1;
 
-    if (virJSONValueArrayForeachSteal(nodes,
-                                      qemuMonitorJSONBlockStatsUpdateCapacityBlockdevWorker,
-                                      stats) < 0)
+    return virJSONValueArrayForeachSteal(nodes,
+                                         qemuMonitorJSONBlockStatsUpdateCapacityBlockdevWorker,
+                                         stats);
+}
+
+
+/**
+ * qemuMonitorJSONGetAllBlockStatsCapacity:
+ * @mon: monitor
+ * @hash: hash table filled with the stats
+ * @backingChain: recurse into the backing chain of devices
+ * @blockdev: fill the capacity of nodes rather than devices
+ * @bestEffort: ignore failures of queries other than query-blockstats
+ * @nodedata: if non-NULL, filled with the reply to query-named-block-nodes
+ *
+ * Combines qemuMonitorJSONGetAllBlockStatsInfo with
+ * qemuMonitorJSONBlockStatsUpdateCapacity or
+ * qemuMonitorJSONBlockStatsUpdateCapacityBlockdev (if @blockdev is true)
+ * and optionally qemuMonitorJSONQueryNamedBlockNodes while sending all
+ * the queries to QEMU at once.
+ *
+ * If @bestEffort is true, failure to fill the capacity leaves it unset
+ * and failure to get @nodedata leaves it NULL, while the block stats
+ * are still returned.
+ *
+ * Returns count of supported block stats fields on success, -1 on error.
+ */
+int
+qemuMonitorJSONGetAllBlockStatsCapacity(qemuMonitorPtr mon,
+                                        virHashTablePtr hash,
+                                        bool backingChain,
+                                        bool blockdev,
+                                        bool bestEffort,
+                                        virJSONValuePtr *nodedata)
+{
+    virJSONValuePtr cmds[3] = { NULL, NULL, NULL };
+    virJSONValuePtr replies[3] = { NULL, NULL, NULL };
+    size_t ncmds = nodedata ? 3 : 2;
+    virJSONValuePtr data;
+    int nstats;
+    int ret = -1;
+    int rc;
+    size_t i;
+
+    if (nodedata)
+        *nodedata = NULL;
+
+    if (!(cmds[0] = qemuMonitorJSONMakeCommand("query-blockstats", NULL)))
         goto cleanup;
 
-    ret = 0;
+    if (blockdev)
+        cmds[1] = qemuMonitorJSONMakeCommand("query-named-block-nodes",
+                                             "B:flat", false,
+                                             NULL);
+    else
+        cmds[1] = qemuMonitorJSONMakeCommand("query-block", NULL);
+    if (!cmds[1])
+        goto cleanup;
+
+    if (nodedata &&
+        !(cmds[2] = qemuMonitorJSONMakeCommand("query-named-block-nodes",
+                                               "B:flat", false,
+                                               NULL)))
+        goto cleanup;
+
+    if (qemuMonitorJSONCommandBatch(mon, cmds, ncmds, replies) < 0)
+        goto cleanup;
+
+    if (qemuMonitorJSONCheckReply(cmds[0], replies[0], VIR_JSON_TYPE_ARRAY) < 0)
+        goto cleanup;
+
+    data = virJSONValueObjectGetArray(replies[0], "return");
+    if ((nstats = qemuMonitorJSONParseAllBlockStatsInfo(data, hash,
+                                                        backingChain)) < 0)
+        goto cleanup;
+
+    if ((rc = qemuMonitorJSONCheckReply(cmds[1], replies[1],
+                                        VIR_JSON_TYPE_ARRAY)) == 0) {
+        data = virJSONValueObjectGetArray(replies[1], "return");
+        if (blockdev)
+            rc = virJSONValueArrayForeachSteal(data,
+                                               qemuMonitorJSONBlockStatsUpdateCapacityBlockdevWorker,
+                                               hash);
+        else
+            rc = qemuMonitorJSONBlockStatsUpdateCapacityParse(data, hash,
+                                                              backingChain);
+    }
+
+    if (rc < 0) {
+        if (!bestEffort)
+            goto cleanup;
+
+        VIR_DEBUG("ignoring failure to get block capacity: %s",
+                  virGetLastErrorMessage());
+        virResetLastError();
+    }
+
+    if (nodedata) {
+        if (qemuMonitorJSONCheckReply(cmds[2], replies[2],
+                                      VIR_JSON_TYPE_ARRAY) == 0) {
+            *nodedata = virJSONValueObjectStealArray(replies[2], "return");
+        } else {
+            if (!bestEffort)
+                goto cleanup;
+
+            VIR_DEBUG("ignoring failure to query named block nodes: %s",
+                      virGetLastErrorMessage());
+            virResetLastError();
+        }
+    }
+
+    ret = nstats;
 
  cleanup:
-    virJSONValueFree(nodes);
+    if (ret < 0 && nodedata)
+        g_clear_pointer(nodedata, virJSONValueFree);
+    for (i = 0; i < G_N_ELEMENTS(cmds); i++) {
+        virJSONValueFree(cmds[i]);
+        virJSONValueFree(replies[i]);
+    }
     return ret;
 }
 
@@ -28,14 +28,13 @@
 #include "cpu/cpu.h"
 #include "util/virgic.h"
 
-int qemuMonitorJSONIOProcessLine(qemuMonitorPtr mon,
-                                 const char *line,
-                                 qemuMonitorMessagePtr msg) G_GNUC_NO_INLINE;
+int qemuMonitorJSONIOProcessValue(qemuMonitorPtr mon,
+                                  virJSONValuePtr obj) G_GNUC_NO_INLINE;
 
 int qemuMonitorJSONIOProcess(qemuMonitorPtr mon,
+                             virJSONStreamParserPtr parser,
                              const char *data,
-                             size_t len,
-                             qemuMonitorMessagePtr msg);
+                             size_t len);
 
 int qemuMonitorJSONHumanCommand(qemuMonitorPtr mon,
                                 const char *cmd,
@@ -86,6 +85,12 @@ int qemuMonitorJSONBlockStatsUpdateCapacity(qemuMonitorPtr mon,
                                             bool backingChain);
 int qemuMonitorJSONBlockStatsUpdateCapacityBlockdev(qemuMonitorPtr mon,
                                                     virHashTablePtr stats);
+int qemuMonitorJSONGetAllBlockStatsCapacity(qemuMonitorPtr mon,
+                                            virHashTablePtr hash,
+                                            bool backingChain,
+                                            bool blockdev,
+                                            bool bestEffort,
+                                            virJSONValuePtr *nodedata);
 
 virHashTablePtr
 qemuMonitorJSONBlockGetNamedNodeDataJSON(virJSONValuePtr nodes);
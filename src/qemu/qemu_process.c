@@ -1716,6 +1716,16 @@ qemuProcessHandleMigrationPass(qemuMonitorPtr mon G_GNUC_UNUSED,
         goto cleanup;
     }
 
+    /* keep the iteration up to date for clients asking for job info
+     * between refreshes of migration statistics */
+    if (priv->job.current) {
+        priv->job.current->stats.mig.ram_iteration = pass;
+
+        /* wake up the convergence controller */
+        if (priv->job.current->convergeSet)
+            virDomainObjBroadcast(vm);
+    }
+
     virObjectEventStateQueue(driver->domainEventState,
                          virDomainEventMigrationIterationNewFromObj(vm, pass));
 
@@ -4528,6 +4538,9 @@ qemuProcessIncomingDefFree(qemuProcessIncomingDefPtr inc)
  * the @path pointer valid during the lifetime of the allocated
  * qemuProcessIncomingDef structure.
  *
+ * If @migrateFrom is NULL, QEMU is started with "-incoming defer" and the
+ * caller is responsible for starting the incoming migration itself.
+ *
  * The caller is responsible for closing @fd, calling
  * qemuProcessIncomingDefFree will NOT close it.
  */
@@ -4540,19 +4553,31 @@ qemuProcessIncomingDefNew(virQEMUCapsPtr qemuCaps,
 {
     qemuProcessIncomingDefPtr inc = NULL;
 
-    if (qemuMigrationDstCheckProtocol(qemuCaps, migrateFrom) < 0)
+    if (!migrateFrom) {
+        if (!virQEMUCapsGet(qemuCaps, QEMU_CAPS_INCOMING_DEFER)) {
+            virReportError(VIR_ERR_OPERATION_UNSUPPORTED, "%s",
+                           _("deferred incoming migration is not supported "
+                             "with this QEMU binary"));
+            return NULL;
+        }
+    } else if (qemuMigrationDstCheckProtocol(qemuCaps, migrateFrom) < 0) {
         return NULL;
+    }
 
     if (VIR_ALLOC(inc) < 0)
         return NULL;
 
     inc->address = g_strdup(listenAddress);
 
-    inc->launchURI = qemuMigrationDstGetURI(migrateFrom, fd);
-    if (!inc->launchURI)
-        goto error;
+    if (!migrateFrom) {
+        inc->launchURI = g_strdup("defer");
+    } else {
+        inc->launchURI = qemuMigrationDstGetURI(migrateFrom, fd);
+        if (!inc->launchURI)
+            goto error;
+    }
 
-    if (virQEMUCapsGet(qemuCaps, QEMU_CAPS_INCOMING_DEFER)) {
+    if (migrateFrom && virQEMUCapsGet(qemuCaps, QEMU_CAPS_INCOMING_DEFER)) {
         inc->deferredURI = inc->launchURI;
         inc->launchURI = g_strdup("defer");
     }
@@ -5578,7 +5603,7 @@ qemuProcessInit(virQEMUDriverPtr driver,
             goto cleanup;
         }
     } else {
-        vm->def->id = qemuDriverAllocateID(driver);
+        virDomainObjListSetID(driver->domains, vm, qemuDriverAllocateID(driver));
         qemuDomainSetFakeReboot(driver, vm, false);
         virDomainObjSetState(vm, VIR_DOMAIN_PAUSED, VIR_DOMAIN_PAUSED_STARTING_UP);
 
@@ -7085,21 +7110,24 @@ qemuProcessFinishStartup(virQEMUDriverPtr driver,
 }
 
 
-int
-qemuProcessStart(virConnectPtr conn,
-                 virQEMUDriverPtr driver,
-                 virDomainObjPtr vm,
-                 virCPUDefPtr updatedCPU,
-                 qemuDomainAsyncJob asyncJob,
-                 const char *migrateFrom,
-                 int migrateFd,
-                 const char *migratePath,
-                 virDomainMomentObjPtr snapshot,
-                 virNetDevVPortProfileOp vmop,
-                 unsigned int flags)
+static int
+qemuProcessStartInternal(virConnectPtr conn,
+                         virQEMUDriverPtr driver,
+                         virDomainObjPtr vm,
+                         virCPUDefPtr updatedCPU,
+                         qemuDomainAsyncJob asyncJob,
+                         const char *migrateFrom,
+                         int migrateFd,
+                         const char *migratePath,
+                         virDomainMomentObjPtr snapshot,
+                         virNetDevVPortProfileOp vmop,
+                         unsigned int flags,
+                         qemuProcessIncomingRunCallback runIncoming,
+                         void *opaque)
 {
     qemuDomainObjPrivatePtr priv = vm->privateData;
     qemuProcessIncomingDefPtr incoming = NULL;
+    bool migration = migrateFrom || runIncoming;
     unsigned int stopFlags;
     bool relabel = false;
     bool relabelSavedState = false;
@@ -7108,25 +7136,25 @@ qemuProcessStart(virConnectPtr conn,
 
     VIR_DEBUG("conn=%p driver=%p vm=%p name=%s id=%d asyncJob=%s "
               "migrateFrom=%s migrateFd=%d migratePath=%s "
-              "snapshot=%p vmop=%d flags=0x%x",
+              "snapshot=%p vmop=%d flags=0x%x runIncoming=%p",
               conn, driver, vm, vm->def->name, vm->def->id,
               qemuDomainAsyncJobTypeToString(asyncJob),
               NULLSTR(migrateFrom), migrateFd, NULLSTR(migratePath),
-              snapshot, vmop, flags);
+              snapshot, vmop, flags, runIncoming);
 
     virCheckFlagsGoto(VIR_QEMU_PROCESS_START_COLD |
                       VIR_QEMU_PROCESS_START_PAUSED |
                       VIR_QEMU_PROCESS_START_AUTODESTROY |
                       VIR_QEMU_PROCESS_START_GEN_VMID, cleanup);
 
-    if (!migrateFrom && !snapshot)
+    if (!migration && !snapshot)
         flags |= VIR_QEMU_PROCESS_START_NEW;
 
     if (qemuProcessInit(driver, vm, updatedCPU,
-                        asyncJob, !!migrateFrom, flags) < 0)
+                        asyncJob, migration, flags) < 0)
         goto cleanup;
 
-    if (migrateFrom) {
+    if (migration) {
         incoming = qemuProcessIncomingDefNew(priv->qemuCaps, NULL, migrateFrom,
                                              migrateFd, migratePath);
         if (!incoming)
@@ -7155,9 +7183,14 @@ qemuProcessStart(virConnectPtr conn,
     relabel = true;
 
     if (incoming) {
-        if (incoming->deferredURI &&
-            qemuMigrationDstRun(driver, vm, incoming->deferredURI, asyncJob) < 0)
+        if (runIncoming) {
+            if (runIncoming(driver, vm, asyncJob, opaque) < 0)
+                goto stop;
+        } else if (incoming->deferredURI &&
+                   qemuMigrationDstRun(driver, vm, incoming->deferredURI,
+                                       asyncJob) < 0) {
             goto stop;
+        }
     } else {
         /* Refresh state of devices from QEMU. During migration this happens
          * in qemuMigrationDstFinish to ensure that state information is fully
@@ -7193,7 +7226,7 @@ qemuProcessStart(virConnectPtr conn,
     stopFlags = 0;
     if (!relabel)
         stopFlags |= VIR_QEMU_PROCESS_STOP_NO_RELABEL;
-    if (migrateFrom)
+    if (migration)
         stopFlags |= VIR_QEMU_PROCESS_STOP_MIGRATED;
     if (priv->mon)
         qemuMonitorSetDomainLog(priv->mon, NULL, NULL, NULL);
@@ -7202,6 +7235,55 @@ qemuProcessStart(virConnectPtr conn,
 }
 
 
+int
+qemuProcessStart(virConnectPtr conn,
+                 virQEMUDriverPtr driver,
+                 virDomainObjPtr vm,
+                 virCPUDefPtr updatedCPU,
+                 qemuDomainAsyncJob asyncJob,
+                 const char *migrateFrom,
+                 int migrateFd,
+                 const char *migratePath,
+                 virDomainMomentObjPtr snapshot,
+                 virNetDevVPortProfileOp vmop,
+                 unsigned int flags)
+{
+    return qemuProcessStartInternal(conn, driver, vm, updatedCPU, asyncJob,
+                                    migrateFrom, migrateFd, migratePath,
+                                    snapshot, vmop, flags, NULL, NULL);
+}
+
+
+/**
+ * qemuProcessStartIncoming:
+ * @migratePath: path of the file the migration data is read from
+ * @runIncoming: callback performing the incoming migration
+ * @opaque: data passed to @runIncoming
+ *
+ * Starts a domain just like qemuProcessStart does for an incoming migration
+ * except that QEMU is started with "-incoming defer" and @runIncoming is
+ * called instead of qemuMigrationDstRun once QEMU is launched. The callback
+ * is responsible for starting the migration and waiting for it to finish.
+ * The domain is stopped if the callback fails.
+ */
+int
+qemuProcessStartIncoming(virConnectPtr conn,
+                         virQEMUDriverPtr driver,
+                         virDomainObjPtr vm,
+                         virCPUDefPtr updatedCPU,
+                         qemuDomainAsyncJob asyncJob,
+                         const char *migratePath,
+                         virNetDevVPortProfileOp vmop,
+                         unsigned int flags,
+                         qemuProcessIncomingRunCallback runIncoming,
+                         void *opaque)
+{
+    return qemuProcessStartInternal(conn, driver, vm, updatedCPU, asyncJob,
+                                    NULL, -1, migratePath, NULL,
+                                    vmop, flags, runIncoming, opaque);
+}
+
+
 virCommandPtr
 qemuProcessCreatePretendCmd(virQEMUDriverPtr driver,
                             virDomainObjPtr vm,
@@ -7439,7 +7521,7 @@ void qemuProcessStop(virQEMUDriverPtr driver,
 
     qemuDBusStop(driver, vm);
 
-    vm->def->id = -1;
+    virDomainObjListSetID(driver->domains, vm, -1);
 
     /* Stop autodestroy in case guest is restarted */
     qemuProcessAutoDestroyRemove(driver, vm);
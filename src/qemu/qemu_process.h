@@ -96,6 +96,22 @@ int qemuProcessStart(virConnectPtr conn,
                      virNetDevVPortProfileOp vmop,
                      unsigned int flags);
 
+typedef int (*qemuProcessIncomingRunCallback)(virQEMUDriverPtr driver,
+                                              virDomainObjPtr vm,
+                                              qemuDomainAsyncJob asyncJob,
+                                              void *opaque);
+
+int qemuProcessStartIncoming(virConnectPtr conn,
+                             virQEMUDriverPtr driver,
+                             virDomainObjPtr vm,
+                             virCPUDefPtr updatedCPU,
+                             qemuDomainAsyncJob asyncJob,
+                             const char *migratePath,
+                             virNetDevVPortProfileOp vmop,
+                             unsigned int flags,
+                             qemuProcessIncomingRunCallback runIncoming,
+                             void *opaque);
+
 virCommandPtr qemuProcessCreatePretendCmd(virQEMUDriverPtr driver,
                                           virDomainObjPtr vm,
                                           const char *migrateURI,
@@ -30,9 +30,12 @@
 #include "virlog.h"
 #include "viralloc.h"
 #include "virqemu.h"
+#include "virthread.h"
+#include "rpc/virnetsocket.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
 #include <fcntl.h>
 
 #define VIR_FROM_THIS VIR_FROM_QEMU
@@ -49,6 +52,7 @@ typedef enum {
      */
     QEMU_SAVE_FORMAT_XZ = 3,
     QEMU_SAVE_FORMAT_LZOP = 4,
+    QEMU_SAVE_FORMAT_ZSTD = 5,
     /* Note: add new members only at the end.
        These values are used in the on-disk format.
        Do not change or re-use numbers. */
@@ -64,6 +68,7 @@ VIR_ENUM_IMPL(qemuSaveCompression,
               "bzip2",
               "xz",
               "lzop",
+              "zstd",
 );
 
 static inline void
@@ -74,6 +79,7 @@ qemuSaveImageBswapHeader(virQEMUSaveHeaderPtr hdr)
     hdr->was_running = GUINT32_SWAP_LE_BE(hdr->was_running);
     hdr->compressed = GUINT32_SWAP_LE_BE(hdr->compressed);
     hdr->cookieOffset = GUINT32_SWAP_LE_BE(hdr->cookieOffset);
+    hdr->streams = GUINT32_SWAP_LE_BE(hdr->streams);
 }
 
 
@@ -251,6 +257,429 @@ qemuSaveImageGetCompressionCommand(virQEMUSaveFormat compression)
 }
 
 
+/* Guest memory of images saved with save_image_streams is striped by QEMU's
+ * multifd migration into several streams. The main migration stream follows
+ * the header in the image itself while each multifd channel is stored in a
+ * separate file named after the image with a ".N" suffix. QEMU connects to
+ * (or listens on) a UNIX socket and libvirt copies the data between the
+ * sockets and the files, one thread per stream. */
+
+#define QEMU_SAVE_IMAGE_STREAM_BUF (1024 * 1024)
+
+typedef struct _qemuSaveImageStream qemuSaveImageStream;
+typedef qemuSaveImageStream *qemuSaveImageStreamPtr;
+struct _qemuSaveImageStream {
+    char *path;
+    int fileFD;
+    bool ownFD;         /* @fileFD is closed by qemuSaveImageStreamsFree */
+    bool needUnlink;
+    int sockFD;
+    bool save;          /* copy data from @sockFD to @fileFD */
+    virThread thread;
+    bool running;
+    int err;            /* errno of a failed read or write */
+};
+
+typedef struct _qemuSaveImageStreams qemuSaveImageStreams;
+typedef qemuSaveImageStreams *qemuSaveImageStreamsPtr;
+struct _qemuSaveImageStreams {
+    size_t nstreams;    /* the main stream followed by multifd channels */
+    qemuSaveImageStream *streams;
+
+    /* saving only */
+    virNetSocketPtr listenSock;
+    virThread acceptThread;
+    bool accepting;
+    size_t naccepted;
+};
+
+
+static char *
+qemuSaveImageStreamPath(const char *path,
+                        size_t idx)
+{
+    return g_strdup_printf("%s.%zu", path, idx);
+}
+
+
+/**
+ * qemuSaveImageUnlinkStreams:
+ * @path: path of the save image
+ *
+ * Removes the files holding additional streams of the image at @path.
+ * Every possible stream index is tried as the files may be left behind
+ * by a partially written or removed image with gaps in the numbering.
+ */
+void
+qemuSaveImageUnlinkStreams(const char *path)
+{
+    size_t i;
+
+    for (i = 1; i <= QEMU_SAVE_IMAGE_STREAMS_MAX; i++) {
+        g_autofree char *file = qemuSaveImageStreamPath(path, i);
+
+        if (unlink(file) < 0 && errno != ENOENT) {
+            VIR_WARN("Failed to remove save image stream '%s': %s",
+                     file, g_strerror(errno));
+        }
+    }
+}
+
+
+static void
+qemuSaveImageStreamsFree(qemuSaveImageStreamsPtr streams,
+                         bool unlinkFiles)
+{
+    size_t i;
+
+    if (!streams)
+        return;
+
+    for (i = 0; i < streams->nstreams; i++) {
+        qemuSaveImageStreamPtr stream = &streams->streams[i];
+
+        if (stream->ownFD)
+            VIR_FORCE_CLOSE(stream->fileFD);
+        VIR_FORCE_CLOSE(stream->sockFD);
+        if (unlinkFiles && stream->needUnlink)
+            unlink(stream->path);
+        g_free(stream->path);
+    }
+
+    virObjectUnref(streams->listenSock);
+    g_free(streams->streams);
+    g_free(streams);
+}
+
+
+/**
+ * qemuSaveImageStreamsNew:
+ * @path: path of the save image
+ * @fd: file descriptor of the save image positioned at the main stream
+ * @channels: number of multifd channels
+ * @save: whether the streams are used for saving or restoring
+ * @cfg: driver config
+ *
+ * Opens the files holding the multifd channels of the image at @path. The
+ * main stream is copied from or to @fd which is not closed by
+ * qemuSaveImageStreamsFree.
+ */
+static qemuSaveImageStreamsPtr
+qemuSaveImageStreamsNew(const char *path,
+                        int fd,
+                        unsigned int channels,
+                        bool save,
+                        virQEMUDriverConfigPtr cfg)
+{
+    qemuSaveImageStreamsPtr streams = g_new0(qemuSaveImageStreams, 1);
+    size_t i;
+
+    streams->nstreams = channels + 1;
+    streams->streams = g_new0(qemuSaveImageStream, streams->nstreams);
+
+    for (i = 0; i < streams->nstreams; i++) {
+        streams->streams[i].fileFD = -1;
+        streams->streams[i].sockFD = -1;
+        streams->streams[i].save = save;
+    }
+
+    streams->streams[0].path = g_strdup(path);
+    streams->streams[0].fileFD = fd;
+
+    for (i = 1; i < streams->nstreams; i++) {
+        qemuSaveImageStreamPtr stream = &streams->streams[i];
+
+        stream->path = qemuSaveImageStreamPath(path, i);
+        stream->ownFD = true;
+
+        if (save) {
+            stream->fileFD = virQEMUFileOpenAs(cfg->user, cfg->group, false,
+                                               stream->path,
+                                               O_WRONLY | O_TRUNC | O_CREAT,
+                                               &stream->needUnlink);
+        } else {
+            stream->fileFD = virQEMUFileOpenAs(cfg->user, cfg->group, false,
+                                               stream->path, O_RDONLY, NULL);
+        }
+
+        if (stream->fileFD < 0)
+            goto error;
+    }
+
+    return streams;
+
+ error:
+    qemuSaveImageStreamsFree(streams, true);
+    return NULL;
+}
+
+
+static void
+qemuSaveImageStreamCopy(void *opaque)
+{
+    qemuSaveImageStreamPtr stream = opaque;
+    int in = stream->save ? stream->sockFD : stream->fileFD;
+    int out = stream->save ? stream->fileFD : stream->sockFD;
+    g_autofree char *buf = g_new0(char, QEMU_SAVE_IMAGE_STREAM_BUF);
+    ssize_t got;
+
+    while ((got = saferead(in, buf, QEMU_SAVE_IMAGE_STREAM_BUF)) > 0) {
+        if (safewrite(out, buf, got) != got)
+            break;
+    }
+
+    if (got != 0) {
+        stream->err = errno;
+        /* make sure QEMU notices the failure rather than waiting forever */
+        shutdown(stream->sockFD, SHUT_RDWR);
+    } else if (!stream->save) {
+        shutdown(stream->sockFD, SHUT_WR);
+    }
+}
+
+
+static int
+qemuSaveImageStreamStart(qemuSaveImageStreamPtr stream)
+{
+    if (virThreadCreateFull(&stream->thread, true, qemuSaveImageStreamCopy,
+                            "qemu-save-stream", false, stream) < 0) {
+        stream->err = errno;
+        return -1;
+    }
+
+    stream->running = true;
+    return 0;
+}
+
+
+/* QEMU opens the main migration stream first and only then connects the
+ * multifd channels, which identify themselves in the data they send. */
+static void
+qemuSaveImageStreamsAccept(void *opaque)
+{
+    qemuSaveImageStreamsPtr streams = opaque;
+    int listenFD = virNetSocketGetFD(streams->listenSock);
+
+    while (streams->naccepted < streams->nstreams) {
+        qemuSaveImageStreamPtr stream = &streams->streams[streams->naccepted];
+
+        if ((stream->sockFD = accept(listenFD, NULL, NULL)) < 0) {
+            if (errno == EINTR)
+                continue;
+            /* the listening socket was shut down */
+            return;
+        }
+
+        streams->naccepted++;
+
+        if (qemuSaveImageStreamStart(stream) < 0) {
+            shutdown(stream->sockFD, SHUT_RDWR);
+            return;
+        }
+    }
+}
+
+
+/**
+ * qemuSaveImageStreamsListen:
+ *
+ * Creates a socket QEMU will migrate into and starts accepting connections.
+ */
+static int
+qemuSaveImageStreamsListen(virQEMUDriverPtr driver,
+                           virDomainObjPtr vm,
+                           qemuSaveImageStreamsPtr streams,
+                           const char *sockpath,
+                           virQEMUDriverConfigPtr cfg)
+{
+    int rc;
+
+    if (qemuSecuritySetSocketLabel(driver->securityManager, vm->def) < 0)
+        return -1;
+
+    rc = virNetSocketNewListenUNIX(sockpath, 0077, cfg->user, cfg->group,
+                                   &streams->listenSock);
+
+    if (qemuSecurityClearSocketLabel(driver->securityManager, vm->def) < 0 ||
+        rc < 0)
+        return -1;
+
+    if (virNetSocketListen(streams->listenSock, streams->nstreams) < 0)
+        return -1;
+
+    if (virThreadCreateFull(&streams->acceptThread, true,
+                            qemuSaveImageStreamsAccept,
+                            "qemu-save-accept", false, streams) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to create save image stream thread"));
+        return -1;
+    }
+    streams->accepting = true;
+
+    return 0;
+}
+
+
+/**
+ * qemuSaveImageStreamsConnect:
+ *
+ * Connects to the socket QEMU listens on for incoming migration and starts
+ * feeding it with data from the image.
+ */
+static int
+qemuSaveImageStreamsConnect(virQEMUDriverPtr driver,
+                            virDomainObjPtr vm,
+                            qemuSaveImageStreamsPtr streams,
+                            const char *sockpath)
+{
+    size_t i;
+
+    /* QEMU treats the first connection as the main migration stream. */
+    for (i = 0; i < streams->nstreams; i++) {
+        qemuSaveImageStreamPtr stream = &streams->streams[i];
+        virNetSocketPtr sock = NULL;
+        int rc;
+
+        if (qemuSecuritySetSocketLabel(driver->securityManager, vm->def) < 0)
+            return -1;
+
+        rc = virNetSocketNewConnectUNIX(sockpath, false, NULL, &sock);
+
+        if (qemuSecurityClearSocketLabel(driver->securityManager, vm->def) < 0 ||
+            rc < 0) {
+            virObjectUnref(sock);
+            return -1;
+        }
+
+        stream->sockFD = virNetSocketDupFD(sock, true);
+        virObjectUnref(sock);
+        if (stream->sockFD < 0)
+            return -1;
+
+        if (qemuSaveImageStreamStart(stream) < 0) {
+            virReportSystemError(stream->err, "%s",
+                                 _("Unable to create save image stream thread"));
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * qemuSaveImageStreamsFinish:
+ * @streams: the streams
+ * @cancel: stop copying data rather than waiting for all of it
+ *
+ * Waits for all threads copying data to finish. Unless @cancel is true,
+ * reports an error if any of the streams failed.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+static int
+qemuSaveImageStreamsFinish(qemuSaveImageStreamsPtr streams,
+                           bool cancel)
+{
+    size_t i;
+    int ret = 0;
+
+    if (streams->accepting) {
+        shutdown(virNetSocketGetFD(streams->listenSock), SHUT_RDWR);
+        virThreadJoin(&streams->acceptThread);
+        streams->accepting = false;
+
+        if (!cancel && streams->naccepted != streams->nstreams) {
+            virReportError(VIR_ERR_OPERATION_FAILED,
+                           _("QEMU opened only %zu of %zu save image streams"),
+                           streams->naccepted, streams->nstreams);
+            ret = -1;
+        }
+    }
+
+    for (i = 0; i < streams->nstreams; i++) {
+        qemuSaveImageStreamPtr stream = &streams->streams[i];
+
+        if (stream->running) {
+            if (cancel)
+                shutdown(stream->sockFD, SHUT_RDWR);
+            virThreadJoin(&stream->thread);
+            stream->running = false;
+        }
+
+        if (!cancel && ret == 0 && stream->err != 0) {
+            virReportSystemError(stream->err,
+                                 _("failed to transfer save image stream '%s'"),
+                                 stream->path);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+
+static int
+qemuSaveImageCloseStreams(qemuSaveImageStreamsPtr streams)
+{
+    size_t i;
+
+    for (i = 1; i < streams->nstreams; i++) {
+        qemuSaveImageStreamPtr stream = &streams->streams[i];
+
+        if (VIR_CLOSE(stream->fileFD) < 0) {
+            virReportSystemError(errno, _("unable to close %s"), stream->path);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * qemuSaveImageCreateStreams:
+ *
+ * Migrates the domain into the save image at @path using multifd with
+ * @channels channels. The main migration stream is written to @fd.
+ */
+static int
+qemuSaveImageCreateStreams(virQEMUDriverPtr driver,
+                           virDomainObjPtr vm,
+                           const char *path,
+                           int fd,
+                           unsigned int channels,
+                           qemuDomainAsyncJob asyncJob)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
+    g_autofree char *sockpath = g_strdup_printf("%s/save.sock", priv->libDir);
+    qemuSaveImageStreamsPtr streams = NULL;
+    int ret = -1;
+    int rc;
+
+    if (!(streams = qemuSaveImageStreamsNew(path, fd, channels, true, cfg)))
+        return -1;
+
+    if (qemuSaveImageStreamsListen(driver, vm, streams, sockpath, cfg) < 0)
+        goto cleanup;
+
+    rc = qemuMigrationSrcToSocket(driver, vm, sockpath, channels, asyncJob);
+
+    if (qemuSaveImageStreamsFinish(streams, rc < 0) < 0 || rc < 0)
+        goto cleanup;
+
+    if (qemuSaveImageCloseStreams(streams) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    qemuSaveImageStreamsFree(streams, ret < 0);
+    return ret;
+}
+
+
 /* Helper function to execute a migration to file with a correct save header
  * the caller needs to make sure that the processors are stopped and do all other
  * actions besides saving memory */
@@ -270,6 +699,20 @@ qemuSaveImageCreate(virQEMUDriverPtr driver,
     int directFlag = 0;
     virFileWrapperFdPtr wrapperFd = NULL;
     unsigned int wrapperFlags = VIR_FILE_WRAPPER_NON_BLOCKING;
+    unsigned int channels = 0;
+
+    if (cfg->saveImageStreams > 0) {
+        if (compressor ||
+            (flags & VIR_DOMAIN_SAVE_BYPASS_CACHE) ||
+            !qemuMigrationCapsGet(vm, QEMU_MIGRATION_CAP_MULTIFD)) {
+            VIR_DEBUG("Saving domain %s into a single stream",
+                      vm->def->name);
+        } else {
+            channels = cfg->saveImageStreams;
+            data->header.version = QEMU_SAVE_VERSION_STREAMS;
+            data->header.streams = channels;
+        }
+    }
 
     /* Obtain the file handle.  */
     if ((flags & VIR_DOMAIN_SAVE_BYPASS_CACHE)) {
@@ -291,15 +734,23 @@ qemuSaveImageCreate(virQEMUDriverPtr driver,
     if (qemuSecuritySetImageFDLabel(driver->securityManager, vm->def, fd) < 0)
         goto cleanup;
 
-    if (!(wrapperFd = virFileWrapperFdNew(&fd, path, wrapperFlags)))
+    if (!(wrapperFd = virFileWrapperFdNew(&fd, path, wrapperFlags,
+                                          cfg->ioHelperBufferSize * 1024ULL,
+                                          cfg->ioHelperQueueDepth)))
         goto cleanup;
 
     if (virQEMUSaveDataWrite(data, fd, path) < 0)
         goto cleanup;
 
     /* Perform the migration */
-    if (qemuMigrationSrcToFile(driver, vm, fd, compressor, asyncJob) < 0)
-        goto cleanup;
+    if (channels > 0) {
+        if (qemuSaveImageCreateStreams(driver, vm, path, fd, channels,
+                                       asyncJob) < 0)
+            goto cleanup;
+    } else {
+        if (qemuMigrationSrcToFile(driver, vm, fd, compressor, asyncJob) < 0)
+            goto cleanup;
+    }
 
     /* Touch up file header to mark image complete. */
 
@@ -327,8 +778,12 @@ qemuSaveImageCreate(virQEMUDriverPtr driver,
         ret = -1;
     virFileWrapperFdFree(wrapperFd);
 
-    if (ret < 0 && needUnlink)
-        unlink(path);
+    if (ret < 0) {
+        if (needUnlink)
+            unlink(path);
+        if (channels > 0)
+            qemuSaveImageUnlinkStreams(path);
+    }
 
     return ret;
 }
@@ -337,6 +792,9 @@ qemuSaveImageCreate(virQEMUDriverPtr driver,
 /* qemuSaveImageGetCompressionProgram:
  * @imageFormat: String representation from qemu.conf for the compression
  *               image format being used (dump, save, or snapshot).
+ * @threads: number of compression threads for programs which support
+ *           multithreaded compression. 0 selects one thread per host CPU
+ *           for zstd and keeps xz single-threaded.
  * @compresspath: Pointer to a character string to store the fully qualified
  *                path from virFindFileInPath.
  * @styleFormat: String representing the style of format (dump, save, snapshot)
@@ -355,6 +813,7 @@ qemuSaveImageCreate(virQEMUDriverPtr driver,
  */
 int
 qemuSaveImageGetCompressionProgram(const char *imageFormat,
+                                   unsigned int threads,
                                    virCommandPtr *compressor,
                                    const char *styleFormat,
                                    bool use_raw_on_fail)
@@ -381,6 +840,13 @@ qemuSaveImageGetCompressionProgram(const char *imageFormat,
     if (ret == QEMU_SAVE_FORMAT_XZ)
         virCommandAddArg(*compressor, "-3");
 
+    /* Both xz and zstd split the stream into blocks compressed by a pool
+     * of threads; the output can still be decompressed by a single one.
+     * xz older than 5.2 rejects -T, so it's passed only if requested. */
+    if (ret == QEMU_SAVE_FORMAT_ZSTD ||
+        (ret == QEMU_SAVE_FORMAT_XZ && threads > 0))
+        virCommandAddArgFormat(*compressor, "-T%u", threads);
+
     return ret;
 
  error:
@@ -442,6 +908,7 @@ qemuSaveImageOpen(virQEMUDriverPtr driver,
                   bool open_write,
                   bool unlink_corrupt)
 {
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
     VIR_AUTOCLOSE fd = -1;
     int ret = -1;
     g_autoptr(virQEMUSaveData) data = NULL;
@@ -466,7 +933,9 @@ qemuSaveImageOpen(virQEMUDriverPtr driver,
 
     if (bypass_cache &&
         !(*wrapperFd = virFileWrapperFdNew(&fd, path,
-                                           VIR_FILE_WRAPPER_BYPASS_CACHE)))
+                                           VIR_FILE_WRAPPER_BYPASS_CACHE,
+                                           cfg->ioHelperBufferSize * 1024ULL,
+                                           cfg->ioHelperQueueDepth)))
         return -1;
 
     data = g_new0(virQEMUSaveData, 1);
@@ -480,6 +949,7 @@ qemuSaveImageOpen(virQEMUDriverPtr driver,
                                      path);
                 return -1;
             } else {
+                qemuSaveImageUnlinkStreams(path);
                 return -3;
             }
         }
@@ -498,6 +968,7 @@ qemuSaveImageOpen(virQEMUDriverPtr driver,
                                          path);
                     return -1;
                 } else {
+                    qemuSaveImageUnlinkStreams(path);
                     return -3;
                 }
             }
@@ -512,15 +983,26 @@ qemuSaveImageOpen(virQEMUDriverPtr driver,
         return -1;
     }
 
-    if (header->version > QEMU_SAVE_VERSION) {
+    if (header->version > QEMU_SAVE_VERSION_STREAMS) {
         /* convert endianness and try again */
         qemuSaveImageBswapHeader(header);
     }
 
-    if (header->version > QEMU_SAVE_VERSION) {
+    if (header->version > QEMU_SAVE_VERSION_STREAMS) {
         virReportError(VIR_ERR_OPERATION_FAILED,
                        _("image version is not supported (%d > %d)"),
-                       header->version, QEMU_SAVE_VERSION);
+                       header->version, QEMU_SAVE_VERSION_STREAMS);
+        return -1;
+    }
+
+    if (header->version < QEMU_SAVE_VERSION_STREAMS)
+        header->streams = 0;
+
+    if (header->streams > QEMU_SAVE_IMAGE_STREAMS_MAX ||
+        (header->streams > 0 && header->compressed != QEMU_SAVE_FORMAT_RAW)) {
+        virReportError(VIR_ERR_OPERATION_FAILED,
+                       _("invalid number of image streams: %u"),
+                       header->streams);
         return -1;
     }
 
@@ -570,6 +1052,90 @@ qemuSaveImageOpen(virQEMUDriverPtr driver,
     return ret;
 }
 
+typedef struct _qemuSaveImageIncoming qemuSaveImageIncoming;
+struct _qemuSaveImageIncoming {
+    const char *path;
+    int fd;
+    unsigned int channels;
+};
+
+
+/**
+ * qemuSaveImageRunIncoming:
+ *
+ * Feeds the freshly launched QEMU with the data read from the main stream
+ * and the stream files of the image. Called by qemuProcessStartIncoming
+ * which takes care of stopping QEMU if this fails.
+ */
+static int
+qemuSaveImageRunIncoming(virQEMUDriverPtr driver,
+                         virDomainObjPtr vm,
+                         qemuDomainAsyncJob asyncJob,
+                         void *opaque)
+{
+    qemuSaveImageIncoming *data = opaque;
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
+    g_autoptr(qemuMigrationParams) migParams = NULL;
+    g_autofree char *sockpath = g_strdup_printf("%s/restore.sock", priv->libDir);
+    g_autofree char *uri = g_strdup_printf("unix:%s", sockpath);
+    qemuSaveImageStreamsPtr streams = NULL;
+    virErrorPtr orig_err = NULL;
+    int ret = -1;
+
+    if (!virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_MIGRATION_EVENT) ||
+        !qemuMigrationCapsGet(vm, QEMU_MIGRATION_CAP_MULTIFD)) {
+        virReportError(VIR_ERR_OPERATION_UNSUPPORTED, "%s",
+                       _("restoring save images with multiple streams is "
+                         "not supported by this QEMU binary"));
+        return -1;
+    }
+
+    if (!(migParams = qemuMigrationParamsNewMultifd(data->channels)))
+        return -1;
+
+    if (qemuMigrationParamsApply(driver, vm, asyncJob, migParams) < 0)
+        goto cleanup;
+
+    if (qemuMigrationDstStartIncoming(driver, vm, uri, asyncJob) < 0)
+        goto cleanup;
+
+    if (!(streams = qemuSaveImageStreamsNew(data->path, data->fd,
+                                            data->channels, false, cfg)))
+        goto cleanup;
+
+    if (qemuSaveImageStreamsConnect(driver, vm, streams, sockpath) < 0 ||
+        qemuMigrationDstWaitForCompletion(driver, vm, asyncJob, false) < 0) {
+        ignore_value(qemuSaveImageStreamsFinish(streams, true));
+        goto cleanup;
+    }
+
+    if (qemuSaveImageStreamsFinish(streams, false) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    qemuSaveImageStreamsFree(streams, false);
+
+    if (ret < 0)
+        virErrorPreserveLast(&orig_err);
+
+    /* Turn multifd off again so that it does not leak into a later
+     * migration or save of the restored domain */
+    if (virDomainObjIsActive(vm)) {
+        g_autoptr(qemuMigrationParams) resetParams = qemuMigrationParamsNew();
+
+        if (resetParams)
+            ignore_value(qemuMigrationParamsApply(driver, vm, asyncJob,
+                                                  resetParams));
+    }
+
+    virErrorRestore(&orig_err);
+    return ret;
+}
+
+
 int
 qemuSaveImageStartVM(virConnectPtr conn,
                      virQEMUDriverPtr driver,
@@ -596,7 +1162,7 @@ qemuSaveImageStartVM(virConnectPtr conn,
                                  virDomainXMLOptionGetSaveCookie(driver->xmlopt)) < 0)
         goto cleanup;
 
-    if ((header->version == 2) &&
+    if ((header->version >= 2) &&
         (header->compressed != QEMU_SAVE_FORMAT_RAW)) {
         if (!(cmd = qemuSaveImageGetCompressionCommand(header->compressed)))
             goto cleanup;
@@ -626,12 +1192,26 @@ qemuSaveImageStartVM(virConnectPtr conn,
     if (cookie && !cookie->slirpHelper)
         priv->disableSlirp = true;
 
-    if (qemuProcessStart(conn, driver, vm, cookie ? cookie->cpu : NULL,
-                         asyncJob, "stdio", *fd, path, NULL,
-                         VIR_NETDEV_VPORT_PROFILE_OP_RESTORE,
-                         VIR_QEMU_PROCESS_START_PAUSED |
-                         VIR_QEMU_PROCESS_START_GEN_VMID) == 0)
+    if (header->streams > 0) {
+        qemuSaveImageIncoming incoming = { .path = path, .fd = *fd,
+                                           .channels = header->streams };
+
+        if (qemuProcessStartIncoming(conn, driver, vm,
+                                     cookie ? cookie->cpu : NULL,
+                                     asyncJob, path,
+                                     VIR_NETDEV_VPORT_PROFILE_OP_RESTORE,
+                                     VIR_QEMU_PROCESS_START_PAUSED |
+                                     VIR_QEMU_PROCESS_START_GEN_VMID,
+                                     qemuSaveImageRunIncoming,
+                                     &incoming) == 0)
+            started = true;
+    } else if (qemuProcessStart(conn, driver, vm, cookie ? cookie->cpu : NULL,
+                                asyncJob, "stdio", *fd, path, NULL,
+                                VIR_NETDEV_VPORT_PROFILE_OP_RESTORE,
+                                VIR_QEMU_PROCESS_START_PAUSED |
+                                VIR_QEMU_PROCESS_START_GEN_VMID) == 0) {
         started = true;
+    }
 
     if (intermediatefd != -1) {
         virErrorPtr orig_err = NULL;
@@ -31,6 +31,8 @@
 #define QEMU_SAVE_MAGIC   "LibvirtQemudSave"
 #define QEMU_SAVE_PARTIAL "LibvirtQemudPart"
 #define QEMU_SAVE_VERSION 2
+/* guest memory is split into several streams, see save_image_streams */
+#define QEMU_SAVE_VERSION_STREAMS 3
 
 G_STATIC_ASSERT(sizeof(QEMU_SAVE_MAGIC) == sizeof(QEMU_SAVE_PARTIAL));
 
@@ -43,7 +45,8 @@ struct _virQEMUSaveHeader {
     uint32_t was_running;
     uint32_t compressed;
     uint32_t cookieOffset;
-    uint32_t unused[14];
+    uint32_t streams; /* number of additional stream files, version 3 only */
+    uint32_t unused[13];
 };
 
 
@@ -86,10 +89,11 @@ qemuSaveImageOpen(virQEMUDriverPtr driver,
 
 int
 qemuSaveImageGetCompressionProgram(const char *imageFormat,
+                                   unsigned int threads,
                                    virCommandPtr *compressor,
                                    const char *styleFormat,
                                    bool use_raw_on_fail)
-    ATTRIBUTE_NONNULL(2);
+    ATTRIBUTE_NONNULL(3);
 
 int
 qemuSaveImageCreate(virQEMUDriverPtr driver,
@@ -100,6 +104,9 @@ qemuSaveImageCreate(virQEMUDriverPtr driver,
                     unsigned int flags,
                     qemuDomainAsyncJob asyncJob);
 
+void
+qemuSaveImageUnlinkStreams(const char *path);
+
 int
 virQEMUSaveDataWrite(virQEMUSaveDataPtr data,
                      int fd,
@@ -1317,6 +1317,7 @@ qemuSnapshotCreateActiveExternal(virQEMUDriverPtr driver,
                                           JOB_MASK(QEMU_JOB_MIGRATION_OP)));
 
         if ((compressed = qemuSaveImageGetCompressionProgram(cfg->snapshotImageFormat,
+                                                             cfg->imageCompressionThreads,
                                                              &compressor,
                                                              "snapshot", false)) < 0)
             goto cleanup;
@@ -1405,8 +1406,10 @@ qemuSnapshotCreateActiveExternal(virQEMUDriverPtr driver,
     }
 
     virQEMUSaveDataFree(data);
-    if (memory_unlink && ret < 0)
+    if (memory_unlink && ret < 0) {
         unlink(snapdef->file);
+        qemuSaveImageUnlinkStreams(snapdef->file);
+    }
 
     return ret;
 }
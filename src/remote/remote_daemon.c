@@ -374,6 +374,12 @@ daemonSetupNetworking(virNetServerPtr srv,
                 return -1;
         }
 
+        if (virNetTLSContextSetTicketKeyRotation(ctxt,
+                                                 config->tls_ticket_key_rotation) < 0) {
+            virObjectUnref(ctxt);
+            return -1;
+        }
+
         VIR_DEBUG("Registering TLS socket %s:%s",
                   config->listen_addr, config->tls_port);
         if (virNetServerAddServiceTCP(srv,
@@ -1023,6 +1029,14 @@ int main(int argc, char **argv) {
         goto cleanup;
     }
 
+    if (virNetServerSetClientJobLimits(srv,
+                                       config->max_client_workers,
+                                       config->max_identity_workers,
+                                       config->client_rw_weight) < 0) {
+        ret = VIR_DAEMON_ERR_CONFIG;
+        goto cleanup;
+    }
+
     if (virNetDaemonAddServer(dmn, srv) < 0) {
         ret = VIR_DAEMON_ERR_INIT;
         goto cleanup;
@@ -1040,6 +1054,7 @@ int main(int argc, char **argv) {
     remoteProcs[REMOTE_PROC_AUTH_POLKIT].needAuth = false;
     if (!(remoteProgram = virNetServerProgramNew(REMOTE_PROGRAM,
                                                  REMOTE_PROTOCOL_VERSION,
+                                                 "remote",
                                                  remoteProcs,
                                                  remoteNProcs))) {
         ret = VIR_DAEMON_ERR_INIT;
@@ -1052,6 +1067,7 @@ int main(int argc, char **argv) {
 
     if (!(lxcProgram = virNetServerProgramNew(LXC_PROGRAM,
                                               LXC_PROTOCOL_VERSION,
+                                              "lxc",
                                               lxcProcs,
                                               lxcNProcs))) {
         ret = VIR_DAEMON_ERR_INIT;
@@ -1064,6 +1080,7 @@ int main(int argc, char **argv) {
 
     if (!(qemuProgram = virNetServerProgramNew(QEMU_PROGRAM,
                                                QEMU_PROTOCOL_VERSION,
+                                               "qemu",
                                                qemuProcs,
                                                qemuNProcs))) {
         ret = VIR_DAEMON_ERR_INIT;
@@ -1097,6 +1114,7 @@ int main(int argc, char **argv) {
 
     if (!(adminProgram = virNetServerProgramNew(ADMIN_PROGRAM,
                                                 ADMIN_PROTOCOL_VERSION,
+                                                "admin",
                                                 adminProcs,
                                                 adminNProcs))) {
         ret = VIR_DAEMON_ERR_INIT;
@@ -28,6 +28,7 @@
 #include "remote_protocol.h"
 #include "lxc_protocol.h"
 #include "qemu_protocol.h"
+#include "remote_event_batch.h"
 #include "virthread.h"
 
 #if WITH_SASL
@@ -90,6 +91,15 @@ struct daemonClientPrivate {
     const char *storageURI;
     bool readonly;
 
+    /* Client accepts stream packets bigger than
+     * VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX */
+    bool streamLargePackets;
+
+    /* Client accepts REMOTE_PROC_EVENT_BATCH messages */
+    bool eventBatching;
+    remoteEventBatch eventBatch;
+    int eventBatchTimer;
+
     daemonClientStreamPtr streams;
 };
 
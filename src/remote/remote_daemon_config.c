@@ -133,6 +133,8 @@ daemonConfigNew(bool privileged G_GNUC_UNUSED)
     data->auth_tcp = REMOTE_AUTH_NONE;
 # endif
     data->auth_tls = REMOTE_AUTH_NONE;
+
+    data->tls_ticket_key_rotation = 3600;
 #endif /* ! WITH_IP */
 
     data->min_workers = 5;
@@ -144,6 +146,9 @@ daemonConfigNew(bool privileged G_GNUC_UNUSED)
     data->prio_workers = 5;
 
     data->max_client_requests = 5;
+    data->max_client_workers = 0;
+    data->max_identity_workers = 0;
+    data->client_rw_weight = 1;
 
     data->audit_level = 1;
     data->audit_logging = false;
@@ -299,6 +304,9 @@ daemonConfigLoadOptions(struct daemonConfig *data,
 
     if (virConfGetValueString(conf, "tls_priority", &data->tls_priority) < 0)
         return -1;
+    if (virConfGetValueUInt(conf, "tls_ticket_key_rotation",
+                            &data->tls_ticket_key_rotation) < 0)
+        return -1;
 #endif /* ! WITH_IP */
 
     if (virConfGetValueStringList(conf, "sasl_allowed_username_list", false,
@@ -326,6 +334,12 @@ daemonConfigLoadOptions(struct daemonConfig *data,
 
     if (virConfGetValueUInt(conf, "max_client_requests", &data->max_client_requests) < 0)
         return -1;
+    if (virConfGetValueUInt(conf, "max_client_workers", &data->max_client_workers) < 0)
+        return -1;
+    if (virConfGetValueUInt(conf, "max_identity_workers", &data->max_identity_workers) < 0)
+        return -1;
+    if (virConfGetValueUInt(conf, "client_rw_weight", &data->client_rw_weight) < 0)
+        return -1;
 
     if (virConfGetValueUInt(conf, "admin_min_workers", &data->admin_min_workers) < 0)
         return -1;
@@ -56,6 +56,7 @@ struct daemonConfig {
     bool tls_no_sanity_certificate;
     char **tls_allowed_dn_list;
     char *tls_priority;
+    unsigned int tls_ticket_key_rotation;
 
     char *key_file;
     char *cert_file;
@@ -74,6 +75,9 @@ struct daemonConfig {
     unsigned int prio_workers;
 
     unsigned int max_client_requests;
+    unsigned int max_client_workers;
+    unsigned int max_identity_workers;
+    unsigned int client_rw_weight;
 
     unsigned int log_level;
     char *log_filters;
@@ -1721,6 +1721,74 @@ void remoteClientFree(void *data)
 }
 
 
+/*
+ * Sends all events queued in @priv->eventBatch to @client. Must be called
+ * with @priv->lock held.
+ */
+static void
+remoteEventBatchFlushLocked(virNetServerClientPtr client,
+                            struct daemonClientPrivate *priv)
+{
+    virNetMessagePtr msg;
+
+    if (priv->eventBatch.nevents == 0)
+        return;
+
+    virEventUpdateTimeout(priv->eventBatchTimer, -1);
+
+    if (!(msg = remoteEventBatchEncode(&priv->eventBatch)))
+        return;
+
+    if (virNetServerClientSendMessage(client, msg) < 0)
+        virNetMessageFree(msg);
+}
+
+
+static void
+remoteEventBatchTimer(int timer G_GNUC_UNUSED,
+                      void *opaque)
+{
+    virNetServerClientPtr client = opaque;
+    struct daemonClientPrivate *priv = virNetServerClientGetPrivateData(client);
+
+    virMutexLock(&priv->lock);
+    remoteEventBatchFlushLocked(client, priv);
+    virMutexUnlock(&priv->lock);
+}
+
+
+/*
+ * Queues an event encoded in @data to be sent to @client together with
+ * other events dispatched in the same event loop iteration. Must be called
+ * with @priv->lock held.
+ *
+ * Returns 0 on success, -1 if the event has to be sent on its own.
+ */
+static int
+remoteEventBatchAppendLocked(virNetServerClientPtr client,
+                             struct daemonClientPrivate *priv,
+                             int procnr,
+                             const char *data,
+                             size_t len)
+{
+    int full;
+
+    if ((full = remoteEventBatchAppend(&priv->eventBatch, procnr,
+                                       data, len)) < 0)
+        return -1;
+
+    /* All events of a single flush of an object event state are queued
+     * from one event loop callback, the timer fires once it's done. */
+    if (priv->eventBatch.nevents == 1)
+        virEventUpdateTimeout(priv->eventBatchTimer, 0);
+
+    if (full)
+        remoteEventBatchFlushLocked(client, priv);
+
+    return 0;
+}
+
+
 static void remoteClientCloseFunc(virNetServerClientPtr client)
 {
     struct daemonClientPrivate *priv = virNetServerClientGetPrivateData(client);
@@ -1728,6 +1796,14 @@ static void remoteClientCloseFunc(virNetServerClientPtr client)
     daemonRemoveAllClientStreams(priv->streams);
 
     remoteClientFreePrivateCallbacks(priv);
+
+    virMutexLock(&priv->lock);
+    if (priv->eventBatching) {
+        virEventRemoveTimeout(priv->eventBatchTimer);
+        priv->eventBatching = false;
+    }
+    remoteEventBatchClear(&priv->eventBatch);
+    virMutexUnlock(&priv->lock);
 }
 
 
@@ -4343,7 +4419,9 @@ remoteDispatchObjectEventSend(virNetServerClientPtr client,
                               xdrproc_t proc,
                               void *data)
 {
+    struct daemonClientPrivate *priv = virNetServerClientGetPrivateData(client);
     virNetMessagePtr msg;
+    size_t headerLen;
 
     if (!(msg = virNetMessageNew(false)))
         goto cleanup;
@@ -4357,13 +4435,31 @@ remoteDispatchObjectEventSend(virNetServerClientPtr client,
 
     if (virNetMessageEncodeHeader(msg) < 0)
         goto cleanup;
+    headerLen = msg->bufferOffset;
 
     if (virNetMessageEncodePayload(msg, proc, data) < 0)
         goto cleanup;
 
     VIR_DEBUG("Queue event %d %zu", procnr, msg->bufferLength);
-    if (virNetServerClientSendMessage(client, msg) < 0)
+
+    virMutexLock(&priv->lock);
+    if (priv->eventBatching &&
+        msg->header.prog == REMOTE_PROGRAM &&
+        msg->bufferLength - headerLen < VIR_NET_MESSAGE_INITIAL &&
+        remoteEventBatchAppendLocked(client, priv, procnr,
+                                     msg->buffer + headerLen,
+                                     msg->bufferLength - headerLen) == 0) {
+        virMutexUnlock(&priv->lock);
         goto cleanup;
+    }
+
+    /* Keep the order of events sent outside of a batch */
+    remoteEventBatchFlushLocked(client, priv);
+    if (virNetServerClientSendMessage(client, msg) < 0) {
+        virMutexUnlock(&priv->lock);
+        goto cleanup;
+    }
+    virMutexUnlock(&priv->lock);
 
     xdr_free(proc, data);
     return;
@@ -4519,12 +4615,12 @@ remoteDispatchConnectDomainEventRegisterAny(virNetServerPtr server G_GNUC_UNUSED
 
 
 static int
-remoteDispatchConnectDomainEventCallbackRegisterAny(virNetServerPtr server G_GNUC_UNUSED,
-                                                    virNetServerClientPtr client,
-                                                    virNetMessagePtr msg G_GNUC_UNUSED,
-                                                    virNetMessageErrorPtr rerr G_GNUC_UNUSED,
-                                                    remote_connect_domain_event_callback_register_any_args *args,
-                                                    remote_connect_domain_event_callback_register_any_ret *ret)
+remoteConnectDomainEventCallbackRegister(virNetServerClientPtr client,
+                                         virNetMessageErrorPtr rerr,
+                                         int eventID,
+                                         remote_domain domain,
+                                         unsigned int flags,
+                                         int *retCallbackID)
 {
     int callbackID;
     int rv = -1;
@@ -4540,13 +4636,13 @@ remoteDispatchConnectDomainEventCallbackRegisterAny(virNetServerPtr server G_GNU
     if (!conn)
         goto cleanup;
 
-    if (args->dom &&
-        !(dom = get_nonnull_domain(conn, *args->dom)))
+    if (domain &&
+        !(dom = get_nonnull_domain(conn, *domain)))
         goto cleanup;
 
-    if (args->eventID >= VIR_DOMAIN_EVENT_ID_LAST || args->eventID < 0) {
+    if (eventID >= VIR_DOMAIN_EVENT_ID_LAST || eventID < 0) {
         virReportError(VIR_ERR_INTERNAL_ERROR, _("unsupported event ID %d"),
-                       args->eventID);
+                       eventID);
         goto cleanup;
     }
 
@@ -4560,7 +4656,7 @@ remoteDispatchConnectDomainEventCallbackRegisterAny(virNetServerPtr server G_GNU
         goto cleanup;
     callback->client = virObjectRef(client);
     callback->program = virObjectRef(remoteProgram);
-    callback->eventID = args->eventID;
+    callback->eventID = eventID;
     callback->callbackID = -1;
     ref = callback;
     if (VIR_APPEND_ELEMENT(priv->domainEventCallbacks,
@@ -4568,12 +4664,24 @@ remoteDispatchConnectDomainEventCallbackRegisterAny(virNetServerPtr server G_GNU
                            callback) < 0)
         goto cleanup;
 
-    if ((callbackID = virConnectDomainEventRegisterAny(conn,
-                                                       dom,
-                                                       args->eventID,
-                                                       domainEventCallbacks[args->eventID],
-                                                       ref,
-                                                       remoteEventCallbackFree)) < 0) {
+    /* Drivers which don't know about registration flags are still
+     * usable without them */
+    if (flags)
+        callbackID = virConnectDomainEventRegisterAnyFlags(conn,
+                                                           dom,
+                                                           eventID,
+                                                           domainEventCallbacks[eventID],
+                                                           ref,
+                                                           remoteEventCallbackFree,
+                                                           flags);
+    else
+        callbackID = virConnectDomainEventRegisterAny(conn,
+                                                      dom,
+                                                      eventID,
+                                                      domainEventCallbacks[eventID],
+                                                      ref,
+                                                      remoteEventCallbackFree);
+    if (callbackID < 0) {
         VIR_SHRINK_N(priv->domainEventCallbacks,
                      priv->ndomainEventCallbacks, 1);
         callback = ref;
@@ -4581,7 +4689,7 @@ remoteDispatchConnectDomainEventCallbackRegisterAny(virNetServerPtr server G_GNU
     }
 
     ref->callbackID = callbackID;
-    ret->callbackID = callbackID;
+    *retCallbackID = callbackID;
 
     rv = 0;
 
@@ -4595,6 +4703,35 @@ remoteDispatchConnectDomainEventCallbackRegisterAny(virNetServerPtr server G_GNU
 }
 
 
+static int
+remoteDispatchConnectDomainEventCallbackRegisterAny(virNetServerPtr server G_GNUC_UNUSED,
+                                                    virNetServerClientPtr client,
+                                                    virNetMessagePtr msg G_GNUC_UNUSED,
+                                                    virNetMessageErrorPtr rerr G_GNUC_UNUSED,
+                                                    remote_connect_domain_event_callback_register_any_args *args,
+                                                    remote_connect_domain_event_callback_register_any_ret *ret)
+{
+    return remoteConnectDomainEventCallbackRegister(client, rerr,
+                                                    args->eventID, args->dom,
+                                                    0, &ret->callbackID);
+}
+
+
+static int
+remoteDispatchConnectDomainEventRegisterAnyFlags(virNetServerPtr server G_GNUC_UNUSED,
+                                                 virNetServerClientPtr client,
+                                                 virNetMessagePtr msg G_GNUC_UNUSED,
+                                                 virNetMessageErrorPtr rerr G_GNUC_UNUSED,
+                                                 remote_connect_domain_event_register_any_flags_args *args,
+                                                 remote_connect_domain_event_register_any_flags_ret *ret)
+{
+    return remoteConnectDomainEventCallbackRegister(client, rerr,
+                                                    args->eventID, args->dom,
+                                                    args->flags,
+                                                    &ret->callbackID);
+}
+
+
 static int
 remoteDispatchConnectDomainEventDeregisterAny(virNetServerPtr server G_GNUC_UNUSED,
                                               virNetServerClientPtr client,
@@ -4997,6 +5134,34 @@ static int remoteDispatchConnectSupportsFeature(virNetServerPtr server G_GNUC_UN
     case VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK:
         supported = 1;
         break;
+    case VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PACKETS: {
+        daemonClientPrivatePtr priv = virNetServerClientGetPrivateData(client);
+
+        /* Clients only ask if they can handle large packets themselves */
+        virMutexLock(&priv->lock);
+        priv->streamLargePackets = true;
+        virMutexUnlock(&priv->lock);
+        supported = 1;
+        break;
+    }
+    case VIR_DRV_FEATURE_REMOTE_EVENT_BATCH: {
+        daemonClientPrivatePtr priv = virNetServerClientGetPrivateData(client);
+
+        /* Clients only ask if they can unpack batched events themselves */
+        virMutexLock(&priv->lock);
+        if (!priv->eventBatching) {
+            priv->eventBatchTimer = virEventAddTimeout(-1, remoteEventBatchTimer,
+                                                       virObjectRef(client),
+                                                       virObjectFreeCallback);
+            if (priv->eventBatchTimer < 0)
+                virObjectUnref(client);
+            else
+                priv->eventBatching = true;
+        }
+        supported = priv->eventBatching;
+        virMutexUnlock(&priv->lock);
+        break;
+    }
     case VIR_DRV_FEATURE_MIGRATION_V1:
     case VIR_DRV_FEATURE_REMOTE:
     case VIR_DRV_FEATURE_MIGRATION_V2:
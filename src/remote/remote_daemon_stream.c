@@ -50,6 +50,9 @@ struct daemonClientStream {
 
     virNetMessagePtr rx;
     bool tx;
+    size_t txPackets;   /* Packets queued for transmission */
+    size_t txWindow;    /* Maximum of @txPackets */
+    size_t packetSize;  /* Maximum payload of data packets */
 
     bool allowSkip;
     size_t dataLen; /* How much data is there remaining until we see a hole */
@@ -82,7 +85,8 @@ daemonStreamUpdateEvents(daemonClientStream *stream)
         return;
     if (stream->rx)
         newEvents |= VIR_STREAM_EVENT_WRITABLE;
-    if (stream->tx && !stream->recvEOF)
+    if (stream->tx && !stream->recvEOF &&
+        stream->txPackets < stream->txWindow)
         newEvents |= VIR_STREAM_EVENT_READABLE;
 
     virStreamEventUpdateCallback(stream->st, newEvents);
@@ -93,17 +97,19 @@ daemonStreamUpdateEvents(daemonClientStream *stream)
  * This simply re-enables TX of further data.
  *
  * The idea is to stop the daemon growing without bound due to
- * fast stream, but slow client
+ * fast stream, but slow client. Only @txWindow packets are
+ * queued at any time.
  */
 static void
 daemonStreamMessageFinished(virNetMessagePtr msg,
                             void *opaque)
 {
     daemonClientStream *stream = opaque;
-    VIR_DEBUG("stream=%p proc=%d serial=%u",
-              stream, msg->header.proc, msg->header.serial);
+    VIR_DEBUG("stream=%p proc=%d serial=%u txPackets=%zu",
+              stream, msg->header.proc, msg->header.serial,
+              stream->txPackets);
 
-    stream->tx = true;
+    stream->txPackets--;
     daemonStreamUpdateEvents(stream);
 
     daemonFreeClientStream(NULL, stream);
@@ -201,7 +207,6 @@ daemonStreamEvent(virStreamPtr st, int events, void *opaque)
         (events & VIR_STREAM_EVENT_HANGUP)) {
         virNetMessagePtr msg;
         events &= ~(VIR_STREAM_EVENT_HANGUP);
-        stream->tx = false;
         stream->recvEOF = true;
         if (!(msg = virNetMessageNew(false))) {
             daemonRemoveClientStream(client, stream);
@@ -211,6 +216,7 @@ daemonStreamEvent(virStreamPtr st, int events, void *opaque)
         msg->cb = daemonStreamMessageFinished;
         msg->opaque = stream;
         stream->refs++;
+        stream->txPackets++;
         if (virNetServerProgramSendStreamData(stream->prog,
                                               client,
                                               msg,
@@ -358,6 +364,7 @@ daemonCreateClientStream(virNetServerClientPtr client,
 {
     daemonClientStream *stream;
     daemonClientPrivatePtr priv = virNetServerClientGetPrivateData(client);
+    bool largePackets;
 
     VIR_DEBUG("client=%p, proc=%d, serial=%u, st=%p",
               client, header->proc, header->serial, st);
@@ -365,6 +372,10 @@ daemonCreateClientStream(virNetServerClientPtr client,
     if (VIR_ALLOC(stream) < 0)
         return NULL;
 
+    virMutexLock(&priv->lock);
+    largePackets = priv->streamLargePackets;
+    virMutexUnlock(&priv->lock);
+
     stream->refs = 1;
     stream->priv = priv;
     stream->prog = virObjectRef(prog);
@@ -374,6 +385,9 @@ daemonCreateClientStream(virNetServerClientPtr client,
     stream->st = st;
     stream->allowSkip = allowSkip;
 
+    virNetMessageGetStreamLimits(largePackets,
+                                 &stream->packetSize, &stream->txWindow);
+
     return stream;
 }
 
@@ -830,7 +844,7 @@ daemonStreamHandleRead(virNetServerClientPtr client,
     virNetMessagePtr msg = NULL;
     virNetMessageError rerr;
     char *buffer;
-    size_t bufferLen = VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
+    size_t bufferLen = stream->packetSize;
     int ret = -1;
     int rv;
     int inData = 0;
@@ -848,7 +862,7 @@ daemonStreamHandleRead(virNetServerClientPtr client,
 
     /* Shouldn't ever be called unless we're marked able to
      * transmit, but doesn't hurt to check */
-    if (!stream->tx)
+    if (!stream->tx || stream->txPackets >= stream->txWindow)
         return 0;
 
     memset(&rerr, 0, sizeof(rerr));
@@ -881,10 +895,10 @@ daemonStreamHandleRead(virNetServerClientPtr client,
             goto done;
         } else {
             if (!inData && length) {
-                stream->tx = false;
                 msg->cb = daemonStreamMessageFinished;
                 msg->opaque = stream;
                 stream->refs++;
+                stream->txPackets++;
                 if (virNetServerProgramSendStreamHole(stream->prog,
                                                       client,
                                                       msg,
@@ -928,13 +942,13 @@ daemonStreamHandleRead(virNetServerClientPtr client,
         if (stream->allowSkip)
             stream->dataLen -= rv;
 
-        stream->tx = false;
         if (rv == 0)
             stream->recvEOF = true;
 
         msg->cb = daemonStreamMessageFinished;
         msg->opaque = stream;
         stream->refs++;
+        stream->txPackets++;
         if (virNetServerProgramSendStreamData(stream->prog,
                                               client,
                                               msg,
@@ -38,6 +38,7 @@
 #include "virbuffer.h"
 #include "remote_driver.h"
 #include "remote_protocol.h"
+#include "remote_event_batch.h"
 #include "lxc_protocol.h"
 #include "qemu_protocol.h"
 #include "viralloc.h"
@@ -54,6 +55,10 @@
 
 VIR_LOG_INIT("remote.remote_driver");
 
+/* Maximum number of events waiting for the dispatch thread; events
+ * arriving while the callbacks are this much behind are dropped */
+#define REMOTE_EVENT_QUEUE_MAX 10000
+
 typedef enum {
     REMOTE_DRIVER_TRANSPORT_TLS,
     REMOTE_DRIVER_TRANSPORT_UNIX,
@@ -134,6 +139,7 @@ struct private_data {
     bool serverKeepAlive;       /* Does server support keepalive protocol? */
     bool serverEventFilter;     /* Does server support modern event filtering */
     bool serverCloseCallback;   /* Does server support driver close callback */
+    bool serverStreamLargePackets; /* Does server accept large stream packets */
 
     virObjectEventStatePtr eventState;
     virConnectCloseCallbackDataPtr closeCallback;
@@ -473,6 +479,11 @@ remoteConnectNotifyEventConnectionClosed(virNetClientProgramPtr prog G_GNUC_UNUS
                                          virNetClientPtr client G_GNUC_UNUSED,
                                          void *evdata, void *opaque);
 
+static void
+remoteConnectNotifyEventBatch(virNetClientProgramPtr prog,
+                              virNetClientPtr client,
+                              void *evdata, void *opaque);
+
 static virNetClientProgramEvent remoteEvents[] = {
     { REMOTE_PROC_DOMAIN_EVENT_LIFECYCLE,
       remoteDomainBuildEventLifecycle,
@@ -679,8 +690,22 @@ static virNetClientProgramEvent remoteEvents[] = {
       remoteDomainBuildEventBlockThreshold,
       sizeof(remote_domain_event_block_threshold_msg),
       (xdrproc_t)xdr_remote_domain_event_block_threshold_msg },
+    { REMOTE_PROC_EVENT_BATCH,
+      remoteConnectNotifyEventBatch,
+      sizeof(remote_event_batch_msg),
+      (xdrproc_t)xdr_remote_event_batch_msg },
 };
 
+static void
+remoteConnectNotifyEventBatch(virNetClientProgramPtr prog,
+                              virNetClientPtr client,
+                              void *evdata, void *opaque G_GNUC_UNUSED)
+{
+    remote_event_batch_msg *msg = evdata;
+
+    remoteEventBatchDispatch(prog, client, msg);
+}
+
 static void
 remoteConnectNotifyEventConnectionClosed(virNetClientProgramPtr prog G_GNUC_UNUSED,
                                          virNetClientPtr client G_GNUC_UNUSED,
@@ -953,6 +978,7 @@ doRemoteOpen(virConnectPtr conn,
     g_autofree char *daemon_name = NULL;
     bool sanity = true;
     bool verify = true;
+    bool eventLoop = true; /* dispatch events from the event loop */
 #ifndef WIN32
     bool tty = true;
 #endif
@@ -1032,6 +1058,7 @@ doRemoteOpen(virConnectPtr conn,
             EXTRACT_URI_ARG_STR("mode", mode_str);
             EXTRACT_URI_ARG_BOOL("no_sanity", sanity);
             EXTRACT_URI_ARG_BOOL("no_verify", verify);
+            EXTRACT_URI_ARG_BOOL("event_thread", eventLoop);
 #ifndef WIN32
             EXTRACT_URI_ARG_BOOL("no_tty", tty);
 #endif
@@ -1347,10 +1374,17 @@ doRemoteOpen(virConnectPtr conn,
             goto failed;
     }
 
-    /* Set up events */
+    /* Set up events. If asked to, callbacks are invoked from a thread of
+     * their own so that a slow one doesn't hold off the RPC and keepalive
+     * traffic processed by the event loop. */
     if (!(priv->eventState = virObjectEventStateNew()))
         goto failed;
 
+    if (!eventLoop &&
+        virObjectEventStateUseThread(priv->eventState, "remote-event",
+                                     REMOTE_EVENT_QUEUE_MAX) < 0)
+        goto failed;
+
     priv->serverEventFilter = remoteConnectSupportsFeatureUnlocked(conn,
                                 priv, VIR_DRV_FEATURE_REMOTE_EVENT_CALLBACK);
     if (!priv->serverEventFilter) {
@@ -1365,6 +1399,21 @@ doRemoteOpen(virConnectPtr conn,
                  "by the remote side.");
     }
 
+    /* Asking also tells the server that we can handle large packets */
+    priv->serverStreamLargePackets = remoteConnectSupportsFeatureUnlocked(conn,
+                                priv, VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PACKETS);
+    if (!priv->serverStreamLargePackets) {
+        VIR_INFO("Large stream packets aren't supported "
+                 "by the remote side.");
+    }
+
+    /* Likewise the server only batches events if we ask for it */
+    if (!remoteConnectSupportsFeatureUnlocked(conn, priv,
+                                              VIR_DRV_FEATURE_REMOTE_EVENT_BATCH)) {
+        VIR_INFO("Batched events aren't supported "
+                 "by the remote side.");
+    }
+
     return VIR_DRV_OPEN_SUCCESS;
 
  failed:
@@ -1378,6 +1427,10 @@ doRemoteOpen(virConnectPtr conn,
     priv->closeCallback = NULL;
     virObjectUnref(priv->tls);
     priv->tls = NULL;
+    if (priv->eventState)
+        virObjectEventStateStopThread(priv->eventState);
+    virObjectUnref(priv->eventState);
+    priv->eventState = NULL;
 
     VIR_FREE(priv->hostname);
     return VIR_DRV_OPEN_ERROR;
@@ -1542,6 +1595,8 @@ doRemoteClose(virConnectPtr conn, struct private_data *priv)
     /* See comment for remoteType. */
     VIR_FREE(priv->type);
 
+    if (priv->eventState)
+        virObjectEventStateStopThread(priv->eventState);
     virObjectUnref(priv->eventState);
     priv->eventState = NULL;
 
@@ -1607,6 +1662,36 @@ remoteConnectGetType(virConnectPtr conn)
     return rv;
 }
 
+static int
+remoteConnectSupportsFeature(virConnectPtr conn, int feature)
+{
+    int rv = -1;
+    remote_connect_supports_feature_args args = { feature };
+    remote_connect_supports_feature_ret ret;
+    struct private_data *priv = conn->privateData;
+
+    remoteDriverLock(priv);
+
+    /* Negotiated in doRemoteOpen and queried by every virStream*All call,
+     * don't ask the server again. */
+    if (feature == VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PACKETS) {
+        rv = priv->serverStreamLargePackets;
+        goto done;
+    }
+
+    memset(&ret, 0, sizeof(ret));
+    if (call(conn, priv, 0, REMOTE_PROC_CONNECT_SUPPORTS_FEATURE,
+             (xdrproc_t) xdr_remote_connect_supports_feature_args, (char *) &args,
+             (xdrproc_t) xdr_remote_connect_supports_feature_ret, (char *) &ret) == -1)
+        goto done;
+
+    rv = ret.supported;
+
+ done:
+    remoteDriverUnlock(priv);
+    return rv;
+}
+
 static int remoteConnectIsSecure(virConnectPtr conn)
 {
     int rv = -1;
@@ -4477,7 +4562,7 @@ remoteConnectDomainEventRegister(virConnectPtr conn,
                                                    NULL,
                                                    VIR_DOMAIN_EVENT_ID_LIFECYCLE,
                                                    VIR_DOMAIN_EVENT_CALLBACK(callback),
-                                                   opaque, freecb, true,
+                                                   opaque, freecb, true, 0,
                                                    &callbackID,
                                                    priv->serverEventFilter)) < 0)
          goto done;
@@ -5969,12 +6054,13 @@ static virStreamDriver remoteStreamDrv = {
 
 
 static int
-remoteConnectDomainEventRegisterAny(virConnectPtr conn,
-                                    virDomainPtr dom,
-                                    int eventID,
-                                    virConnectDomainEventGenericCallback callback,
-                                    void *opaque,
-                                    virFreeCallback freecb)
+remoteConnectDomainEventRegisterAnyFlags(virConnectPtr conn,
+                                         virDomainPtr dom,
+                                         int eventID,
+                                         virConnectDomainEventGenericCallback callback,
+                                         void *opaque,
+                                         virFreeCallback freecb,
+                                         unsigned int flags)
 {
     int rv = -1;
     struct private_data *priv = conn->privateData;
@@ -5984,17 +6070,49 @@ remoteConnectDomainEventRegisterAny(virConnectPtr conn,
 
     remoteDriverLock(priv);
 
+    /* The event policies are applied by the server on a callback of
+     * its own, which needs per-callback event filtering */
+    if (flags && !priv->serverEventFilter) {
+        virReportError(VIR_ERR_ARGUMENT_UNSUPPORTED, "%s",
+                       _("event registration flags are not supported "
+                         "by the server"));
+        goto done;
+    }
+
     if ((count = virDomainEventStateRegisterClient(conn, priv->eventState,
                                                    dom, eventID, callback,
                                                    opaque, freecb, false,
-                                                   &callbackID,
+                                                   flags, &callbackID,
                                                    priv->serverEventFilter)) < 0)
         goto done;
 
     /* If this is the first callback for this eventID, we need to enable
      * events on the server */
     if (count == 1) {
-        if (priv->serverEventFilter) {
+        if (flags) {
+            remote_connect_domain_event_register_any_flags_args args;
+            remote_connect_domain_event_register_any_flags_ret ret;
+
+            args.eventID = eventID;
+            if (dom) {
+                make_nonnull_domain(&domain, dom);
+                args.dom = &domain;
+            } else {
+                args.dom = NULL;
+            }
+            args.flags = flags;
+
+            memset(&ret, 0, sizeof(ret));
+            if (call(conn, priv, 0, REMOTE_PROC_CONNECT_DOMAIN_EVENT_REGISTER_ANY_FLAGS,
+                     (xdrproc_t) xdr_remote_connect_domain_event_register_any_flags_args, (char *) &args,
+                     (xdrproc_t) xdr_remote_connect_domain_event_register_any_flags_ret, (char *) &ret) == -1) {
+                virObjectEventStateDeregisterID(conn, priv->eventState,
+                                                callbackID, false);
+                goto done;
+            }
+            virObjectEventStateSetRemote(conn, priv->eventState, callbackID,
+                                         ret.callbackID);
+        } else if (priv->serverEventFilter) {
             remote_connect_domain_event_callback_register_any_args args;
             remote_connect_domain_event_callback_register_any_ret ret;
 
@@ -6039,6 +6157,20 @@ remoteConnectDomainEventRegisterAny(virConnectPtr conn,
 }
 
 
+static int
+remoteConnectDomainEventRegisterAny(virConnectPtr conn,
+                                    virDomainPtr dom,
+                                    int eventID,
+                                    virConnectDomainEventGenericCallback callback,
+                                    void *opaque,
+                                    virFreeCallback freecb)
+{
+    return remoteConnectDomainEventRegisterAnyFlags(conn, dom, eventID,
+                                                    callback, opaque, freecb,
+                                                    0);
+}
+
+
 static int
 remoteConnectDomainEventDeregisterAny(virConnectPtr conn,
                                       int callbackID)
@@ -8686,6 +8818,7 @@ static virHypervisorDriver hypervisor_driver = {
     .domainAgentSetResponseTimeout = remoteDomainAgentSetResponseTimeout, /* 5.10.0 */
     .domainBackupBegin = remoteDomainBackupBegin, /* 6.0.0 */
     .domainBackupGetXMLDesc = remoteDomainBackupGetXMLDesc, /* 6.0.0 */
+    .connectDomainEventRegisterAnyFlags = remoteConnectDomainEventRegisterAnyFlags, /* 6.7.0 */
 };
 
 static virNetworkDriver network_driver = {
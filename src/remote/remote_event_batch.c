@@ -0,0 +1,177 @@
+/*
+ * remote_event_batch.c: batching of events sent to remote clients
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "remote_event_batch.h"
+#include "viralloc.h"
+#include "virlog.h"
+
+#define VIR_FROM_THIS VIR_FROM_REMOTE
+
+VIR_LOG_INIT("remote.remote_event_batch");
+
+
+/**
+ * remoteEventBatchAppend:
+ * @batch: the batch
+ * @procnr: procedure number of the event
+ * @data: XDR encoded body of the event
+ * @len: length of @data
+ *
+ * Queues a copy of the event in @batch.
+ *
+ * Returns 1 if @batch holds REMOTE_EVENT_BATCH_MAX events or at least
+ * VIR_NET_MESSAGE_INITIAL bytes of them and has to be sent now, 0 if
+ * more events fit in, -1 on error.
+ */
+int
+remoteEventBatchAppend(remoteEventBatchPtr batch,
+                       int procnr,
+                       const char *data,
+                       size_t len)
+{
+    remote_event_batch_item item;
+
+    item.proc = procnr;
+    item.data.data_len = len;
+    item.data.data_val = g_memdup(data, len);
+
+    if (VIR_APPEND_ELEMENT(batch->events, batch->nevents, item) < 0) {
+        VIR_FREE(item.data.data_val);
+        return -1;
+    }
+    batch->size += len;
+
+    if (batch->nevents >= REMOTE_EVENT_BATCH_MAX ||
+        batch->size >= VIR_NET_MESSAGE_INITIAL)
+        return 1;
+    return 0;
+}
+
+
+/**
+ * remoteEventBatchEncode:
+ * @batch: the batch
+ *
+ * Encodes the events queued in @batch into a message and empties @batch.
+ * A single event is encoded as a regular message, more of them are wrapped
+ * in REMOTE_PROC_EVENT_BATCH. @batch is emptied even on failure.
+ *
+ * Returns the message or NULL if @batch is empty or on error.
+ */
+virNetMessagePtr
+remoteEventBatchEncode(remoteEventBatchPtr batch)
+{
+    remote_event_batch_msg data;
+    virNetMessagePtr msg = NULL;
+
+    if (batch->nevents == 0)
+        return NULL;
+
+    data.events.events_len = batch->nevents;
+    data.events.events_val = g_steal_pointer(&batch->events);
+    batch->nevents = 0;
+    batch->size = 0;
+
+    if (!(msg = virNetMessageNew(false)))
+        goto cleanup;
+
+    msg->header.prog = REMOTE_PROGRAM;
+    msg->header.vers = REMOTE_PROTOCOL_VERSION;
+    msg->header.type = VIR_NET_MESSAGE;
+    msg->header.serial = 1;
+    msg->header.status = VIR_NET_OK;
+
+    if (data.events.events_len == 1) {
+        remote_event_batch_item *item = &data.events.events_val[0];
+
+        msg->header.proc = item->proc;
+        if (virNetMessageEncodeHeader(msg) < 0 ||
+            virNetMessageEncodePayloadRaw(msg, item->data.data_val,
+                                          item->data.data_len) < 0)
+            goto error;
+    } else {
+        msg->header.proc = REMOTE_PROC_EVENT_BATCH;
+        if (virNetMessageEncodeHeader(msg) < 0 ||
+            virNetMessageEncodePayload(msg,
+                                       (xdrproc_t)xdr_remote_event_batch_msg,
+                                       &data) < 0)
+            goto error;
+    }
+
+    VIR_DEBUG("Encoded %u batched events %zu",
+              data.events.events_len, msg->bufferLength);
+
+ cleanup:
+    xdr_free((xdrproc_t)xdr_remote_event_batch_msg, (char *) &data);
+    return msg;
+
+ error:
+    virNetMessageFree(msg);
+    msg = NULL;
+    goto cleanup;
+}
+
+
+/**
+ * remoteEventBatchClear:
+ * @batch: the batch
+ *
+ * Discards the events queued in @batch.
+ */
+void
+remoteEventBatchClear(remoteEventBatchPtr batch)
+{
+    while (batch->nevents > 0)
+        VIR_FREE(batch->events[--batch->nevents].data.data_val);
+    VIR_FREE(batch->events);
+    batch->size = 0;
+}
+
+
+/**
+ * remoteEventBatchDispatch:
+ * @prog: the program which received the batch
+ * @client: the client which received the batch
+ * @msg: the decoded batch
+ *
+ * Passes the events of @msg to the handlers registered in @prog in the
+ * order they were queued by the server. Unknown and malformed events are
+ * skipped, as are batches nested in @msg.
+ */
+void
+remoteEventBatchDispatch(virNetClientProgramPtr prog,
+                         virNetClientPtr client,
+                         remote_event_batch_msg *msg)
+{
+    size_t i;
+
+    for (i = 0; i < msg->events.events_len; i++) {
+        remote_event_batch_item *item = &msg->events.events_val[i];
+
+        if (item->proc == REMOTE_PROC_EVENT_BATCH) {
+            VIR_WARN("Ignoring nested event batch");
+            continue;
+        }
+
+        ignore_value(virNetClientProgramDispatchEvent(prog, client, item->proc,
+                                                      item->data.data_val,
+                                                      item->data.data_len));
+    }
+}
@@ -0,0 +1,47 @@
+/*
+ * remote_event_batch.h: batching of events sent to remote clients
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "remote_protocol.h"
+#include "virnetmessage.h"
+#include "virnetclientprogram.h"
+
+typedef struct _remoteEventBatch remoteEventBatch;
+typedef remoteEventBatch *remoteEventBatchPtr;
+struct _remoteEventBatch {
+    /* Encoded events waiting to be sent in a single message */
+    remote_event_batch_item *events;
+    size_t nevents;
+    /* Sum of the lengths of the encoded events */
+    size_t size;
+};
+
+int remoteEventBatchAppend(remoteEventBatchPtr batch,
+                           int procnr,
+                           const char *data,
+                           size_t len)
+    G_GNUC_WARN_UNUSED_RESULT;
+
+virNetMessagePtr remoteEventBatchEncode(remoteEventBatchPtr batch);
+
+void remoteEventBatchClear(remoteEventBatchPtr batch);
+
+void remoteEventBatchDispatch(virNetClientProgramPtr prog,
+                              virNetClientPtr client,
+                              remote_event_batch_msg *msg);
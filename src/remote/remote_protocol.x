@@ -280,6 +280,9 @@ const REMOTE_DOMAIN_GUEST_INFO_PARAMS_MAX = 2048;
  */
 const REMOTE_NETWORK_PORT_PARAMETERS_MAX = 16;
 
+/* Upper limit on number of events sent in a single batch */
+const REMOTE_EVENT_BATCH_MAX = 1024;
+
 
 /* UUID.  VIR_UUID_BUFLEN definition comes from libvirt.h */
 typedef opaque remote_uuid[VIR_UUID_BUFLEN];
@@ -2457,6 +2460,16 @@ struct remote_connect_domain_event_callback_register_any_ret {
     int callbackID;
 };
 
+struct remote_connect_domain_event_register_any_flags_args {
+    int eventID;
+    remote_domain dom;
+    unsigned int flags;
+};
+
+struct remote_connect_domain_event_register_any_flags_ret {
+    int callbackID;
+};
+
 struct remote_connect_domain_event_callback_deregister_any_args {
     int callbackID;
 };
@@ -3771,6 +3784,17 @@ struct remote_domain_backup_get_xml_desc_ret {
     remote_nonnull_string xml;
 };
 
+/* A single event of a batch. @data holds the XDR encoded body of the
+ * message which would have been sent for event procedure @proc. */
+struct remote_event_batch_item {
+    int proc;
+    opaque data<REMOTE_STRING_MAX>;
+};
+
+struct remote_event_batch_msg {
+    remote_event_batch_item events<REMOTE_EVENT_BATCH_MAX>;
+};
+
 /*----- Protocol. -----*/
 
 /* Define the program number, protocol version and procedure numbers here. */
@@ -4231,7 +4255,7 @@ enum remote_procedure {
     REMOTE_PROC_CONNECT_GET_HOSTNAME = 59,
 
     /**
-     * @generate: client
+     * @generate: none
      * @priority: high
      * @acl: connect:getattr
      */
@@ -6664,5 +6688,19 @@ enum remote_procedure {
      * @priority: high
      * @acl: domain:read
      */
-    REMOTE_PROC_DOMAIN_BACKUP_GET_XML_DESC = 422
+    REMOTE_PROC_DOMAIN_BACKUP_GET_XML_DESC = 422,
+
+    /**
+     * @generate: none
+     * @acl: none
+     */
+    REMOTE_PROC_EVENT_BATCH = 423,
+
+    /**
+     * @generate: none
+     * @priority: high
+     * @acl: connect:search_domains
+     * @aclfilter: domain:getattr
+     */
+    REMOTE_PROC_CONNECT_DOMAIN_EVENT_REGISTER_ANY_FLAGS = 424
 };
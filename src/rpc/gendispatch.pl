@@ -1266,11 +1266,12 @@ elsif ($mode eq "server") {
 
     print "virNetServerProgramProc ${structprefix}Procs[] = {\n";
     for ($id = 0 ; $id <= $#calls ; $id++) {
-        my ($comment, $name, $argtype, $arglen, $argfilter, $retlen, $retfilter, $priority);
+        my ($comment, $name, $argtype, $arglen, $argfilter, $retlen, $retfilter, $priority, $procname);
 
         if (defined $calls[$id] && !$calls[$id]->{msg}) {
             $comment = "/* Method $calls[$id]->{ProcName} => $id */";
             $name = $structprefix . "Dispatch" . $calls[$id]->{ProcName} . "Helper";
+            $procname = "\"$calls[$id]->{ProcName}\"";
             my $argtype = $calls[$id]->{args};
             my $rettype = $calls[$id]->{ret};
             $arglen = $argtype ne "void" ? "sizeof($argtype)" : "0";
@@ -1284,6 +1285,7 @@ elsif ($mode eq "server") {
                 $comment = "/* Unused $id */";
             }
             $name = "NULL";
+            $procname = "NULL";
             $arglen = $retlen = 0;
             $argfilter = "xdr_void";
             $retfilter = "xdr_void";
@@ -1291,7 +1293,7 @@ elsif ($mode eq "server") {
 
     $priority = defined $calls[$id]->{priority} ? $calls[$id]->{priority} : 0;
 
-        print "{ $comment\n   ${name},\n   $arglen,\n   (xdrproc_t)$argfilter,\n   $retlen,\n   (xdrproc_t)$retfilter,\n   true,\n   $priority\n},\n";
+        print "{ $comment\n   ${name},\n   $arglen,\n   (xdrproc_t)$argfilter,\n   $retlen,\n   (xdrproc_t)$retfilter,\n   true,\n   $priority,\n   $procname\n},\n";
     }
     print "};\n";
     print "size_t ${structprefix}NProcs = G_N_ELEMENTS(${structprefix}Procs);\n";
@@ -72,6 +72,7 @@ struct _virNetClient {
 
     virNetTLSSessionPtr tls;
     char *hostname;
+    char *service;
 
     virNetClientProgramPtr *programs;
     size_t nprograms;
@@ -290,7 +291,8 @@ virNetClientKeepAliveSendCB(void *opaque,
 }
 
 static virNetClientPtr virNetClientNew(virNetSocketPtr sock,
-                                       const char *hostname)
+                                       const char *hostname,
+                                       const char *service)
 {
     virNetClientPtr client = NULL;
 
@@ -307,6 +309,7 @@ static virNetClientPtr virNetClientNew(virNetSocketPtr sock,
     client->eventLoop = g_main_loop_new(client->eventCtx, FALSE);
 
     client->hostname = g_strdup(hostname);
+    client->service = g_strdup(service);
 
     PROBE(RPC_CLIENT_NEW,
           "client=%p sock=%p",
@@ -373,7 +376,7 @@ virNetClientPtr virNetClientNewUNIX(const char *path,
     if (virNetSocketNewConnectUNIX(path, spawnDaemon, binary, &sock) < 0)
         return NULL;
 
-    return virNetClientNew(sock, NULL);
+    return virNetClientNew(sock, NULL, NULL);
 }
 
 
@@ -388,7 +391,7 @@ virNetClientPtr virNetClientNewTCP(const char *nodename,
                                   &sock) < 0)
         return NULL;
 
-    return virNetClientNew(sock, nodename);
+    return virNetClientNew(sock, nodename, service);
 }
 
 virNetClientPtr virNetClientNewSSH(const char *nodename,
@@ -407,7 +410,7 @@ virNetClientPtr virNetClientNewSSH(const char *nodename,
                                   noVerify, netcat, keyfile, path, &sock) < 0)
         return NULL;
 
-    return virNetClientNew(sock, NULL);
+    return virNetClientNew(sock, NULL, NULL);
 }
 
 #define DEFAULT_VALUE(VAR, VAL) \
@@ -496,7 +499,7 @@ virNetClientPtr virNetClientNewLibSSH2(const char *host,
                                       command, authPtr, uri, &sock) != 0)
         return NULL;
 
-   return virNetClientNew(sock, NULL);
+   return virNetClientNew(sock, NULL, NULL);
 }
 #undef DEFAULT_VALUE
 
@@ -576,7 +579,7 @@ virNetClientPtr virNetClientNewLibssh(const char *host,
                                      command, authPtr, uri, &sock) != 0)
         return NULL;
 
-    return virNetClientNew(sock, NULL);
+    return virNetClientNew(sock, NULL, NULL);
 }
 #undef DEFAULT_VALUE
 
@@ -587,7 +590,7 @@ virNetClientPtr virNetClientNewExternal(const char **cmdargv)
     if (virNetSocketNewConnectExternal(cmdargv, &sock) < 0)
         return NULL;
 
-    return virNetClientNew(sock, NULL);
+    return virNetClientNew(sock, NULL, NULL);
 }
 
 
@@ -692,6 +695,7 @@ void virNetClientDispose(void *obj)
     g_main_context_unref(client->eventCtx);
 
     VIR_FREE(client->hostname);
+    VIR_FREE(client->service);
 
     if (client->sock)
         virNetSocketRemoveIOCallback(client->sock);
@@ -901,7 +905,8 @@ int virNetClientSetTLSSession(virNetClientPtr client,
     virObjectLock(client);
 
     if (!(client->tls = virNetTLSSessionNew(tls,
-                                            client->hostname)))
+                                            client->hostname,
+                                            client->service)))
         goto error;
 
     virNetSocketSetTLSSession(client->sock, client->tls);
@@ -965,6 +970,10 @@ int virNetClientSetTLSSession(virNetClientPtr client,
         goto error;
     }
 
+    /* The server is known to accept us, so make it possible for the
+     * next connection to resume this session */
+    virNetTLSSessionSaveResumeData(client->tls);
+
     virObjectUnlock(client);
     return 0;
 
@@ -1105,12 +1114,10 @@ virNetClientCallDispatchReply(virNetClientPtr client)
         return -1;
     }
 
-    if (VIR_REALLOC_N(thecall->msg->buffer, client->msg.bufferLength) < 0)
-        return -1;
+    virNetMessageResizeBuffer(thecall->msg, client->msg.bufferLength);
 
     memcpy(thecall->msg->buffer, client->msg.buffer, client->msg.bufferLength);
     memcpy(&thecall->msg->header, &client->msg.header, sizeof(client->msg.header));
-    thecall->msg->bufferLength = client->msg.bufferLength;
     thecall->msg->bufferOffset = client->msg.bufferOffset;
 
     thecall->msg->nfds = client->msg.nfds;
@@ -1306,13 +1313,41 @@ virNetClientIOWriteMessage(virNetClientPtr client,
     ssize_t ret = 0;
 
     if (thecall->msg->bufferOffset < thecall->msg->bufferLength) {
-        ret = virNetSocketWrite(client->sock,
-                                thecall->msg->buffer + thecall->msg->bufferOffset,
-                                thecall->msg->bufferLength - thecall->msg->bufferOffset);
+        GOutputVector vec[VIR_NET_SOCKET_WRITEV_MAX];
+        size_t nvec = 0;
+        virNetClientCallPtr call;
+        size_t done;
+
+        /* Send the calls queued behind this one along with it, up to
+         * the first one passing FDs as they must follow its data */
+        for (call = thecall; call && nvec < G_N_ELEMENTS(vec); call = call->next) {
+            if (call->mode != VIR_NET_CLIENT_MODE_WAIT_TX)
+                continue;
+
+            if (call->msg->bufferOffset < call->msg->bufferLength) {
+                vec[nvec].buffer = call->msg->buffer + call->msg->bufferOffset;
+                vec[nvec].size = call->msg->bufferLength - call->msg->bufferOffset;
+                nvec++;
+            }
+
+            if (call->msg->nfds)
+                break;
+        }
+
+        ret = virNetSocketWritev(client->sock, vec, nvec);
         if (ret <= 0)
             return ret;
 
-        thecall->msg->bufferOffset += ret;
+        for (call = thecall, done = ret; call && done; call = call->next) {
+            size_t len;
+
+            if (call->mode != VIR_NET_CLIENT_MODE_WAIT_TX)
+                continue;
+
+            len = MIN(done, call->msg->bufferLength - call->msg->bufferOffset);
+            call->msg->bufferOffset += len;
+            done -= len;
+        }
     }
 
     if (thecall->msg->bufferOffset == thecall->msg->bufferLength) {
@@ -1372,11 +1407,8 @@ virNetClientIOReadMessage(virNetClientPtr client)
     ssize_t ret;
 
     /* Start by reading length word */
-    if (client->msg.bufferLength == 0) {
-        client->msg.bufferLength = 4;
-        if (VIR_ALLOC_N(client->msg.buffer, client->msg.bufferLength) < 0)
-            return -ENOMEM;
-    }
+    if (client->msg.bufferLength == 0)
+        virNetMessageResizeBuffer(&client->msg, VIR_NET_MESSAGE_LEN_MAX);
 
     wantData = client->msg.bufferLength - client->msg.bufferOffset;
 
@@ -263,6 +263,57 @@ int virNetClientProgramDispatch(virNetClientProgramPtr prog,
 }
 
 
+/**
+ * virNetClientProgramDispatchEvent:
+ * @prog: the program
+ * @client: the client which received the event
+ * @proc: event procedure number
+ * @data: XDR encoded body of the event message
+ * @len: length of @data
+ *
+ * Decodes an event which arrived embedded in another message, e.g. in
+ * a batch of events, and passes it to the handler registered for @proc.
+ *
+ * Returns 0 on success, -1 if the event is unknown or malformed.
+ */
+int virNetClientProgramDispatchEvent(virNetClientProgramPtr prog,
+                                     virNetClientPtr client,
+                                     int proc,
+                                     const char *data,
+                                     size_t len)
+{
+    virNetClientProgramEventPtr event;
+    g_autofree char *evdata = NULL;
+    XDR xdr;
+    int ret = -1;
+
+    VIR_DEBUG("prog=%d proc=%d len=%zu", prog->program, proc, len);
+
+    if (!(event = virNetClientProgramGetEvent(prog, proc))) {
+        VIR_ERROR(_("No event expected with procedure 0x%x"), proc);
+        return -1;
+    }
+
+    evdata = g_new0(char, event->msg_len);
+
+    xdrmem_create(&xdr, (char *) data, len, XDR_DECODE);
+
+    if (!(*event->msg_filter)(&xdr, evdata, 0)) {
+        VIR_ERROR(_("Unable to decode event with procedure 0x%x"), proc);
+        goto cleanup;
+    }
+
+    event->func(prog, client, evdata, prog->eventOpaque);
+
+    ret = 0;
+
+ cleanup:
+    xdr_free(event->msg_filter, evdata);
+    xdr_destroy(&xdr);
+    return ret;
+}
+
+
 int virNetClientProgramCall(virNetClientProgramPtr prog,
                             virNetClientPtr client,
                             unsigned serial,
@@ -67,6 +67,12 @@ int virNetClientProgramDispatch(virNetClientProgramPtr prog,
                                 virNetClientPtr client,
                                 virNetMessagePtr msg);
 
+int virNetClientProgramDispatchEvent(virNetClientProgramPtr prog,
+                                     virNetClientPtr client,
+                                     int proc,
+                                     const char *data,
+                                     size_t len);
+
 int virNetClientProgramCall(virNetClientProgramPtr prog,
                             virNetClientPtr client,
                             unsigned serial,
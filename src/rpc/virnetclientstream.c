@@ -344,10 +344,11 @@ int virNetClientStreamQueuePacket(virNetClientStreamPtr st,
 
     /* Steal message buffer */
     tmp_msg->buffer = msg->buffer;
+    tmp_msg->bufferAlloc = msg->bufferAlloc;
     tmp_msg->bufferLength = msg->bufferLength;
     tmp_msg->bufferOffset = msg->bufferOffset;
     msg->buffer = NULL;
-    msg->bufferLength = msg->bufferOffset = 0;
+    msg->bufferAlloc = msg->bufferLength = msg->bufferOffset = 0;
 
     virObjectLock(st);
 
@@ -29,17 +29,198 @@
 #include "virfile.h"
 #include "virutil.h"
 #include "virstring.h"
+#include "virthread.h"
 
 #define VIR_FROM_THIS VIR_FROM_RPC
 
 VIR_LOG_INIT("rpc.netmessage");
 
+/*
+ * Every RPC call and reply needs a message and a buffer of at least
+ * VIR_NET_MESSAGE_INITIAL bytes which used to be allocated and freed
+ * again for each packet. Freed messages and buffers are kept in a
+ * process wide pool instead. Buffers are grouped in size classes
+ * which double from VIR_NET_MESSAGE_INITIAL up to the size of a
+ * large stream packet, so that the buffer growth done while encoding
+ * a payload maps onto the classes. Anything larger, and the small
+ * buffers used to read the length word of incoming packets, are
+ * allocated and freed as before. The amount of memory retained by the
+ * pool is capped.
+ */
+#define VIR_NET_MESSAGE_POOL_CLASSES 7
+#define VIR_NET_MESSAGE_POOL_MAX_BYTES (32 * 1024 * 1024)
+#define VIR_NET_MESSAGE_POOL_MAX_MSGS 64
+
+typedef struct _virNetMessagePoolBuffer virNetMessagePoolBuffer;
+struct _virNetMessagePoolBuffer {
+    virNetMessagePoolBuffer *next;
+};
+
+static virMutex virNetMessagePoolLock = VIR_MUTEX_INITIALIZER;
+static virNetMessagePoolBuffer *virNetMessagePoolBuffers[VIR_NET_MESSAGE_POOL_CLASSES];
+static size_t virNetMessagePoolBytes;
+static virNetMessagePtr virNetMessagePoolMsgs;
+static size_t virNetMessagePoolNMsgs;
+
+G_STATIC_ASSERT((VIR_NET_MESSAGE_INITIAL << (VIR_NET_MESSAGE_POOL_CLASSES - 1)) ==
+                VIR_NET_MESSAGE_STREAM_PAYLOAD);
+
+
+/* Room for the length word and header on top of the payload, so that
+ * a full stream packet fits in the largest class. */
+static size_t
+virNetMessagePoolClassSize(size_t cls)
+{
+    return (VIR_NET_MESSAGE_INITIAL << cls) +
+        VIR_NET_MESSAGE_LEN_MAX + VIR_NET_MESSAGE_HEADER_MAX;
+}
+
+
+static char *
+virNetMessagePoolGetBuffer(size_t len,
+                           size_t *alloc)
+{
+    virNetMessagePoolBuffer *buf = NULL;
+    size_t cls;
+
+    /* Idle connections sit on a buffer for the length word, which must
+     * not pin a pooled buffer of the smallest class. */
+    if (len < VIR_NET_MESSAGE_INITIAL) {
+        *alloc = len;
+        return g_new0(char, len);
+    }
+
+    for (cls = 0; cls < VIR_NET_MESSAGE_POOL_CLASSES; cls++) {
+        if (len <= virNetMessagePoolClassSize(cls))
+            break;
+    }
+
+    if (cls == VIR_NET_MESSAGE_POOL_CLASSES) {
+        *alloc = len;
+        return g_new(char, len);
+    }
+
+    *alloc = virNetMessagePoolClassSize(cls);
+
+    virMutexLock(&virNetMessagePoolLock);
+    if ((buf = virNetMessagePoolBuffers[cls])) {
+        virNetMessagePoolBuffers[cls] = buf->next;
+        virNetMessagePoolBytes -= *alloc;
+    }
+    virMutexUnlock(&virNetMessagePoolLock);
+
+    if (buf)
+        return (char *)buf;
+
+    return g_new(char, *alloc);
+}
+
+
+static void
+virNetMessagePoolPutBuffer(char *buffer,
+                           size_t alloc)
+{
+    virNetMessagePoolBuffer *buf = (virNetMessagePoolBuffer *)buffer;
+    size_t cls;
+
+    if (!buffer)
+        return;
+
+    for (cls = 0; cls < VIR_NET_MESSAGE_POOL_CLASSES; cls++) {
+        if (alloc == virNetMessagePoolClassSize(cls))
+            break;
+    }
+
+    if (cls < VIR_NET_MESSAGE_POOL_CLASSES) {
+        virMutexLock(&virNetMessagePoolLock);
+        if (virNetMessagePoolBytes + alloc <= VIR_NET_MESSAGE_POOL_MAX_BYTES) {
+            buf->next = virNetMessagePoolBuffers[cls];
+            virNetMessagePoolBuffers[cls] = buf;
+            virNetMessagePoolBytes += alloc;
+            buf = NULL;
+        }
+        virMutexUnlock(&virNetMessagePoolLock);
+    }
+
+    g_free(buf);
+}
+
+
+/**
+ * virNetMessageGetStreamLimits:
+ * @largePackets: whether the peer accepts large stream packets
+ * @packetSize: filled with the maximum payload of stream data packets
+ * @txWindow: filled with the number of packets which can be in flight
+ *
+ * Peers which announced VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PACKETS are
+ * sent stream data in packets of VIR_NET_MESSAGE_STREAM_PAYLOAD bytes with
+ * up to VIR_NET_MESSAGE_STREAM_TX_WINDOW of them queued. Older peers get a
+ * single packet of at most VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX at a time.
+ */
+void
+virNetMessageGetStreamLimits(bool largePackets,
+                             size_t *packetSize,
+                             size_t *txWindow)
+{
+    if (largePackets) {
+        *packetSize = VIR_NET_MESSAGE_STREAM_PAYLOAD;
+        *txWindow = VIR_NET_MESSAGE_STREAM_TX_WINDOW;
+    } else {
+        *packetSize = VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
+        *txWindow = 1;
+    }
+}
+
+
+/**
+ * virNetMessageResizeBuffer:
+ * @msg: the message
+ * @len: the new length of the message buffer
+ *
+ * Makes @msg->buffer at least @len bytes long, preserving its current
+ * contents up to @msg->bufferLength, and sets @msg->bufferLength to
+ * @len. Buffers are taken from the message pool whenever possible, so
+ * this must be used rather than allocating @msg->buffer directly.
+ */
+void
+virNetMessageResizeBuffer(virNetMessagePtr msg,
+                          size_t len)
+{
+    char *buffer;
+    size_t alloc;
+
+    if (msg->buffer && len <= msg->bufferAlloc) {
+        msg->bufferLength = len;
+        return;
+    }
+
+    buffer = virNetMessagePoolGetBuffer(len, &alloc);
+    if (msg->buffer) {
+        memcpy(buffer, msg->buffer, MIN(msg->bufferLength, len));
+        virNetMessagePoolPutBuffer(msg->buffer, msg->bufferAlloc);
+    }
+
+    msg->buffer = buffer;
+    msg->bufferAlloc = alloc;
+    msg->bufferLength = len;
+}
+
+
 virNetMessagePtr virNetMessageNew(bool tracked)
 {
     virNetMessagePtr msg;
 
-    if (VIR_ALLOC(msg) < 0)
-        return NULL;
+    virMutexLock(&virNetMessagePoolLock);
+    if ((msg = virNetMessagePoolMsgs)) {
+        virNetMessagePoolMsgs = msg->next;
+        virNetMessagePoolNMsgs--;
+    }
+    virMutexUnlock(&virNetMessagePoolLock);
+
+    if (msg)
+        memset(msg, 0, sizeof(*msg));
+    else
+        msg = g_new0(virNetMessage, 1);
 
     msg->tracked = tracked;
     VIR_DEBUG("msg=%p tracked=%d", msg, tracked);
@@ -62,7 +243,8 @@ virNetMessageClearPayload(virNetMessagePtr msg)
 
     msg->bufferOffset = 0;
     msg->bufferLength = 0;
-    VIR_FREE(msg->buffer);
+    virNetMessagePoolPutBuffer(g_steal_pointer(&msg->buffer), msg->bufferAlloc);
+    msg->bufferAlloc = 0;
 }
 
 
@@ -89,6 +271,16 @@ void virNetMessageFree(virNetMessagePtr msg)
         msg->cb(msg, msg->opaque);
 
     virNetMessageClearPayload(msg);
+
+    virMutexLock(&virNetMessagePoolLock);
+    if (virNetMessagePoolNMsgs < VIR_NET_MESSAGE_POOL_MAX_MSGS) {
+        msg->next = virNetMessagePoolMsgs;
+        virNetMessagePoolMsgs = msg;
+        virNetMessagePoolNMsgs++;
+        msg = NULL;
+    }
+    virMutexUnlock(&virNetMessagePoolLock);
+
     VIR_FREE(msg);
 }
 
@@ -152,9 +344,7 @@ int virNetMessageDecodeLength(virNetMessagePtr msg)
 
     /* Extend our declared buffer length and carry
        on reading the header + payload */
-    msg->bufferLength += len;
-    if (VIR_REALLOC_N(msg->buffer, msg->bufferLength) < 0)
-        goto cleanup;
+    virNetMessageResizeBuffer(msg, msg->bufferLength + len);
 
     VIR_DEBUG("Got length, now need %zu total (%u more)",
               msg->bufferLength, len);
@@ -229,9 +419,7 @@ int virNetMessageEncodeHeader(virNetMessagePtr msg)
     int ret = -1;
     unsigned int len = 0;
 
-    msg->bufferLength = VIR_NET_MESSAGE_INITIAL + VIR_NET_MESSAGE_LEN_MAX;
-    if (VIR_REALLOC_N(msg->buffer, msg->bufferLength) < 0)
-        return ret;
+    virNetMessageResizeBuffer(msg, VIR_NET_MESSAGE_INITIAL + VIR_NET_MESSAGE_LEN_MAX);
     msg->bufferOffset = 0;
 
     /* Format the header. */
@@ -369,10 +557,7 @@ int virNetMessageEncodePayload(virNetMessagePtr msg,
 
         xdr_destroy(&xdr);
 
-        msg->bufferLength = newlen + VIR_NET_MESSAGE_LEN_MAX;
-
-        if (VIR_REALLOC_N(msg->buffer, msg->bufferLength) < 0)
-            goto error;
+        virNetMessageResizeBuffer(msg, newlen + VIR_NET_MESSAGE_LEN_MAX);
 
         xdrmem_create(&xdr, msg->buffer + msg->bufferOffset,
                       msg->bufferLength - msg->bufferOffset, XDR_ENCODE);
@@ -453,10 +638,7 @@ int virNetMessageEncodePayloadRaw(virNetMessagePtr msg,
             return -1;
         }
 
-        msg->bufferLength = msg->bufferOffset + len;
-
-        if (VIR_REALLOC_N(msg->buffer, msg->bufferLength) < 0)
-            return -1;
+        virNetMessageResizeBuffer(msg, msg->bufferOffset + len);
 
         VIR_DEBUG("Increased message buffer length = %zu", msg->bufferLength);
     }
@@ -30,16 +30,24 @@ typedef virNetMessage *virNetMessagePtr;
 
 typedef void (*virNetMessageFreeCallback)(virNetMessagePtr msg, void *opaque);
 
+/* How many stream data packets can be queued for transmission to peers
+ * which accept large stream packets. Other peers get one at a time. */
+#define VIR_NET_MESSAGE_STREAM_TX_WINDOW 4
+
 struct _virNetMessage {
     bool tracked;
 
     char *buffer; /* Initially VIR_NET_MESSAGE_INITIAL + VIR_NET_MESSAGE_LEN_MAX */
                   /* Maximum   VIR_NET_MESSAGE_MAX     + VIR_NET_MESSAGE_LEN_MAX */
+    size_t bufferAlloc; /* Allocated size of @buffer, see virNetMessageResizeBuffer */
     size_t bufferLength;
     size_t bufferOffset;
 
     virNetMessageHeader header;
 
+    /* Monotonic time a call was handed to the server for dispatch */
+    gint64 queued;
+
     virNetMessageFreeCallback cb;
     void *opaque;
 
@@ -59,6 +67,15 @@ void virNetMessageClear(virNetMessagePtr);
 
 void virNetMessageFree(virNetMessagePtr msg);
 
+void virNetMessageResizeBuffer(virNetMessagePtr msg,
+                               size_t len)
+    ATTRIBUTE_NONNULL(1);
+
+void virNetMessageGetStreamLimits(bool largePackets,
+                                  size_t *packetSize,
+                                  size_t *txWindow)
+    ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(3);
+
 virNetMessagePtr virNetMessageQueueServe(virNetMessagePtr *queue)
     ATTRIBUTE_NONNULL(1);
 void virNetMessageQueuePush(virNetMessagePtr *queue,
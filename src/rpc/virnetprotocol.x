@@ -46,6 +46,13 @@ const VIR_NET_MESSAGE_HEADER_MAX = 24;
 /* Size of message payload */
 const VIR_NET_MESSAGE_PAYLOAD_MAX = 33554408;
 
+/*
+ * Size of stream data packets sent to peers which accept large
+ * packets. Those take anything up to VIR_NET_MESSAGE_PAYLOAD_MAX,
+ * but bigger packets don't improve throughput any further.
+ */
+const VIR_NET_MESSAGE_STREAM_PAYLOAD = 4194304;
+
 /* Size of message length field. Not counted in VIR_NET_MESSAGE_MAX
  * and VIR_NET_MESSAGE_INITIAL.
  */
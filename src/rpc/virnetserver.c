@@ -27,21 +27,45 @@
 #include "virerror.h"
 #include "virthread.h"
 #include "virthreadpool.h"
+#include "virhash.h"
 #include "virstring.h"
 #include "virutil.h"
 
+#define LIBVIRT_VIRNETSERVERPRIV_H_ALLOW
+#include "virnetserverpriv.h"
+
 #define VIR_FROM_THIS VIR_FROM_RPC
 
 VIR_LOG_INIT("rpc.netserver");
 
 
-typedef struct _virNetServerJob virNetServerJob;
-typedef virNetServerJob *virNetServerJobPtr;
+typedef struct _virNetServerJobIdentity virNetServerJobIdentity;
+typedef virNetServerJobIdentity *virNetServerJobIdentityPtr;
 
-struct _virNetServerJob {
-    virNetServerClientPtr client;
-    virNetMessagePtr msg;
-    virNetServerProgramPtr prog;
+/* Calls handed to workers on behalf of all clients of one identity */
+struct _virNetServerJobIdentity {
+    char *name;
+    size_t refs;        /* number of client queues using this */
+    size_t nrunning;
+};
+
+/* Calls of a single client waiting for a worker. A queue only exists
+ * while the client has calls queued or running. */
+struct _virNetServerJobQueue {
+    char *key;
+    virNetServerJobIdentityPtr identity;
+
+    unsigned int weight;
+    unsigned int credit; /* calls left to hand out in the current round */
+
+    virNetServerJobPtr head;
+    virNetServerJobPtr tail;
+    size_t nqueued;
+    size_t nrunning;
+
+    /* Ring of queues with calls waiting */
+    virNetServerJobQueuePtr prev;
+    virNetServerJobQueuePtr next;
 };
 
 struct _virNetServer {
@@ -70,6 +94,18 @@ struct _virNetServer {
 
     virNetTLSContextPtr tls;
 
+    /* Fair scheduling of calls across clients, see virNetServerScheduleJobs.
+     * Lock ordering: jobLock may be acquired with the server lock held,
+     * but not the other way round. */
+    virMutex jobLock;
+    virHashTablePtr jobQueues;          /* client ID -> virNetServerJobQueue */
+    virHashTablePtr jobIdentities;      /* identity -> virNetServerJobIdentity */
+    virNetServerJobQueuePtr jobRing;    /* queue to take the next call from */
+    size_t njobs_running;               /* calls handed to workers */
+    size_t client_workers_max;          /* per client limit of njobs_running */
+    size_t identity_workers_max;        /* per identity limit of njobs_running */
+    unsigned int client_rw_weight;      /* share of read-write clients */
+
     virNetServerClientPrivNew clientPrivNew;
     virNetServerClientPrivPreExecRestart clientPrivPreExecRestart;
     virFreeCallback clientPrivFree;
@@ -143,28 +179,361 @@ static int virNetServerProcessMsg(virNetServerPtr srv,
     return 0;
 }
 
+static void
+virNetServerJobIdentityFree(void *opaque)
+{
+    virNetServerJobIdentityPtr identity = opaque;
+
+    if (!identity)
+        return;
+
+    g_free(identity->name);
+    g_free(identity);
+}
+
+
+static void
+virNetServerJobDiscard(virNetServerJobPtr job)
+{
+    virObjectUnref(job->prog);
+    virNetMessageFree(job->msg);
+    virNetServerClientClose(job->client);
+    virObjectUnref(job->client);
+    g_free(job);
+}
+
+
+static void
+virNetServerJobQueueFree(void *opaque)
+{
+    virNetServerJobQueuePtr queue = opaque;
+    virNetServerJobPtr job;
+
+    if (!queue)
+        return;
+
+    while ((job = queue->head)) {
+        queue->head = job->next;
+        virNetServerJobDiscard(job);
+    }
+
+    g_free(queue->key);
+    g_free(queue);
+}
+
+
+/*
+ * Returns the queue of the client with ID @id, creating it if needed.
+ *
+ * Must be called with srv->jobLock held.
+ */
+static virNetServerJobQueuePtr
+virNetServerJobQueueGetLocked(virNetServerPtr srv,
+                              unsigned long long id,
+                              bool readonly,
+                              const char *name)
+{
+    g_autofree char *key = NULL;
+    virNetServerJobQueuePtr queue;
+
+    key = g_strdup_printf("%llu", id);
+    if ((queue = virHashLookup(srv->jobQueues, key)))
+        return queue;
+
+    queue = g_new0(virNetServerJobQueue, 1);
+    queue->weight = readonly ? 1 : srv->client_rw_weight;
+
+    if (name) {
+        if (!(queue->identity = virHashLookup(srv->jobIdentities, name))) {
+            queue->identity = g_new0(virNetServerJobIdentity, 1);
+            queue->identity->name = g_strdup(name);
+            if (virHashAddEntry(srv->jobIdentities, name, queue->identity) < 0) {
+                virNetServerJobIdentityFree(queue->identity);
+                g_free(queue);
+                return NULL;
+            }
+        }
+        queue->identity->refs++;
+    }
+
+    if (virHashAddEntry(srv->jobQueues, key, queue) < 0) {
+        if (queue->identity && --queue->identity->refs == 0)
+            virHashRemoveEntry(srv->jobIdentities, queue->identity->name);
+        g_free(queue);
+        return NULL;
+    }
+    queue->key = g_steal_pointer(&key);
+
+    return queue;
+}
+
+
+/* Must be called with srv->jobLock held */
+static void
+virNetServerJobQueueRingRemoveLocked(virNetServerPtr srv,
+                                     virNetServerJobQueuePtr queue)
+{
+    if (queue->next == queue) {
+        srv->jobRing = NULL;
+    } else {
+        queue->prev->next = queue->next;
+        queue->next->prev = queue->prev;
+        if (srv->jobRing == queue)
+            srv->jobRing = queue->next;
+    }
+    queue->prev = queue->next = NULL;
+    queue->credit = 0;
+}
+
+
+/* Must be called with srv->jobLock held */
+static void
+virNetServerJobQueuePushLocked(virNetServerPtr srv,
+                               virNetServerJobQueuePtr queue,
+                               virNetServerJobPtr job)
+{
+    job->queue = queue;
+    if (queue->tail)
+        queue->tail->next = job;
+    else
+        queue->head = job;
+    queue->tail = job;
+
+    /* Clients with new calls join the ring at the end of the round */
+    if (queue->nqueued++ == 0) {
+        if (srv->jobRing) {
+            queue->next = srv->jobRing;
+            queue->prev = srv->jobRing->prev;
+            queue->prev->next = queue;
+            queue->next->prev = queue;
+        } else {
+            queue->prev = queue->next = queue;
+            srv->jobRing = queue;
+        }
+    }
+}
+
+
+/* Must be called with srv->jobLock held */
+static bool
+virNetServerJobQueueCanRunLocked(virNetServerPtr srv,
+                                 virNetServerJobQueuePtr queue)
+{
+    if (srv->client_workers_max &&
+        queue->nrunning >= srv->client_workers_max)
+        return false;
+
+    if (srv->identity_workers_max && queue->identity &&
+        queue->identity->nrunning >= srv->identity_workers_max)
+        return false;
+
+    return true;
+}
+
+
+/*
+ * Picks the next call to hand to a worker using weighted round robin
+ * across the clients which have calls waiting and are within their limits.
+ * Each client gets to run up to its weight of calls before the next one
+ * takes its turn.
+ *
+ * Must be called with srv->jobLock held.
+ */
+static virNetServerJobPtr
+virNetServerJobQueuePopLocked(virNetServerPtr srv)
+{
+    virNetServerJobQueuePtr queue = srv->jobRing;
+    virNetServerJobQueuePtr first = queue;
+    virNetServerJobPtr job;
+
+    if (!queue)
+        return NULL;
+
+    do {
+        if (virNetServerJobQueueCanRunLocked(srv, queue))
+            break;
+
+        /* Over the limit, the client loses its turn */
+        queue->credit = 0;
+        queue = queue->next;
+    } while (queue != first);
+
+    if (!virNetServerJobQueueCanRunLocked(srv, queue))
+        return NULL;
+
+    job = queue->head;
+    if (!(queue->head = job->next))
+        queue->tail = NULL;
+    job->next = NULL;
+
+    queue->nqueued--;
+    queue->nrunning++;
+    if (queue->identity)
+        queue->identity->nrunning++;
+    srv->njobs_running++;
+
+    if (queue->credit == 0)
+        queue->credit = queue->weight;
+    queue->credit--;
+
+    if (queue->nqueued == 0)
+        virNetServerJobQueueRingRemoveLocked(srv, queue);
+    else if (queue->credit == 0)
+        srv->jobRing = queue->next;
+    else
+        srv->jobRing = queue;
+
+    return job;
+}
+
+
+/* Must be called with srv->jobLock held */
+static void
+virNetServerJobFinishLocked(virNetServerPtr srv,
+                            virNetServerJobQueuePtr queue)
+{
+    queue->nrunning--;
+    if (queue->identity)
+        queue->identity->nrunning--;
+    srv->njobs_running--;
+
+    if (queue->nrunning == 0 && queue->nqueued == 0) {
+        virNetServerJobIdentityPtr identity = queue->identity;
+
+        virHashRemoveEntry(srv->jobQueues, queue->key);
+        if (identity && --identity->refs == 0)
+            virHashRemoveEntry(srv->jobIdentities, identity->name);
+    }
+}
+
+
+/**
+ * virNetServerJobQueuePush:
+ * @srv: server
+ * @id: ID of the client sending the call
+ * @readonly: whether the client is read-only
+ * @identity: name shared by all clients of the same user, or NULL
+ * @job: the call
+ *
+ * Queues @job until virNetServerJobQueuePop picks it. The client details
+ * are looked up by the caller so that no client lock is acquired with
+ * srv->jobLock held.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virNetServerJobQueuePush(virNetServerPtr srv,
+                         unsigned long long id,
+                         bool readonly,
+                         const char *identity,
+                         virNetServerJobPtr job)
+{
+    virNetServerJobQueuePtr queue;
+
+    virMutexLock(&srv->jobLock);
+    if ((queue = virNetServerJobQueueGetLocked(srv, id, readonly, identity)))
+        virNetServerJobQueuePushLocked(srv, queue, job);
+    virMutexUnlock(&srv->jobLock);
+
+    return queue ? 0 : -1;
+}
+
+
+/**
+ * virNetServerJobQueuePop:
+ * @srv: server
+ * @maxRunning: number of calls which may run at once
+ *
+ * Returns the next call to run, or NULL if none of the queued calls may run
+ * until some of those already running finish. The caller has to pass the
+ * call to virNetServerJobFinish once it's done with it.
+ */
+virNetServerJobPtr
+virNetServerJobQueuePop(virNetServerPtr srv,
+                        size_t maxRunning)
+{
+    virNetServerJobPtr job = NULL;
+
+    virMutexLock(&srv->jobLock);
+    if (srv->njobs_running < maxRunning)
+        job = virNetServerJobQueuePopLocked(srv);
+    virMutexUnlock(&srv->jobLock);
+
+    return job;
+}
+
+
+/**
+ * virNetServerJobFinish:
+ * @srv: server
+ * @job: call returned by virNetServerJobQueuePop
+ *
+ * Accounts for @job not running anymore. @job itself is left alone.
+ */
+void
+virNetServerJobFinish(virNetServerPtr srv,
+                      virNetServerJobPtr job)
+{
+    virMutexLock(&srv->jobLock);
+    virNetServerJobFinishLocked(srv, job->queue);
+    virMutexUnlock(&srv->jobLock);
+}
+
+
+/**
+ * virNetServerScheduleJobs:
+ * @srv: server
+ *
+ * Hands calls waiting in the client queues to the workers as long as there
+ * are fewer calls running than workers. Keeping the calls in the client
+ * queues rather than in the thread pool lets a client which is not busy
+ * get a worker before the backlog of a client flooding the server is
+ * dealt with.
+ */
+static void
+virNetServerScheduleJobs(virNetServerPtr srv)
+{
+    size_t maxWorkers = virThreadPoolGetMaxWorkers(srv->workers);
+
+    while (1) {
+        virNetServerJobPtr job;
+
+        if (!(job = virNetServerJobQueuePop(srv, maxWorkers)))
+            return;
+
+        if (virThreadPoolSendJob(srv->workers, 0, job) < 0) {
+            virNetServerJobFinish(srv, job);
+            virNetServerJobDiscard(job);
+        }
+    }
+}
+
+
 static void virNetServerHandleJob(void *jobOpaque, void *opaque)
 {
     virNetServerPtr srv = opaque;
     virNetServerJobPtr job = jobOpaque;
+    bool queued = !!job->queue;
+    int rc;
 
     VIR_DEBUG("server=%p client=%p message=%p prog=%p",
               srv, job->client, job->msg, job->prog);
 
-    if (virNetServerProcessMsg(srv, job->client, job->prog, job->msg) < 0)
-        goto error;
+    rc = virNetServerProcessMsg(srv, job->client, job->prog, job->msg);
 
-    virObjectUnref(job->prog);
-    virObjectUnref(job->client);
-    VIR_FREE(job);
-    return;
+    if (queued)
+        virNetServerJobFinish(srv, job);
 
- error:
-    virObjectUnref(job->prog);
-    virNetMessageFree(job->msg);
-    virNetServerClientClose(job->client);
-    virObjectUnref(job->client);
-    VIR_FREE(job);
+    if (rc < 0) {
+        virNetServerJobDiscard(job);
+    } else {
+        virObjectUnref(job->prog);
+        virObjectUnref(job->client);
+        VIR_FREE(job);
+    }
+
+    if (queued)
+        virNetServerScheduleJobs(srv);
 }
 
 /**
@@ -200,6 +569,8 @@ virNetServerDispatchNewMessage(virNetServerClientPtr client,
     VIR_DEBUG("server=%p client=%p message=%p",
               srv, client, msg);
 
+    msg->queued = g_get_monotonic_time();
+
     virObjectLock(srv);
     prog = virNetServerGetProgramLocked(srv, msg);
     /* we can unlock @srv since @prog can only become invalid in case
@@ -222,11 +593,27 @@ virNetServerDispatchNewMessage(virNetServerClientPtr client,
             priority = virNetServerProgramGetPriority(prog, msg->header.proc);
         }
 
-        if (virThreadPoolSendJob(srv->workers, priority, job) < 0) {
-            virObjectUnref(client);
-            VIR_FREE(job);
-            virObjectUnref(prog);
-            goto error;
+        if (priority) {
+            /* High priority calls go straight to the workers */
+            if (virThreadPoolSendJob(srv->workers, priority, job) < 0) {
+                virObjectUnref(client);
+                VIR_FREE(job);
+                virObjectUnref(prog);
+                goto error;
+            }
+        } else {
+            g_autofree char *name = virNetServerClientGetIdentityName(client);
+
+            if (virNetServerJobQueuePush(srv, virNetServerClientGetID(client),
+                                         virNetServerClientGetReadonly(client),
+                                         name, job) < 0) {
+                virObjectUnref(client);
+                VIR_FREE(job);
+                virObjectUnref(prog);
+                goto error;
+            }
+
+            virNetServerScheduleJobs(srv);
         }
     } else {
         if (virNetServerProcessMsg(srv, client, prog, msg) < 0)
@@ -369,6 +756,17 @@ virNetServerPtr virNetServerNew(const char *name,
     if (!(srv = virObjectLockableNew(virNetServerClass)))
         return NULL;
 
+    if (virMutexInit(&srv->jobLock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Unable to initialize mutex"));
+        goto error;
+    }
+
+    if (!(srv->jobQueues = virHashNew(virNetServerJobQueueFree)) ||
+        !(srv->jobIdentities = virHashNew(virNetServerJobIdentityFree)))
+        goto error;
+    srv->client_rw_weight = 1;
+
     if (!(srv->workers = virThreadPoolNewFull(min_workers, max_workers,
                                               priority_workers,
                                               virNetServerHandleJob,
@@ -914,6 +1312,10 @@ void virNetServerDispose(void *obj)
 
     virThreadPoolFree(srv->workers);
 
+    virHashFree(srv->jobQueues);
+    virHashFree(srv->jobIdentities);
+    virMutexDestroy(&srv->jobLock);
+
     for (i = 0; i < srv->nservices; i++)
         virObjectUnref(srv->services[i]);
     VIR_FREE(srv->services);
@@ -1024,7 +1426,10 @@ virNetServerGetThreadPoolParameters(virNetServerPtr srv,
                                     size_t *nWorkers,
                                     size_t *freeWorkers,
                                     size_t *nPrioWorkers,
-                                    size_t *jobQueueDepth)
+                                    size_t *jobQueueDepth,
+                                    unsigned long long *jobCount,
+                                    unsigned long long *jobWaitTime,
+                                    unsigned long long *jobSteals)
 {
     virObjectLock(srv);
 
@@ -1034,6 +1439,9 @@ virNetServerGetThreadPoolParameters(virNetServerPtr srv,
     *nWorkers = virThreadPoolGetCurrentWorkers(srv->workers);
     *nPrioWorkers = virThreadPoolGetPriorityWorkers(srv->workers);
     *jobQueueDepth = virThreadPoolGetJobQueueDepth(srv->workers);
+    *jobCount = virThreadPoolGetJobCount(srv->workers);
+    *jobWaitTime = virThreadPoolGetJobWaitTime(srv->workers);
+    *jobSteals = virThreadPoolGetJobSteals(srv->workers);
 
     virObjectUnlock(srv);
     return 0;
@@ -1052,6 +1460,10 @@ virNetServerSetThreadPoolParameters(virNetServerPtr srv,
                                      maxWorkers, prioWorkers);
     virObjectUnlock(srv);
 
+    /* More calls may be allowed to run now */
+    if (ret == 0)
+        virNetServerScheduleJobs(srv);
+
     return ret;
 }
 
@@ -1149,6 +1561,35 @@ virNetServerGetClients(virNetServerPtr srv,
     return ret;
 }
 
+int
+virNetServerGetPrograms(virNetServerPtr srv,
+                        virNetServerProgramPtr **progs)
+{
+    int ret = -1;
+    size_t i;
+    size_t nprogs = 0;
+    virNetServerProgramPtr *list = NULL;
+
+    virObjectLock(srv);
+
+    for (i = 0; i < srv->nprograms; i++) {
+        virNetServerProgramPtr prog = virObjectRef(srv->programs[i]);
+        if (VIR_APPEND_ELEMENT(list, nprogs, prog) < 0) {
+            virObjectUnref(prog);
+            goto cleanup;
+        }
+    }
+
+    *progs = list;
+    list = NULL;
+    ret = nprogs;
+
+ cleanup:
+    virObjectListFreeCount(list, nprogs);
+    virObjectUnlock(srv);
+    return ret;
+}
+
 virNetServerClientPtr
 virNetServerGetClient(virNetServerPtr srv,
                       unsigned long long id)
@@ -1208,6 +1649,120 @@ virNetServerSetClientLimits(virNetServerPtr srv,
     return ret;
 }
 
+size_t
+virNetServerGetMaxClientWorkers(virNetServerPtr srv)
+{
+    size_t ret;
+
+    virMutexLock(&srv->jobLock);
+    ret = srv->client_workers_max;
+    virMutexUnlock(&srv->jobLock);
+
+    return ret;
+}
+
+size_t
+virNetServerGetMaxIdentityWorkers(virNetServerPtr srv)
+{
+    size_t ret;
+
+    virMutexLock(&srv->jobLock);
+    ret = srv->identity_workers_max;
+    virMutexUnlock(&srv->jobLock);
+
+    return ret;
+}
+
+unsigned int
+virNetServerGetClientRWWeight(virNetServerPtr srv)
+{
+    unsigned int ret;
+
+    virMutexLock(&srv->jobLock);
+    ret = srv->client_rw_weight;
+    virMutexUnlock(&srv->jobLock);
+
+    return ret;
+}
+
+/**
+ * virNetServerSetClientJobLimits:
+ * @srv: server
+ * @maxClientWorkers: max workers a single client may occupy, 0 for no limit
+ * @maxIdentityWorkers: max workers all clients of one identity may occupy,
+ *                      0 for no limit
+ * @rwWeight: number of calls a read-write client may run in its turn for
+ *            every call of a read-only client
+ *
+ * Negative values leave the respective setting unchanged. The weight only
+ * applies to clients which don't have any call in progress at the time.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virNetServerSetClientJobLimits(virNetServerPtr srv,
+                               long long int maxClientWorkers,
+                               long long int maxIdentityWorkers,
+                               long long int rwWeight)
+{
+    if (rwWeight == 0 || rwWeight > UINT_MAX) {
+        virReportError(VIR_ERR_INVALID_ARG,
+                       _("Read-write client weight must be between 1 and %u"),
+                       UINT_MAX);
+        return -1;
+    }
+
+    virMutexLock(&srv->jobLock);
+
+    if (maxClientWorkers >= 0)
+        srv->client_workers_max = maxClientWorkers;
+
+    if (maxIdentityWorkers >= 0)
+        srv->identity_workers_max = maxIdentityWorkers;
+
+    if (rwWeight > 0)
+        srv->client_rw_weight = rwWeight;
+
+    virMutexUnlock(&srv->jobLock);
+
+    /* Raised limits may allow more calls to run */
+    virNetServerScheduleJobs(srv);
+
+    return 0;
+}
+
+/**
+ * virNetServerGetClientJobs:
+ * @srv: server
+ * @client: client of @srv
+ * @queued: filled with the number of calls waiting for a worker
+ * @running: filled with the number of calls being processed
+ *
+ * High priority calls, which don't wait in the client queue, are not
+ * included in the counts.
+ */
+void
+virNetServerGetClientJobs(virNetServerPtr srv,
+                          virNetServerClientPtr client,
+                          size_t *queued,
+                          size_t *running)
+{
+    g_autofree char *key = NULL;
+    virNetServerJobQueuePtr queue;
+
+    key = g_strdup_printf("%llu", virNetServerClientGetID(client));
+
+    virMutexLock(&srv->jobLock);
+    if ((queue = virHashLookup(srv->jobQueues, key))) {
+        *queued = queue->nqueued;
+        *running = queue->nrunning;
+    } else {
+        *queued = 0;
+        *running = 0;
+    }
+    virMutexUnlock(&srv->jobLock);
+}
+
 static virNetTLSContextPtr
 virNetServerGetTLSContext(virNetServerPtr srv)
 {
@@ -107,7 +107,10 @@ int virNetServerGetThreadPoolParameters(virNetServerPtr srv,
                                         size_t *nWorkers,
                                         size_t *freeWorkers,
                                         size_t *nPrioWorkers,
-                                        size_t *jobQueueDepth);
+                                        size_t *jobQueueDepth,
+                                        unsigned long long *jobCount,
+                                        unsigned long long *jobWaitTime,
+                                        unsigned long long *jobSteals);
 
 int virNetServerSetThreadPoolParameters(virNetServerPtr srv,
                                         long long int minWorkers,
@@ -125,6 +128,9 @@ bool virNetServerNeedsAuth(virNetServerPtr srv,
 int virNetServerGetClients(virNetServerPtr srv,
                            virNetServerClientPtr **clients);
 
+int virNetServerGetPrograms(virNetServerPtr srv,
+                            virNetServerProgramPtr **progs);
+
 size_t virNetServerGetMaxClients(virNetServerPtr srv);
 size_t virNetServerGetCurrentClients(virNetServerPtr srv);
 size_t virNetServerGetMaxUnauthClients(virNetServerPtr srv);
@@ -134,4 +140,18 @@ int virNetServerSetClientLimits(virNetServerPtr srv,
                                 long long int maxClients,
                                 long long int maxClientsUnauth);
 
+size_t virNetServerGetMaxClientWorkers(virNetServerPtr srv);
+size_t virNetServerGetMaxIdentityWorkers(virNetServerPtr srv);
+unsigned int virNetServerGetClientRWWeight(virNetServerPtr srv);
+
+int virNetServerSetClientJobLimits(virNetServerPtr srv,
+                                   long long int maxClientWorkers,
+                                   long long int maxIdentityWorkers,
+                                   long long int rwWeight);
+
+void virNetServerGetClientJobs(virNetServerPtr srv,
+                               virNetServerClientPtr client,
+                               size_t *queued,
+                               size_t *running);
+
 int virNetServerUpdateTlsFiles(virNetServerPtr srv);
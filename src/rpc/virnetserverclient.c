@@ -81,6 +81,9 @@ struct _virNetServerClient
 
 
     virIdentityPtr identity;
+    /* Name shared by all clients of one user, see
+     * virNetServerClientGetIdentityName */
+    char *identityName;
 
     /* Connection timestamp, i.e. when a client connected to the daemon (UTC).
      * For old clients restored by post-exec-restart, which did not have this
@@ -310,11 +313,7 @@ virNetServerClientCheckAccess(virNetServerClientPtr client)
      * indicate this (otherwise the socket is abruptly closed).
      * (NB. The '\1' byte is sent in an encrypted record).
      */
-    confirm->bufferLength = 1;
-    if (VIR_ALLOC_N(confirm->buffer, confirm->bufferLength) < 0) {
-        virNetMessageFree(confirm);
-        return -1;
-    }
+    virNetMessageResizeBuffer(confirm, 1);
     confirm->bufferOffset = 0;
     confirm->buffer[0] = '\1';
 
@@ -413,9 +412,7 @@ virNetServerClientNewInternal(unsigned long long id,
     /* Prepare one for packet receive */
     if (!(client->rx = virNetMessageNew(true)))
         goto error;
-    client->rx->bufferLength = VIR_NET_MESSAGE_LEN_MAX;
-    if (VIR_ALLOC_N(client->rx->buffer, client->rx->bufferLength) < 0)
-        goto error;
+    virNetMessageResizeBuffer(client->rx, VIR_NET_MESSAGE_LEN_MAX);
     client->nrequests = 1;
 
     PROBE(RPC_SERVER_CLIENT_NEW,
@@ -837,6 +834,7 @@ void virNetServerClientSetIdentity(virNetServerClientPtr client,
 {
     virObjectLock(client);
     g_clear_object(&client->identity);
+    VIR_FREE(client->identityName);
     client->identity = identity;
     if (client->identity)
         g_object_ref(client->identity);
@@ -844,6 +842,52 @@ void virNetServerClientSetIdentity(virNetServerClientPtr client,
 }
 
 
+/**
+ * virNetServerClientGetIdentityName:
+ * @client: the client
+ *
+ * Returns a name shared by all clients authenticated as the same user,
+ * that is the X.509 DN, the SASL user name or the UNIX user ID, or NULL
+ * if there's nothing to identify @client by. The SASL user name is only
+ * known once the client authenticated, so the name is computed and cached
+ * for the lifetime of the client the first time it's asked for after
+ * that. The caller must free the returned string.
+ */
+char *virNetServerClientGetIdentityName(virNetServerClientPtr client)
+{
+    char *ret = NULL;
+
+    virObjectLock(client);
+
+    if (!client->identityName &&
+        virNetServerClientAuthMethodImpliesAuthenticated(client->auth)) {
+        const char *name;
+        uid_t uid;
+
+        if (!client->identity)
+            client->identity = virNetServerClientCreateIdentity(client);
+
+        if (!client->identity)
+            goto cleanup;
+
+        if (virIdentityGetX509DName(client->identity, &name) == 1)
+            client->identityName = g_strdup_printf("x509:%s", name);
+        else if (virIdentityGetSASLUserName(client->identity, &name) == 1)
+            client->identityName = g_strdup_printf("sasl:%s", name);
+        else if (virIdentityGetUNIXUserID(client->identity, &uid) == 1)
+            client->identityName = g_strdup_printf("uid:%llu",
+                                                   (unsigned long long) uid);
+    }
+
+    ret = g_strdup(client->identityName);
+
+ cleanup:
+    virObjectUnlock(client);
+
+    return ret;
+}
+
+
 int virNetServerClientGetSELinuxContext(virNetServerClientPtr client,
                                         char **context)
 {
@@ -977,6 +1021,7 @@ void virNetServerClientDispose(void *obj)
         client->privateDataFreeFunc(client->privateData);
 
     g_clear_object(&client->identity);
+    g_free(client->identityName);
 
 #if WITH_SASL
     virObjectUnref(client->sasl);
@@ -1107,7 +1152,7 @@ int virNetServerClientInit(virNetServerClientPtr client)
         int ret;
 
         if (!(client->tls = virNetTLSSessionNew(client->tlsCtxt,
-                                                NULL)))
+                                                NULL, NULL)))
             goto error;
 
         virNetSocketSetTLSSession(client->sock,
@@ -1305,13 +1350,8 @@ static virNetMessagePtr virNetServerClientDispatchRead(virNetServerClientPtr cli
             if (!(client->rx = virNetMessageNew(true))) {
                 client->wantClose = true;
             } else {
-                client->rx->bufferLength = VIR_NET_MESSAGE_LEN_MAX;
-                if (VIR_ALLOC_N(client->rx->buffer,
-                                client->rx->bufferLength) < 0) {
-                    client->wantClose = true;
-                } else {
-                    client->nrequests++;
-                }
+                virNetMessageResizeBuffer(client->rx, VIR_NET_MESSAGE_LEN_MAX);
+                client->nrequests++;
             }
         }
         virNetServerClientUpdateEvent(client);
@@ -1324,6 +1364,12 @@ static virNetMessagePtr virNetServerClientDispatchRead(virNetServerClientPtr cli
 /*
  * Send client->tx using no encoding
  *
+ * Messages queued behind client->tx are written with the same
+ * system call, up to the first one which passes FDs as those
+ * have to follow the message data on the socket. Nothing is
+ * batched while a SASL layer is pending as it takes effect
+ * right after client->tx has been sent.
+ *
  * Returns:
  *   -1 on error or EOF
  *    0 on EAGAIN
@@ -1331,6 +1377,10 @@ static virNetMessagePtr virNetServerClientDispatchRead(virNetServerClientPtr cli
  */
 static ssize_t virNetServerClientWrite(virNetServerClientPtr client)
 {
+    GOutputVector vec[VIR_NET_SOCKET_WRITEV_MAX];
+    size_t nvec = 0;
+    virNetMessagePtr msg;
+    size_t done;
     ssize_t ret;
 
     if (client->tx->bufferLength < client->tx->bufferOffset) {
@@ -1344,13 +1394,32 @@ static ssize_t virNetServerClientWrite(virNetServerClientPtr client)
     if (client->tx->bufferLength == client->tx->bufferOffset)
         return 1;
 
-    ret = virNetSocketWrite(client->sock,
-                            client->tx->buffer + client->tx->bufferOffset,
-                            client->tx->bufferLength - client->tx->bufferOffset);
+    for (msg = client->tx; msg && nvec < G_N_ELEMENTS(vec); msg = msg->next) {
+        if (msg->bufferOffset < msg->bufferLength) {
+            vec[nvec].buffer = msg->buffer + msg->bufferOffset;
+            vec[nvec].size = msg->bufferLength - msg->bufferOffset;
+            nvec++;
+        }
+
+        if (msg->nfds)
+            break;
+#if WITH_SASL
+        if (client->sasl)
+            break;
+#endif
+    }
+
+    ret = virNetSocketWritev(client->sock, vec, nvec);
     if (ret <= 0)
         return ret; /* -1 error, 0 = egain */
 
-    client->tx->bufferOffset += ret;
+    for (msg = client->tx, done = ret; msg && done; msg = msg->next) {
+        size_t len = MIN(done, msg->bufferLength - msg->bufferOffset);
+
+        msg->bufferOffset += len;
+        done -= len;
+    }
+
     return ret;
 }
 
@@ -1410,11 +1479,7 @@ virNetServerClientDispatchWrite(virNetServerClientPtr client)
                     client->nrequests < client->nrequests_max) {
                     /* Ready to recv more messages */
                     virNetMessageClear(msg);
-                    msg->bufferLength = VIR_NET_MESSAGE_LEN_MAX;
-                    if (VIR_ALLOC_N(msg->buffer, msg->bufferLength) < 0) {
-                        virNetMessageFree(msg);
-                        return;
-                    }
+                    virNetMessageResizeBuffer(msg, VIR_NET_MESSAGE_LEN_MAX);
                     client->rx = msg;
                     msg = NULL;
                     client->nrequests++;
@@ -128,6 +128,7 @@ int virNetServerClientGetSELinuxContext(virNetServerClientPtr client,
 virIdentityPtr virNetServerClientGetIdentity(virNetServerClientPtr client);
 void virNetServerClientSetIdentity(virNetServerClientPtr client,
                                    virIdentityPtr identity);
+char *virNetServerClientGetIdentityName(virNetServerClientPtr client);
 
 void *virNetServerClientGetPrivateData(virNetServerClientPtr client);
 
@@ -0,0 +1,53 @@
+/*
+ * virnetserverpriv.h: generic network RPC server, internals for tests
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBVIRT_VIRNETSERVERPRIV_H_ALLOW
+# error "virnetserverpriv.h may only be included by virnetserver.c or test suites"
+#endif /* LIBVIRT_VIRNETSERVERPRIV_H_ALLOW */
+
+#pragma once
+
+#include "virnetserver.h"
+
+typedef struct _virNetServerJob virNetServerJob;
+typedef virNetServerJob *virNetServerJobPtr;
+
+typedef struct _virNetServerJobQueue virNetServerJobQueue;
+typedef virNetServerJobQueue *virNetServerJobQueuePtr;
+
+struct _virNetServerJob {
+    virNetServerClientPtr client;
+    virNetMessagePtr msg;
+    virNetServerProgramPtr prog;
+
+    /* NULL for high priority calls which bypass the client queues */
+    virNetServerJobQueuePtr queue;
+    virNetServerJobPtr next;
+};
+
+int virNetServerJobQueuePush(virNetServerPtr srv,
+                             unsigned long long id,
+                             bool readonly,
+                             const char *identity,
+                             virNetServerJobPtr job);
+
+virNetServerJobPtr virNetServerJobQueuePop(virNetServerPtr srv,
+                                           size_t maxRunning);
+
+void virNetServerJobFinish(virNetServerPtr srv,
+                           virNetServerJobPtr job);
@@ -22,6 +22,8 @@
 #include <config.h>
 
 #include "virnetserverprogram.h"
+#define LIBVIRT_VIRNETSERVERPROGRAMPRIV_H_ALLOW
+#include "virnetserverprogrampriv.h"
 #include "virnetserverclient.h"
 
 #include "viralloc.h"
@@ -39,8 +41,12 @@ struct _virNetServerProgram {
 
     unsigned program;
     unsigned version;
+    char *name;
     virNetServerProgramProcPtr procs;
     size_t nprocs;
+
+    virMutex statsLock;
+    virNetServerProgramProcStatsPtr *stats; /* @nprocs, allocated on demand */
 };
 
 
@@ -60,6 +66,7 @@ VIR_ONCE_GLOBAL_INIT(virNetServerProgram);
 
 virNetServerProgramPtr virNetServerProgramNew(unsigned program,
                                               unsigned version,
+                                              const char *name,
                                               virNetServerProgramProcPtr procs,
                                               size_t nprocs)
 {
@@ -71,10 +78,19 @@ virNetServerProgramPtr virNetServerProgramNew(unsigned program,
     if (!(prog = virObjectNew(virNetServerProgramClass)))
         return NULL;
 
+    if (virMutexInit(&prog->statsLock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Unable to initialize mutex"));
+        virObjectUnref(prog);
+        return NULL;
+    }
+
     prog->program = program;
     prog->version = version;
+    prog->name = g_strdup(name);
     prog->procs = procs;
     prog->nprocs = nprocs;
+    prog->stats = g_new0(virNetServerProgramProcStatsPtr, nprocs);
 
     VIR_DEBUG("prog=%p", prog);
 
@@ -94,6 +110,18 @@ int virNetServerProgramGetVersion(virNetServerProgramPtr prog)
 }
 
 
+const char *virNetServerProgramGetName(virNetServerProgramPtr prog)
+{
+    return prog->name;
+}
+
+
+size_t virNetServerProgramGetNProcs(virNetServerProgramPtr prog)
+{
+    return prog->nprocs;
+}
+
+
 int virNetServerProgramMatches(virNetServerProgramPtr prog,
                                virNetMessagePtr msg)
 {
@@ -134,6 +162,93 @@ virNetServerProgramGetPriority(virNetServerProgramPtr prog,
     return proc->priority;
 }
 
+
+const char *
+virNetServerProgramGetProcName(virNetServerProgramPtr prog,
+                               int procedure)
+{
+    virNetServerProgramProcPtr proc = virNetServerProgramGetProc(prog, procedure);
+
+    if (!proc)
+        return NULL;
+
+    return proc->name;
+}
+
+
+static size_t
+virNetServerProgramStatsBucket(gint64 usec)
+{
+    if (usec <= 0)
+        return 0;
+
+    if (usec >= 1LL << (VIR_NET_SERVER_PROGRAM_STATS_BUCKETS - 2))
+        return VIR_NET_SERVER_PROGRAM_STATS_BUCKETS - 1;
+
+    return g_bit_storage(usec);
+}
+
+
+/*
+ * Accounts a call of @procedure which was queued at @queued, picked up by
+ * a worker at @start and finished at @end. All times are in microseconds
+ * of the monotonic clock; @queued is 0 if unknown.
+ */
+void
+virNetServerProgramRecordCall(virNetServerProgramPtr prog,
+                              int procedure,
+                              gint64 queued,
+                              gint64 start,
+                              gint64 end)
+{
+    virNetServerProgramProcStatsPtr stats;
+    gint64 wait = queued > 0 ? start - queued : 0;
+    gint64 exec = end - start;
+
+    virMutexLock(&prog->statsLock);
+
+    if (!(stats = prog->stats[procedure]))
+        stats = prog->stats[procedure] = g_new0(virNetServerProgramProcStats, 1);
+
+    stats->calls++;
+    stats->waitTotal += MAX(wait, 0);
+    stats->wait[virNetServerProgramStatsBucket(wait)]++;
+    stats->execTotal += MAX(exec, 0);
+    stats->exec[virNetServerProgramStatsBucket(exec)]++;
+
+    virMutexUnlock(&prog->statsLock);
+}
+
+
+/**
+ * virNetServerProgramGetProcStats:
+ * @prog: the program
+ * @procedure: procedure number
+ * @stats: filled with the statistics of @procedure
+ *
+ * Returns true if @procedure was called at least once and @stats was
+ * filled, false otherwise.
+ */
+bool
+virNetServerProgramGetProcStats(virNetServerProgramPtr prog,
+                                int procedure,
+                                virNetServerProgramProcStatsPtr stats)
+{
+    bool ret = false;
+
+    if (procedure < 0 || procedure >= prog->nprocs)
+        return false;
+
+    virMutexLock(&prog->statsLock);
+    if (prog->stats[procedure]) {
+        *stats = *prog->stats[procedure];
+        ret = true;
+    }
+    virMutexUnlock(&prog->statsLock);
+
+    return ret;
+}
+
 static int
 virNetServerProgramSendError(unsigned program,
                              unsigned version,
@@ -368,10 +483,13 @@ virNetServerProgramDispatchCall(virNetServerProgramPtr prog,
     g_autofree char *arg = NULL;
     g_autofree char *ret = NULL;
     int rv = -1;
-    virNetServerProgramProcPtr dispatcher;
+    virNetServerProgramProcPtr dispatcher = NULL;
     virNetMessageError rerr;
     size_t i;
     g_autoptr(virIdentity) identity = NULL;
+    gint64 queued = msg->queued;
+    gint64 start = g_get_monotonic_time();
+    int procedure = msg->header.proc;
 
     memset(&rerr, 0, sizeof(rerr));
 
@@ -480,10 +598,17 @@ virNetServerProgramDispatchCall(virNetServerProgramPtr prog,
 
     xdr_free(dispatcher->ret_filter, ret);
 
+    virNetServerProgramRecordCall(prog, procedure, queued, start,
+                                  g_get_monotonic_time());
+
     /* Put reply on end of tx queue to send out  */
     return virNetServerClientSendMessage(client, msg);
 
  error:
+    if (dispatcher)
+        virNetServerProgramRecordCall(prog, procedure, queued, start,
+                                      g_get_monotonic_time());
+
     /* Bad stuff (de-)serializing message, but we have an
      * RPC error message we can send back to the client */
     rv = virNetServerProgramSendReplyError(prog, client, msg, &rerr, &msg->header);
@@ -569,6 +694,14 @@ int virNetServerProgramSendStreamHole(virNetServerProgramPtr prog,
 }
 
 
-void virNetServerProgramDispose(void *obj G_GNUC_UNUSED)
+void virNetServerProgramDispose(void *obj)
 {
+    virNetServerProgramPtr prog = obj;
+    size_t i;
+
+    for (i = 0; i < prog->nprocs && prog->stats; i++)
+        g_free(prog->stats[i]);
+    g_free(prog->stats);
+    g_free(prog->name);
+    virMutexDestroy(&prog->statsLock);
 }
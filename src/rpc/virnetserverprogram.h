@@ -52,15 +52,45 @@ struct _virNetServerProgramProc {
     xdrproc_t ret_filter;
     bool needAuth;
     unsigned int priority;
+    const char *name;
+};
+
+/* Bucket 0 counts calls which took less than 1us, bucket N calls which took
+ * at least 2^(N-1)us but less than 2^N us and the last bucket counts all
+ * longer calls. */
+#define VIR_NET_SERVER_PROGRAM_STATS_BUCKETS 26
+
+typedef struct _virNetServerProgramProcStats virNetServerProgramProcStats;
+typedef virNetServerProgramProcStats *virNetServerProgramProcStatsPtr;
+
+struct _virNetServerProgramProcStats {
+    unsigned long long calls;
+
+    /* Time between receiving a call and a worker picking it up */
+    unsigned long long waitTotal;
+    unsigned long long wait[VIR_NET_SERVER_PROGRAM_STATS_BUCKETS];
+
+    /* Time spent processing a call by a worker */
+    unsigned long long execTotal;
+    unsigned long long exec[VIR_NET_SERVER_PROGRAM_STATS_BUCKETS];
 };
 
 virNetServerProgramPtr virNetServerProgramNew(unsigned program,
                                               unsigned version,
+                                              const char *name,
                                               virNetServerProgramProcPtr procs,
                                               size_t nprocs);
 
 int virNetServerProgramGetID(virNetServerProgramPtr prog);
 int virNetServerProgramGetVersion(virNetServerProgramPtr prog);
+const char *virNetServerProgramGetName(virNetServerProgramPtr prog);
+
+size_t virNetServerProgramGetNProcs(virNetServerProgramPtr prog);
+const char *virNetServerProgramGetProcName(virNetServerProgramPtr prog,
+                                           int procedure);
+bool virNetServerProgramGetProcStats(virNetServerProgramPtr prog,
+                                     int procedure,
+                                     virNetServerProgramProcStatsPtr stats);
 
 unsigned int virNetServerProgramGetPriority(virNetServerProgramPtr prog,
                                             int procedure);
@@ -25,6 +25,9 @@
 #include <unistd.h>
 #include <signal.h>
 #include <fcntl.h>
+#ifndef WIN32
+# include <sys/uio.h>
+#endif
 #ifdef HAVE_IFADDRS_H
 # include <ifaddrs.h>
 #endif
@@ -86,6 +89,8 @@ struct _virNetSocket {
     char *remoteAddrStrURI;
 
     virNetTLSSessionPtr tlsSession;
+    bool tlsKernelChecked;
+    bool tlsKernelTX; /* the kernel encrypts data written to @fd */
 #if WITH_SASL
     virNetSASLSessionPtr saslSession;
 
@@ -1700,6 +1705,8 @@ void virNetSocketSetTLSSession(virNetSocketPtr sock,
     virObjectLock(sock);
     virObjectUnref(sock->tlsSession);
     sock->tlsSession = virObjectRef(sess);
+    sock->tlsKernelChecked = false;
+    sock->tlsKernelTX = false;
     virNetTLSSessionSetIOCallbacks(sess,
                                    virNetSocketTLSSessionWrite,
                                    virNetSocketTLSSessionRead,
@@ -1857,6 +1864,29 @@ static ssize_t virNetSocketReadWire(virNetSocketPtr sock, char *buf, size_t len)
     return ret;
 }
 
+/*
+ * Returns true if data written to the socket has to be passed
+ * through the TLS session. Right after the handshake the kernel
+ * is given the chance to take over encryption, which makes plain
+ * writes to the socket possible again.
+ */
+static bool virNetSocketTLSWriteActive(virNetSocketPtr sock)
+{
+    if (!sock->tlsSession ||
+        virNetTLSSessionGetHandshakeStatus(sock->tlsSession) !=
+        VIR_NET_TLS_HANDSHAKE_COMPLETE)
+        return false;
+
+    if (!sock->tlsKernelChecked) {
+        sock->tlsKernelChecked = true;
+        sock->tlsKernelTX = virNetTLSSessionSetKernelOffload(sock->tlsSession,
+                                                             sock->fd) > 0;
+    }
+
+    return !sock->tlsKernelTX;
+}
+
+
 static ssize_t virNetSocketWriteWire(virNetSocketPtr sock, const char *buf, size_t len)
 {
     ssize_t ret;
@@ -1872,9 +1902,7 @@ static ssize_t virNetSocketWriteWire(virNetSocketPtr sock, const char *buf, size
 #endif
 
  rewrite:
-    if (sock->tlsSession &&
-        virNetTLSSessionGetHandshakeStatus(sock->tlsSession) ==
-        VIR_NET_TLS_HANDSHAKE_COMPLETE) {
+    if (virNetSocketTLSWriteActive(sock)) {
         ret = virNetTLSSessionWrite(sock->tlsSession, buf, len);
     } else {
         ret = write(sock->fd, buf, len);
@@ -1900,6 +1928,53 @@ static ssize_t virNetSocketWriteWire(virNetSocketPtr sock, const char *buf, size
 }
 
 
+/*
+ * Writes several buffers with a single system call. Only usable when
+ * the data goes to the socket unmodified, see virNetSocketWritev.
+ */
+static ssize_t virNetSocketWritevWire(virNetSocketPtr sock,
+                                      const GOutputVector *vec,
+                                      size_t nvec)
+{
+#ifndef WIN32
+    struct iovec iov[VIR_NET_SOCKET_WRITEV_MAX];
+    ssize_t ret;
+    size_t i;
+
+    if (nvec > VIR_NET_SOCKET_WRITEV_MAX)
+        nvec = VIR_NET_SOCKET_WRITEV_MAX;
+
+    for (i = 0; i < nvec; i++) {
+        iov[i].iov_base = (void *)vec[i].buffer;
+        iov[i].iov_len = vec[i].size;
+    }
+
+ rewrite:
+    ret = writev(sock->fd, iov, nvec);
+
+    if (ret < 0) {
+        if (errno == EINTR)
+            goto rewrite;
+        if (errno == EAGAIN)
+            return 0;
+
+        virReportSystemError(errno, "%s",
+                             _("Cannot write data"));
+        return -1;
+    }
+    if (ret == 0) {
+        virReportSystemError(EIO, "%s",
+                             _("End of file while writing data"));
+        return -1;
+    }
+
+    return ret;
+#else /* WIN32 */
+    return virNetSocketWriteWire(sock, vec[0].buffer, vec[0].size);
+#endif /* WIN32 */
+}
+
+
 #if WITH_SASL
 static ssize_t virNetSocketReadSASL(virNetSocketPtr sock, char *buf, size_t len)
 {
@@ -2037,6 +2112,83 @@ ssize_t virNetSocketWrite(virNetSocketPtr sock, const char *buf, size_t len)
 }
 
 
+/**
+ * virNetSocketWritev:
+ * @sock: the socket
+ * @vec: the buffers to write
+ * @nvec: number of elements in @vec
+ *
+ * Writes the contents of @vec in order, like virNetSocketWrite does
+ * for a single buffer. Data that goes to the socket as is, including
+ * TLS encrypted by the kernel, is written with a single writev() call
+ * of at most VIR_NET_SOCKET_WRITEV_MAX buffers, while gnutls, SASL
+ * and SSH sessions get the buffers one at a time as they frame each
+ * write on their own.
+ *
+ * Returns the number of bytes written, which may end in the middle of
+ * any buffer, 0 if the write would block, or -1 on error
+ */
+ssize_t virNetSocketWritev(virNetSocketPtr sock,
+                           const GOutputVector *vec,
+                           size_t nvec)
+{
+    ssize_t ret = 0;
+    bool framed = false;
+    size_t i;
+
+    if (nvec == 0)
+        return 0;
+
+    virObjectLock(sock);
+    if (virNetSocketTLSWriteActive(sock))
+        framed = true;
+#if WITH_SASL
+    if (sock->saslSession)
+        framed = true;
+#endif
+#if WITH_SSH2
+    if (sock->sshSession)
+        framed = true;
+#endif
+#if WITH_LIBSSH
+    if (sock->libsshSession)
+        framed = true;
+#endif
+
+    if (!framed) {
+        ret = virNetSocketWritevWire(sock, vec, nvec);
+        goto cleanup;
+    }
+
+    for (i = 0; i < nvec; i++) {
+        ssize_t rv;
+
+        if (vec[i].size == 0)
+            continue;
+
+#if WITH_SASL
+        if (sock->saslSession)
+            rv = virNetSocketWriteSASL(sock, vec[i].buffer, vec[i].size);
+        else
+#endif
+            rv = virNetSocketWriteWire(sock, vec[i].buffer, vec[i].size);
+
+        if (rv < 0) {
+            ret = -1;
+            break;
+        }
+
+        ret += rv;
+        if ((size_t)rv < vec[i].size)
+            break;
+    }
+
+ cleanup:
+    virObjectUnlock(sock);
+    return ret;
+}
+
+
 /*
  * Returns 1 if an FD was sent, 0 if it would block, -1 on error
  */
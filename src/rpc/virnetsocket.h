@@ -147,6 +147,13 @@ void virNetSocketSetQuietEOF(virNetSocketPtr sock);
 ssize_t virNetSocketRead(virNetSocketPtr sock, char *buf, size_t len);
 ssize_t virNetSocketWrite(virNetSocketPtr sock, const char *buf, size_t len);
 
+/* Most buffers virNetSocketWritev writes with one system call */
+#define VIR_NET_SOCKET_WRITEV_MAX 16
+
+ssize_t virNetSocketWritev(virNetSocketPtr sock,
+                           const GOutputVector *vec,
+                           size_t nvec);
+
 int virNetSocketSendFD(virNetSocketPtr sock, int fd);
 int virNetSocketRecvFD(virNetSocketPtr sock, int *fd);
 
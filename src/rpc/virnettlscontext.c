@@ -26,6 +26,21 @@
 #include <gnutls/crypto.h>
 #include <gnutls/x509.h>
 
+#if defined(__linux__) && HAVE_LINUX_TLS_H && GNUTLS_VERSION_NUMBER >= 0x030400
+# include <sys/socket.h>
+# include <netinet/in.h>
+# include <netinet/tcp.h>
+# include <linux/tls.h>
+# define WITH_KERNEL_TLS 1
+
+# ifndef SOL_TLS
+#  define SOL_TLS 282
+# endif
+# ifndef TCP_ULP
+#  define TCP_ULP 31
+# endif
+#endif
+
 #include "virnettlscontext.h"
 #include "virstring.h"
 
@@ -36,10 +51,14 @@
 #include "virlog.h"
 #include "virprobe.h"
 #include "virthread.h"
+#include "virhash.h"
 #include "configmake.h"
 
 #define DH_BITS 2048
 
+/* Most servers whose session data a client remembers */
+#define VIR_NET_TLS_SESSION_CACHE_MAX 64
+
 #define LIBVIRT_PKI_DIR SYSCONFDIR "/pki"
 #define LIBVIRT_CACERT LIBVIRT_PKI_DIR "/CA/cacert.pem"
 #define LIBVIRT_CACRL LIBVIRT_PKI_DIR "/CA/cacrl.pem"
@@ -62,6 +81,14 @@ struct _virNetTLSContext {
     bool requireValidCert;
     const char *const *x509dnACL;
     char *priority;
+
+    /* Identifies the credentials in the client session cache */
+    char *cacheID;
+
+    /* Server session tickets */
+    unsigned int ticketKeyRotation;
+    gint64 ticketKeyCreated;
+    gnutls_datum_t ticketKey;
 };
 
 struct _virNetTLSSession {
@@ -71,6 +98,7 @@ struct _virNetTLSSession {
 
     bool isServer;
     char *hostname;
+    char *cacheKey;
     gnutls_session_t session;
     virNetTLSSessionWriteFunc writeFunc;
     virNetTLSSessionReadFunc readFunc;
@@ -83,6 +111,12 @@ static virClassPtr virNetTLSSessionClass;
 static void virNetTLSContextDispose(void *obj);
 static void virNetTLSSessionDispose(void *obj);
 
+/* Data of the last session with each server, so that clients making
+ * many short connections can resume them instead of going through a
+ * full handshake each time. Keyed by the credentials and hostname. */
+static virMutex virNetTLSSessionCacheLock = VIR_MUTEX_INITIALIZER;
+static virHashTablePtr virNetTLSSessionCache;
+
 
 static int virNetTLSContextOnceInit(void)
 {
@@ -691,6 +725,9 @@ static virNetTLSContextPtr virNetTLSContextNew(const char *cacert,
         return NULL;
 
     ctxt->priority = g_strdup(priority);
+    ctxt->cacheID = g_strdup_printf("%s|%s|%s|%s", NULLSTR(cacert),
+                                    NULLSTR(cert), NULLSTR(key),
+                                    NULLSTR(priority));
 
     err = gnutls_certificate_allocate_credentials(&ctxt->x509cred);
     if (err) {
@@ -1141,6 +1178,98 @@ int virNetTLSContextCheckCertificate(virNetTLSContextPtr ctxt,
     return ret;
 }
 
+static void
+virNetTLSContextFreeTicketKey(gnutls_datum_t *key)
+{
+    if (!key->data)
+        return;
+
+    memset(key->data, 0, key->size);
+    gnutls_free(key->data);
+    key->data = NULL;
+    key->size = 0;
+}
+
+
+/* Must be called with @ctxt locked */
+static int
+virNetTLSContextRotateTicketKey(virNetTLSContextPtr ctxt)
+{
+    gnutls_datum_t key = { NULL, 0 };
+    int err;
+
+    if ((err = gnutls_session_ticket_key_generate(&key)) < 0) {
+        virReportError(VIR_ERR_SYSTEM_ERROR,
+                       _("Unable to generate TLS session ticket key: %s"),
+                       gnutls_strerror(err));
+        return -1;
+    }
+
+    virNetTLSContextFreeTicketKey(&ctxt->ticketKey);
+    ctxt->ticketKey = key;
+    ctxt->ticketKeyCreated = g_get_monotonic_time();
+
+    return 0;
+}
+
+
+/**
+ * virNetTLSContextSetTicketKeyRotation:
+ * @ctxt: the server TLS context
+ * @seconds: how often to replace the session ticket key
+ *
+ * Lets clients resume their sessions with the servers using @ctxt
+ * with a session ticket, which skips the certificate exchange and
+ * key agreement of a full handshake. The key protecting the tickets
+ * is replaced every @seconds, which also bounds how long a ticket
+ * can be used for: gnutls accepts only a single key, so tickets
+ * issued before the rotation fall back to a full handshake.
+ * Passing 0 disables session tickets.
+ *
+ * Returns 0 on success, -1 on error
+ */
+int virNetTLSContextSetTicketKeyRotation(virNetTLSContextPtr ctxt,
+                                         unsigned int seconds)
+{
+    int ret = -1;
+
+    virObjectLock(ctxt);
+
+    if (!ctxt->isServer) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Session tickets can only be issued by a server"));
+        goto cleanup;
+    }
+
+    if (seconds == 0) {
+        virNetTLSContextFreeTicketKey(&ctxt->ticketKey);
+    } else if (!ctxt->ticketKey.data &&
+               virNetTLSContextRotateTicketKey(ctxt) < 0) {
+        goto cleanup;
+    }
+
+    ctxt->ticketKeyRotation = seconds;
+    ret = 0;
+
+ cleanup:
+    virObjectUnlock(ctxt);
+    return ret;
+}
+
+
+static void
+virNetTLSSessionCacheDataFree(void *opaque)
+{
+    gnutls_datum_t *data = opaque;
+
+    if (!data)
+        return;
+
+    gnutls_free(data->data);
+    g_free(data);
+}
+
+
 void virNetTLSContextDispose(void *obj)
 {
     virNetTLSContextPtr ctxt = obj;
@@ -1149,6 +1278,8 @@ void virNetTLSContextDispose(void *obj)
           "ctxt=%p", ctxt);
 
     VIR_FREE(ctxt->priority);
+    VIR_FREE(ctxt->cacheID);
+    virNetTLSContextFreeTicketKey(&ctxt->ticketKey);
     gnutls_dh_params_deinit(ctxt->dhParams);
     gnutls_certificate_free_credentials(ctxt->x509cred);
 }
@@ -1183,14 +1314,15 @@ virNetTLSSessionPull(void *opaque, void *buf, size_t len)
 
 
 virNetTLSSessionPtr virNetTLSSessionNew(virNetTLSContextPtr ctxt,
-                                        const char *hostname)
+                                        const char *hostname,
+                                        const char *service)
 {
     virNetTLSSessionPtr sess;
     int err;
     const char *priority;
 
-    VIR_DEBUG("ctxt=%p hostname=%s isServer=%d",
-              ctxt, NULLSTR(hostname), ctxt->isServer);
+    VIR_DEBUG("ctxt=%p hostname=%s service=%s isServer=%d",
+              ctxt, NULLSTR(hostname), NULLSTR(service), ctxt->isServer);
 
     if (!(sess = virObjectLockableNew(virNetTLSSessionClass)))
         return NULL;
@@ -1234,6 +1366,42 @@ virNetTLSSessionPtr virNetTLSSessionNew(virNetTLSContextPtr ctxt,
         gnutls_certificate_server_set_request(sess->session, GNUTLS_CERT_REQUEST);
 
         gnutls_dh_set_prime_bits(sess->session, DH_BITS);
+
+        virObjectLock(ctxt);
+        if (ctxt->ticketKey.data &&
+            g_get_monotonic_time() - ctxt->ticketKeyCreated >=
+            (gint64) ctxt->ticketKeyRotation * G_USEC_PER_SEC &&
+            virNetTLSContextRotateTicketKey(ctxt) < 0) {
+            /* Keep using the current key */
+            VIR_WARN("%s", virGetLastErrorMessage());
+            virResetLastError();
+        }
+
+        if (ctxt->ticketKey.data &&
+            (err = gnutls_session_ticket_enable_server(sess->session,
+                                                       &ctxt->ticketKey)) != 0) {
+            virObjectUnlock(ctxt);
+            virReportError(VIR_ERR_SYSTEM_ERROR,
+                           _("Failed to enable TLS session tickets: %s"),
+                           gnutls_strerror(err));
+            goto error;
+        }
+        virObjectUnlock(ctxt);
+    } else if (hostname) {
+        gnutls_datum_t *data;
+
+        /* Different ports of one host may be different servers */
+        sess->cacheKey = g_strdup_printf("%s|%s|%s", ctxt->cacheID,
+                                         hostname, NULLSTR_EMPTY(service));
+
+        virMutexLock(&virNetTLSSessionCacheLock);
+        if (virNetTLSSessionCache &&
+            (data = virHashLookup(virNetTLSSessionCache, sess->cacheKey))) {
+            /* A stale entry just results in a full handshake */
+            if (gnutls_session_set_data(sess->session, data->data, data->size) < 0)
+                VIR_DEBUG("Unable to resume previous session with %s", hostname);
+        }
+        virMutexUnlock(&virNetTLSSessionCacheLock);
     }
 
     gnutls_transport_set_ptr(sess->session, sess);
@@ -1341,7 +1509,8 @@ int virNetTLSSessionHandshake(virNetTLSSessionPtr sess)
     VIR_DEBUG("Ret=%d", ret);
     if (ret == 0) {
         sess->handshakeComplete = true;
-        VIR_DEBUG("Handshake is complete");
+        VIR_DEBUG("Handshake is complete, resumed=%d",
+                  gnutls_session_is_resumed(sess->session));
         goto cleanup;
     }
     if (ret == GNUTLS_E_INTERRUPTED || ret == GNUTLS_E_AGAIN) {
@@ -1397,6 +1566,202 @@ int virNetTLSSessionGetKeySize(virNetTLSSessionPtr sess)
     return ssf;
 }
 
+/**
+ * virNetTLSSessionSetKernelOffload:
+ * @sess: the TLS session, with the handshake complete
+ * @fd: the TCP socket the session runs over
+ *
+ * Installs the keys used for sending on @sess in the kernel TLS
+ * module of @fd, so that the kernel encrypts application data
+ * written to @fd. This must be done before any data was sent with
+ * virNetTLSSessionWrite, which must not be used afterwards.
+ *
+ * Receiving stays with gnutls: it may already have read data past
+ * the end of the handshake which cannot be handed to the kernel.
+ *
+ * Returns 1 if the kernel took over, 0 if kernel TLS is not
+ * available for the host or the negotiated cipher
+ */
+int virNetTLSSessionSetKernelOffload(virNetTLSSessionPtr sess G_GNUC_UNUSED,
+                                     int fd G_GNUC_UNUSED)
+{
+#ifdef WITH_KERNEL_TLS
+    union {
+        struct tls12_crypto_info_aes_gcm_128 aes128;
+# ifdef TLS_CIPHER_AES_GCM_256
+        struct tls12_crypto_info_aes_gcm_256 aes256;
+# endif
+    } info;
+    struct tls_crypto_info *base = &info.aes128.info;
+    unsigned char *infoIV;
+    unsigned char *infoKey;
+    unsigned char *infoSalt;
+    unsigned char *infoSeq;
+    socklen_t infoLen;
+    size_t keyLen;
+    gnutls_datum_t mac;
+    gnutls_datum_t iv;
+    gnutls_datum_t key;
+    unsigned char seq[8];
+    int ret = 0;
+
+    G_STATIC_ASSERT(sizeof(seq) == TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE);
+
+    memset(&info, 0, sizeof(info));
+
+    virObjectLock(sess);
+
+    switch ((int) gnutls_protocol_get_version(sess->session)) {
+    case GNUTLS_TLS1_2:
+        base->version = TLS_1_2_VERSION;
+        break;
+# if defined(TLS_1_3_VERSION) && GNUTLS_VERSION_NUMBER >= 0x030605
+    case GNUTLS_TLS1_3:
+        base->version = TLS_1_3_VERSION;
+        break;
+# endif
+    default:
+        VIR_DEBUG("No kernel TLS for protocol version of sess=%p", sess);
+        goto cleanup;
+    }
+
+    /* Both GCM variants only differ in the key size */
+    switch ((int) gnutls_cipher_get(sess->session)) {
+    case GNUTLS_CIPHER_AES_128_GCM:
+        base->cipher_type = TLS_CIPHER_AES_GCM_128;
+        infoIV = info.aes128.iv;
+        infoKey = info.aes128.key;
+        infoSalt = info.aes128.salt;
+        infoSeq = info.aes128.rec_seq;
+        infoLen = sizeof(info.aes128);
+        keyLen = TLS_CIPHER_AES_GCM_128_KEY_SIZE;
+        break;
+# ifdef TLS_CIPHER_AES_GCM_256
+    case GNUTLS_CIPHER_AES_256_GCM:
+        base->cipher_type = TLS_CIPHER_AES_GCM_256;
+        infoIV = info.aes256.iv;
+        infoKey = info.aes256.key;
+        infoSalt = info.aes256.salt;
+        infoSeq = info.aes256.rec_seq;
+        infoLen = sizeof(info.aes256);
+        keyLen = TLS_CIPHER_AES_GCM_256_KEY_SIZE;
+        break;
+# endif
+    default:
+        VIR_DEBUG("No kernel TLS for cipher of sess=%p", sess);
+        goto cleanup;
+    }
+
+    if (gnutls_record_get_state(sess->session, 0, &mac, &iv, &key, seq) < 0 ||
+        key.size != keyLen ||
+        iv.size != (base->version == TLS_1_2_VERSION ?
+                    TLS_CIPHER_AES_GCM_128_SALT_SIZE :
+                    TLS_CIPHER_AES_GCM_128_SALT_SIZE +
+                    TLS_CIPHER_AES_GCM_128_IV_SIZE)) {
+        VIR_DEBUG("Unable to get keys of sess=%p", sess);
+        goto cleanup;
+    }
+
+    /* The implicit part of the nonce is the salt. The explicit part
+     * is the sequence number with TLS 1.2, while TLS 1.3 derives it
+     * from the IV */
+    memcpy(infoSalt, iv.data, TLS_CIPHER_AES_GCM_128_SALT_SIZE);
+    if (base->version == TLS_1_2_VERSION)
+        memcpy(infoIV, seq, TLS_CIPHER_AES_GCM_128_IV_SIZE);
+    else
+        memcpy(infoIV, iv.data + TLS_CIPHER_AES_GCM_128_SALT_SIZE,
+               TLS_CIPHER_AES_GCM_128_IV_SIZE);
+    memcpy(infoKey, key.data, keyLen);
+    memcpy(infoSeq, seq, sizeof(seq));
+
+    /* Without the TLS module loaded, or on anything but TCP, this
+     * fails and nothing changed. With the module attached but no key
+     * installed the socket passes data through unmodified. */
+    if (setsockopt(fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) < 0) {
+        VIR_DEBUG("Kernel TLS unavailable on fd=%d: %s", fd, g_strerror(errno));
+        goto cleanup;
+    }
+
+    if (setsockopt(fd, SOL_TLS, TLS_TX, &info, infoLen) < 0) {
+        VIR_DEBUG("Kernel TLS rejected keys on fd=%d: %s", fd, g_strerror(errno));
+        goto cleanup;
+    }
+
+    VIR_DEBUG("Kernel TLS enabled for sending on fd=%d sess=%p", fd, sess);
+    ret = 1;
+
+ cleanup:
+    memset(&info, 0, sizeof(info));
+    virObjectUnlock(sess);
+    return ret;
+#else /* !WITH_KERNEL_TLS */
+    return 0;
+#endif /* !WITH_KERNEL_TLS */
+}
+
+/**
+ * virNetTLSSessionSaveResumeData:
+ * @sess: the client TLS session
+ *
+ * Remembers the data needed to resume @sess, so that the next session
+ * to the same server using the same credentials can skip the full
+ * handshake. With TLS 1.3 the server sends this data after the
+ * handshake, so this should be called once something was read from
+ * the server.
+ */
+void virNetTLSSessionSaveResumeData(virNetTLSSessionPtr sess)
+{
+    gnutls_datum_t *data = NULL;
+
+    virObjectLock(sess);
+
+    if (sess->isServer || !sess->cacheKey || !sess->handshakeComplete)
+        goto cleanup;
+
+    data = g_new0(gnutls_datum_t, 1);
+    if (gnutls_session_get_data2(sess->session, data) < 0) {
+        VIR_DEBUG("No data to resume session with %s", sess->hostname);
+        goto cleanup;
+    }
+
+    virMutexLock(&virNetTLSSessionCacheLock);
+    if (!virNetTLSSessionCache)
+        virNetTLSSessionCache = virHashNew(virNetTLSSessionCacheDataFree);
+
+    if (virHashSize(virNetTLSSessionCache) >= VIR_NET_TLS_SESSION_CACHE_MAX &&
+        !virHashLookup(virNetTLSSessionCache, sess->cacheKey))
+        virHashRemoveAll(virNetTLSSessionCache);
+
+    if (virHashUpdateEntry(virNetTLSSessionCache, sess->cacheKey, data) == 0)
+        data = NULL;
+    virMutexUnlock(&virNetTLSSessionCacheLock);
+
+ cleanup:
+    virNetTLSSessionCacheDataFree(data);
+    virObjectUnlock(sess);
+}
+
+/**
+ * virNetTLSSessionIsResumed:
+ * @sess: the TLS session
+ *
+ * Returns true if the handshake of @sess resumed a previous session
+ * instead of doing a full handshake.
+ */
+bool virNetTLSSessionIsResumed(virNetTLSSessionPtr sess)
+{
+    bool ret = false;
+
+    virObjectLock(sess);
+
+    if (sess->handshakeComplete)
+        ret = gnutls_session_is_resumed(sess->session) != 0;
+
+    virObjectUnlock(sess);
+
+    return ret;
+}
+
 const char *virNetTLSSessionGetX509DName(virNetTLSSessionPtr sess)
 {
     const char *ret = NULL;
@@ -1419,6 +1784,7 @@ void virNetTLSSessionDispose(void *obj)
 
     VIR_FREE(sess->x509dname);
     VIR_FREE(sess->hostname);
+    VIR_FREE(sess->cacheKey);
     gnutls_deinit(sess->session);
 }
 
@@ -68,6 +68,9 @@ int virNetTLSContextReloadForServer(virNetTLSContextPtr ctxt,
 int virNetTLSContextCheckCertificate(virNetTLSContextPtr ctxt,
                                      virNetTLSSessionPtr sess);
 
+int virNetTLSContextSetTicketKeyRotation(virNetTLSContextPtr ctxt,
+                                         unsigned int seconds);
+
 
 typedef ssize_t (*virNetTLSSessionWriteFunc)(const char *buf, size_t len,
                                              void *opaque);
@@ -75,7 +78,8 @@ typedef ssize_t (*virNetTLSSessionReadFunc)(char *buf, size_t len,
                                             void *opaque);
 
 virNetTLSSessionPtr virNetTLSSessionNew(virNetTLSContextPtr ctxt,
-                                        const char *hostname);
+                                        const char *hostname,
+                                        const char *service);
 
 void virNetTLSSessionSetIOCallbacks(virNetTLSSessionPtr sess,
                                     virNetTLSSessionWriteFunc writeFunc,
@@ -100,4 +104,10 @@ virNetTLSSessionGetHandshakeStatus(virNetTLSSessionPtr sess);
 
 int virNetTLSSessionGetKeySize(virNetTLSSessionPtr sess);
 
+int virNetTLSSessionSetKernelOffload(virNetTLSSessionPtr sess,
+                                     int fd);
+
+void virNetTLSSessionSaveResumeData(virNetTLSSessionPtr sess);
+bool virNetTLSSessionIsResumed(virNetTLSSessionPtr sess);
+
 const char *virNetTLSSessionGetX509DName(virNetTLSSessionPtr sess);
@@ -706,10 +706,12 @@ testDomainGenerateIfnames(virDomainDefPtr domdef)
 
 
 static void
-testDomainShutdownState(virDomainPtr domain,
+testDomainShutdownState(testDriverPtr privconn,
+                        virDomainPtr domain,
                         virDomainObjPtr privdom,
                         virDomainShutoffReason reason)
 {
+    virDomainObjListSetID(privconn->domains, privdom, -1);
     virDomainObjRemoveTransientDef(privdom);
     virDomainObjSetState(privdom, VIR_DOMAIN_SHUTOFF, reason);
 
@@ -726,7 +728,8 @@ testDomainStartState(testDriverPtr privconn,
     int ret = -1;
 
     virDomainObjSetState(dom, VIR_DOMAIN_RUNNING, reason);
-    dom->def->id = g_atomic_int_add(&privconn->nextDomID, 1);
+    virDomainObjListSetID(privconn->domains, dom,
+                          g_atomic_int_add(&privconn->nextDomID, 1));
 
     if (virDomainObjSetDefTransient(privconn->xmlopt,
                                     dom, NULL) < 0) {
@@ -737,7 +740,7 @@ testDomainStartState(testDriverPtr privconn,
     ret = 0;
  cleanup:
     if (ret < 0)
-        testDomainShutdownState(NULL, dom, VIR_DOMAIN_SHUTOFF_FAILED);
+        testDomainShutdownState(privconn, NULL, dom, VIR_DOMAIN_SHUTOFF_FAILED);
     return ret;
 }
 
@@ -996,7 +999,7 @@ testParseDomains(testDriverPtr privconn,
                                      VIR_DOMAIN_RUNNING_BOOTED) < 0)
                 goto error;
         } else {
-            testDomainShutdownState(NULL, obj, 0);
+            testDomainShutdownState(privconn, NULL, obj, 0);
         }
         virDomainObjSetState(obj, nsdata->runstate, 0);
 
@@ -1635,7 +1638,9 @@ testConnectSupportsFeature(virConnectPtr conn G_GNUC_UNUSED,
     case VIR_DRV_FEATURE_PROGRAM_KEEPALIVE:
     case VIR_DRV_FEATURE_REMOTE:
     case VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK:
+    case VIR_DRV_FEATURE_REMOTE_EVENT_BATCH:
     case VIR_DRV_FEATURE_REMOTE_EVENT_CALLBACK:
+    case VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PACKETS:
     default:
         return 0;
     }
@@ -1831,7 +1836,7 @@ static int testDomainDestroyFlags(virDomainPtr domain,
     if (virDomainObjCheckActive(privdom) < 0)
         goto cleanup;
 
-    testDomainShutdownState(domain, privdom, VIR_DOMAIN_SHUTOFF_DESTROYED);
+    testDomainShutdownState(privconn, domain, privdom, VIR_DOMAIN_SHUTOFF_DESTROYED);
     event = virDomainEventLifecycleNewFromObj(privdom,
                                      VIR_DOMAIN_EVENT_STOPPED,
                                      VIR_DOMAIN_EVENT_STOPPED_DESTROYED);
@@ -1967,7 +1972,7 @@ static int testDomainShutdownFlags(virDomainPtr domain,
     testDomainActionSetState(privdom, privdom->def->onPoweroff);
 
     if (virDomainObjGetState(privdom, NULL) == VIR_DOMAIN_SHUTOFF) {
-        testDomainShutdownState(domain, privdom, VIR_DOMAIN_SHUTOFF_SHUTDOWN);
+        testDomainShutdownState(privconn, domain, privdom, VIR_DOMAIN_SHUTOFF_SHUTDOWN);
         event = virDomainEventLifecycleNewFromObj(privdom,
                                                   VIR_DOMAIN_EVENT_STOPPED,
                                                   VIR_DOMAIN_EVENT_STOPPED_SHUTDOWN);
@@ -2013,7 +2018,7 @@ static int testDomainReboot(virDomainPtr domain,
     testDomainActionSetState(privdom, privdom->def->onReboot);
 
     if (virDomainObjGetState(privdom, NULL) == VIR_DOMAIN_SHUTOFF) {
-        testDomainShutdownState(domain, privdom, VIR_DOMAIN_SHUTOFF_SHUTDOWN);
+        testDomainShutdownState(privconn, domain, privdom, VIR_DOMAIN_SHUTOFF_SHUTDOWN);
         event = virDomainEventLifecycleNewFromObj(privdom,
                                          VIR_DOMAIN_EVENT_STOPPED,
                                          VIR_DOMAIN_EVENT_STOPPED_SHUTDOWN);
@@ -2350,7 +2355,7 @@ testDomainSaveFlags(virDomainPtr domain, const char *path,
     if (!testDomainSaveImageWrite(privconn, path, privdom->def))
         goto cleanup;
 
-    testDomainShutdownState(domain, privdom, VIR_DOMAIN_SHUTOFF_SAVED);
+    testDomainShutdownState(privconn, domain, privdom, VIR_DOMAIN_SHUTOFF_SAVED);
     event = virDomainEventLifecycleNewFromObj(privdom,
                                      VIR_DOMAIN_EVENT_STOPPED,
                                      VIR_DOMAIN_EVENT_STOPPED_SAVED);
@@ -2540,7 +2545,7 @@ static int testDomainCoreDumpWithFormat(virDomainPtr domain,
     }
 
     if (flags & VIR_DUMP_CRASH) {
-        testDomainShutdownState(domain, privdom, VIR_DOMAIN_SHUTOFF_CRASHED);
+        testDomainShutdownState(privconn, domain, privdom, VIR_DOMAIN_SHUTOFF_CRASHED);
         event = virDomainEventLifecycleNewFromObj(privdom,
                                          VIR_DOMAIN_EVENT_STOPPED,
                                          VIR_DOMAIN_EVENT_STOPPED_CRASHED);
@@ -2644,8 +2649,10 @@ static int testDomainSetMemoryFlags(virDomainPtr domain,
                                     unsigned long memory,
                                     unsigned int flags)
 {
+    testDriverPtr privconn = domain->conn->privateData;
     virDomainObjPtr vm;
     virDomainDefPtr def;
+    virObjectEventPtr event = NULL;
     int ret = -1;
     bool live = false;
 
@@ -2693,11 +2700,16 @@ static int testDomainSetMemoryFlags(virDomainPtr domain,
         }
 
         def->mem.cur_balloon = memory;
+
+        /* The balloon of the test guest reaches its target at once */
+        if (live)
+            event = virDomainEventBalloonChangeNewFromObj(vm, memory);
     }
 
     ret = 0;
  cleanup:
     virDomainObjEndAPI(&vm);
+    virObjectEventStateQueue(privconn->eventState, event);
     return ret;
 }
 
@@ -7615,6 +7627,28 @@ testConnectDomainEventRegisterAny(virConnectPtr conn,
     return ret;
 }
 
+static int
+testConnectDomainEventRegisterAnyFlags(virConnectPtr conn,
+                                       virDomainPtr dom,
+                                       int eventID,
+                                       virConnectDomainEventGenericCallback callback,
+                                       void *opaque,
+                                       virFreeCallback freecb,
+                                       unsigned int flags)
+{
+    testDriverPtr driver = conn->privateData;
+    int ret;
+
+    if (virDomainEventStateRegisterIDFlags(conn,
+                                           driver->eventState,
+                                           dom, eventID,
+                                           callback, opaque, freecb,
+                                           flags, &ret) < 0)
+        ret = -1;
+
+    return ret;
+}
+
 static int
 testConnectDomainEventDeregisterAny(virConnectPtr conn,
                                     int callbackID)
@@ -7885,7 +7919,7 @@ testDomainManagedSave(virDomainPtr dom, unsigned int flags)
         goto cleanup;
     }
 
-    testDomainShutdownState(dom, vm, VIR_DOMAIN_SHUTOFF_SAVED);
+    testDomainShutdownState(privconn, dom, vm, VIR_DOMAIN_SHUTOFF_SAVED);
     event = virDomainEventLifecycleNewFromObj(vm,
                                      VIR_DOMAIN_EVENT_STOPPED,
                                      VIR_DOMAIN_EVENT_STOPPED_SAVED);
@@ -8588,7 +8622,7 @@ testDomainSnapshotCreateXML(virDomainPtr domain,
 
         if ((flags & VIR_DOMAIN_SNAPSHOT_CREATE_HALT) &&
             virDomainObjIsActive(vm)) {
-            testDomainShutdownState(domain, vm,
+            testDomainShutdownState(privconn, domain, vm,
                                     VIR_DOMAIN_SHUTOFF_FROM_SNAPSHOT);
             event = virDomainEventLifecycleNewFromObj(vm, VIR_DOMAIN_EVENT_STOPPED,
                                     VIR_DOMAIN_EVENT_STOPPED_FROM_SNAPSHOT);
@@ -8817,7 +8851,7 @@ testDomainRevertToSnapshot(virDomainSnapshotPtr snapshot,
                 }
 
                 virResetError(err);
-                testDomainShutdownState(snapshot->domain, vm,
+                testDomainShutdownState(privconn, snapshot->domain, vm,
                                         VIR_DOMAIN_SHUTOFF_FROM_SNAPSHOT);
                 event = virDomainEventLifecycleNewFromObj(vm,
                             VIR_DOMAIN_EVENT_STOPPED,
@@ -8889,7 +8923,7 @@ testDomainRevertToSnapshot(virDomainSnapshotPtr snapshot,
 
         if (virDomainObjIsActive(vm)) {
             /* Transitions 4, 7 */
-            testDomainShutdownState(snapshot->domain, vm,
+            testDomainShutdownState(privconn, snapshot->domain, vm,
                                     VIR_DOMAIN_SHUTOFF_FROM_SNAPSHOT);
             event = virDomainEventLifecycleNewFromObj(vm,
                                     VIR_DOMAIN_EVENT_STOPPED,
@@ -9441,6 +9475,7 @@ static virHypervisorDriver testHypervisorDriver = {
     .domainCheckpointLookupByName = testDomainCheckpointLookupByName, /* 5.6.0 */
     .domainCheckpointGetParent = testDomainCheckpointGetParent, /* 5.6.0 */
     .domainCheckpointDelete = testDomainCheckpointDelete, /* 5.6.0 */
+    .connectDomainEventRegisterAnyFlags = testConnectDomainEventRegisterAnyFlags, /* 6.7.0 */
 };
 
 static virNetworkDriver testNetworkDriver = {
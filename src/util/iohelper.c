@@ -27,6 +27,7 @@
 
 #include <unistd.h>
 #include <fcntl.h>
+#include <getopt.h>
 
 #include "virthread.h"
 #include "virfile.h"
@@ -42,32 +43,295 @@
 # define O_DIRECT 0
 #endif
 
+/* O_DIRECT requires file offsets, transfer sizes and buffer addresses to
+ * be aligned; 64 KiB is a multiple of any block size in use. */
+#define IOHELPER_ALIGN VIR_FILE_WRAPPER_BUFFER_ALIGN
+#define IOHELPER_BUFLEN_DEFAULT (1024 * 1024)
+#define IOHELPER_BUFLEN_MAX VIR_FILE_WRAPPER_BUFFER_MAX
+#define IOHELPER_DEPTH_DEFAULT 4
+#define IOHELPER_DEPTH_MAX VIR_FILE_WRAPPER_QUEUE_DEPTH_MAX
+
+typedef struct _runIOBuffer runIOBuffer;
+struct _runIOBuffer {
+    void *base;     /* Location to be freed */
+    char *buf;      /* Aligned location within base */
+    size_t len;     /* Number of valid bytes in buf */
+};
+
+/* The reading side of the copy runs in a separate thread and hands filled
+ * buffers over to the writing side using a ring of @nbufs buffers, so that
+ * reading the next chunk of data overlaps with writing the previous ones.
+ * Both sides hold a reference as the writer doesn't wait for the reader
+ * when it fails: the reader may be stuck in read() until the process
+ * exits. */
+typedef struct _runIOData runIOData;
+struct _runIOData {
+    int refs;
+    int fdin;
+    bool directin;      /* reading from @fdin uses O_DIRECT */
+    size_t buflen;
+
+    virMutex lock;
+    virCond cond;
+    runIOBuffer *bufs;
+    size_t nbufs;
+    size_t head;        /* first filled buffer */
+    size_t count;       /* number of filled buffers */
+    bool eof;           /* the reader is done */
+    int err;            /* errno of a failed read */
+    bool quit;          /* the writer gave up */
+};
+
+
+static void
+runIODataUnref(runIOData *data)
+{
+    size_t i;
+
+    if (!data || !g_atomic_int_dec_and_test(&data->refs))
+        return;
+
+    for (i = 0; i < data->nbufs; i++)
+        g_free(data->bufs[i].base);
+    g_free(data->bufs);
+    virCondDestroy(&data->cond);
+    virMutexDestroy(&data->lock);
+    g_free(data);
+}
+
+
+static runIOData *
+runIODataNew(size_t buflen, size_t depth)
+{
+    runIOData *data = g_new0(runIOData, 1);
+    size_t i;
+
+    data->refs = 1;
+    data->fdin = -1;
+    data->buflen = buflen;
+
+    if (virMutexInit(&data->lock) < 0) {
+        virReportSystemError(errno, "%s", _("Unable to initialize lock"));
+        g_free(data);
+        return NULL;
+    }
+
+    if (virCondInit(&data->cond) < 0) {
+        virReportSystemError(errno, "%s", _("Unable to initialize condition"));
+        virMutexDestroy(&data->lock);
+        g_free(data);
+        return NULL;
+    }
+
+    data->nbufs = depth;
+    data->bufs = g_new0(runIOBuffer, depth);
+
+    for (i = 0; i < depth; i++) {
+        runIOBuffer *buf = &data->bufs[i];
+
+#if HAVE_POSIX_MEMALIGN
+        if (posix_memalign(&buf->base, IOHELPER_ALIGN, buflen)) {
+            virReportOOMError();
+            runIODataUnref(data);
+            return NULL;
+        }
+        buf->buf = buf->base;
+#else
+        buf->base = g_new0(char, buflen + IOHELPER_ALIGN - 1);
+        buf->buf = (char *) (((intptr_t) buf->base + IOHELPER_ALIGN - 1) &
+                             ~((intptr_t) IOHELPER_ALIGN - 1));
+#endif
+    }
+
+    return data;
+}
+
+
+static int
+runIOSetDirect(int fd, bool direct)
+{
+    int flags;
+
+    if ((flags = fcntl(fd, F_GETFL)) < 0)
+        return -1;
+
+    if (direct)
+        flags |= O_DIRECT;
+    else
+        flags &= ~O_DIRECT;
+
+    return fcntl(fd, F_SETFL, flags);
+}
+
+
+static ssize_t
+runIORead(runIOData *data, char *buf)
+{
+    ssize_t got;
+
+    /* If we read with O_DIRECT from file we can't use saferead as
+     * it can lead to unaligned read after reading last bytes.
+     * If we write with O_DIRECT use should use saferead so that
+     * writes will be aligned.
+     * In other cases using saferead reduces number of syscalls.
+     */
+    if (!data->directin)
+        return saferead(data->fdin, buf, data->buflen);
+
+    while ((got = read(data->fdin, buf, data->buflen)) < 0 &&
+           errno == EINTR)
+        ;
+
+    return got;
+}
+
+
+static void
+runIOReaderLoop(runIOData *data)
+{
+    while (1) {
+        runIOBuffer *buf;
+        ssize_t got;
+        int err;
+
+        virMutexLock(&data->lock);
+        while (data->count == data->nbufs && !data->quit)
+            virCondWait(&data->cond, &data->lock);
+        if (data->quit) {
+            virMutexUnlock(&data->lock);
+            return;
+        }
+        buf = &data->bufs[(data->head + data->count) % data->nbufs];
+        virMutexUnlock(&data->lock);
+
+        got = runIORead(data, buf->buf);
+        err = errno;
+
+        virMutexLock(&data->lock);
+        if (got > 0) {
+            buf->len = got;
+            data->count++;
+        } else {
+            data->eof = true;
+            if (got < 0)
+                data->err = err;
+        }
+        virCondSignal(&data->cond);
+        virMutexUnlock(&data->lock);
+
+        if (got <= 0)
+            return;
+    }
+}
+
+
+static void
+runIOReader(void *opaque)
+{
+    runIOData *data = opaque;
+
+    runIOReaderLoop(data);
+    runIODataUnref(data);
+}
+
+
+/* O_DIRECT transfers have to start at an aligned file offset. When @fd is
+ * positioned elsewhere, copy the data up to the next aligned offset with
+ * O_DIRECT temporarily turned off. */
+static int
+runIOAlignStart(int fd, const char *path,
+                int fdin, const char *fdinname,
+                int fdout, const char *fdoutname,
+                char *buf)
+{
+    off_t pos;
+    size_t len;
+    ssize_t got;
+
+    if ((pos = lseek(fd, 0, SEEK_CUR)) < 0) {
+        virReportSystemError(errno, _("O_DIRECT needs a seekable file %s"),
+                             path);
+        return -1;
+    }
+
+    if ((pos & (IOHELPER_ALIGN - 1)) == 0)
+        return 0;
+
+    len = IOHELPER_ALIGN - (pos & (IOHELPER_ALIGN - 1));
+
+    if (runIOSetDirect(fd, false) < 0) {
+        virReportSystemError(errno, _("Unable to disable O_DIRECT on %s"), path);
+        return -1;
+    }
+
+    if ((got = saferead(fdin, buf, len)) < 0) {
+        virReportSystemError(errno, _("Unable to read %s"), fdinname);
+        return -1;
+    }
+
+    if (safewrite(fdout, buf, got) < 0) {
+        virReportSystemError(errno, _("Unable to write %s"), fdoutname);
+        return -1;
+    }
+
+    if (runIOSetDirect(fd, true) < 0) {
+        virReportSystemError(errno, _("Unable to enable O_DIRECT on %s"), path);
+        return -1;
+    }
+
+    return 0;
+}
+
+
 static int
-runIO(const char *path, int fd, int oflags)
+runIOWrite(int fdout, const char *fdoutname,
+           runIOBuffer *buf,
+           bool directout)
 {
-    g_autofree void *base = NULL; /* Location to be freed */
-    char *buf = NULL; /* Aligned location within base */
-    size_t buflen = 1024*1024;
-    intptr_t alignMask = 64*1024 - 1;
+    size_t len = buf->len;
+
+    /* The last chunk of data doesn't need to be aligned, write the
+     * unaligned tail without O_DIRECT. */
+    if (directout && (len & (IOHELPER_ALIGN - 1)) != 0) {
+        size_t aligned = len & ~(IOHELPER_ALIGN - 1);
+
+        if (aligned > 0 && safewrite(fdout, buf->buf, aligned) < 0)
+            goto error;
+
+        if (runIOSetDirect(fdout, false) < 0) {
+            virReportSystemError(errno, _("Unable to disable O_DIRECT on %s"),
+                                 fdoutname);
+            return -1;
+        }
+
+        if (safewrite(fdout, buf->buf + aligned, len - aligned) < 0)
+            goto error;
+
+        return 0;
+    }
+
+    if (safewrite(fdout, buf->buf, len) < 0)
+        goto error;
+
+    return 0;
+
+ error:
+    virReportSystemError(errno, _("Unable to write %s"), fdoutname);
+    return -1;
+}
+
+
+static int
+runIO(const char *path, int fd, int oflags,
+      size_t buflen, size_t depth)
+{
+    runIOData *data = NULL;
+    virThread reader;
+    bool readerRunning = false;
     int ret = -1;
     int fdin, fdout;
     const char *fdinname, *fdoutname;
-    unsigned long long total = 0;
     bool direct = O_DIRECT && ((oflags & O_DIRECT) != 0);
-    off_t end = 0;
-
-#if HAVE_POSIX_MEMALIGN
-    if (posix_memalign(&base, alignMask + 1, buflen)) {
-        virReportOOMError();
-        goto cleanup;
-    }
-    buf = base;
-#else
-    if (VIR_ALLOC_N(buf, buflen + alignMask) < 0)
-        goto cleanup;
-    base = buf;
-    buf = (char *) (((intptr_t) base + alignMask) & ~alignMask);
-#endif
 
     switch (oflags & O_ACCMODE) {
     case O_RDONLY:
@@ -75,26 +339,12 @@ runIO(const char *path, int fd, int oflags)
         fdinname = path;
         fdout = STDOUT_FILENO;
         fdoutname = "stdout";
-        /* To make the implementation simpler, we give up on any
-         * attempt to use O_DIRECT in a non-trivial manner.  */
-        if (direct && ((end = lseek(fd, 0, SEEK_CUR)) != 0)) {
-            virReportSystemError(end < 0 ? errno : EINVAL, "%s",
-                                 _("O_DIRECT read needs entire seekable file"));
-            goto cleanup;
-        }
         break;
     case O_WRONLY:
         fdin = STDIN_FILENO;
         fdinname = "stdin";
         fdout = fd;
         fdoutname = path;
-        /* To make the implementation simpler, we give up on any
-         * attempt to use O_DIRECT in a non-trivial manner.  */
-        if (direct && (end = lseek(fd, 0, SEEK_END)) != 0) {
-            virReportSystemError(end < 0 ? errno : EINVAL, "%s",
-                                 _("O_DIRECT write needs empty seekable file"));
-            goto cleanup;
-        }
         break;
 
     case O_RDWR:
@@ -105,55 +355,54 @@ runIO(const char *path, int fd, int oflags)
         goto cleanup;
     }
 
-    while (1) {
-        ssize_t got;
-
-        /* If we read with O_DIRECT from file we can't use saferead as
-         * it can lead to unaligned read after reading last bytes.
-         * If we write with O_DIRECT use should use saferead so that
-         * writes will be aligned.
-         * In other cases using saferead reduces number of syscalls.
-         */
-        if (fdin == fd && direct) {
-            if ((got = read(fdin, buf, buflen)) < 0 &&
-                errno == EINTR)
-                continue;
-        } else {
-            got = saferead(fdin, buf, buflen);
-        }
-
-        if (got < 0) {
-            virReportSystemError(errno, _("Unable to read %s"), fdinname);
-            goto cleanup;
-        }
-        if (got == 0)
-            break;
-
-        total += got;
+    if (!(data = runIODataNew(buflen, depth)))
+        goto cleanup;
 
-        /* handle last write size align in direct case */
-        if (got < buflen && direct && fdout == fd) {
-            ssize_t aligned_got = (got + alignMask) & ~alignMask;
+    if (direct &&
+        runIOAlignStart(fd, path, fdin, fdinname, fdout, fdoutname,
+                        data->bufs[0].buf) < 0)
+        goto cleanup;
 
-            memset(buf + got, 0, aligned_got - got);
+    data->fdin = fdin;
+    data->directin = direct && fdin == fd;
 
-            if (safewrite(fdout, buf, aligned_got) < 0) {
-                virReportSystemError(errno, _("Unable to write %s"), fdoutname);
-                goto cleanup;
-            }
+    g_atomic_int_inc(&data->refs);
+    if (virThreadCreate(&reader, true, runIOReader, data) < 0) {
+        virReportSystemError(errno, "%s", _("Unable to create reader thread"));
+        ignore_value(g_atomic_int_dec_and_test(&data->refs));
+        goto cleanup;
+    }
+    readerRunning = true;
 
-            if (ftruncate(fd, total) < 0) {
-                virReportSystemError(errno, _("Unable to truncate %s"), fdoutname);
-                goto cleanup;
-            }
+    while (1) {
+        runIOBuffer *buf;
 
+        virMutexLock(&data->lock);
+        while (data->count == 0 && !data->eof)
+            virCondWait(&data->cond, &data->lock);
+        if (data->count == 0) {
+            virMutexUnlock(&data->lock);
             break;
         }
+        buf = &data->bufs[data->head];
+        virMutexUnlock(&data->lock);
 
-        if (safewrite(fdout, buf, got) < 0) {
-            virReportSystemError(errno, _("Unable to write %s"), fdoutname);
+        if (runIOWrite(fdout, fdoutname, buf, direct && fdout == fd) < 0)
             goto cleanup;
-        }
+
+        virMutexLock(&data->lock);
+        data->head = (data->head + 1) % data->nbufs;
+        data->count--;
+        virCondSignal(&data->cond);
+        virMutexUnlock(&data->lock);
+    }
+
+    virThreadJoin(&reader);
+    readerRunning = false;
+
+    if (data->err != 0) {
+        virReportSystemError(data->err, _("Unable to read %s"), fdinname);
+        goto cleanup;
     }
 
     /* Ensure all data is written */
@@ -168,6 +417,16 @@ runIO(const char *path, int fd, int oflags)
     ret = 0;
 
  cleanup:
+    if (readerRunning) {
+        /* The reader may be blocked in read() which can't be interrupted.
+         * Tell it to stop and leave freeing the shared data to whichever
+         * side drops the last reference, the process exits anyway. */
+        virMutexLock(&data->lock);
+        data->quit = true;
+        virCondSignal(&data->cond);
+        virMutexUnlock(&data->lock);
+    }
+    runIODataUnref(data);
     if (VIR_CLOSE(fd) < 0 &&
         ret == 0) {
         virReportSystemError(errno, _("Unable to close %s"), path);
@@ -184,7 +443,11 @@ usage(int status)
     if (status) {
         fprintf(stderr, _("%s: try --help for more details"), program_name);
     } else {
-        printf(_("Usage: %s FILENAME FD"), program_name);
+        printf(_("Usage: %s [OPTIONS] FILENAME FD\n"
+                 "\n"
+                 "  --buffer-size=BYTES  size of a single I/O buffer, a multiple of %d\n"
+                 "  --queue-depth=N      number of buffers in flight (1-%d)\n"),
+               program_name, IOHELPER_ALIGN, IOHELPER_DEPTH_MAX);
     }
     exit(status);
 }
@@ -195,6 +458,15 @@ main(int argc, char **argv)
     const char *path;
     int oflags = -1;
     int fd = -1;
+    unsigned long long buflen = IOHELPER_BUFLEN_DEFAULT;
+    unsigned long long depth = IOHELPER_DEPTH_DEFAULT;
+
+    struct option opts[] = {
+        { "buffer-size", required_argument, NULL, 'b' },
+        { "queue-depth", required_argument, NULL, 'q' },
+        { "help", no_argument, NULL, 'h' },
+        {0, 0, 0, 0}
+    };
 
     program_name = argv[0];
 
@@ -204,14 +476,49 @@ main(int argc, char **argv)
         exit(EXIT_FAILURE);
     }
 
-    path = argv[1];
+    while (1) {
+        int optidx = 0;
+        int c;
+
+        c = getopt_long(argc, argv, "+b:q:h", opts, &optidx);
+
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'b':
+            if (virStrToLong_ull(optarg, NULL, 10, &buflen) < 0 ||
+                buflen == 0 || buflen > IOHELPER_BUFLEN_MAX ||
+                (buflen & (IOHELPER_ALIGN - 1)) != 0) {
+                fprintf(stderr, _("%s: invalid buffer size %s"),
+                        program_name, optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 'q':
+            if (virStrToLong_ull(optarg, NULL, 10, &depth) < 0 ||
+                depth == 0 || depth > IOHELPER_DEPTH_MAX) {
+                fprintf(stderr, _("%s: invalid queue depth %s"),
+                        program_name, optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 'h':
+            usage(EXIT_SUCCESS);
+
+        case '?':
+        default:
+            usage(EXIT_FAILURE);
+        }
+    }
 
-    if (argc > 1 && STREQ(argv[1], "--help"))
-        usage(EXIT_SUCCESS);
-    if (argc == 3) { /* FILENAME FD */
-        if (virStrToLong_i(argv[2], NULL, 10, &fd) < 0) {
+    if (argc - optind == 2) { /* FILENAME FD */
+        path = argv[optind];
+        if (virStrToLong_i(argv[optind + 1], NULL, 10, &fd) < 0) {
             fprintf(stderr, _("%s: malformed fd %s"),
-                    program_name, argv[3]);
+                    program_name, argv[optind + 1]);
             exit(EXIT_FAILURE);
         }
 #ifdef F_GETFL
@@ -232,7 +539,7 @@ main(int argc, char **argv)
         usage(EXIT_FAILURE);
     }
 
-    if (fd < 0 || runIO(path, fd, oflags) < 0)
+    if (fd < 0 || runIO(path, fd, oflags, buflen, depth) < 0)
         goto error;
 
     return 0;
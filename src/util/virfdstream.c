@@ -47,6 +47,13 @@
 VIR_LOG_INIT("fdstream");
 
 #ifndef WIN32
+/* With splice(2) the data read from or written to a file is moved
+ * through the pipe between the thread and the event loop directly
+ * instead of being copied into a heap buffer first. */
+# if defined(HAVE_SPLICE) && defined(F_SETPIPE_SZ)
+#  define VIR_FDSTREAM_SPLICE 1
+# endif
+
 typedef enum {
     VIR_FDSTREAM_MSG_TYPE_DATA,
     VIR_FDSTREAM_MSG_TYPE_HOLE,
@@ -64,6 +71,7 @@ struct _virFDStreamMsg {
             char *buf;
             size_t len;
             size_t offset;
+            bool pipe; /* data is stored in the pipe rather than in @buf */
         } data;
         struct {
             long long len;
@@ -108,6 +116,7 @@ struct virFDStreamData {
     bool threadQuit;
     bool threadAbort;
     bool threadDoRead;
+    bool threadSplice;
     virFDStreamMsgPtr msg;
 };
 
@@ -138,6 +147,33 @@ static int virFDStreamDataOnceInit(void)
 VIR_ONCE_GLOBAL_INIT(virFDStreamData);
 
 
+/**
+ * virFDStreamMsgHasToken:
+ * @fdst: FD stream
+ * @msg: message
+ *
+ * Each message is accompanied by a one byte token written into the pipe so
+ * that the other side can poll() for it. When splicing, the pipe carries the
+ * data itself and the token is needed only for messages without any data in
+ * the pipe in read direction. In write direction the thread is woken up by
+ * the condition alone.
+ *
+ * Returns: true if a token is written into the pipe for @msg.
+ */
+static bool
+virFDStreamMsgHasToken(virFDStreamDataPtr fdst,
+                       virFDStreamMsgPtr msg)
+{
+    if (!fdst->threadSplice)
+        return true;
+
+    if (!fdst->threadDoRead)
+        return false;
+
+    return msg->type != VIR_FDSTREAM_MSG_TYPE_DATA || !msg->stream.data.pipe;
+}
+
+
 static int
 virFDStreamMsgQueuePush(virFDStreamDataPtr fdst,
                         virFDStreamMsgPtr *msg,
@@ -145,6 +181,7 @@ virFDStreamMsgQueuePush(virFDStreamDataPtr fdst,
                         const char *fdname)
 {
     virFDStreamMsgPtr *tmp = &fdst->msg;
+    bool token = virFDStreamMsgHasToken(fdst, *msg);
     char c = '1';
 
     while (*tmp)
@@ -153,6 +190,9 @@ virFDStreamMsgQueuePush(virFDStreamDataPtr fdst,
     *tmp = g_steal_pointer(msg);
     virCondSignal(&fdst->threadCond);
 
+    if (!token)
+        return 0;
+
     if (safewrite(fd, &c, sizeof(c)) != sizeof(c)) {
         virReportSystemError(errno,
                              _("Unable to write to %s"),
@@ -179,6 +219,9 @@ virFDStreamMsgQueuePop(virFDStreamDataPtr fdst,
 
     virCondSignal(&fdst->threadCond);
 
+    if (tmp && !virFDStreamMsgHasToken(fdst, tmp))
+        return tmp;
+
     if (saferead(fd, &c, sizeof(c)) != sizeof(c)) {
         virReportSystemError(errno,
                              _("Unable to read from %s"),
@@ -399,6 +442,7 @@ struct _virFDStreamThreadData {
     bool doRead;
     bool sparse;
     bool isBlock;
+    bool splice;
     int fdin;
     char *fdinname;
     int fdout;
@@ -419,10 +463,53 @@ virFDStreamThreadDataFree(virFDStreamThreadDataPtr data)
 }
 
 
+#ifdef VIR_FDSTREAM_SPLICE
+static ssize_t
+virFDStreamSplice(int fdin,
+                  int fdout,
+                  size_t len,
+                  bool nonblock)
+{
+    unsigned int flags = SPLICE_F_MOVE;
+    ssize_t ret;
+
+    if (nonblock)
+        flags |= SPLICE_F_NONBLOCK;
+
+    do {
+        ret = splice(fdin, NULL, fdout, NULL, len, flags);
+    } while (ret < 0 && errno == EINTR);
+
+    return ret;
+}
+#else /* !VIR_FDSTREAM_SPLICE */
+static ssize_t
+virFDStreamSplice(int fdin G_GNUC_UNUSED,
+                  int fdout G_GNUC_UNUSED,
+                  size_t len G_GNUC_UNUSED,
+                  bool nonblock G_GNUC_UNUSED)
+{
+    errno = ENOSYS;
+    return -1;
+}
+#endif /* !VIR_FDSTREAM_SPLICE */
+
+
+/* Errors which mean that the file can't be spliced and the data has to be
+ * copied through a buffer instead, e.g. because the file was opened with
+ * O_APPEND or O_DIRECT or the filesystem doesn't implement splice. */
+static bool
+virFDStreamSpliceUnsupported(int err)
+{
+    return err == EINVAL || err == ENOSYS || err == EAGAIN;
+}
+
+
 static ssize_t
 virFDStreamThreadDoRead(virFDStreamDataPtr fdst,
                         bool sparse,
                         bool isBlock,
+                        bool *splice,
                         const int fdin,
                         const int fdout,
                         const char *fdinname,
@@ -436,6 +523,7 @@ virFDStreamThreadDoRead(virFDStreamDataPtr fdst,
     int inData = 0;
     long long sectionLen = 0;
     g_autofree char *buf = NULL;
+    bool spliced = false;
     ssize_t got;
 
     if (sparse && *dataLen == 0) {
@@ -487,18 +575,41 @@ virFDStreamThreadDoRead(virFDStreamDataPtr fdst,
             buflen > *dataLen)
             buflen = *dataLen;
 
-        buf = g_new0(char, buflen);
+        /* The pipe is empty at this point and @buflen doesn't exceed its
+         * size, so the data can be moved there right away. EOF is left
+         * for saferead() below so that it's announced by a token. */
+        if (*splice) {
+            if ((got = virFDStreamSplice(fdin, fdout, buflen, true)) > 0) {
+                spliced = true;
+            } else if (got < 0) {
+                if (!virFDStreamSpliceUnsupported(errno)) {
+                    virReportSystemError(errno,
+                                         _("Unable to read %s"),
+                                         fdinname);
+                    return -1;
+                }
 
-        if ((got = saferead(fdin, buf, buflen)) < 0) {
-            virReportSystemError(errno,
-                                 _("Unable to read %s"),
-                                 fdinname);
-            return -1;
+                VIR_DEBUG("Unable to splice %s, falling back to copying",
+                          fdinname);
+                *splice = false;
+            }
+        }
+
+        if (!spliced) {
+            buf = g_new0(char, buflen);
+
+            if ((got = saferead(fdin, buf, buflen)) < 0) {
+                virReportSystemError(errno,
+                                     _("Unable to read %s"),
+                                     fdinname);
+                return -1;
+            }
         }
 
         msg->type = VIR_FDSTREAM_MSG_TYPE_DATA;
         msg->stream.data.buf = g_steal_pointer(&buf);
         msg->stream.data.len = got;
+        msg->stream.data.pipe = spliced;
         if (sparse)
             *dataLen -= got;
     }
@@ -509,10 +620,65 @@ virFDStreamThreadDoRead(virFDStreamDataPtr fdst,
 }
 
 
+/**
+ * virFDStreamThreadWritePipe:
+ *
+ * Moves @len bytes which were written into the pipe @fdin by
+ * virFDStreamWrite() into @fdout. If the file can't be spliced the data is
+ * copied through a buffer and @splice is cleared.
+ */
+static ssize_t
+virFDStreamThreadWritePipe(bool *splice,
+                           const int fdin,
+                           const int fdout,
+                           const char *fdinname,
+                           const char *fdoutname,
+                           size_t len)
+{
+    g_autofree char *buf = NULL;
+    ssize_t got;
+
+    if (*splice) {
+        if ((got = virFDStreamSplice(fdin, fdout, len, false)) >= 0)
+            return got;
+
+        if (!virFDStreamSpliceUnsupported(errno)) {
+            virReportSystemError(errno,
+                                 _("Unable to write %s"),
+                                 fdoutname);
+            return -1;
+        }
+
+        VIR_DEBUG("Unable to splice %s, falling back to copying",
+                  fdoutname);
+        *splice = false;
+    }
+
+    buf = g_new0(char, len);
+
+    if ((got = saferead(fdin, buf, len)) < 0) {
+        virReportSystemError(errno,
+                             _("Unable to read %s"),
+                             fdinname);
+        return -1;
+    }
+
+    if (safewrite(fdout, buf, got) < 0) {
+        virReportSystemError(errno,
+                             _("Unable to write %s"),
+                             fdoutname);
+        return -1;
+    }
+
+    return got;
+}
+
+
 static ssize_t
 virFDStreamThreadDoWrite(virFDStreamDataPtr fdst,
                          bool sparse,
                          bool isBlock,
+                         bool *splice,
                          const int fdin,
                          const int fdout,
                          const char *fdinname,
@@ -524,14 +690,23 @@ virFDStreamThreadDoWrite(virFDStreamDataPtr fdst,
 
     switch (msg->type) {
     case VIR_FDSTREAM_MSG_TYPE_DATA:
-        got = safewrite(fdout,
-                        msg->stream.data.buf + msg->stream.data.offset,
-                        msg->stream.data.len - msg->stream.data.offset);
-        if (got < 0) {
-            virReportSystemError(errno,
-                                 _("Unable to write %s"),
-                                 fdoutname);
-            return -1;
+        if (msg->stream.data.pipe) {
+            got = virFDStreamThreadWritePipe(splice, fdin, fdout,
+                                             fdinname, fdoutname,
+                                             msg->stream.data.len -
+                                             msg->stream.data.offset);
+            if (got < 0)
+                return -1;
+        } else {
+            got = safewrite(fdout,
+                            msg->stream.data.buf + msg->stream.data.offset,
+                            msg->stream.data.len - msg->stream.data.offset);
+            if (got < 0) {
+                virReportSystemError(errno,
+                                     _("Unable to write %s"),
+                                     fdoutname);
+                return -1;
+            }
         }
 
         msg->stream.data.offset += got;
@@ -618,10 +793,28 @@ virFDStreamThread(void *opaque)
     char *fdoutname = data->fdoutname;
     virFDStreamDataPtr fdst = st->privateData;
     bool doRead = fdst->threadDoRead;
+    bool splice = data->splice;
     size_t buflen = 256 * 1024;
     size_t total = 0;
     size_t dataLen = 0;
 
+#ifdef VIR_FDSTREAM_SPLICE
+    if (splice) {
+        int pipefd = doRead ? fdout : fdin;
+        int pipelen;
+
+        /* Let the pipe hold a whole buffer. If that's not allowed
+         * (see pipe-user-pages-soft) make do with what we have. */
+        if ((pipelen = fcntl(pipefd, F_SETPIPE_SZ, buflen)) < 0)
+            pipelen = fcntl(pipefd, F_GETPIPE_SZ);
+
+        if (pipelen > 0)
+            buflen = MIN(buflen, pipelen);
+        else if (doRead)
+            splice = false;
+    }
+#endif /* VIR_FDSTREAM_SPLICE */
+
     virObjectRef(fdst);
     virObjectLock(fdst);
 
@@ -648,13 +841,13 @@ virFDStreamThread(void *opaque)
         }
 
         if (doRead)
-            got = virFDStreamThreadDoRead(fdst, sparse, isBlock,
+            got = virFDStreamThreadDoRead(fdst, sparse, isBlock, &splice,
                                           fdin, fdout,
                                           fdinname, fdoutname,
                                           length, total,
                                           &dataLen, buflen);
         else
-            got = virFDStreamThreadDoWrite(fdst, sparse, isBlock,
+            got = virFDStreamThreadDoWrite(fdst, sparse, isBlock, &splice,
                                            fdin, fdout,
                                            fdinname, fdoutname);
 
@@ -843,15 +1036,38 @@ static int virFDStreamWrite(virStreamPtr st, const char *bytes, size_t nbytes)
         }
 
         msg = g_new0(virFDStreamMsg, 1);
-        buf = g_new0(char, nbytes);
-
-        memcpy(buf, bytes, nbytes);
         msg->type = VIR_FDSTREAM_MSG_TYPE_DATA;
-        msg->stream.data.buf = buf;
-        msg->stream.data.len = nbytes;
+
+        if (fdst->threadSplice) {
+            /* Put the data into the pipe right away, the thread splices
+             * it into the file. */
+         rewrite:
+            if ((ret = write(fdst->fd, bytes, nbytes)) < 0) {
+                VIR_WARNINGS_NO_WLOGICALOP_EQUAL_EXPR
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                VIR_WARNINGS_RESET
+                    ret = -2;
+                } else if (errno == EINTR) {
+                    goto rewrite;
+                } else {
+                    virReportSystemError(errno, "%s",
+                                         _("cannot write to stream"));
+                }
+                goto cleanup;
+            }
+
+            msg->stream.data.len = ret;
+            msg->stream.data.pipe = true;
+        } else {
+            buf = g_new0(char, nbytes);
+
+            memcpy(buf, bytes, nbytes);
+            msg->stream.data.buf = buf;
+            msg->stream.data.len = nbytes;
+            ret = nbytes;
+        }
 
         virFDStreamMsgQueuePush(fdst, &msg, fdst->fd, "pipe");
-        ret = nbytes;
     } else {
      retry:
         ret = write(fdst->fd, bytes, nbytes);
@@ -950,9 +1166,31 @@ static int virFDStreamRead(virStreamPtr st, char *bytes, size_t nbytes)
         if (nbytes > msg->stream.data.len - msg->stream.data.offset)
             nbytes = msg->stream.data.len - msg->stream.data.offset;
 
-        memcpy(bytes,
-               msg->stream.data.buf + msg->stream.data.offset,
-               nbytes);
+        if (msg->stream.data.pipe) {
+            ssize_t got;
+
+            /* The thread has spliced the data into the pipe already. */
+         reread:
+            if ((got = read(fdst->fd, bytes, nbytes)) < 0) {
+                VIR_WARNINGS_NO_WLOGICALOP_EQUAL_EXPR
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                VIR_WARNINGS_RESET
+                    ret = -2;
+                } else if (errno == EINTR) {
+                    goto reread;
+                } else {
+                    virReportSystemError(errno, "%s",
+                                         _("cannot read from stream"));
+                }
+                goto cleanup;
+            }
+
+            nbytes = got;
+        } else {
+            memcpy(bytes,
+                   msg->stream.data.buf + msg->stream.data.offset,
+                   nbytes);
+        }
 
         msg->stream.data.offset += nbytes;
         if (msg->stream.data.offset == msg->stream.data.len) {
@@ -1155,6 +1393,7 @@ static int virFDStreamOpenInternal(virStreamPtr st,
 
     if (threadData) {
         fdst->threadDoRead = threadData->doRead;
+        fdst->threadSplice = threadData->splice;
 
         /* Create the thread after fdst and st were initialized.
          * The thread worker expects them to be that way. */
@@ -1316,6 +1555,9 @@ virFDStreamOpenFileInternal(virStreamPtr st,
         threadData->length = length;
         threadData->sparse = sparse;
         threadData->isBlock = !!S_ISBLK(sb.st_mode);
+#ifdef VIR_FDSTREAM_SPLICE
+        threadData->splice = true;
+#endif
 
         if ((oflags & O_ACCMODE) == O_RDONLY) {
             threadData->fdin = fd;
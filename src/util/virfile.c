@@ -208,9 +208,16 @@ struct _virFileWrapperFd {
  * @fd: pointer to fd to wrap
  * @name: name of fd, for diagnostics
  * @flags: bitwise-OR of virFileWrapperFdFlags
+ * @bufferSize: size of a single I/O buffer in bytes, 0 for the default
+ * @queueDepth: number of I/O buffers in flight, 0 for the default
  *
  * Update @fd so that it meets parameters requested by @flags.
  *
+ * The data is copied by a helper process which keeps @queueDepth buffers
+ * of @bufferSize bytes in flight. @bufferSize has to be a multiple of
+ * VIR_FILE_WRAPPER_BUFFER_ALIGN not exceeding VIR_FILE_WRAPPER_BUFFER_MAX
+ * and @queueDepth must not exceed VIR_FILE_WRAPPER_QUEUE_DEPTH_MAX.
+ *
  * If VIR_FILE_WRAPPER_BYPASS_CACHE bit is set in @flags, @fd will be updated
  * in a way that all I/O to that file will bypass the system cache.  The
  * original fd must have been created with virFileDirectFdFlag() among the
@@ -231,7 +238,11 @@ struct _virFileWrapperFd {
  * error message is output, and NULL is returned.
  */
 virFileWrapperFdPtr
-virFileWrapperFdNew(int *fd, const char *name, unsigned int flags)
+virFileWrapperFdNew(int *fd,
+                    const char *name,
+                    unsigned int flags,
+                    size_t bufferSize,
+                    unsigned int queueDepth)
 {
     virFileWrapperFdPtr ret = NULL;
     bool output = false;
@@ -283,7 +294,14 @@ virFileWrapperFdNew(int *fd, const char *name, unsigned int flags)
                                               LIBEXECDIR)))
         goto error;
 
-    ret->cmd = virCommandNewArgList(iohelper_path, name, NULL);
+    ret->cmd = virCommandNew(iohelper_path);
+
+    if (bufferSize > 0)
+        virCommandAddArgFormat(ret->cmd, "--buffer-size=%zu", bufferSize);
+    if (queueDepth > 0)
+        virCommandAddArgFormat(ret->cmd, "--queue-depth=%u", queueDepth);
+
+    virCommandAddArg(ret->cmd, name);
 
     if (output) {
         virCommandSetInputFD(ret->cmd, pipefd[0]);
@@ -324,7 +342,9 @@ virFileWrapperFdNew(int *fd, const char *name, unsigned int flags)
 virFileWrapperFdPtr
 virFileWrapperFdNew(int *fd G_GNUC_UNUSED,
                     const char *name G_GNUC_UNUSED,
-                    unsigned int fdflags G_GNUC_UNUSED)
+                    unsigned int fdflags G_GNUC_UNUSED,
+                    size_t bufferSize G_GNUC_UNUSED,
+                    unsigned int queueDepth G_GNUC_UNUSED)
 {
     virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                    _("virFileWrapperFd unsupported on this platform"));
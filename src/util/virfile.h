@@ -110,9 +110,16 @@ typedef enum {
     VIR_FILE_WRAPPER_NON_BLOCKING   = (1 << 1),
 } virFileWrapperFdFlags;
 
+/* Limits of the I/O buffers of virFileWrapperFd */
+#define VIR_FILE_WRAPPER_BUFFER_ALIGN (64 * 1024)
+#define VIR_FILE_WRAPPER_BUFFER_MAX (256 * 1024 * 1024)
+#define VIR_FILE_WRAPPER_QUEUE_DEPTH_MAX 64
+
 virFileWrapperFdPtr virFileWrapperFdNew(int *fd,
                                         const char *name,
-                                        unsigned int flags)
+                                        unsigned int flags,
+                                        size_t bufferSize,
+                                        unsigned int queueDepth)
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) G_GNUC_WARN_UNUSED_RESULT;
 
 int virFileWrapperFdClose(virFileWrapperFdPtr dfd);
@@ -53,14 +53,35 @@ typedef struct _virJSONArray virJSONArray;
 typedef virJSONArray *virJSONArrayPtr;
 
 
+/* Objects with at least this many keys get a hash table index.
+ * Linear scan is faster for smaller ones. */
+#define VIR_JSON_OBJECT_INDEX_THRESHOLD 16
+
+/* Maximum number of distinct keys shared by a single streaming parser */
+#define VIR_JSON_STREAM_PARSER_MAX_KEYS 1024
+
+/* Reference counted key shared by objects created by one parser */
+typedef struct _virJSONSharedKey virJSONSharedKey;
+struct _virJSONSharedKey {
+    gint refs;
+    char str[];
+};
+
 struct _virJSONObjectPair {
     char *key;
+    bool shared; /* @key is the @str member of a virJSONSharedKey */
     virJSONValuePtr value;
 };
 
 struct _virJSONObject {
     size_t npairs;
     virJSONObjectPairPtr pairs;
+
+    /* key -> position in @pairs + 1; NULL for small objects. Kept up to
+     * date by functions modifying the object so that lookups never
+     * change it and concurrent readers need no more locking than
+     * before. */
+    GHashTable *index;
 };
 
 struct _virJSONArray {
@@ -95,6 +116,15 @@ struct _virJSONParser {
     virJSONParserStatePtr state;
     size_t nstate;
     int wrap;
+
+    /* Used only by the streaming parser: top-level values which
+     * were parsed completely and weren't fetched yet */
+    bool stream;
+    /* str -> virJSONSharedKey.str, each holding a reference; NULL
+     * unless keys are shared */
+    GHashTable *keys;
+    virJSONValuePtr *values;
+    size_t nvalues;
 };
 
 
@@ -388,6 +418,110 @@ virJSONValueObjectCreate(virJSONValuePtr *obj, ...)
 }
 
 
+static virJSONSharedKey *
+virJSONSharedKeyFromStr(char *str)
+{
+    return (virJSONSharedKey *) (str - offsetof(virJSONSharedKey, str));
+}
+
+
+static char *
+virJSONSharedKeyRef(char *str)
+{
+    g_atomic_int_inc(&virJSONSharedKeyFromStr(str)->refs);
+    return str;
+}
+
+
+static void
+virJSONSharedKeyUnref(void *str)
+{
+    virJSONSharedKey *key;
+
+    if (!str)
+        return;
+
+    key = virJSONSharedKeyFromStr(str);
+
+    if (g_atomic_int_dec_and_test(&key->refs))
+        g_free(key);
+}
+
+
+static void
+virJSONObjectPairFreeKey(virJSONObjectPairPtr pair)
+{
+    if (pair->shared)
+        virJSONSharedKeyUnref(pair->key);
+    else
+        g_free(pair->key);
+    pair->key = NULL;
+    pair->shared = false;
+}
+
+
+static void
+virJSONObjectDropIndex(virJSONObjectPtr object)
+{
+    if (object->index) {
+        g_hash_table_unref(object->index);
+        object->index = NULL;
+    }
+}
+
+
+/* Has to be called whenever positions of pairs in @object change */
+static void
+virJSONObjectUpdateIndex(virJSONObjectPtr object)
+{
+    size_t i;
+
+    virJSONObjectDropIndex(object);
+
+    if (object->npairs < VIR_JSON_OBJECT_INDEX_THRESHOLD)
+        return;
+
+    object->index = g_hash_table_new(g_str_hash, g_str_equal);
+
+    for (i = 0; i < object->npairs; i++)
+        g_hash_table_insert(object->index, object->pairs[i].key,
+                            GSIZE_TO_POINTER(i + 1));
+}
+
+
+/**
+ * virJSONObjectFindPair:
+ * @object: JSON object
+ * @key: key to look up
+ *
+ * Returns the position of @key in @object or -1 if it isn't present.
+ * Large objects are looked up using their hash table index. @object is
+ * not modified.
+ */
+static ssize_t
+virJSONObjectFindPair(virJSONObjectPtr object,
+                      const char *key)
+{
+    size_t i;
+
+    if (object->index) {
+        gpointer pos;
+
+        if (!(pos = g_hash_table_lookup(object->index, key)))
+            return -1;
+
+        return GPOINTER_TO_SIZE(pos) - 1;
+    }
+
+    for (i = 0; i < object->npairs; i++) {
+        if (STREQ(object->pairs[i].key, key))
+            return i;
+    }
+
+    return -1;
+}
+
+
 void
 virJSONValueFree(virJSONValuePtr value)
 {
@@ -398,10 +532,11 @@ virJSONValueFree(virJSONValuePtr value)
     switch ((virJSONType) value->type) {
     case VIR_JSON_TYPE_OBJECT:
         for (i = 0; i < value->data.object.npairs; i++) {
-            VIR_FREE(value->data.object.pairs[i].key);
+            virJSONObjectPairFreeKey(&value->data.object.pairs[i]);
             virJSONValueFree(value->data.object.pairs[i].value);
         }
         VIR_FREE(value->data.object.pairs);
+        virJSONObjectDropIndex(&value->data.object);
         break;
     case VIR_JSON_TYPE_ARRAY:
         for (i = 0; i < value->data.array.nvalues; i++)
@@ -583,9 +718,10 @@ static int
 virJSONValueObjectInsert(virJSONValuePtr object,
                          const char *key,
                          virJSONValuePtr value,
-                         bool prepend)
+                         bool prepend,
+                         bool shared)
 {
-    virJSONObjectPair pair = { NULL, value };
+    virJSONObjectPair pair = { NULL, false, value };
     int ret = -1;
 
     if (object->type != VIR_JSON_TYPE_OBJECT) {
@@ -599,17 +735,35 @@ virJSONValueObjectInsert(virJSONValuePtr object,
         return -1;
     }
 
-    pair.key = g_strdup(key);
+    if (shared) {
+        pair.key = virJSONSharedKeyRef((char *) key);
+        pair.shared = true;
+    } else {
+        pair.key = g_strdup(key);
+    }
 
     if (prepend) {
         ret = VIR_INSERT_ELEMENT(object->data.object.pairs, 0,
                                  object->data.object.npairs, pair);
+        if (ret == 0)
+            virJSONObjectUpdateIndex(&object->data.object);
     } else {
         ret = VIR_APPEND_ELEMENT(object->data.object.pairs,
                                  object->data.object.npairs, pair);
+
+        if (ret == 0) {
+            size_t last = object->data.object.npairs - 1;
+
+            if (object->data.object.index)
+                g_hash_table_insert(object->data.object.index,
+                                    object->data.object.pairs[last].key,
+                                    GSIZE_TO_POINTER(last + 1));
+            else
+                virJSONObjectUpdateIndex(&object->data.object);
+        }
     }
 
-    VIR_FREE(pair.key);
+    virJSONObjectPairFreeKey(&pair);
     return ret;
 }
 
@@ -619,7 +773,7 @@ virJSONValueObjectAppend(virJSONValuePtr object,
                          const char *key,
                          virJSONValuePtr value)
 {
-    return virJSONValueObjectInsert(object, key, value, false);
+    return virJSONValueObjectInsert(object, key, value, false, false);
 }
 
 
@@ -632,7 +786,7 @@ virJSONValueObjectInsertString(virJSONValuePtr object,
     virJSONValuePtr jvalue = virJSONValueNewString(value);
     if (!jvalue)
         return -1;
-    if (virJSONValueObjectInsert(object, key, jvalue, prepend) < 0) {
+    if (virJSONValueObjectInsert(object, key, jvalue, prepend, false) < 0) {
         virJSONValueFree(jvalue);
         return -1;
     }
@@ -856,17 +1010,13 @@ int
 virJSONValueObjectHasKey(virJSONValuePtr object,
                          const char *key)
 {
-    size_t i;
-
     if (object->type != VIR_JSON_TYPE_OBJECT)
         return -1;
 
-    for (i = 0; i < object->data.object.npairs; i++) {
-        if (STREQ(object->data.object.pairs[i].key, key))
-            return 1;
-    }
+    if (virJSONObjectFindPair(&object->data.object, key) < 0)
+        return 0;
 
-    return 0;
+    return 1;
 }
 
 
@@ -874,17 +1024,15 @@ virJSONValuePtr
 virJSONValueObjectGet(virJSONValuePtr object,
                       const char *key)
 {
-    size_t i;
+    ssize_t i;
 
     if (object->type != VIR_JSON_TYPE_OBJECT)
         return NULL;
 
-    for (i = 0; i < object->data.object.npairs; i++) {
-        if (STREQ(object->data.object.pairs[i].key, key))
-            return object->data.object.pairs[i].value;
-    }
+    if ((i = virJSONObjectFindPair(&object->data.object, key)) < 0)
+        return NULL;
 
-    return NULL;
+    return object->data.object.pairs[i].value;
 }
 
 
@@ -892,21 +1040,21 @@ static virJSONValuePtr
 virJSONValueObjectSteal(virJSONValuePtr object,
                         const char *key)
 {
-    size_t i;
+    ssize_t i;
     virJSONValuePtr obj = NULL;
 
     if (object->type != VIR_JSON_TYPE_OBJECT)
         return NULL;
 
-    for (i = 0; i < object->data.object.npairs; i++) {
-        if (STREQ(object->data.object.pairs[i].key, key)) {
-            obj = g_steal_pointer(&object->data.object.pairs[i].value);
-            VIR_FREE(object->data.object.pairs[i].key);
-            VIR_DELETE_ELEMENT(object->data.object.pairs, i,
-                               object->data.object.npairs);
-            break;
-        }
-    }
+    if ((i = virJSONObjectFindPair(&object->data.object, key)) < 0)
+        return NULL;
+
+    obj = g_steal_pointer(&object->data.object.pairs[i].value);
+    virJSONObjectDropIndex(&object->data.object);
+    virJSONObjectPairFreeKey(&object->data.object.pairs[i]);
+    VIR_DELETE_ELEMENT(object->data.object.pairs, i,
+                       object->data.object.npairs);
+    virJSONObjectUpdateIndex(&object->data.object);
 
     return obj;
 }
@@ -974,7 +1122,7 @@ virJSONValueObjectRemoveKey(virJSONValuePtr object,
                             const char *key,
                             virJSONValuePtr *value)
 {
-    size_t i;
+    ssize_t i;
 
     if (value)
         *value = NULL;
@@ -982,21 +1130,20 @@ virJSONValueObjectRemoveKey(virJSONValuePtr object,
     if (object->type != VIR_JSON_TYPE_OBJECT)
         return -1;
 
-    for (i = 0; i < object->data.object.npairs; i++) {
-        if (STREQ(object->data.object.pairs[i].key, key)) {
-            if (value) {
-                *value = object->data.object.pairs[i].value;
-                object->data.object.pairs[i].value = NULL;
-            }
-            VIR_FREE(object->data.object.pairs[i].key);
-            virJSONValueFree(object->data.object.pairs[i].value);
-            VIR_DELETE_ELEMENT(object->data.object.pairs, i,
-                               object->data.object.npairs);
-            return 1;
-        }
-    }
+    if ((i = virJSONObjectFindPair(&object->data.object, key)) < 0)
+        return 0;
 
-    return 0;
+    if (value) {
+        *value = object->data.object.pairs[i].value;
+        object->data.object.pairs[i].value = NULL;
+    }
+    virJSONObjectDropIndex(&object->data.object);
+    virJSONObjectPairFreeKey(&object->data.object.pairs[i]);
+    virJSONValueFree(object->data.object.pairs[i].value);
+    VIR_DELETE_ELEMENT(object->data.object.pairs, i,
+                       object->data.object.npairs);
+    virJSONObjectUpdateIndex(&object->data.object);
+    return 1;
 }
 
 
@@ -1564,6 +1711,44 @@ virJSONValueCopy(const virJSONValue *in)
 
 
 #if WITH_YAJL
+static char *
+virJSONSharedKeyNew(const char *str)
+{
+    size_t len = strlen(str);
+    virJSONSharedKey *key = g_malloc(sizeof(*key) + len + 1);
+
+    key->refs = 1;
+    memcpy(key->str, str, len + 1);
+
+    return key->str;
+}
+
+
+/* Returns a shared copy of @key owned by @parser or NULL if keys aren't
+ * shared or the table of keys is full. */
+static char *
+virJSONParserGetSharedKey(virJSONParserPtr parser,
+                          const char *key)
+{
+    char *ret;
+
+    if (!parser->keys)
+        return NULL;
+
+    if ((ret = g_hash_table_lookup(parser->keys, key)))
+        return ret;
+
+    /* keys come from the other side of the stream, don't let them
+     * consume unbounded amount of memory */
+    if (g_hash_table_size(parser->keys) >= VIR_JSON_STREAM_PARSER_MAX_KEYS)
+        return NULL;
+
+    ret = virJSONSharedKeyNew(key);
+    g_hash_table_insert(parser->keys, ret, ret);
+    return ret;
+}
+
+
 static int
 virJSONParserInsertValue(virJSONParserPtr parser,
                          virJSONValuePtr value)
@@ -1586,9 +1771,11 @@ virJSONParserInsertValue(virJSONParserPtr parser,
                 return -1;
             }
 
-            if (virJSONValueObjectAppend(state->value,
-                                         state->key,
-                                         value) < 0)
+            char *shared = virJSONParserGetSharedKey(parser, state->key);
+
+            if (virJSONValueObjectInsert(state->value,
+                                         shared ? shared : state->key,
+                                         value, false, !!shared) < 0)
                 return -1;
 
             VIR_FREE(state->key);
@@ -1615,6 +1802,21 @@ virJSONParserInsertValue(virJSONParserPtr parser,
 }
 
 
+/* In streaming mode move a completely parsed top-level value to the
+ * queue of values ready to be fetched by virJSONStreamParserNext */
+static int
+virJSONParserFinishValue(virJSONParserPtr parser)
+{
+    if (!parser->stream || parser->nstate || !parser->head)
+        return 0;
+
+    if (VIR_APPEND_ELEMENT(parser->values, parser->nvalues, parser->head) < 0)
+        return -1;
+
+    return 0;
+}
+
+
 static int
 virJSONParserHandleNull(void *ctx)
 {
@@ -1631,6 +1833,9 @@ virJSONParserHandleNull(void *ctx)
         return 0;
     }
 
+    if (virJSONParserFinishValue(parser) < 0)
+        return 0;
+
     return 1;
 }
 
@@ -1652,6 +1857,9 @@ virJSONParserHandleBoolean(void *ctx,
         return 0;
     }
 
+    if (virJSONParserFinishValue(parser) < 0)
+        return 0;
+
     return 1;
 }
 
@@ -1679,6 +1887,9 @@ virJSONParserHandleNumber(void *ctx,
         return 0;
     }
 
+    if (virJSONParserFinishValue(parser) < 0)
+        return 0;
+
     return 1;
 }
 
@@ -1702,6 +1913,9 @@ virJSONParserHandleString(void *ctx,
         return 0;
     }
 
+    if (virJSONParserFinishValue(parser) < 0)
+        return 0;
+
     return 1;
 }
 
@@ -1772,6 +1986,9 @@ virJSONParserHandleEndMap(void *ctx)
 
     VIR_DELETE_ELEMENT(parser->state, parser->nstate - 1, parser->nstate);
 
+    if (virJSONParserFinishValue(parser) < 0)
+        return 0;
+
     return 1;
 }
 
@@ -1820,6 +2037,9 @@ virJSONParserHandleEndArray(void *ctx)
 
     VIR_DELETE_ELEMENT(parser->state, parser->nstate - 1, parser->nstate);
 
+    if (virJSONParserFinishValue(parser) < 0)
+        return 0;
+
     return 1;
 }
 
@@ -1839,7 +2059,6 @@ static const yajl_callbacks parserCallbacks = {
 };
 
 
-/* XXX add an incremental streaming parser - yajl trivially supports it */
 virJSONValuePtr
 virJSONValueFromString(const char *jsonstring)
 {
@@ -1899,6 +2118,144 @@ virJSONValueFromString(const char *jsonstring)
 }
 
 
+struct _virJSONStreamParser {
+    yajl_handle hand;
+    virJSONParser parser;
+    size_t next; /* index of the next value in parser.values to fetch */
+};
+
+
+/**
+ * virJSONStreamParserNew:
+ * @flags: bitwise-OR of virJSONStreamParserFlags
+ *
+ * Creates a new incremental JSON parser. Data can be passed to the parser
+ * in arbitrary chunks using virJSONStreamParserFeed and the parser builds
+ * virJSONValue trees as the data arrives. Any number of whitespace
+ * separated top-level values can be parsed by a single parser. Complete
+ * values are retrieved using virJSONStreamParserNext.
+ *
+ * If VIR_JSON_STREAM_PARSER_INTERN_KEYS is set in @flags, objects created
+ * by the parser share reference counted copies of their keys, so every
+ * distinct key is allocated only once. The table of shared keys belongs
+ * to the parser and holds at most VIR_JSON_STREAM_PARSER_MAX_KEYS keys,
+ * further keys are copied for each object. Shared keys are freed once
+ * both the parser and all values using them are freed.
+ *
+ * Returns the new parser or NULL on error.
+ */
+virJSONStreamParserPtr
+virJSONStreamParserNew(unsigned int flags)
+{
+    g_autoptr(virJSONStreamParser) ret = g_new0(virJSONStreamParser, 1);
+
+    virCheckFlags(VIR_JSON_STREAM_PARSER_INTERN_KEYS, NULL);
+
+    ret->parser.stream = true;
+    if (flags & VIR_JSON_STREAM_PARSER_INTERN_KEYS)
+        ret->parser.keys = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                 NULL, virJSONSharedKeyUnref);
+
+    if (!(ret->hand = yajl_alloc(&parserCallbacks, NULL, &ret->parser))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Unable to create JSON parser"));
+        return NULL;
+    }
+
+    yajl_config(ret->hand, yajl_allow_multiple_values, 1);
+
+    return g_steal_pointer(&ret);
+}
+
+
+void
+virJSONStreamParserFree(virJSONStreamParserPtr parser)
+{
+    size_t i;
+
+    if (!parser)
+        return;
+
+    if (parser->hand)
+        yajl_free(parser->hand);
+
+    for (i = 0; i < parser->parser.nstate; i++)
+        VIR_FREE(parser->parser.state[i].key);
+    VIR_FREE(parser->parser.state);
+
+    for (i = parser->next; i < parser->parser.nvalues; i++)
+        virJSONValueFree(parser->parser.values[i]);
+    VIR_FREE(parser->parser.values);
+
+    virJSONValueFree(parser->parser.head);
+    if (parser->parser.keys)
+        g_hash_table_unref(parser->parser.keys);
+    g_free(parser);
+}
+
+
+/**
+ * virJSONStreamParserFeed:
+ * @parser: streaming parser
+ * @data: chunk of JSON text
+ * @len: length of @data
+ *
+ * Passes @len bytes of @data to @parser. The chunk doesn't have to end
+ * on a token boundary, incomplete tokens are kept by the parser until
+ * the rest arrives. Values completed by this chunk can be fetched using
+ * virJSONStreamParserNext. Once an error is reported the parser must
+ * not be used any more.
+ *
+ * Returns 0 on success, -1 on error (with error reported).
+ */
+int
+virJSONStreamParserFeed(virJSONStreamParserPtr parser,
+                        const char *data,
+                        size_t len)
+{
+    if (yajl_parse(parser->hand, (const unsigned char *)data, len) != yajl_status_ok) {
+        unsigned char *errstr = yajl_get_error(parser->hand, 1,
+                                               (const unsigned char *)data,
+                                               len);
+
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("cannot parse json %.*s: %s"),
+                       (int)len, data, (const char *)errstr);
+        yajl_free_error(parser->hand, errstr);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * virJSONStreamParserNext:
+ * @parser: streaming parser
+ *
+ * Returns the next completely parsed top-level value (caller owns the
+ * returned value) or NULL if there's none. The values are returned in
+ * the order they appeared in the input.
+ */
+virJSONValuePtr
+virJSONStreamParserNext(virJSONStreamParserPtr parser)
+{
+    virJSONValuePtr ret;
+
+    if (parser->next == parser->parser.nvalues) {
+        if (parser->next) {
+            VIR_FREE(parser->parser.values);
+            parser->parser.nvalues = parser->next = 0;
+        }
+        return NULL;
+    }
+
+    ret = g_steal_pointer(&parser->parser.values[parser->next++]);
+
+    return ret;
+}
+
+
 static int
 virJSONValueToStringOne(virJSONValuePtr object,
                         yajl_gen g)
@@ -2016,6 +2373,39 @@ virJSONValueFromString(const char *jsonstring G_GNUC_UNUSED)
 }
 
 
+virJSONStreamParserPtr
+virJSONStreamParserNew(unsigned int flags G_GNUC_UNUSED)
+{
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("No JSON parser implementation is available"));
+    return NULL;
+}
+
+
+void
+virJSONStreamParserFree(virJSONStreamParserPtr parser G_GNUC_UNUSED)
+{
+}
+
+
+int
+virJSONStreamParserFeed(virJSONStreamParserPtr parser G_GNUC_UNUSED,
+                        const char *data G_GNUC_UNUSED,
+                        size_t len G_GNUC_UNUSED)
+{
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("No JSON parser implementation is available"));
+    return -1;
+}
+
+
+virJSONValuePtr
+virJSONStreamParserNext(virJSONStreamParserPtr parser G_GNUC_UNUSED)
+{
+    return NULL;
+}
+
+
 int
 virJSONValueToBuffer(virJSONValuePtr object G_GNUC_UNUSED,
                      virBufferPtr buf G_GNUC_UNUSED,
@@ -2189,9 +2579,10 @@ virJSONValueObjectDeflattenArrays(virJSONValuePtr json)
     }
 
     for (i = 0; i < obj->npairs; i++)
-        g_free(obj->pairs[i].key);
+        virJSONObjectPairFreeKey(obj->pairs + i);
 
     g_free(json->data.object.pairs);
+    virJSONObjectDropIndex(obj);
 
     i = obj->npairs;
     json->type = VIR_JSON_TYPE_ARRAY;
@@ -145,6 +145,23 @@ int virJSONValueObjectRemoveKey(virJSONValuePtr object, const char *key,
 int virJSONValueArrayAppendString(virJSONValuePtr object, const char *value);
 
 virJSONValuePtr virJSONValueFromString(const char *jsonstring);
+
+typedef struct _virJSONStreamParser virJSONStreamParser;
+typedef virJSONStreamParser *virJSONStreamParserPtr;
+
+typedef enum {
+    /* share copies of object keys among parsed objects */
+    VIR_JSON_STREAM_PARSER_INTERN_KEYS = 1 << 0,
+} virJSONStreamParserFlags;
+
+virJSONStreamParserPtr virJSONStreamParserNew(unsigned int flags);
+void virJSONStreamParserFree(virJSONStreamParserPtr parser);
+int virJSONStreamParserFeed(virJSONStreamParserPtr parser,
+                            const char *data,
+                            size_t len)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2);
+virJSONValuePtr virJSONStreamParserNext(virJSONStreamParserPtr parser)
+    ATTRIBUTE_NONNULL(1);
 char *virJSONValueToString(virJSONValuePtr object,
                            bool pretty);
 int virJSONValueToBuffer(virJSONValuePtr object,
@@ -167,3 +184,4 @@ char *virJSONStringReformat(const char *jsonstr, bool pretty);
 virJSONValuePtr virJSONValueObjectDeflatten(virJSONValuePtr json);
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(virJSONValue, virJSONValueFree);
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(virJSONStreamParser, virJSONStreamParserFree);
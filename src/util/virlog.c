@@ -609,6 +609,31 @@ virLogVMessage(virLogSourcePtr source,
 }
 
 
+/**
+ * virLogSourceIsEnabled:
+ * @source: where messages would be coming from
+ * @priority: the priority level
+ *
+ * Checks whether messages of @priority from @source pass the configured
+ * filters. Useful to avoid formatting expensive arguments of messages
+ * which would be discarded anyway.
+ *
+ * Returns true if such messages would be logged.
+ */
+bool
+virLogSourceIsEnabled(virLogSourcePtr source,
+                      virLogPriority priority)
+{
+    if (virLogInitialize() < 0)
+        return false;
+
+    if (source->serial < virLogFiltersSerial)
+        virLogSourceUpdate(source);
+
+    return priority >= source->priority;
+}
+
+
 /**
  * virLogMessage:
  * @source: where is that message coming from
@@ -177,6 +177,8 @@ void virLogMessage(virLogSourcePtr source,
                    const char *funcname,
                    virLogMetadataPtr metadata,
                    const char *fmt, ...) G_GNUC_PRINTF(7, 8);
+bool virLogSourceIsEnabled(virLogSourcePtr source,
+                           virLogPriority priority);
 
 bool virLogProbablyLogMessage(const char *str);
 virLogOutputPtr virLogOutputNew(virLogOutputFunc f,
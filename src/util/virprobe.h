@@ -95,6 +95,8 @@
         PROBE_EXPAND(LIBVIRT_ ## NAME, \
                      VIR_ADD_CASTS(__VA_ARGS__)); \
     }
+
+# define PROBE_ENABLED(NAME) LIBVIRT_ ## NAME ## _ENABLED()
 #else
 # define PROBE(NAME, FMT, ...) \
     VIR_INFO_INT(&virLogSelf, \
@@ -102,4 +104,6 @@
                  #NAME ": " FMT, __VA_ARGS__);
 
 # define PROBE_QUIET(NAME, FMT, ...)
+
+# define PROBE_ENABLED(NAME) false
 #endif
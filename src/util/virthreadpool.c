@@ -29,13 +29,17 @@
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
+/* Upper bound on the number of per-CPU job queues */
+#define VIR_THREAD_POOL_MAX_QUEUES 16
+
 typedef struct _virThreadPoolJob virThreadPoolJob;
 typedef virThreadPoolJob *virThreadPoolJobPtr;
 
 struct _virThreadPoolJob {
-    virThreadPoolJobPtr prev;
     virThreadPoolJobPtr next;
     unsigned int priority;
+    gint64 queued; /* monotonic time the job was queued at */
+    unsigned int seq; /* orders jobs of different queues */
 
     void *data;
 };
@@ -44,32 +48,65 @@ typedef struct _virThreadPoolJobList virThreadPoolJobList;
 typedef virThreadPoolJobList *virThreadPoolJobListPtr;
 
 struct _virThreadPoolJobList {
+    virMutex lock;
     virThreadPoolJobPtr head;
     virThreadPoolJobPtr tail;
-    virThreadPoolJobPtr firstPrio;
+
+    /* statistics, protected by @lock */
+    unsigned long long jobs;
+    unsigned long long waitTime;
+    unsigned long long steals;
 };
 
 
+/*
+ * Jobs are spread over several queues, each with its own lock, so that
+ * workers picking up jobs don't contend on a single mutex. Every worker has
+ * a home queue it drains first before stealing from the other ones. Jobs with
+ * priority go to a separate queue which is the only one priority workers look
+ * at. Other workers take a priority job only if it was queued before the head
+ * of their home queue, which keeps the FIFO order across both kinds of jobs
+ * within a queue. There's no global order between the per-CPU
+ * queues though, so a job may run before one queued slightly earlier on
+ * another CPU.
+ *
+ * @mutex only protects the worker bookkeeping and is used by idle workers to
+ * sleep on @cond / @prioCond. The queue depths and free worker counters are
+ * accessed atomically: a worker going to sleep increments its free counter
+ * before re-checking the depth and virThreadPoolSendJob increments the depth
+ * before checking the free counters, so a wakeup is never lost.
+ */
 struct _virThreadPool {
-    bool quit;
+    int quit;
 
     virThreadPoolJobFunc jobFunc;
     const char *jobName;
     void *jobOpaque;
-    virThreadPoolJobList jobList;
-    size_t jobQueueDepth;
+
+    size_t nQueues;
+    virThreadPoolJobListPtr queues;
+    virThreadPoolJobList prioQueue;
+    unsigned int nextQueue;
+    unsigned int jobSeq;
+    int jobQueueDepth;
+    int prioQueueDepth;
 
     virMutex mutex;
     virCond cond;
     virCond quit_cond;
 
+    /* set when the pool has more workers than allowed */
+    int shrink;
+
     size_t maxWorkers;
     size_t minWorkers;
-    size_t freeWorkers;
+    int freeWorkers;
     size_t nWorkers;
     virThreadPtr workers;
+    size_t workerSeq;
 
     size_t maxPrioWorkers;
+    int freePrioWorkers;
     size_t nPrioWorkers;
     virThreadPtr prioWorkers;
     virCond prioCond;
@@ -79,6 +116,7 @@ struct virThreadPoolWorkerData {
     virThreadPoolPtr pool;
     virCondPtr cond;
     bool priority;
+    size_t home;
 };
 
 /* Test whether the worker needs to quit if the current number of workers @count
@@ -89,80 +127,187 @@ static inline bool virThreadPoolWorkerQuitHelper(size_t count, size_t limit)
     return count > limit;
 }
 
+/* Must be called with pool->mutex held whenever the number of workers or
+ * the limits change */
+static void
+virThreadPoolUpdateShrink(virThreadPoolPtr pool)
+{
+    g_atomic_int_set(&pool->shrink,
+                     pool->nWorkers > pool->maxWorkers ||
+                     pool->nPrioWorkers > pool->maxPrioWorkers);
+}
+
+
+static void
+virThreadPoolJobListPush(virThreadPoolPtr pool,
+                         virThreadPoolJobListPtr list,
+                         virThreadPoolJobPtr job)
+{
+    virMutexLock(&list->lock);
+
+    job->queued = g_get_monotonic_time();
+    job->seq = g_atomic_int_add(&pool->jobSeq, 1);
+    if (list->tail)
+        list->tail->next = job;
+    else
+        list->head = job;
+    list->tail = job;
+
+    g_atomic_int_inc(&pool->jobQueueDepth);
+    if (job->priority)
+        g_atomic_int_inc(&pool->prioQueueDepth);
+
+    virMutexUnlock(&list->lock);
+}
+
+
+static virThreadPoolJobPtr
+virThreadPoolJobListPop(virThreadPoolPtr pool,
+                        virThreadPoolJobListPtr list,
+                        bool steal)
+{
+    virThreadPoolJobPtr job;
+
+    virMutexLock(&list->lock);
+
+    if ((job = list->head)) {
+        if (!(list->head = job->next))
+            list->tail = NULL;
+
+        list->jobs++;
+        list->waitTime += g_get_monotonic_time() - job->queued;
+        if (steal)
+            list->steals++;
+
+        g_atomic_int_add(&pool->jobQueueDepth, -1);
+        if (job->priority)
+            g_atomic_int_add(&pool->prioQueueDepth, -1);
+    }
+
+    virMutexUnlock(&list->lock);
+
+    return job;
+}
+
+
+/* Returns true and fills @seq with the sequence number of the first job
+ * of @list, or returns false if @list is empty */
+static bool
+virThreadPoolJobListHeadSeq(virThreadPoolJobListPtr list,
+                            unsigned int *seq)
+{
+    bool ret = false;
+
+    virMutexLock(&list->lock);
+    if (list->head) {
+        *seq = list->head->seq;
+        ret = true;
+    }
+    virMutexUnlock(&list->lock);
+
+    return ret;
+}
+
+
+/* Take the next job for a worker whose home queue is @home. Priority workers
+ * only take priority jobs, the others take whichever of the first priority
+ * job and the first job of their home queue was queued earlier. */
+static virThreadPoolJobPtr
+virThreadPoolJobTake(virThreadPoolPtr pool,
+                     size_t home,
+                     bool priority)
+{
+    virThreadPoolJobPtr job;
+    size_t i;
+
+    if (g_atomic_int_get(&pool->prioQueueDepth) > 0) {
+        unsigned int prioSeq;
+        unsigned int homeSeq;
+        bool first = true;
+
+        /* The priority queue has to be looked at first: any job which
+         * was queued before its head is already in the home queue then */
+        if (!priority &&
+            virThreadPoolJobListHeadSeq(&pool->prioQueue, &prioSeq) &&
+            virThreadPoolJobListHeadSeq(&pool->queues[home], &homeSeq))
+            first = (int) (prioSeq - homeSeq) < 0;
+
+        if (first &&
+            (job = virThreadPoolJobListPop(pool, &pool->prioQueue, false)))
+            return job;
+    }
+
+    if (priority)
+        return NULL;
+
+    for (i = 0; i < pool->nQueues; i++) {
+        virThreadPoolJobListPtr list = &pool->queues[(home + i) % pool->nQueues];
+
+        if ((job = virThreadPoolJobListPop(pool, list, i > 0)))
+            return job;
+    }
+
+    /* The home queue may have been drained by a thief meanwhile */
+    if (g_atomic_int_get(&pool->prioQueueDepth) > 0)
+        return virThreadPoolJobListPop(pool, &pool->prioQueue, false);
+
+    return NULL;
+}
+
+
 static void virThreadPoolWorker(void *opaque)
 {
     struct virThreadPoolWorkerData *data = opaque;
     virThreadPoolPtr pool = data->pool;
     virCondPtr cond = data->cond;
     bool priority = data->priority;
+    size_t home = data->home;
     size_t *curWorkers = priority ? &pool->nPrioWorkers : &pool->nWorkers;
     size_t *maxLimit = priority ? &pool->maxPrioWorkers : &pool->maxWorkers;
+    int *freeWorkers = priority ? &pool->freePrioWorkers : &pool->freeWorkers;
+    int *queueDepth = priority ? &pool->prioQueueDepth : &pool->jobQueueDepth;
     virThreadPoolJobPtr job = NULL;
 
     VIR_FREE(data);
 
-    virMutexLock(&pool->mutex);
-
     while (1) {
         /* In order to support async worker termination, we need ensure that
          * both busy and free workers know if they need to terminated. Thus,
-         * busy workers need to check for this fact before they start waiting for
-         * another job (and before taking another one from the queue); and
-         * free workers need to check for this right after waking up.
+         * busy workers need to check for this fact before they take another
+         * job from the queue; and free workers need to check for this right
+         * after waking up.
          */
-        if (virThreadPoolWorkerQuitHelper(*curWorkers, *maxLimit))
-            goto out;
-        while (!pool->quit &&
-               ((!priority && !pool->jobList.head) ||
-                (priority && !pool->jobList.firstPrio))) {
-            if (!priority)
-                pool->freeWorkers++;
-            if (virCondWait(cond, &pool->mutex) < 0) {
-                if (!priority)
-                    pool->freeWorkers--;
-                goto out;
-            }
-            if (!priority)
-                pool->freeWorkers--;
-
+        if (g_atomic_int_get(&pool->shrink)) {
+            virMutexLock(&pool->mutex);
             if (virThreadPoolWorkerQuitHelper(*curWorkers, *maxLimit))
                 goto out;
+            virMutexUnlock(&pool->mutex);
         }
 
-        if (pool->quit)
-            break;
+        if (g_atomic_int_get(&pool->quit)) {
+            virMutexLock(&pool->mutex);
+            goto out;
+        }
 
-        if (priority) {
-            job = pool->jobList.firstPrio;
-        } else {
-            job = pool->jobList.head;
+        if (g_atomic_int_get(queueDepth) > 0 &&
+            (job = virThreadPoolJobTake(pool, home, priority))) {
+            (pool->jobFunc)(job->data, pool->jobOpaque);
+            VIR_FREE(job);
+            continue;
         }
 
-        if (job == pool->jobList.firstPrio) {
-            virThreadPoolJobPtr tmp = job->next;
-            while (tmp) {
-                if (tmp->priority)
-                    break;
-                tmp = tmp->next;
+        virMutexLock(&pool->mutex);
+        g_atomic_int_inc(freeWorkers);
+        while (!g_atomic_int_get(&pool->quit) &&
+               g_atomic_int_get(queueDepth) == 0) {
+            if (virCondWait(cond, &pool->mutex) < 0 ||
+                virThreadPoolWorkerQuitHelper(*curWorkers, *maxLimit)) {
+                g_atomic_int_add(freeWorkers, -1);
+                goto out;
             }
-            pool->jobList.firstPrio = tmp;
         }
-
-        if (job->prev)
-            job->prev->next = job->next;
-        else
-            pool->jobList.head = job->next;
-        if (job->next)
-            job->next->prev = job->prev;
-        else
-            pool->jobList.tail = job->prev;
-
-        pool->jobQueueDepth--;
-
+        g_atomic_int_add(freeWorkers, -1);
         virMutexUnlock(&pool->mutex);
-        (pool->jobFunc)(job->data, pool->jobOpaque);
-        VIR_FREE(job);
-        virMutexLock(&pool->mutex);
     }
 
  out:
@@ -170,6 +315,7 @@ static void virThreadPoolWorker(void *opaque)
         pool->nPrioWorkers--;
     else
         pool->nWorkers--;
+    virThreadPoolUpdateShrink(pool);
     if (pool->nWorkers == 0 && pool->nPrioWorkers == 0)
         virCondSignal(&pool->quit_cond);
     virMutexUnlock(&pool->mutex);
@@ -194,6 +340,7 @@ virThreadPoolExpand(virThreadPoolPtr pool, size_t gain, bool priority)
         data->pool = pool;
         data->cond = priority ? &pool->prioCond : &pool->cond;
         data->priority = priority;
+        data->home = pool->workerSeq++;
 
         if (priority)
             name = g_strdup_printf("prio-%s", pool->jobName);
@@ -228,6 +375,7 @@ virThreadPoolNewFull(size_t minWorkers,
                      void *opaque)
 {
     virThreadPoolPtr pool;
+    size_t nQueues;
 
     if (minWorkers > maxWorkers)
         minWorkers = maxWorkers;
@@ -235,12 +383,25 @@ virThreadPoolNewFull(size_t minWorkers,
     if (VIR_ALLOC(pool) < 0)
         return NULL;
 
-    pool->jobList.tail = pool->jobList.head = NULL;
+    if (virMutexInit(&pool->prioQueue.lock) < 0) {
+        VIR_FREE(pool);
+        return NULL;
+    }
 
     pool->jobFunc = func;
     pool->jobName = name;
     pool->jobOpaque = opaque;
 
+    /* A pool with a single worker keeps a single queue so that jobs
+     * are still processed in the order they were sent. */
+    nQueues = MIN(g_get_num_processors(), VIR_THREAD_POOL_MAX_QUEUES);
+    nQueues = MAX(MIN(nQueues, maxWorkers), 1);
+    pool->queues = g_new0(virThreadPoolJobList, nQueues);
+    for (pool->nQueues = 0; pool->nQueues < nQueues; pool->nQueues++) {
+        if (virMutexInit(&pool->queues[pool->nQueues].lock) < 0)
+            goto error;
+    }
+
     if (virMutexInit(&pool->mutex) < 0)
         goto error;
     if (virCondInit(&pool->cond) < 0)
@@ -271,16 +432,32 @@ virThreadPoolNewFull(size_t minWorkers,
 
 }
 
-void virThreadPoolFree(virThreadPoolPtr pool)
+
+static void
+virThreadPoolJobListClear(virThreadPoolJobListPtr list)
 {
     virThreadPoolJobPtr job;
+
+    while ((job = list->head)) {
+        list->head = job->next;
+        VIR_FREE(job);
+    }
+    list->tail = NULL;
+
+    virMutexDestroy(&list->lock);
+}
+
+
+void virThreadPoolFree(virThreadPoolPtr pool)
+{
     bool priority = false;
+    size_t i;
 
     if (!pool)
         return;
 
     virMutexLock(&pool->mutex);
-    pool->quit = true;
+    g_atomic_int_set(&pool->quit, 1);
     if (pool->nWorkers > 0)
         virCondBroadcast(&pool->cond);
     if (pool->nPrioWorkers > 0) {
@@ -291,10 +468,10 @@ void virThreadPoolFree(virThreadPoolPtr pool)
     while (pool->nWorkers > 0 || pool->nPrioWorkers > 0)
         ignore_value(virCondWait(&pool->quit_cond, &pool->mutex));
 
-    while ((job = pool->jobList.head)) {
-        pool->jobList.head = pool->jobList.head->next;
-        VIR_FREE(job);
-    }
+    for (i = 0; i < pool->nQueues; i++)
+        virThreadPoolJobListClear(&pool->queues[i]);
+    VIR_FREE(pool->queues);
+    virThreadPoolJobListClear(&pool->prioQueue);
 
     VIR_FREE(pool->workers);
     virMutexUnlock(&pool->mutex);
@@ -355,26 +532,89 @@ size_t virThreadPoolGetCurrentWorkers(virThreadPoolPtr pool)
 
 size_t virThreadPoolGetFreeWorkers(virThreadPoolPtr pool)
 {
-    size_t ret;
+    return g_atomic_int_get(&pool->freeWorkers);
+}
 
-    virMutexLock(&pool->mutex);
-    ret = pool->freeWorkers;
-    virMutexUnlock(&pool->mutex);
+size_t virThreadPoolGetJobQueueDepth(virThreadPoolPtr pool)
+{
+    return g_atomic_int_get(&pool->jobQueueDepth);
+}
+
+
+typedef enum {
+    VIR_THREAD_POOL_STAT_JOBS,
+    VIR_THREAD_POOL_STAT_WAIT_TIME,
+    VIR_THREAD_POOL_STAT_STEALS,
+} virThreadPoolStat;
+
+static unsigned long long
+virThreadPoolJobListGetStat(virThreadPoolJobListPtr list,
+                            virThreadPoolStat stat)
+{
+    unsigned long long ret = 0;
+
+    virMutexLock(&list->lock);
+    switch (stat) {
+    case VIR_THREAD_POOL_STAT_JOBS:
+        ret = list->jobs;
+        break;
+    case VIR_THREAD_POOL_STAT_WAIT_TIME:
+        ret = list->waitTime;
+        break;
+    case VIR_THREAD_POOL_STAT_STEALS:
+        ret = list->steals;
+        break;
+    }
+    virMutexUnlock(&list->lock);
 
     return ret;
 }
 
-size_t virThreadPoolGetJobQueueDepth(virThreadPoolPtr pool)
+static unsigned long long
+virThreadPoolGetStat(virThreadPoolPtr pool,
+                     virThreadPoolStat stat)
 {
-    size_t ret;
+    unsigned long long ret;
+    size_t i;
 
-    virMutexLock(&pool->mutex);
-    ret = pool->jobQueueDepth;
-    virMutexUnlock(&pool->mutex);
+    ret = virThreadPoolJobListGetStat(&pool->prioQueue, stat);
+    for (i = 0; i < pool->nQueues; i++)
+        ret += virThreadPoolJobListGetStat(&pool->queues[i], stat);
 
     return ret;
 }
 
+/**
+ * virThreadPoolGetJobCount:
+ *
+ * Returns the number of jobs picked up by workers so far.
+ */
+unsigned long long virThreadPoolGetJobCount(virThreadPoolPtr pool)
+{
+    return virThreadPoolGetStat(pool, VIR_THREAD_POOL_STAT_JOBS);
+}
+
+/**
+ * virThreadPoolGetJobWaitTime:
+ *
+ * Returns the total time in microseconds the jobs picked up by workers
+ * so far spent waiting in the queue.
+ */
+unsigned long long virThreadPoolGetJobWaitTime(virThreadPoolPtr pool)
+{
+    return virThreadPoolGetStat(pool, VIR_THREAD_POOL_STAT_WAIT_TIME);
+}
+
+/**
+ * virThreadPoolGetJobSteals:
+ *
+ * Returns the number of jobs a worker took from a queue other than its own.
+ */
+unsigned long long virThreadPoolGetJobSteals(virThreadPoolPtr pool)
+{
+    return virThreadPoolGetStat(pool, VIR_THREAD_POOL_STAT_STEALS);
+}
+
 /*
  * @priority - job priority
  * Return: 0 on success, -1 otherwise
@@ -384,45 +624,52 @@ int virThreadPoolSendJob(virThreadPoolPtr pool,
                          void *jobData)
 {
     virThreadPoolJobPtr job;
+    virThreadPoolJobListPtr list;
 
-    virMutexLock(&pool->mutex);
-    if (pool->quit)
-        goto error;
+    if (g_atomic_int_get(&pool->quit))
+        return -1;
 
-    if (pool->freeWorkers - pool->jobQueueDepth <= 0 &&
-        pool->nWorkers < pool->maxWorkers &&
-        virThreadPoolExpand(pool, 1, false) < 0)
-        goto error;
+    /* Spawn another worker if there's not enough free ones to pick up
+     * the jobs already queued */
+    if (g_atomic_int_get(&pool->freeWorkers) <=
+        g_atomic_int_get(&pool->jobQueueDepth)) {
+        int rc = 0;
+
+        virMutexLock(&pool->mutex);
+        if (pool->nWorkers < pool->maxWorkers)
+            rc = virThreadPoolExpand(pool, 1, false);
+        virMutexUnlock(&pool->mutex);
+
+        if (rc < 0)
+            return -1;
+    }
 
     if (VIR_ALLOC(job) < 0)
-        goto error;
+        return -1;
 
     job->data = jobData;
     job->priority = priority;
 
-    job->prev = pool->jobList.tail;
-    if (pool->jobList.tail)
-        pool->jobList.tail->next = job;
-    pool->jobList.tail = job;
-
-    if (!pool->jobList.head)
-        pool->jobList.head = job;
-
-    if (priority && !pool->jobList.firstPrio)
-        pool->jobList.firstPrio = job;
+    if (priority) {
+        list = &pool->prioQueue;
+    } else {
+        unsigned int idx = g_atomic_int_add(&pool->nextQueue, 1);
+        list = &pool->queues[idx % pool->nQueues];
+    }
 
-    pool->jobQueueDepth++;
+    virThreadPoolJobListPush(pool, list, job);
 
-    virCondSignal(&pool->cond);
-    if (priority)
-        virCondSignal(&pool->prioCond);
+    if (g_atomic_int_get(&pool->freeWorkers) > 0 ||
+        (priority && g_atomic_int_get(&pool->freePrioWorkers) > 0)) {
+        virMutexLock(&pool->mutex);
+        if (g_atomic_int_get(&pool->freeWorkers) > 0)
+            virCondSignal(&pool->cond);
+        if (priority && g_atomic_int_get(&pool->freePrioWorkers) > 0)
+            virCondSignal(&pool->prioCond);
+        virMutexUnlock(&pool->mutex);
+    }
 
-    virMutexUnlock(&pool->mutex);
     return 0;
-
- error:
-    virMutexUnlock(&pool->mutex);
-    return -1;
 }
 
 int
@@ -476,6 +723,7 @@ virThreadPoolSetParameters(virThreadPoolPtr pool,
         pool->maxPrioWorkers = prioWorkers;
     }
 
+    virThreadPoolUpdateShrink(pool);
     virMutexUnlock(&pool->mutex);
     return 0;
 
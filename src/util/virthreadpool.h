@@ -44,6 +44,9 @@ size_t virThreadPoolGetPriorityWorkers(virThreadPoolPtr pool);
 size_t virThreadPoolGetCurrentWorkers(virThreadPoolPtr pool);
 size_t virThreadPoolGetFreeWorkers(virThreadPoolPtr pool);
 size_t virThreadPoolGetJobQueueDepth(virThreadPoolPtr pool);
+unsigned long long virThreadPoolGetJobCount(virThreadPoolPtr pool);
+unsigned long long virThreadPoolGetJobWaitTime(virThreadPoolPtr pool);
+unsigned long long virThreadPoolGetJobSteals(virThreadPoolPtr pool);
 
 void virThreadPoolFree(virThreadPoolPtr pool);
 
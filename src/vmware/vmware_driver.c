@@ -327,7 +327,7 @@ vmwareUpdateVMStatus(struct vmware_driver *driver, virDomainObjPtr vm)
     }
 
     if (!found) {
-        vm->def->id = -1;
+        virDomainObjListSetID(driver->domains, vm, -1);
         newState = VIR_DOMAIN_SHUTOFF;
     }
 
@@ -355,7 +355,7 @@ vmwareStopVM(struct vmware_driver *driver,
     if (virCommandRun(cmd, NULL) < 0)
         return -1;
 
-    vm->def->id = -1;
+    virDomainObjListSetID(driver->domains, vm, -1);
     virDomainObjSetState(vm, VIR_DOMAIN_SHUTOFF, reason);
 
     return 0;
@@ -366,6 +366,7 @@ vmwareStartVM(struct vmware_driver *driver, virDomainObjPtr vm)
 {
     g_autoptr(virCommand) cmd = virCommandNew(driver->vmrun);
     const char *vmxPath = ((vmwareDomainPtr) vm->privateData)->vmxPath;
+    int pid;
 
     virCommandAddArgList(cmd, "-T", vmwareDriverTypeToString(driver->type),
                          "start", vmxPath, NULL);
@@ -382,11 +383,13 @@ vmwareStartVM(struct vmware_driver *driver, virDomainObjPtr vm)
     if (virCommandRun(cmd, NULL) < 0)
         return -1;
 
-    if ((vm->def->id = vmwareExtractPid(vmxPath)) < 0) {
+    if ((pid = vmwareExtractPid(vmxPath)) < 0) {
         vmwareStopVM(driver, vm, VIR_DOMAIN_SHUTOFF_FAILED);
         return -1;
     }
 
+    virDomainObjListSetID(driver->domains, vm, pid);
+
     virDomainObjSetState(vm, VIR_DOMAIN_RUNNING, VIR_DOMAIN_RUNNING_BOOTED);
 
     return 0;
@@ -1036,6 +1036,31 @@ vzConnectDomainEventRegisterAny(virConnectPtr conn,
     return ret;
 }
 
+static int
+vzConnectDomainEventRegisterAnyFlags(virConnectPtr conn,
+                                     virDomainPtr domain,
+                                     int eventID,
+                                     virConnectDomainEventGenericCallback callback,
+                                     void *opaque,
+                                     virFreeCallback freecb,
+                                     unsigned int flags)
+{
+    vzConnPtr privconn = conn->privateData;
+    int ret;
+
+    if (virConnectDomainEventRegisterAnyFlagsEnsureACL(conn) < 0)
+        return -1;
+
+    if (virDomainEventStateRegisterIDFlags(conn,
+                                           privconn->driver->domainEventState,
+                                           domain, eventID,
+                                           callback, opaque, freecb,
+                                           flags, &ret) < 0)
+        ret = -1;
+
+    return ret;
+}
+
 static int
 vzConnectDomainEventDeregisterAny(virConnectPtr conn,
                                   int callbackID)
@@ -3040,7 +3065,9 @@ vzConnectSupportsFeature(virConnectPtr conn G_GNUC_UNUSED, int feature)
     case VIR_DRV_FEATURE_PROGRAM_KEEPALIVE:
     case VIR_DRV_FEATURE_REMOTE:
     case VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK:
+    case VIR_DRV_FEATURE_REMOTE_EVENT_BATCH:
     case VIR_DRV_FEATURE_REMOTE_EVENT_CALLBACK:
+    case VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PACKETS:
     case VIR_DRV_FEATURE_TYPED_PARAM_STRING:
     case VIR_DRV_FEATURE_XML_MIGRATABLE:
     default:
@@ -4078,6 +4105,7 @@ static virHypervisorDriver vzHypervisorDriver = {
     .domainAbortJob = vzDomainAbortJob, /* 3.1.0 */
     .domainReset = vzDomainReset, /* 3.1.0 */
     .domainBlockResize = vzDomainBlockResize, /* 3.3.0 */
+    .connectDomainEventRegisterAnyFlags = vzConnectDomainEventRegisterAnyFlags, /* 6.7.0 */
 };
 
 static virConnectDriver vzConnectDriver = {
@@ -0,0 +1,144 @@
+/*
+ * adminservertest.c: Test the server statistics of the admin interface
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "virerror.h"
+#include "virbuffer.h"
+#include "virtypedparam.h"
+#include "admin_server.h"
+
+#define LIBVIRT_VIRNETSERVERPROGRAMPRIV_H_ALLOW
+#include "rpc/virnetserverprogrampriv.h"
+
+#define VIR_FROM_THIS VIR_FROM_ADMIN
+
+static virNetServerProgramProc testProcs[] = {
+    { .name = "TEST_PROC_UNUSED" },
+    { .name = "TEST_PROC_NAMED" },
+    { .name = NULL },
+};
+
+struct testCall {
+    int procedure;
+    gint64 queued;
+    gint64 start;
+    gint64 end;
+};
+
+
+/*
+ * Records @calls and checks the typed parameters reported for them by
+ * adminServerGetProcedureStats, which are formatted one per line.
+ */
+static int
+testProcedureStats(const void *opaque G_GNUC_UNUSED)
+{
+    const struct testCall calls[] = {
+        /* Nothing measurable goes to bucket 0 */
+        { 1, 1000, 1000, 1000 },
+        /* The largest time which still gets its own bucket */
+        { 1, 1000, 1001, 1001 + (1LL << 24) - 1 },
+        /* Unknown queue time, the execution goes to the last bucket */
+        { 1, 0, 5000, 5000 + (1LL << 24) },
+        /* Way over the last bucket's lower bound */
+        { 1, 10, 10 + (1LL << 40), 12 + (1LL << 40) },
+        /* A procedure without name */
+        { 2, 100, 103, 110 },
+    };
+    const char *expect =
+        "proc.0.program=test\n"
+        "proc.0.name=TEST_PROC_NAMED\n"
+        "proc.0.number=1\n"
+        "proc.0.calls=4\n"
+        "proc.0.wait.total=1099511627777\n"
+        "proc.0.wait.bucket.0=2\n"
+        "proc.0.wait.bucket.1=1\n"
+        "proc.0.wait.bucket.25=1\n"
+        "proc.0.exec.total=33554433\n"
+        "proc.0.exec.bucket.0=1\n"
+        "proc.0.exec.bucket.2=1\n"
+        "proc.0.exec.bucket.24=1\n"
+        "proc.0.exec.bucket.25=1\n"
+        "proc.1.program=test\n"
+        "proc.1.name=2\n"
+        "proc.1.number=2\n"
+        "proc.1.calls=1\n"
+        "proc.1.wait.total=3\n"
+        "proc.1.wait.bucket.2=1\n"
+        "proc.1.exec.total=7\n"
+        "proc.1.exec.bucket.3=1\n"
+        "proc.count=2\n";
+    virNetServerPtr srv = NULL;
+    virNetServerProgramPtr prog = NULL;
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    g_autofree char *actual = NULL;
+    size_t i;
+    int ret = -1;
+
+    if (!(srv = virNetServerNew("test", 1, 0, 0, 0, 10, 5, 0, 0,
+                                NULL, NULL, NULL, NULL)) ||
+        !(prog = virNetServerProgramNew(0x11223344, 1, "test", testProcs,
+                                        G_N_ELEMENTS(testProcs))) ||
+        virNetServerAddProgram(srv, prog) < 0)
+        goto cleanup;
+
+    for (i = 0; i < G_N_ELEMENTS(calls); i++)
+        virNetServerProgramRecordCall(prog, calls[i].procedure, calls[i].queued,
+                                      calls[i].start, calls[i].end);
+
+    if (adminServerGetProcedureStats(srv, &params, &nparams, 0) < 0)
+        goto cleanup;
+
+    for (i = 0; i < nparams; i++) {
+        g_autofree char *value = virTypedParameterToString(&params[i]);
+
+        virBufferAsprintf(&buf, "%s=%s\n", params[i].field, NULLSTR(value));
+    }
+
+    actual = virBufferContentAndReset(&buf);
+    if (STRNEQ_NULLABLE(expect, actual)) {
+        virTestDifference(stderr, expect, actual);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virTypedParamsFree(params, nparams);
+    virObjectUnref(prog);
+    virObjectUnref(srv);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (virTestRun("procedure stats", testProcedureStats, NULL) < 0)
+        ret = -1;
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
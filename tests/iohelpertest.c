@@ -0,0 +1,243 @@
+/*
+ * iohelpertest.c: Test the I/O helper program
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library;  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <fcntl.h>
+
+#include "testutils.h"
+
+#include "vircommand.h"
+#include "virfile.h"
+#include "virstring.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+#define IOHELPER abs_top_builddir "/src/libvirt_iohelper"
+
+#ifndef O_DIRECT
+# define O_DIRECT 0
+#endif
+
+struct testInfo {
+    const char *scratchdir;
+    bool pipe;              /* feed the helper from a pipe rather than a file */
+    bool direct;            /* open the file with O_DIRECT */
+    size_t size;            /* amount of data to copy */
+    off_t offset;           /* file offset the copy starts at */
+    const char *bufsize;    /* --buffer-size */
+    const char *depth;      /* --queue-depth */
+};
+
+
+/* Data passed through a pipe must not contain NUL bytes as it's fed using
+ * virCommandSetInputBuffer. */
+static char *
+testIOHelperPattern(size_t len)
+{
+    char *data = g_new0(char, len + 1);
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        data[i] = 'a' + (i * 7 + i / 4093) % 26;
+
+    return data;
+}
+
+
+static int
+testIOHelperOpen(const char *path,
+                 int oflags,
+                 bool direct,
+                 off_t offset)
+{
+    int fd;
+
+    if (direct)
+        oflags |= O_DIRECT;
+
+    if ((fd = open(path, oflags, 0600)) < 0)
+        return -1;
+
+    if (lseek(fd, offset, SEEK_SET) < 0) {
+        VIR_FORCE_CLOSE(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+
+/**
+ * testIOHelper:
+ *
+ * Copies data from a file or a pipe into a file using the I/O helper the
+ * same way virFileWrapperFd does and checks the result. The throughput is
+ * printed with VIR_TEST_VERBOSE=1; with VIR_TEST_EXPENSIVE=1 the larger
+ * test cases copy 256 MiB to get meaningful numbers.
+ */
+static int
+testIOHelper(const void *opaque)
+{
+    const struct testInfo *info = opaque;
+    size_t size = info->size;
+    g_autofree char *prefix = testIOHelperPattern(info->offset);
+    g_autofree char *data = NULL;
+    g_autofree char *src = g_strdup_printf("%s/src", info->scratchdir);
+    g_autofree char *dst = g_strdup_printf("%s/dst", info->scratchdir);
+    g_autofree char *expect = NULL;
+    g_autofree char *actual = NULL;
+    g_autoptr(virCommand) cmd = NULL;
+    VIR_AUTOCLOSE srcfd = -1;
+    VIR_AUTOCLOSE dstfd = -1;
+    size_t expectlen;
+    int len;
+    gint64 start;
+    gint64 elapsed;
+
+    if (size >= 1024 * 1024 && virTestGetExpensive())
+        size = 256 * 1024 * 1024;
+
+    data = testIOHelperPattern(size);
+    unlink(src);
+    unlink(dst);
+
+    cmd = virCommandNew(IOHELPER);
+    if (info->bufsize)
+        virCommandAddArgPair(cmd, "--buffer-size", info->bufsize);
+    if (info->depth)
+        virCommandAddArgPair(cmd, "--queue-depth", info->depth);
+
+    if (info->pipe) {
+        /* pipe -> file: the helper writes the file passed as stdout which
+         * already contains @offset bytes of other data */
+        if (virFileWriteStr(dst, prefix, 0600) < 0)
+            return -1;
+
+        if ((dstfd = testIOHelperOpen(dst, O_WRONLY, info->direct,
+                                      info->offset)) < 0) {
+            if (info->direct && errno == EINVAL)
+                return EXIT_AM_SKIP;
+            return -1;
+        }
+
+        virCommandAddArgList(cmd, dst, "1", NULL);
+        virCommandSetInputBuffer(cmd, data);
+        virCommandSetOutputFD(cmd, &dstfd);
+
+        expect = g_strdup_printf("%s%s", prefix, data);
+        expectlen = info->offset + size;
+    } else {
+        /* file -> file: the helper reads the file passed as stdin from
+         * @offset and its stdout is redirected into another file */
+        expect = g_strdup_printf("%s%s", prefix, data);
+        if (virFileWriteStr(src, expect, 0600) < 0)
+            return -1;
+        VIR_FREE(expect);
+
+        if ((srcfd = testIOHelperOpen(src, O_RDONLY, info->direct,
+                                      info->offset)) < 0) {
+            if (info->direct && errno == EINVAL)
+                return EXIT_AM_SKIP;
+            return -1;
+        }
+
+        if ((dstfd = open(dst, O_WRONLY | O_CREAT | O_TRUNC, 0600)) < 0)
+            return -1;
+
+        virCommandAddArgList(cmd, src, "0", NULL);
+        virCommandSetInputFD(cmd, srcfd);
+        virCommandSetOutputFD(cmd, &dstfd);
+
+        expect = g_steal_pointer(&data);
+        expectlen = size;
+    }
+
+    start = g_get_monotonic_time();
+    if (virCommandRun(cmd, NULL) < 0)
+        return -1;
+    elapsed = g_get_monotonic_time() - start;
+
+    if ((len = virFileReadAll(dst, expectlen + 1, &actual)) < 0)
+        return -1;
+
+    if (len != expectlen || memcmp(actual, expect, expectlen) != 0) {
+        VIR_TEST_VERBOSE("copied data differ: expected %zu bytes, got %d",
+                         expectlen, len);
+        return -1;
+    }
+
+    VIR_TEST_VERBOSE("%zu bytes in %lld us (%.1f MiB/s)",
+                     size, (long long) elapsed,
+                     elapsed ? size / (1024.0 * 1024.0) / (elapsed / 1000000.0) : 0);
+
+    return 0;
+}
+
+
+#define SCRATCHDIRTEMPLATE abs_builddir "/iohelperdir-XXXXXX"
+
+static int
+mymain(void)
+{
+    char scratchdir[] = SCRATCHDIRTEMPLATE;
+    int ret = 0;
+
+    if (!g_mkdtemp(scratchdir)) {
+        fprintf(stderr, "Cannot create iohelperdir");
+        abort();
+    }
+
+#define DO_TEST_FULL(name, pipe, direct, size, offset, bufsize, depth) \
+    do { \
+        struct testInfo info = { scratchdir, pipe, direct, size, offset, \
+                                 bufsize, depth }; \
+        if (virTestRun("iohelper " name, testIOHelper, &info) < 0) \
+            ret = -1; \
+    } while (0)
+
+#define DO_TEST(name, pipe, direct, size, offset) \
+    DO_TEST_FULL(name, pipe, direct, size, offset, NULL, NULL)
+
+    DO_TEST("file to file", false, false, 3 * 1024 * 1024 + 4097, 0);
+    DO_TEST("file to file offset", false, false, 1024 * 1024, 12345);
+    DO_TEST("pipe to file", true, false, 3 * 1024 * 1024 + 4097, 0);
+    DO_TEST("pipe to file offset", true, false, 1024 * 1024, 12345);
+    DO_TEST("empty", true, false, 0, 0);
+
+    if (O_DIRECT) {
+        DO_TEST("file to file direct", false, true, 3 * 1024 * 1024 + 4097, 0);
+        DO_TEST("file to file direct offset", false, true, 1024 * 1024, 12345);
+        DO_TEST("file to file direct short", false, true, 100, 12345);
+        DO_TEST("pipe to file direct", true, true, 3 * 1024 * 1024 + 4097, 0);
+        DO_TEST("pipe to file direct offset", true, true, 1024 * 1024, 12345);
+        DO_TEST("pipe to file direct short", true, true, 100, 12345);
+    }
+
+    DO_TEST_FULL("pipe to file sequential", true, false,
+                 1024 * 1024 + 1, 0, "65536", "1");
+    DO_TEST_FULL("pipe to file deep queue", true, false,
+                 8 * 1024 * 1024, 0, "131072", "32");
+
+    if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
+        virFileDeleteTree(scratchdir);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
@@ -25,6 +25,9 @@
 
 #include "virerror.h"
 #include "virxml.h"
+#include "virthread.h"
+#include "virtime.h"
+#include "domain_event.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
@@ -198,6 +201,93 @@ nodeDeviceLifecycleCb(virConnectPtr conn G_GNUC_UNUSED,
         counter->deletedEvents++;
 }
 
+typedef struct {
+    int count;
+    unsigned long long actual;
+} throttleEventCounter;
+
+static void
+domainBalloonChangeCb(virConnectPtr conn G_GNUC_UNUSED,
+                      virDomainPtr dom G_GNUC_UNUSED,
+                      unsigned long long actual,
+                      void *opaque)
+{
+    throttleEventCounter *counter = opaque;
+
+    counter->count++;
+    counter->actual = actual;
+}
+
+static void
+domainJobCompletedCb(virConnectPtr conn G_GNUC_UNUSED,
+                     virDomainPtr dom G_GNUC_UNUSED,
+                     virTypedParameterPtr params G_GNUC_UNUSED,
+                     int nparams G_GNUC_UNUSED,
+                     void *opaque)
+{
+    throttleEventCounter *counter = opaque;
+
+    counter->count++;
+}
+
+typedef struct {
+    virMutex lock;
+    virCond cond;
+    int entered;
+    int finished;
+    unsigned long long threadID;
+    bool block; /* callbacks wait until it's cleared */
+    unsigned int delay; /* milliseconds a callback takes */
+} threadEventData;
+
+static int
+domainThreadedCb(virConnectPtr conn G_GNUC_UNUSED,
+                 virDomainPtr dom G_GNUC_UNUSED,
+                 int event G_GNUC_UNUSED,
+                 int detail G_GNUC_UNUSED,
+                 void *opaque)
+{
+    threadEventData *data = opaque;
+
+    virMutexLock(&data->lock);
+    data->entered++;
+    data->threadID = virThreadSelfID();
+    virCondBroadcast(&data->cond);
+    while (data->block)
+        ignore_value(virCondWait(&data->cond, &data->lock));
+    virMutexUnlock(&data->lock);
+
+    g_usleep(data->delay * 1000);
+
+    virMutexLock(&data->lock);
+    data->finished++;
+    virCondBroadcast(&data->cond);
+    virMutexUnlock(&data->lock);
+    return 0;
+}
+
+/* Waits up to 5 seconds for @counter of @data to reach @n */
+static int
+threadEventWait(threadEventData *data, const int *counter, int n)
+{
+    unsigned long long deadline;
+    int ret = 0;
+
+    if (virTimeMillisNow(&deadline) < 0)
+        return -1;
+    deadline += 5000;
+
+    virMutexLock(&data->lock);
+    while (*counter < n) {
+        if (virCondWaitUntil(&data->cond, &data->lock, deadline) < 0) {
+            ret = -1;
+            break;
+        }
+    }
+    virMutexUnlock(&data->lock);
+    return ret;
+}
+
 static int
 testDomainCreateXMLOld(const void *data)
 {
@@ -472,6 +562,303 @@ testDomainStartStopEvent(const void *data)
     return ret;
 }
 
+static void
+testEventDeadline(int timer G_GNUC_UNUSED, void *opaque)
+{
+    bool *expired = opaque;
+
+    *expired = true;
+}
+
+/* Balloon changes of the test domain are delivered to a coalescing
+ * callback as the first one right away and the latest one once the
+ * window of a second ends, a callback without flags gets all of them */
+static int
+testDomainCoalesceEvent(const void *data)
+{
+    const objecteventTest *test = data;
+    throttleEventCounter coalesced = { 0 };
+    throttleEventCounter plain = { 0 };
+    int eventId = VIR_DOMAIN_EVENT_ID_BALLOON_CHANGE;
+    int coalescedId = -1;
+    int plainId = -1;
+    int deadline = -1;
+    bool expired = false;
+    gint64 start;
+    size_t i;
+    int ret = -1;
+    virDomainPtr dom;
+
+    dom = virDomainLookupByName(test->conn, "test");
+    if (dom == NULL)
+        return -1;
+
+    coalescedId = virConnectDomainEventRegisterAnyFlags(test->conn, dom, eventId,
+                           VIR_DOMAIN_EVENT_CALLBACK(&domainBalloonChangeCb),
+                           &coalesced, NULL,
+                           VIR_CONNECT_DOMAIN_EVENT_REGISTER_COALESCE);
+    plainId = virConnectDomainEventRegisterAny(test->conn, dom, eventId,
+                           VIR_DOMAIN_EVENT_CALLBACK(&domainBalloonChangeCb),
+                           &plain, NULL);
+    if (coalescedId < 0 || plainId < 0)
+        goto cleanup;
+
+    start = g_get_monotonic_time();
+
+    for (i = 1; i <= 5; i++) {
+        if (virDomainSetMemory(dom, 1024 * 1024 + i * 1024) < 0)
+            goto cleanup;
+    }
+
+    if (virEventRunDefaultImpl() < 0)
+        goto cleanup;
+
+    if (plain.count != 5 || plain.actual != 1024 * 1024 + 5 * 1024)
+        goto cleanup;
+
+    if (coalesced.count != 1 || coalesced.actual != 1024 * 1024 + 1024)
+        goto cleanup;
+
+    /* The latest event is pending until the window ends */
+    if ((deadline = virEventAddTimeout(5 * 1000, testEventDeadline,
+                                       &expired, NULL)) < 0)
+        goto cleanup;
+
+    while (coalesced.count < 2 && !expired) {
+        if (virEventRunDefaultImpl() < 0)
+            goto cleanup;
+    }
+
+    if (expired) {
+        VIR_TEST_VERBOSE("pending event not delivered within 5 seconds");
+        goto cleanup;
+    }
+
+    if (coalesced.count != 2 || coalesced.actual != 1024 * 1024 + 5 * 1024)
+        goto cleanup;
+
+    if (g_get_monotonic_time() - start < 1000 * 1000) {
+        VIR_TEST_VERBOSE("pending event delivered before the window ended");
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    if (deadline >= 0)
+        virEventRemoveTimeout(deadline);
+    if (coalescedId >= 0)
+        virConnectDomainEventDeregisterAny(test->conn, coalescedId);
+    if (plainId >= 0)
+        virConnectDomainEventDeregisterAny(test->conn, plainId);
+    virDomainFree(dom);
+
+    return ret;
+}
+
+/* At most VIR_OBJECT_EVENT_RATE_LIMIT job completion events are
+ * delivered to a rate limited callback within a window, the others are
+ * dropped.  The test driver does not emit them, so they are queued on
+ * a state of the test's own. */
+static int
+testDomainRateLimitEvent(const void *data)
+{
+    const objecteventTest *test = data;
+    throttleEventCounter counter = { 0 };
+    virObjectEventStatePtr state = NULL;
+    int eventId = VIR_DOMAIN_EVENT_ID_JOB_COMPLETED;
+    unsigned long long dropped = 0;
+    int id = -1;
+    size_t i;
+    int ret = -1;
+    virDomainPtr dom;
+
+    dom = virDomainLookupByName(test->conn, "test");
+    if (dom == NULL)
+        return -1;
+
+    if (!(state = virObjectEventStateNew()))
+        goto cleanup;
+
+    if (virDomainEventStateRegisterIDFlags(test->conn, state, dom, eventId,
+                           VIR_DOMAIN_EVENT_CALLBACK(&domainJobCompletedCb),
+                           &counter, NULL,
+                           VIR_CONNECT_DOMAIN_EVENT_REGISTER_RATE_LIMIT,
+                           &id) < 0)
+        goto cleanup;
+
+    for (i = 0; i < 15; i++)
+        virObjectEventStateQueue(state,
+                                 virDomainEventJobCompletedNewFromDom(dom, NULL, 0));
+
+    if (virEventRunDefaultImpl() < 0)
+        goto cleanup;
+
+    if (counter.count != 10)
+        goto cleanup;
+
+    if (virObjectEventStateCallbackDropped(test->conn, state, id,
+                                           &dropped) < 0 ||
+        dropped != 5) {
+        VIR_TEST_VERBOSE("expected 5 dropped events, got %llu", dropped);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    if (id >= 0)
+        virObjectEventStateDeregisterID(test->conn, state, id, true);
+    virObjectUnref(state);
+    virDomainFree(dom);
+
+    return ret;
+}
+
+/* Callbacks of a state with a dispatch thread run in that thread and
+ * stopping the thread waits for the callback it is running */
+static int
+testDomainThreadedEvent(const void *data)
+{
+    const objecteventTest *test = data;
+    threadEventData ev = { .delay = 200 };
+    virObjectEventStatePtr state = NULL;
+    int id = -1;
+    int ret = -1;
+    virDomainPtr dom;
+
+    if (virMutexInit(&ev.lock) < 0 || virCondInit(&ev.cond) < 0)
+        return -1;
+
+    if (!(dom = virDomainLookupByName(test->conn, "test")))
+        goto cleanup;
+
+    if (!(state = virObjectEventStateNew()) ||
+        virObjectEventStateUseThread(state, "test-event", 0) < 0)
+        goto cleanup;
+
+    if (virDomainEventStateRegisterID(test->conn, state, dom,
+                                      VIR_DOMAIN_EVENT_ID_LIFECYCLE,
+                                      VIR_DOMAIN_EVENT_CALLBACK(&domainThreadedCb),
+                                      &ev, NULL, &id) < 0)
+        goto cleanup;
+
+    virObjectEventStateQueue(state,
+                             virDomainEventLifecycleNewFromDom(dom,
+                                                               VIR_DOMAIN_EVENT_STARTED, 0));
+
+    /* No event loop iteration is needed for the event to be delivered */
+    if (threadEventWait(&ev, &ev.entered, 1) < 0)
+        goto cleanup;
+
+    virObjectEventStateStopThread(state);
+
+    if (ev.finished != 1) {
+        VIR_TEST_VERBOSE("callback still running after the thread was stopped");
+        goto cleanup;
+    }
+
+    if (ev.threadID == virThreadSelfID()) {
+        VIR_TEST_VERBOSE("callback invoked from the thread queueing the event");
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    if (state) {
+        virObjectEventStateStopThread(state);
+        if (id >= 0)
+            virObjectEventStateDeregisterID(test->conn, state, id, true);
+        virObjectUnref(state);
+    }
+    if (dom)
+        virDomainFree(dom);
+    virCondDestroy(&ev.cond);
+    virMutexDestroy(&ev.lock);
+
+    return ret;
+}
+
+/* Events queued while the queue of a dispatch thread is full are
+ * dropped and counted */
+static int
+testDomainThreadedQueueBound(const void *data)
+{
+    const objecteventTest *test = data;
+    threadEventData ev = { .block = true };
+    virObjectEventStatePtr state = NULL;
+    unsigned long long dropped;
+    int id = -1;
+    size_t i;
+    int ret = -1;
+    virDomainPtr dom;
+
+    if (virMutexInit(&ev.lock) < 0 || virCondInit(&ev.cond) < 0)
+        return -1;
+
+    if (!(dom = virDomainLookupByName(test->conn, "test")))
+        goto cleanup;
+
+    if (!(state = virObjectEventStateNew()) ||
+        virObjectEventStateUseThread(state, "test-event", 2) < 0)
+        goto cleanup;
+
+    if (virDomainEventStateRegisterID(test->conn, state, dom,
+                                      VIR_DOMAIN_EVENT_ID_LIFECYCLE,
+                                      VIR_DOMAIN_EVENT_CALLBACK(&domainThreadedCb),
+                                      &ev, NULL, &id) < 0)
+        goto cleanup;
+
+    /* Keep the thread busy with the first event, so that the following
+     * ones stay in the queue */
+    virObjectEventStateQueue(state,
+                             virDomainEventLifecycleNewFromDom(dom,
+                                                               VIR_DOMAIN_EVENT_STARTED, 0));
+    if (threadEventWait(&ev, &ev.entered, 1) < 0)
+        goto cleanup;
+
+    for (i = 0; i < 5; i++)
+        virObjectEventStateQueue(state,
+                                 virDomainEventLifecycleNewFromDom(dom,
+                                                                   VIR_DOMAIN_EVENT_STARTED, 0));
+
+    dropped = virObjectEventStateGetDropped(state);
+
+    virMutexLock(&ev.lock);
+    ev.block = false;
+    virCondBroadcast(&ev.cond);
+    virMutexUnlock(&ev.lock);
+
+    if (threadEventWait(&ev, &ev.finished, 3) < 0)
+        goto cleanup;
+
+    virObjectEventStateStopThread(state);
+
+    if (dropped != 3 || ev.finished != 3) {
+        VIR_TEST_VERBOSE("expected 3 events delivered and 3 dropped, "
+                         "got %d delivered and %llu dropped",
+                         ev.finished, dropped);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    if (state) {
+        virMutexLock(&ev.lock);
+        ev.block = false;
+        virCondBroadcast(&ev.cond);
+        virMutexUnlock(&ev.lock);
+        virObjectEventStateStopThread(state);
+        if (id >= 0)
+            virObjectEventStateDeregisterID(test->conn, state, id, true);
+        virObjectUnref(state);
+    }
+    if (dom)
+        virDomainFree(dom);
+    virCondDestroy(&ev.cond);
+    virMutexDestroy(&ev.lock);
+
+    return ret;
+}
+
 static int
 testNetworkCreateXML(const void *data)
 {
@@ -864,6 +1251,15 @@ mymain(void)
         ret = EXIT_FAILURE;
     if (virTestRun("Domain start stop events", testDomainStartStopEvent, &test) < 0)
         ret = EXIT_FAILURE;
+    if (virTestRun("Domain coalesced events", testDomainCoalesceEvent, &test) < 0)
+        ret = EXIT_FAILURE;
+    if (virTestRun("Domain rate limited events", testDomainRateLimitEvent, &test) < 0)
+        ret = EXIT_FAILURE;
+    if (virTestRun("Domain threaded events", testDomainThreadedEvent, &test) < 0)
+        ret = EXIT_FAILURE;
+    if (virTestRun("Domain threaded events queue bound",
+                   testDomainThreadedQueueBound, &test) < 0)
+        ret = EXIT_FAILURE;
 
     /* Network event tests */
     /* Tests requiring the test network not to be set up */
@@ -51,17 +51,11 @@ printLineSkipEmpty(const char *line,
 }
 
 
-static int (*realQemuMonitorSend)(qemuMonitorPtr mon,
-                                  qemuMonitorMessagePtr msg);
-
-int
-qemuMonitorSend(qemuMonitorPtr mon,
-                qemuMonitorMessagePtr msg)
+static void
+printMessage(qemuMonitorMessagePtr msg)
 {
     char *reformatted;
 
-    REAL_SYM(realQemuMonitorSend);
-
     if (!(reformatted = virJSONStringReformat(msg->txBuffer, true))) {
         fprintf(stderr, "Failed to reformat command string '%s'\n", msg->txBuffer);
         abort();
@@ -74,39 +68,68 @@ qemuMonitorSend(qemuMonitorPtr mon,
 
     printLineSkipEmpty(reformatted, stdout);
     VIR_FREE(reformatted);
+}
+
+
+static int (*realQemuMonitorSend)(qemuMonitorPtr mon,
+                                  qemuMonitorMessagePtr msg);
+
+int
+qemuMonitorSend(qemuMonitorPtr mon,
+                qemuMonitorMessagePtr msg)
+{
+    REAL_SYM(realQemuMonitorSend);
+
+    printMessage(msg);
 
     return realQemuMonitorSend(mon, msg);
 }
 
 
-static int (*realQemuMonitorJSONIOProcessLine)(qemuMonitorPtr mon,
-                                               const char *line,
-                                               qemuMonitorMessagePtr msg);
+static int (*realQemuMonitorSendBatch)(qemuMonitorPtr mon,
+                                       qemuMonitorMessagePtr *msgs,
+                                       size_t nmsgs);
+
+int
+qemuMonitorSendBatch(qemuMonitorPtr mon,
+                     qemuMonitorMessagePtr *msgs,
+                     size_t nmsgs)
+{
+    size_t i;
+
+    REAL_SYM(realQemuMonitorSendBatch);
+
+    for (i = 0; i < nmsgs; i++)
+        printMessage(msgs[i]);
+
+    return realQemuMonitorSendBatch(mon, msgs, nmsgs);
+}
+
+
+static int (*realQemuMonitorJSONIOProcessValue)(qemuMonitorPtr mon,
+                                                virJSONValuePtr obj);
 
 int
-qemuMonitorJSONIOProcessLine(qemuMonitorPtr mon,
-                             const char *line,
-                             qemuMonitorMessagePtr msg)
+qemuMonitorJSONIOProcessValue(qemuMonitorPtr mon,
+                              virJSONValuePtr obj)
 {
-    virJSONValuePtr value = NULL;
     char *json = NULL;
+    bool greeting;
     int ret;
 
-    REAL_SYM(realQemuMonitorJSONIOProcessLine);
-
-    ret = realQemuMonitorJSONIOProcessLine(mon, line, msg);
+    REAL_SYM(realQemuMonitorJSONIOProcessValue);
 
-    if (ret == 0) {
-        if (!(value = virJSONValueFromString(line)) ||
-            !(json = virJSONValueToString(value, true))) {
-            fprintf(stderr, "Failed to reformat reply string '%s'\n", line);
-            abort();
-        }
+    /* @obj is consumed by the real function */
+    if (!(json = virJSONValueToString(obj, true))) {
+        fprintf(stderr, "Failed to format reply\n");
+        abort();
+    }
+    greeting = virJSONValueObjectHasKey(obj, "QMP") == 1;
 
-        /* Ignore QMP greeting */
-        if (virJSONValueObjectHasKey(value, "QMP"))
-            goto cleanup;
+    ret = realQemuMonitorJSONIOProcessValue(mon, obj);
 
+    /* Ignore QMP greeting */
+    if (ret == 0 && !greeting) {
         if (first)
             first = false;
         else
@@ -115,8 +138,6 @@ qemuMonitorJSONIOProcessLine(qemuMonitorPtr mon,
         printLineSkipEmpty(json, stdout);
     }
 
- cleanup:
     VIR_FREE(json);
-    virJSONValueFree(value);
     return ret;
 }
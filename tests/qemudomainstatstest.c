@@ -0,0 +1,195 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+
+#ifdef WITH_QEMU
+
+# include "internal.h"
+# include "datatypes.h"
+# include "virthreadpool.h"
+# include "testutilsqemu.h"
+
+# define LIBVIRT_QEMU_DRIVERPRIV_H_ALLOW
+# include "qemu/qemu_driverpriv.h"
+
+# define VIR_FROM_THIS VIR_FROM_QEMU
+
+static virQEMUDriver driver;
+
+struct testStatsInfo {
+    size_t nvms;
+    size_t workers;
+    ssize_t fail; /* index of the domain which fails, -1 for none */
+};
+
+
+static virDomainObjPtr
+testStatsNewDomain(size_t idx)
+{
+    virDomainObjPtr vm;
+
+    if (!(vm = virDomainObjNew(driver.xmlopt)))
+        return NULL;
+
+    virObjectUnlock(vm);
+
+    if (!(vm->def = virDomainDefNew())) {
+        virObjectUnref(vm);
+        return NULL;
+    }
+
+    vm->def->name = g_strdup_printf("dom%zu", idx);
+    vm->def->uuid[0] = idx;
+    vm->def->id = -1;
+
+    return vm;
+}
+
+
+/*
+ * Collects the state of several domains and checks that there is a record
+ * for each of them in the order of the domain list, whether or not the
+ * stats worker pool is used. With @fail set, one of the domains can't
+ * produce a record, which must fail the whole call without leaking the
+ * records of the other domains.
+ */
+static int
+testStatsCollect(const void *opaque)
+{
+    const struct testStatsInfo *info = opaque;
+    virDomainObjPtr *vms = NULL;
+    virDomainStatsRecordPtr *records = NULL;
+    virConnectPtr conn = NULL;
+    size_t i;
+    int rc;
+    int ret = -1;
+
+    if (info->workers > 1 &&
+        !(driver.statsPool = virThreadPoolNewFull(0, info->workers, 0,
+                                                  qemuDomainGetStatsParallelWorker,
+                                                  "qemu-stats", &driver)))
+        return -1;
+
+    vms = g_new0(virDomainObjPtr, info->nvms);
+    for (i = 0; i < info->nvms; i++) {
+        if (!(vms[i] = testStatsNewDomain(i)))
+            goto cleanup;
+    }
+
+    /* a domain without a name has no virDomainPtr to put in its record */
+    if (info->fail >= 0)
+        VIR_FREE(vms[info->fail]->def->name);
+
+    if (!(conn = virGetConnect()))
+        goto cleanup;
+    conn->privateData = &driver;
+
+    rc = qemuDomainGetStatsCollect(conn, vms, info->nvms,
+                                   VIR_DOMAIN_STATS_STATE, 0, 0, &records);
+
+    if (info->fail >= 0) {
+        if (rc >= 0) {
+            VIR_TEST_VERBOSE("collecting stats unexpectedly succeeded");
+            goto cleanup;
+        }
+        virResetLastError();
+        ret = 0;
+        goto cleanup;
+    }
+
+    if (rc < 0 || (size_t)rc != info->nvms) {
+        VIR_TEST_VERBOSE("expected %zu records, got %d", info->nvms, rc);
+        goto cleanup;
+    }
+
+    for (i = 0; i < info->nvms; i++) {
+        if (!records[i] ||
+            STRNEQ(records[i]->dom->name, vms[i]->def->name)) {
+            VIR_TEST_VERBOSE("record %zu doesn't belong to domain '%s'",
+                             i, vms[i]->def->name);
+            goto cleanup;
+        }
+    }
+
+    if (records[info->nvms]) {
+        VIR_TEST_VERBOSE("list of records is not NULL terminated");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virDomainStatsRecordListFree(records);
+    if (conn) {
+        conn->privateData = NULL;
+        virObjectUnref(conn);
+    }
+    if (vms) {
+        for (i = 0; i < info->nvms; i++)
+            virObjectUnref(vms[i]);
+        g_free(vms);
+    }
+    virThreadPoolFree(driver.statsPool);
+    driver.statsPool = NULL;
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (qemuTestDriverInit(&driver) < 0)
+        return EXIT_FAILURE;
+
+# define DO_TEST_FULL(name, nvms, workers, fail) \
+    do { \
+        struct testStatsInfo info = { nvms, workers, fail }; \
+        if (virTestRun("collect " name, testStatsCollect, &info) < 0) \
+            ret = -1; \
+    } while (0)
+
+# define DO_TEST(name, nvms, workers) \
+    DO_TEST_FULL(name, nvms, workers, -1)
+
+    DO_TEST("sequential", 8, 1);
+    DO_TEST("parallel single domain", 1, 4);
+    DO_TEST("parallel", 8, 4);
+    DO_TEST("parallel more workers", 3, 8);
+    DO_TEST_FULL("sequential failure", 8, 1, 3);
+    DO_TEST_FULL("parallel failure", 8, 4, 3);
+    DO_TEST_FULL("parallel failure first", 8, 4, 0);
+
+    qemuTestDriverFree(&driver);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
+
+#else
+
+int
+main(void)
+{
+    return EXIT_AM_SKIP;
+}
+
+#endif /* WITH_QEMU */
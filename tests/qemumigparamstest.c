@@ -188,6 +188,101 @@ qemuMigParamsTestJSON(const void *opaque)
 }
 
 
+typedef struct _qemuMigParamsConvergeData qemuMigParamsConvergeData;
+struct _qemuMigParamsConvergeData {
+    virDomainXMLOptionPtr xmlopt;
+    const char *name;
+    virHashTablePtr qmpschema;
+    unsigned long long maxTime;
+    unsigned long long maxDowntime;
+    bool throttle;
+    size_t npasses;
+};
+
+
+static int
+qemuMigParamsTestConverge(const void *opaque)
+{
+    const qemuMigParamsConvergeData *data = opaque;
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    g_autofree char *replyFile = NULL;
+    g_autofree char *outFile = NULL;
+    g_autofree char *actual = NULL;
+    qemuMonitorTestPtr mon = NULL;
+    g_autoptr(virJSONValue) paramsIn = NULL;
+    g_autoptr(qemuMigrationParams) origParams = NULL;
+    qemuMigrationConverge conv = {
+        .maxTime = data->maxTime,
+        .maxDowntime = data->maxDowntime,
+        .throttle = data->throttle,
+    };
+    size_t i;
+    int ret = -1;
+
+    replyFile = g_strdup_printf("%s/qemumigparamsdata/%s.reply",
+                                abs_srcdir, data->name);
+    outFile = g_strdup_printf("%s/qemumigparamsdata/%s.out",
+                              abs_srcdir, data->name);
+
+    if (!(mon = qemuMonitorTestNewFromFile(replyFile, data->xmlopt, true)))
+        goto cleanup;
+
+    if (qemuMonitorGetMigrationParams(qemuMonitorTestGetMonitor(mon),
+                                      &paramsIn) < 0)
+        goto cleanup;
+
+    if (!(origParams = qemuMigrationParamsFromJSON(paramsIn)) ||
+        qemuMigrationParamsConvergeStart(&conv, origParams) < 0)
+        goto cleanup;
+
+    for (i = 0; i < data->npasses; i++) {
+        qemuMonitorMigrationStats stats = { 0 };
+        g_autoptr(virJSONValue) params = NULL;
+        g_autofree char *json = NULL;
+        g_auto(virBuffer) debug = VIR_BUFFER_INITIALIZER;
+
+        if (qemuMonitorGetMigrationStats(qemuMonitorTestGetMonitor(mon),
+                                         &stats, NULL) < 0)
+            goto cleanup;
+
+        virBufferAsprintf(&buf, "pass %llu: ", stats.ram_iteration);
+
+        if (!qemuMigrationParamsConvergeUpdate(&conv, &stats)) {
+            virBufferAddLit(&buf, "no change\n");
+            continue;
+        }
+
+        if (!(params = qemuMigrationParamsConvergeToJSON(&conv)) ||
+            !(json = virJSONValueToString(params, false)))
+            goto cleanup;
+
+        if (testQEMUSchemaValidateCommand("migrate-set-parameters",
+                                          params,
+                                          data->qmpschema,
+                                          false,
+                                          false,
+                                          &debug) < 0) {
+            VIR_TEST_VERBOSE("failed to validate migration params '%s' against QMP schema: %s",
+                             json, virBufferCurrentContent(&debug));
+            goto cleanup;
+        }
+
+        virBufferAsprintf(&buf, "%s\n", json);
+    }
+
+    actual = virBufferContentAndReset(&buf);
+
+    if (virTestCompareToFile(actual, outFile) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    qemuMonitorTestFree(mon);
+    return ret;
+}
+
+
 static int
 mymain(void)
 {
@@ -225,6 +320,19 @@ mymain(void)
     DO_TEST("tls-enabled");
     DO_TEST("tls-hostname");
 
+#define DO_TEST_CONVERGE(name, maxTime, maxDowntime, throttle, npasses) \
+    do { \
+        qemuMigParamsConvergeData data = { \
+            driver.xmlopt, name, qmpschema, \
+            maxTime, maxDowntime, throttle, npasses \
+        }; \
+        if (virTestRun(name " (converge)", qemuMigParamsTestConverge, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_TEST_CONVERGE("converge-downtime", 0, 1000, false, 4);
+    DO_TEST_CONVERGE("converge-time", 20000, 500, true, 5);
+
     qemuTestDriverFree(&driver);
 
     return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
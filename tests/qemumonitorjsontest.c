@@ -1877,6 +1877,172 @@ testQemuMonitorJSONqemuMonitorJSONGetAllBlockStatsInfo(const void *opaque)
 }
 
 
+static int
+testQemuMonitorJSONqemuMonitorJSONGetAllBlockStatsCapacity(const void *opaque)
+{
+    const testGenericData *data = opaque;
+    virDomainXMLOptionPtr xmlopt = data->xmlopt;
+    g_autoptr(qemuMonitorTest) test = NULL;
+    virHashTablePtr blockstats = NULL;
+    qemuBlockStatsPtr stats;
+    int ret = -1;
+
+    if (!(test = qemuMonitorTestNewSchema(xmlopt, data->schema)))
+        return -1;
+
+    if (!(blockstats = virHashCreate(10, virHashValueFree)))
+        goto cleanup;
+
+    /* both commands are sent before the first reply is received */
+    if (qemuMonitorTestAddItem(test, "query-blockstats",
+                               "{"
+                               "    \"return\": ["
+                               "        {"
+                               "            \"device\": \"drive-virtio-disk0\","
+                               "            \"stats\": {"
+                               "                \"wr_highest_offset\": 0,"
+                               "                \"wr_bytes\": 4096,"
+                               "                \"wr_operations\": 1,"
+                               "                \"rd_bytes\": 8192,"
+                               "                \"rd_operations\": 2"
+                               "            }"
+                               "        }"
+                               "    ],"
+                               "    \"id\": \"libvirt-1\""
+                               "}") < 0 ||
+        qemuMonitorTestAddItem(test, "query-block",
+                               "{"
+                               "    \"return\": ["
+                               "        {"
+                               "            \"device\": \"drive-virtio-disk0\","
+                               "            \"locked\": false,"
+                               "            \"removable\": false,"
+                               "            \"inserted\": {"
+                               "                \"image\": {"
+                               "                    \"virtual-size\": 10737418240,"
+                               "                    \"actual-size\": 1048576"
+                               "                }"
+                               "            }"
+                               "        }"
+                               "    ],"
+                               "    \"id\": \"libvirt-2\""
+                               "}") < 0)
+        goto cleanup;
+
+    if (qemuMonitorJSONGetAllBlockStatsCapacity(qemuMonitorTestGetMonitor(test),
+                                                blockstats, false, false,
+                                                false, NULL) < 0)
+        goto cleanup;
+
+    if (!(stats = virHashLookup(blockstats, "virtio-disk0"))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       "block stats for device 'virtio-disk0' are missing");
+        goto cleanup;
+    }
+
+    if (stats->rd_req != 2 || stats->rd_bytes != 8192 ||
+        stats->wr_req != 1 || stats->wr_bytes != 4096) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       "unexpected block stats of 'virtio-disk0'");
+        goto cleanup;
+    }
+
+    if (stats->capacity != 10737418240ULL || stats->physical != 1048576) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "unexpected capacity '%llu' or physical size '%llu'",
+                       stats->capacity, stats->physical);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virHashFree(blockstats);
+    return ret;
+}
+
+
+static int
+testQemuMonitorJSONqemuMonitorJSONGetAllBlockStatsCapacityBestEffort(const void *opaque)
+{
+    const testGenericData *data = opaque;
+    virDomainXMLOptionPtr xmlopt = data->xmlopt;
+    g_autoptr(qemuMonitorTest) test = NULL;
+    g_autoptr(virJSONValue) nodedata = NULL;
+    virHashTablePtr blockstats = NULL;
+    qemuBlockStatsPtr stats;
+    int ret = -1;
+
+    if (!(test = qemuMonitorTestNewSchema(xmlopt, data->schema)))
+        return -1;
+
+    if (!(blockstats = virHashCreate(10, virHashValueFree)))
+        goto cleanup;
+
+    /* a failed capacity query must not drop the block stats */
+    if (qemuMonitorTestAddItem(test, "query-blockstats",
+                               "{"
+                               "    \"return\": ["
+                               "        {"
+                               "            \"device\": \"drive-virtio-disk0\","
+                               "            \"stats\": {"
+                               "                \"wr_highest_offset\": 0,"
+                               "                \"wr_bytes\": 4096,"
+                               "                \"wr_operations\": 1,"
+                               "                \"rd_bytes\": 8192,"
+                               "                \"rd_operations\": 2"
+                               "            }"
+                               "        }"
+                               "    ],"
+                               "    \"id\": \"libvirt-1\""
+                               "}") < 0 ||
+        qemuMonitorTestAddItem(test, "query-block",
+                               "{"
+                               "    \"error\": {"
+                               "        \"class\": \"GenericError\","
+                               "        \"desc\": \"failed\""
+                               "    },"
+                               "    \"id\": \"libvirt-2\""
+                               "}") < 0 ||
+        qemuMonitorTestAddItem(test, "query-named-block-nodes",
+                               "{"
+                               "    \"return\": [],"
+                               "    \"id\": \"libvirt-3\""
+                               "}") < 0)
+        goto cleanup;
+
+    if (qemuMonitorJSONGetAllBlockStatsCapacity(qemuMonitorTestGetMonitor(test),
+                                                blockstats, false, false,
+                                                true, &nodedata) < 0)
+        goto cleanup;
+
+    if (!(stats = virHashLookup(blockstats, "virtio-disk0")) ||
+        stats->rd_req != 2 || stats->wr_req != 1) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       "block stats for device 'virtio-disk0' are missing");
+        goto cleanup;
+    }
+
+    if (stats->capacity != 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "unexpected capacity '%llu'", stats->capacity);
+        goto cleanup;
+    }
+
+    if (!nodedata || !virJSONValueIsArray(nodedata)) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       "reply to query-named-block-nodes is missing");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virHashFree(blockstats);
+    return ret;
+}
+
+
 static int
 testQemuMonitorJSONqemuMonitorJSONGetMigrationCacheSize(const void *opaque)
 {
@@ -3295,6 +3461,8 @@ mymain(void)
     DO_TEST(qemuMonitorJSONGetBalloonInfo);
     DO_TEST(qemuMonitorJSONGetBlockInfo);
     DO_TEST(qemuMonitorJSONGetAllBlockStatsInfo);
+    DO_TEST(qemuMonitorJSONGetAllBlockStatsCapacity);
+    DO_TEST(qemuMonitorJSONGetAllBlockStatsCapacityBestEffort);
     DO_TEST(qemuMonitorJSONGetMigrationCacheSize);
     DO_TEST(qemuMonitorJSONGetMigrationStats);
     DO_TEST(qemuMonitorJSONGetChardevInfo);
@@ -0,0 +1,305 @@
+#include <config.h>
+
+#include <fcntl.h>
+
+#include "testutils.h"
+
+#ifdef WITH_QEMU
+
+# include "internal.h"
+# include "virfile.h"
+# include "vircommand.h"
+# include "qemu/qemu_saveimage.h"
+# include "testutilsqemu.h"
+
+# define VIR_FROM_THIS VIR_FROM_QEMU
+
+static virQEMUDriver driver;
+static char *fakerootdir;
+static char *fakebindir;
+
+static const char *domainXML =
+    "<domain type='qemu'>\n"
+    "  <name>QEMUGuest1</name>\n"
+    "  <uuid>c7a5fdbd-edaf-9455-926a-d65c16db1809</uuid>\n"
+    "  <memory unit='KiB'>219136</memory>\n"
+    "  <vcpu placement='static'>1</vcpu>\n"
+    "  <os>\n"
+    "    <type arch='x86_64' machine='pc'>hvm</type>\n"
+    "  </os>\n"
+    "  <devices>\n"
+    "    <emulator>/usr/bin/qemu-system-x86_64</emulator>\n"
+    "  </devices>\n"
+    "</domain>\n";
+
+struct testCompressionInfo {
+    const char *format;
+    unsigned int threads;
+    int compressed; /* expected return value */
+    const char *args; /* expected command line without the directory */
+};
+
+
+static int
+testCompressionProgram(const void *opaque)
+{
+    const struct testCompressionInfo *info = opaque;
+    g_autoptr(virCommand) compressor = NULL;
+    g_autofree char *expect = NULL;
+    g_autofree char *actual = NULL;
+    int compressed;
+
+    compressed = qemuSaveImageGetCompressionProgram(info->format, info->threads,
+                                                    &compressor, "save", false);
+
+    if (compressed != info->compressed) {
+        VIR_TEST_VERBOSE("expected format %d, got %d",
+                         info->compressed, compressed);
+        return -1;
+    }
+
+    if (!info->args) {
+        if (compressor) {
+            VIR_TEST_VERBOSE("unexpected compressor");
+            return -1;
+        }
+        virResetLastError();
+        return 0;
+    }
+
+    if (!compressor) {
+        VIR_TEST_VERBOSE("missing compressor");
+        return -1;
+    }
+
+    expect = g_strdup_printf("%s/%s", fakebindir, info->args);
+    if (!(actual = virCommandToString(compressor, false)))
+        return -1;
+
+    if (STRNEQ(expect, actual)) {
+        virTestDifference(stderr, expect, actual);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+struct testHeaderInfo {
+    const char *name;
+    uint32_t version;
+    uint32_t streams;
+    uint32_t compressed;
+    uint32_t expectStreams;
+    bool fail;
+};
+
+
+static int
+testHeader(const void *opaque)
+{
+    const struct testHeaderInfo *info = opaque;
+    g_autofree char *path = g_strdup_printf("%s/%s.save", fakerootdir, info->name);
+    g_autoptr(virQEMUSaveData) data = NULL;
+    g_autoptr(virQEMUSaveData) parsed = NULL;
+    g_autoptr(virDomainDef) def = NULL;
+    VIR_AUTOCLOSE fd = -1;
+    VIR_AUTOCLOSE rfd = -1;
+
+    if (!(data = virQEMUSaveDataNew(g_strdup(domainXML), NULL, true,
+                                    info->compressed, driver.xmlopt)))
+        return -1;
+
+    memcpy(data->header.magic, QEMU_SAVE_MAGIC, sizeof(data->header.magic));
+    data->header.version = info->version;
+    data->header.streams = info->streams;
+
+    if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600)) < 0) {
+        fprintf(stderr, "cannot create %s\n", path);
+        return -1;
+    }
+
+    if (virQEMUSaveDataWrite(data, fd, path) < 0 ||
+        VIR_CLOSE(fd) < 0)
+        return -1;
+
+    rfd = qemuSaveImageOpen(&driver, NULL, path, &def, &parsed,
+                            false, NULL, false, false);
+    unlink(path);
+
+    if (info->fail) {
+        if (rfd >= 0) {
+            VIR_TEST_VERBOSE("image with %u streams unexpectedly accepted",
+                             info->streams);
+            return -1;
+        }
+        virResetLastError();
+        return 0;
+    }
+
+    if (rfd < 0)
+        return -1;
+
+    if (parsed->header.version != info->version ||
+        parsed->header.streams != info->expectStreams ||
+        parsed->header.was_running != 1 ||
+        parsed->header.compressed != info->compressed ||
+        parsed->header.data_len != data->header.data_len) {
+        VIR_TEST_VERBOSE("header mismatch: version=%u streams=%u "
+                         "was_running=%u compressed=%u data_len=%u",
+                         parsed->header.version, parsed->header.streams,
+                         parsed->header.was_running, parsed->header.compressed,
+                         parsed->header.data_len);
+        return -1;
+    }
+
+    if (STRNEQ(def->name, "QEMUGuest1")) {
+        VIR_TEST_VERBOSE("unexpected domain name '%s'", def->name);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+testUnlinkStreams(const void *opaque G_GNUC_UNUSED)
+{
+    g_autofree char *path = g_strdup_printf("%s/unlink.save", fakerootdir);
+    const unsigned int idx[] = { 1, 2, 5, QEMU_SAVE_IMAGE_STREAMS_MAX };
+    size_t i;
+
+    /* leave gaps in the numbering as a partially removed image would */
+    for (i = 0; i < G_N_ELEMENTS(idx); i++) {
+        g_autofree char *file = g_strdup_printf("%s.%u", path, idx[i]);
+
+        if (virFileWriteStr(file, "", 0600) < 0)
+            return -1;
+    }
+
+    qemuSaveImageUnlinkStreams(path);
+
+    for (i = 0; i < G_N_ELEMENTS(idx); i++) {
+        g_autofree char *file = g_strdup_printf("%s.%u", path, idx[i]);
+
+        if (virFileExists(file)) {
+            VIR_TEST_VERBOSE("stream file '%s' was not removed", file);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+static int
+mymain(void)
+{
+    const char *programs[] = { "gzip", "bzip2", "xz", "lzop", "zstd" };
+    g_autofree char *oldpath = g_strdup(g_getenv("PATH"));
+    int ret = 0;
+    size_t i;
+
+    fakerootdir = g_strdup(abs_builddir "/fakerootdir-XXXXXX");
+    if (!g_mkdtemp(fakerootdir)) {
+        fprintf(stderr, "Cannot create fakerootdir");
+        return EXIT_FAILURE;
+    }
+
+    fakebindir = g_strdup_printf("%s/bin", fakerootdir);
+    if (g_mkdir_with_parents(fakebindir, 0755) < 0) {
+        fprintf(stderr, "Cannot create fakebindir");
+        ret = -1;
+        goto cleanup;
+    }
+
+    if (qemuTestDriverInit(&driver) < 0) {
+        ret = -1;
+        goto cleanup;
+    }
+
+    qemuTestSetHostArch(&driver, VIR_ARCH_X86_64);
+
+    /* the compressors are never run, they only have to be found */
+    for (i = 0; i < G_N_ELEMENTS(programs); i++) {
+        g_autofree char *path = g_strdup_printf("%s/%s", fakebindir, programs[i]);
+
+        if (virFileWriteStr(path, "#!/bin/sh\n", 0755) < 0) {
+            ret = -1;
+            goto cleanup;
+        }
+    }
+
+    g_setenv("PATH", fakebindir, TRUE);
+
+# define DO_TEST_COMPRESSION(name, format, threads, compressed, args) \
+    do { \
+        struct testCompressionInfo info = { format, threads, compressed, args }; \
+        if (virTestRun("compression program " name, \
+                       testCompressionProgram, &info) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_TEST_COMPRESSION("none", NULL, 0, 0, NULL);
+    DO_TEST_COMPRESSION("raw", "raw", 4, 0, NULL);
+    DO_TEST_COMPRESSION("invalid", "foo", 0, -1, NULL);
+    DO_TEST_COMPRESSION("gzip", "gzip", 4, 1, "gzip -c");
+    DO_TEST_COMPRESSION("bzip2", "bzip2", 4, 2, "bzip2 -c");
+    DO_TEST_COMPRESSION("lzop", "lzop", 4, 4, "lzop -c");
+    /* xz gets -T only if threads are configured as old versions reject it */
+    DO_TEST_COMPRESSION("xz", "xz", 0, 3, "xz -c -3");
+    DO_TEST_COMPRESSION("xz-threads", "xz", 4, 3, "xz -c -3 -T4");
+    DO_TEST_COMPRESSION("zstd", "zstd", 0, 5, "zstd -c -T0");
+    DO_TEST_COMPRESSION("zstd-threads", "zstd", 4, 5, "zstd -c -T4");
+
+# define DO_TEST_HEADER_FULL(name, version, streams, compressed, expectStreams, fail) \
+    do { \
+        struct testHeaderInfo info = { name, version, streams, compressed, \
+                                       expectStreams, fail }; \
+        if (virTestRun("header " name, testHeader, &info) < 0) \
+            ret = -1; \
+    } while (0)
+
+# define DO_TEST_HEADER(name, version, streams) \
+    DO_TEST_HEADER_FULL(name, version, streams, 0, streams, false)
+
+    DO_TEST_HEADER("v2", QEMU_SAVE_VERSION, 0);
+    DO_TEST_HEADER("v3", QEMU_SAVE_VERSION_STREAMS, 4);
+    DO_TEST_HEADER("v3-max", QEMU_SAVE_VERSION_STREAMS,
+                   QEMU_SAVE_IMAGE_STREAMS_MAX);
+    /* the field is unused in older images and must be ignored */
+    DO_TEST_HEADER_FULL("v2-garbage", QEMU_SAVE_VERSION, 4, 0, 0, false);
+    DO_TEST_HEADER_FULL("v3-too-many", QEMU_SAVE_VERSION_STREAMS,
+                        QEMU_SAVE_IMAGE_STREAMS_MAX + 1, 0, 0, true);
+    DO_TEST_HEADER_FULL("v3-compressed", QEMU_SAVE_VERSION_STREAMS,
+                        4, 1, 0, true);
+    DO_TEST_HEADER_FULL("v4", QEMU_SAVE_VERSION_STREAMS + 1, 0, 0, 0, true);
+
+    if (virTestRun("unlink streams", testUnlinkStreams, NULL) < 0)
+        ret = -1;
+
+ cleanup:
+    qemuTestDriverFree(&driver);
+
+    if (oldpath)
+        g_setenv("PATH", oldpath, TRUE);
+
+    if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
+        virFileDeleteTree(fakerootdir);
+    VIR_FREE(fakerootdir);
+    VIR_FREE(fakebindir);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
+
+#else
+
+int
+main(void)
+{
+    return EXIT_AM_SKIP;
+}
+
+#endif /* WITH_QEMU */
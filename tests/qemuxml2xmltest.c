@@ -50,6 +50,72 @@ testXML2XMLInactive(const void *opaque)
 }
 
 
+/*
+ * The native copy of an inactive definition must format to the same XML
+ * as the copy made through XML. Definitions which the native copy doesn't
+ * handle are only copied through XML. With VIR_TEST_EXPENSIVE=1 both
+ * copies are repeated and their average duration is printed with
+ * VIR_TEST_VERBOSE=1.
+ */
+static int
+testXML2XMLCopy(const void *opaque)
+{
+    const struct testQemuInfo *info = opaque;
+    g_autoptr(virDomainDef) def = NULL;
+    g_autoptr(virDomainDef) copy = NULL;
+    g_autoptr(virDomainDef) native = NULL;
+    g_autofree char *expect = NULL;
+    g_autofree char *actual = NULL;
+    unsigned int format_flags = VIR_DOMAIN_DEF_FORMAT_SECURE |
+                                VIR_DOMAIN_DEF_FORMAT_INACTIVE;
+    size_t rounds = virTestGetExpensive() ? 100 : 1;
+    gint64 start;
+    size_t i;
+
+    if (!(def = virDomainDefParseFile(info->infile, driver.xmlopt, NULL,
+                                      VIR_DOMAIN_DEF_PARSE_INACTIVE)))
+        return -1;
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < rounds; i++) {
+        virDomainDefFree(copy);
+        if (!(copy = virDomainDefCopyXML(def, driver.xmlopt,
+                                         info->qemuCaps, false)))
+            return -1;
+    }
+
+    VIR_TEST_VERBOSE("%s: %lld us per XML copy", info->name,
+                     (long long) (g_get_monotonic_time() - start) / (long long) rounds);
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < rounds; i++) {
+        virDomainDefFree(native);
+        if (virDomainDefCopyNative(def, driver.xmlopt,
+                                   info->qemuCaps, &native) < 0)
+            return -1;
+    }
+
+    if (!native) {
+        VIR_TEST_VERBOSE("%s: not copied natively", info->name);
+        return 0;
+    }
+
+    VIR_TEST_VERBOSE("%s: %lld us per native copy", info->name,
+                     (long long) (g_get_monotonic_time() - start) / (long long) rounds);
+
+    if (!(expect = virDomainDefFormat(copy, driver.xmlopt, format_flags)) ||
+        !(actual = virDomainDefFormat(native, driver.xmlopt, format_flags)))
+        return -1;
+
+    if (STRNEQ(expect, actual)) {
+        virTestDifference(stderr, expect, actual);
+        return -1;
+    }
+
+    return 0;
+}
+
+
 static int
 testCompareStatusXMLToXMLFiles(const void *opaque)
 {
@@ -195,6 +261,9 @@ mymain(void)
             if (virTestRun("QEMU XML-2-XML-inactive " _name, \
                             testXML2XMLInactive, &info) < 0) \
                 ret = -1; \
+            if (virTestRun("QEMU XML-2-XML-copy " _name, \
+                            testXML2XMLCopy, &info) < 0) \
+                ret = -1; \
         } \
  \
         if (when & WHEN_ACTIVE) { \
@@ -0,0 +1,413 @@
+/*
+ * remoteeventbatchtest.c: Test the batching of events sent to clients
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "virerror.h"
+#include "virbuffer.h"
+#include "remote_event_batch.h"
+
+#define VIR_FROM_THIS VIR_FROM_RPC
+
+
+static void
+testEventReboot(virNetClientProgramPtr prog G_GNUC_UNUSED,
+                virNetClientPtr client G_GNUC_UNUSED,
+                void *evdata, void *opaque)
+{
+    remote_domain_event_callback_reboot_msg *msg = evdata;
+    virBufferPtr buf = opaque;
+
+    virBufferAsprintf(buf, "%d|", msg->callbackID);
+}
+
+
+static void
+testEventBatch(virNetClientProgramPtr prog,
+               virNetClientPtr client,
+               void *evdata, void *opaque G_GNUC_UNUSED)
+{
+    remoteEventBatchDispatch(prog, client, evdata);
+}
+
+
+static virNetClientProgramEvent testEvents[] = {
+    { REMOTE_PROC_DOMAIN_EVENT_CALLBACK_REBOOT,
+      testEventReboot,
+      sizeof(remote_domain_event_callback_reboot_msg),
+      (xdrproc_t)xdr_remote_domain_event_callback_reboot_msg },
+    { REMOTE_PROC_EVENT_BATCH,
+      testEventBatch,
+      sizeof(remote_event_batch_msg),
+      (xdrproc_t)xdr_remote_event_batch_msg },
+};
+
+
+/*
+ * Encodes @msg with @filter into a new buffer stored in @data.
+ *
+ * Returns the length of the encoded data or 0 on error.
+ */
+static size_t
+testEncode(xdrproc_t filter, void *msg, size_t size, char **data)
+{
+    XDR xdr;
+    size_t len = 0;
+
+    *data = g_new0(char, size);
+    xdrmem_create(&xdr, *data, size, XDR_ENCODE);
+    if ((*filter)(&xdr, msg, 0))
+        len = xdr_getpos(&xdr);
+    xdr_destroy(&xdr);
+
+    return len;
+}
+
+
+/*
+ * Encodes a reboot event for @callbackID of a domain whose name is
+ * @namelen characters long.
+ */
+static size_t
+testEncodeReboot(int callbackID, size_t namelen, char **data)
+{
+    remote_domain_event_callback_reboot_msg msg;
+    g_autofree char *name = g_strnfill(namelen, 'x');
+
+    memset(&msg, 0, sizeof(msg));
+    msg.callbackID = callbackID;
+    msg.msg.dom.name = name;
+    msg.msg.dom.id = 1;
+
+    return testEncode((xdrproc_t)xdr_remote_domain_event_callback_reboot_msg,
+                      &msg, namelen + 1024, data);
+}
+
+
+static int
+testAppendReboot(remoteEventBatchPtr batch, int callbackID)
+{
+    g_autofree char *data = NULL;
+    size_t len = testEncodeReboot(callbackID, 4, &data);
+
+    return remoteEventBatchAppend(batch, REMOTE_PROC_DOMAIN_EVENT_CALLBACK_REBOOT,
+                                  data, len);
+}
+
+
+/*
+ * Sends @batch the way the daemon does and dispatches the message the way
+ * the remote driver does once it is received. The events delivered are
+ * recorded as their callback IDs in @actual.
+ */
+static int
+testDeliver(remoteEventBatchPtr batch,
+            int expectProc,
+            char **actual)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    virNetClientProgramPtr prog = NULL;
+    virNetMessagePtr tx = NULL;
+    virNetMessagePtr rx = NULL;
+    int ret = -1;
+
+    if (!(prog = virNetClientProgramNew(REMOTE_PROGRAM, REMOTE_PROTOCOL_VERSION,
+                                        testEvents, G_N_ELEMENTS(testEvents),
+                                        &buf)))
+        goto cleanup;
+
+    if (!(tx = remoteEventBatchEncode(batch)))
+        goto cleanup;
+
+    if (batch->nevents != 0 || batch->size != 0) {
+        VIR_TEST_VERBOSE("batch not emptied by encoding");
+        goto cleanup;
+    }
+
+    if (!(rx = virNetMessageNew(true)))
+        goto cleanup;
+
+    rx->bufferLength = VIR_NET_MESSAGE_LEN_MAX;
+    rx->buffer = g_new0(char, rx->bufferLength);
+    memcpy(rx->buffer, tx->buffer, rx->bufferLength);
+
+    if (virNetMessageDecodeLength(rx) < 0)
+        goto cleanup;
+
+    if (rx->bufferLength != tx->bufferLength) {
+        VIR_TEST_VERBOSE("expected length %zu got %zu",
+                         tx->bufferLength, rx->bufferLength);
+        goto cleanup;
+    }
+    memcpy(rx->buffer, tx->buffer, rx->bufferLength);
+
+    if (virNetMessageDecodeHeader(rx) < 0)
+        goto cleanup;
+
+    if (rx->header.proc != expectProc) {
+        VIR_TEST_VERBOSE("expected procedure %d got %d",
+                         expectProc, rx->header.proc);
+        goto cleanup;
+    }
+
+    if (virNetClientProgramDispatch(prog, NULL, rx) < 0)
+        goto cleanup;
+
+    *actual = virBufferContentAndReset(&buf);
+    ret = 0;
+
+ cleanup:
+    virNetMessageFree(rx);
+    virNetMessageFree(tx);
+    virObjectUnref(prog);
+    return ret;
+}
+
+
+static int
+testCheck(remoteEventBatchPtr batch,
+          int expectProc,
+          const char *expect)
+{
+    g_autofree char *actual = NULL;
+
+    if (testDeliver(batch, expectProc, &actual) < 0)
+        return -1;
+
+    if (STRNEQ_NULLABLE(expect, actual)) {
+        virTestDifference(stderr, expect, actual);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+testEventBatchSingle(const void *opaque G_GNUC_UNUSED)
+{
+    remoteEventBatch batch = { 0 };
+    int ret = -1;
+
+    if (testAppendReboot(&batch, 1) != 0) {
+        VIR_TEST_VERBOSE("single event fills the batch");
+        goto cleanup;
+    }
+
+    /* A single event is not wrapped */
+    ret = testCheck(&batch, REMOTE_PROC_DOMAIN_EVENT_CALLBACK_REBOOT, "1|");
+
+ cleanup:
+    remoteEventBatchClear(&batch);
+    return ret;
+}
+
+
+static int
+testEventBatchOrder(const void *opaque G_GNUC_UNUSED)
+{
+    remoteEventBatch batch = { 0 };
+    int ret = -1;
+
+    if (testAppendReboot(&batch, 1) < 0 ||
+        testAppendReboot(&batch, 2) < 0 ||
+        testAppendReboot(&batch, 3) < 0)
+        goto cleanup;
+
+    ret = testCheck(&batch, REMOTE_PROC_EVENT_BATCH, "1|2|3|");
+
+ cleanup:
+    remoteEventBatchClear(&batch);
+    return ret;
+}
+
+
+/*
+ * An event which the client does not know or fails to decode is skipped
+ * without affecting the other events of the batch.
+ */
+static int
+testEventBatchInvalid(const void *opaque G_GNUC_UNUSED)
+{
+    remoteEventBatch batch = { 0 };
+    g_autofree char *data = NULL;
+    size_t len = testEncodeReboot(2, 4, &data);
+    int ret = -1;
+
+    if (testAppendReboot(&batch, 1) < 0 ||
+        remoteEventBatchAppend(&batch, 0x7fff, data, len) < 0 ||
+        remoteEventBatchAppend(&batch, REMOTE_PROC_DOMAIN_EVENT_CALLBACK_REBOOT,
+                               data, len - 8) < 0 ||
+        remoteEventBatchAppend(&batch, REMOTE_PROC_DOMAIN_EVENT_CALLBACK_REBOOT,
+                               data, 0) < 0 ||
+        testAppendReboot(&batch, 3) < 0)
+        goto cleanup;
+
+    ret = testCheck(&batch, REMOTE_PROC_EVENT_BATCH, "1|3|");
+
+ cleanup:
+    remoteEventBatchClear(&batch);
+    return ret;
+}
+
+
+/*
+ * A batch nested in another one is not dispatched, otherwise a server
+ * could make the client recurse without bounds.
+ */
+static int
+testEventBatchNested(const void *opaque G_GNUC_UNUSED)
+{
+    remoteEventBatch batch = { 0 };
+    remote_event_batch_item item;
+    remote_event_batch_msg inner;
+    g_autofree char *event = NULL;
+    g_autofree char *data = NULL;
+    size_t len;
+    int ret = -1;
+
+    item.proc = REMOTE_PROC_DOMAIN_EVENT_CALLBACK_REBOOT;
+    item.data.data_len = testEncodeReboot(2, 4, &event);
+    item.data.data_val = event;
+    inner.events.events_len = 1;
+    inner.events.events_val = &item;
+
+    if (!(len = testEncode((xdrproc_t)xdr_remote_event_batch_msg, &inner,
+                           1024, &data)))
+        goto cleanup;
+
+    if (testAppendReboot(&batch, 1) < 0 ||
+        remoteEventBatchAppend(&batch, REMOTE_PROC_EVENT_BATCH, data, len) < 0 ||
+        testAppendReboot(&batch, 3) < 0)
+        goto cleanup;
+
+    ret = testCheck(&batch, REMOTE_PROC_EVENT_BATCH, "1|3|");
+
+ cleanup:
+    remoteEventBatchClear(&batch);
+    return ret;
+}
+
+
+/*
+ * The batch is full once it holds REMOTE_EVENT_BATCH_MAX events and
+ * a full batch is still delivered completely.
+ */
+static int
+testEventBatchMaxEvents(const void *opaque G_GNUC_UNUSED)
+{
+    remoteEventBatch batch = { 0 };
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    g_autofree char *expect = NULL;
+    size_t i;
+    int ret = -1;
+
+    for (i = 0; i < REMOTE_EVENT_BATCH_MAX; i++) {
+        int full = testAppendReboot(&batch, i);
+
+        if (full < 0)
+            goto cleanup;
+
+        if (full != (i == REMOTE_EVENT_BATCH_MAX - 1)) {
+            VIR_TEST_VERBOSE("batch %s full after %zu events",
+                             full ? "is" : "is not", i + 1);
+            goto cleanup;
+        }
+        virBufferAsprintf(&buf, "%zu|", i);
+    }
+
+    expect = virBufferContentAndReset(&buf);
+    ret = testCheck(&batch, REMOTE_PROC_EVENT_BATCH, expect);
+
+ cleanup:
+    remoteEventBatchClear(&batch);
+    return ret;
+}
+
+
+/*
+ * The batch is full once its events take VIR_NET_MESSAGE_INITIAL bytes
+ * even though there are much fewer than REMOTE_EVENT_BATCH_MAX of them.
+ */
+static int
+testEventBatchMaxSize(const void *opaque G_GNUC_UNUSED)
+{
+    remoteEventBatch batch = { 0 };
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    g_autofree char *expect = NULL;
+    g_autofree char *data = NULL;
+    size_t len = testEncodeReboot(0, 16 * 1024, &data);
+    size_t nevents = VIR_NET_MESSAGE_INITIAL / len + 1;
+    size_t i;
+    int ret = -1;
+
+    if (!len)
+        goto cleanup;
+
+    for (i = 0; i < nevents; i++) {
+        g_autofree char *event = NULL;
+        int full;
+
+        testEncodeReboot(i, 16 * 1024, &event);
+        full = remoteEventBatchAppend(&batch,
+                                      REMOTE_PROC_DOMAIN_EVENT_CALLBACK_REBOOT,
+                                      event, len);
+
+        if (full < 0)
+            goto cleanup;
+
+        if (full != (i == nevents - 1)) {
+            VIR_TEST_VERBOSE("batch %s full after %zu bytes",
+                             full ? "is" : "is not", batch.size);
+            goto cleanup;
+        }
+        virBufferAsprintf(&buf, "%zu|", i);
+    }
+
+    expect = virBufferContentAndReset(&buf);
+    ret = testCheck(&batch, REMOTE_PROC_EVENT_BATCH, expect);
+
+ cleanup:
+    remoteEventBatchClear(&batch);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (virTestRun("single event", testEventBatchSingle, NULL) < 0)
+        ret = -1;
+    if (virTestRun("event order", testEventBatchOrder, NULL) < 0)
+        ret = -1;
+    if (virTestRun("invalid events", testEventBatchInvalid, NULL) < 0)
+        ret = -1;
+    if (virTestRun("nested batch", testEventBatchNested, NULL) < 0)
+        ret = -1;
+    if (virTestRun("max events", testEventBatchMaxEvents, NULL) < 0)
+        ret = -1;
+    if (virTestRun("max size", testEventBatchMaxSize, NULL) < 0)
+        ret = -1;
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
@@ -4,6 +4,7 @@
 
 #include "internal.h"
 #include "virjson.h"
+#include "virbuffer.h"
 #include "testutils.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
@@ -102,6 +103,312 @@ testJSONFromString(const void *data)
 }
 
 
+static int
+testJSONStreamChunked(const char *doc,
+                      size_t chunk,
+                      char **formatted)
+{
+    g_autoptr(virJSONStreamParser) parser = NULL;
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    size_t len = strlen(doc);
+    size_t off;
+
+    if (!(parser = virJSONStreamParserNew(0)))
+        return -1;
+
+    for (off = 0; off < len; off += chunk) {
+        virJSONValuePtr tmp;
+
+        if (virJSONStreamParserFeed(parser, doc + off,
+                                    MIN(chunk, len - off)) < 0)
+            return -1;
+
+        while ((tmp = virJSONStreamParserNext(parser))) {
+            g_autoptr(virJSONValue) value = tmp;
+            g_autofree char *str = NULL;
+
+            if (!(str = virJSONValueToString(value, false)))
+                return -1;
+
+            virBufferAdd(&buf, str, -1);
+        }
+    }
+
+    *formatted = virBufferContentAndReset(&buf);
+    return 0;
+}
+
+
+static int
+testJSONStream(const void *data)
+{
+    const struct testInfo *info = data;
+    size_t chunks[] = { 1, 3, 64, strlen(info->doc) };
+    size_t i;
+
+    for (i = 0; i < G_N_ELEMENTS(chunks); i++) {
+        g_autofree char *formatted = NULL;
+
+        if (testJSONStreamChunked(info->doc, chunks[i], &formatted) < 0) {
+            if (info->pass) {
+                VIR_TEST_VERBOSE("Failed to parse %s in chunks of %zu",
+                                 info->doc, chunks[i]);
+                return -1;
+            }
+
+            continue;
+        }
+
+        if (!info->pass) {
+            VIR_TEST_VERBOSE("Unexpected success while parsing %s in chunks of %zu",
+                             info->doc, chunks[i]);
+            return -1;
+        }
+
+        if (STRNEQ_NULLABLE(info->expect, formatted)) {
+            virTestDifference(stderr, NULLSTR(info->expect), NULLSTR(formatted));
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * testJSONStreamSharedKeys:
+ *
+ * Parses two objects with the same keys using a parser sharing keys
+ * and checks that the keys are shared up to the limit of the parser,
+ * stay valid after the parser is freed, and that lookups in the large
+ * objects keep working as they're modified.
+ */
+static int
+testJSONStreamSharedKeys(const void *data G_GNUC_UNUSED)
+{
+    g_autoptr(virJSONStreamParser) parser = NULL;
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    g_autoptr(virJSONValue) first = NULL;
+    g_autoptr(virJSONValue) second = NULL;
+    g_autofree char *doc = NULL;
+    size_t nkeys = 1100;
+    size_t i;
+
+    virBufferAddLit(&buf, "{");
+    for (i = 0; i < nkeys; i++)
+        virBufferAsprintf(&buf, "%s\"key%zu\":%zu", i ? "," : "", i, i);
+    virBufferAddLit(&buf, "}");
+    doc = virBufferContentAndReset(&buf);
+
+    if (!(parser = virJSONStreamParserNew(VIR_JSON_STREAM_PARSER_INTERN_KEYS)) ||
+        virJSONStreamParserFeed(parser, doc, strlen(doc)) < 0 ||
+        virJSONStreamParserFeed(parser, doc, strlen(doc)) < 0)
+        return -1;
+
+    first = virJSONStreamParserNext(parser);
+    second = virJSONStreamParserNext(parser);
+    g_clear_pointer(&parser, virJSONStreamParserFree);
+
+    if (!first || !second) {
+        VIR_TEST_VERBOSE("expected two parsed objects");
+        return -1;
+    }
+
+    for (i = 0; i < nkeys; i++) {
+        const char *key = virJSONValueObjectGetKey(first, i);
+        bool shared = key == virJSONValueObjectGetKey(second, i);
+
+        /* the first 1024 keys fit into the table of the parser */
+        if (shared != (i < 1024)) {
+            VIR_TEST_VERBOSE("key '%s' shared=%d", key, shared);
+            return -1;
+        }
+    }
+
+    for (i = 0; i < nkeys; i += 2) {
+        g_autofree char *key = g_strdup_printf("key%zu", i);
+
+        if (virJSONValueObjectRemoveKey(first, key, NULL) != 1)
+            return -1;
+    }
+
+    for (i = 0; i < nkeys; i++) {
+        g_autofree char *key = g_strdup_printf("key%zu", i);
+        unsigned long long val;
+        int rc = virJSONValueObjectGetNumberUlong(first, key, &val);
+
+        if ((i % 2 == 0) != (rc < 0) ||
+            (rc == 0 && val != i)) {
+            VIR_TEST_VERBOSE("wrong lookup result for removed keys at '%s'", key);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+static void
+testJSONBenchCollectObjects(virJSONValuePtr value,
+                            GPtrArray *objects)
+{
+    size_t i;
+
+    if (virJSONValueIsObject(value)) {
+        size_t nkeys = virJSONValueObjectKeysNumber(value);
+
+        g_ptr_array_add(objects, value);
+
+        for (i = 0; i < nkeys; i++)
+            testJSONBenchCollectObjects(virJSONValueObjectGetValue(value, i),
+                                        objects);
+    } else if (virJSONValueIsArray(value)) {
+        for (i = 0; i < virJSONValueArraySize(value); i++)
+            testJSONBenchCollectObjects(virJSONValueArrayGet(value, i),
+                                        objects);
+    }
+}
+
+
+/* Key lookup as it was done before objects got the hash index */
+static virJSONValuePtr
+testJSONBenchLinearGet(virJSONValuePtr object,
+                       const char *key)
+{
+    size_t nkeys = virJSONValueObjectKeysNumber(object);
+    size_t i;
+
+    for (i = 0; i < nkeys; i++) {
+        if (STREQ(virJSONValueObjectGetKey(object, i), key))
+            return virJSONValueObjectGetValue(object, i);
+    }
+
+    return NULL;
+}
+
+
+static int
+testJSONBenchParse(const char *doc,
+                   unsigned int flags,
+                   GPtrArray *values,
+                   gint64 *elapsed)
+{
+    g_autoptr(virJSONStreamParser) parser = NULL;
+    virJSONValuePtr tmp;
+    gint64 start = g_get_monotonic_time();
+
+    if (!(parser = virJSONStreamParserNew(flags)) ||
+        virJSONStreamParserFeed(parser, doc, strlen(doc)) < 0)
+        return -1;
+
+    while ((tmp = virJSONStreamParserNext(parser)))
+        g_ptr_array_add(values, tmp);
+
+    *elapsed += g_get_monotonic_time() - start;
+    return 0;
+}
+
+
+/**
+ * testJSONLookupBench:
+ *
+ * Parses recorded QMP replies and looks up every key of every object
+ * both using virJSONValueObjectGet and using a plain linear scan,
+ * checking that they agree. With VIR_TEST_EXPENSIVE=1 the lookups are
+ * repeated many times and the timings printed with VIR_TEST_VERBOSE=1
+ * show the gain of the hash index and of key interning while parsing.
+ */
+static int
+testJSONLookupBench(const void *data)
+{
+    const struct testInfo *info = data;
+    g_autofree char *infile = NULL;
+    g_autofree char *indata = NULL;
+    g_autoptr(GPtrArray) values = g_ptr_array_new_with_free_func((GDestroyNotify) virJSONValueFree);
+    g_autoptr(GPtrArray) objects = g_ptr_array_new();
+    size_t rounds = virTestGetExpensive() ? 100 : 1;
+    gint64 parsePlain = 0;
+    gint64 parseIntern = 0;
+    gint64 linear = 0;
+    gint64 indexed = 0;
+    size_t nlookups = 0;
+    size_t r;
+    size_t i;
+    size_t j;
+
+    infile = g_strdup_printf("%s/qemucapabilitiesdata/%s.replies",
+                             abs_srcdir, info->name);
+
+    if (virTestLoadFile(infile, &indata) < 0)
+        return -1;
+
+    for (r = 0; r < rounds; r++) {
+        g_autoptr(GPtrArray) tmp = g_ptr_array_new_with_free_func((GDestroyNotify) virJSONValueFree);
+
+        if (testJSONBenchParse(indata, 0, tmp, &parsePlain) < 0)
+            return -1;
+    }
+
+    for (r = 0; r < rounds; r++) {
+        g_ptr_array_set_size(values, 0);
+
+        if (testJSONBenchParse(indata, VIR_JSON_STREAM_PARSER_INTERN_KEYS,
+                               values, &parseIntern) < 0)
+            return -1;
+    }
+
+    for (i = 0; i < values->len; i++)
+        testJSONBenchCollectObjects(g_ptr_array_index(values, i), objects);
+
+    for (i = 0; i < objects->len; i++) {
+        virJSONValuePtr obj = g_ptr_array_index(objects, i);
+        size_t nkeys = virJSONValueObjectKeysNumber(obj);
+        gint64 start;
+
+        for (j = 0; j < nkeys; j++) {
+            const char *key = virJSONValueObjectGetKey(obj, j);
+
+            if (virJSONValueObjectGet(obj, key) !=
+                testJSONBenchLinearGet(obj, key)) {
+                VIR_TEST_VERBOSE("lookup of key '%s' returned wrong value", key);
+                return -1;
+            }
+        }
+
+        if (virJSONValueObjectGet(obj, "-libvirt-nonexistent-key") ||
+            testJSONBenchLinearGet(obj, "-libvirt-nonexistent-key")) {
+            VIR_TEST_VERBOSE("lookup of a missing key succeeded");
+            return -1;
+        }
+
+        start = g_get_monotonic_time();
+        for (r = 0; r < rounds; r++) {
+            for (j = 0; j < nkeys; j++)
+                ignore_value(testJSONBenchLinearGet(obj, virJSONValueObjectGetKey(obj, j)));
+        }
+        linear += g_get_monotonic_time() - start;
+
+        start = g_get_monotonic_time();
+        for (r = 0; r < rounds; r++) {
+            for (j = 0; j < nkeys; j++)
+                ignore_value(virJSONValueObjectGet(obj, virJSONValueObjectGetKey(obj, j)));
+        }
+        indexed += g_get_monotonic_time() - start;
+
+        nlookups += nkeys * rounds;
+    }
+
+    VIR_TEST_VERBOSE("%s: %u replies, %u objects, %zu rounds",
+                     info->name, values->len, objects->len, rounds);
+    VIR_TEST_VERBOSE("  parse: %lld us plain, %lld us with interned keys",
+                     (long long) parsePlain, (long long) parseIntern);
+    VIR_TEST_VERBOSE("  %zu lookups: %lld us linear, %lld us indexed",
+                     nlookups, (long long) linear, (long long) indexed);
+
+    return 0;
+}
+
+
 static int
 testJSONAddRemove(const void *data)
 {
@@ -577,6 +884,34 @@ mymain(void)
     DO_TEST_PARSE_FAIL("object with unterminated key", "{ \"key:7 }");
     DO_TEST_PARSE_FAIL("duplicate key", "{ \"a\": 1, \"a\": 1 }");
 
+#define DO_TEST_STREAM(name, doc, expect) \
+    DO_TEST_FULL(name, Stream, doc, expect, true)
+
+#define DO_TEST_STREAM_FAIL(name, doc) \
+    DO_TEST_FULL(name, Stream, doc, NULL, false)
+
+    DO_TEST_STREAM("stream single object",
+                   "{\"return\": {}}\r\n",
+                   "{\"return\":{}}");
+    DO_TEST_STREAM("stream multiple objects",
+                   "{\"QMP\": {\"version\": 1}}\r\n"
+                   "{\"event\": \"STOP\", \"timestamp\": {\"seconds\": 1}}\r\n"
+                   "{\"return\": [\"a\", 1, true, null], \"id\": \"libvirt-1\"}\r\n",
+                   "{\"QMP\":{\"version\":1}}"
+                   "{\"event\":\"STOP\",\"timestamp\":{\"seconds\":1}}"
+                   "{\"return\":[\"a\",1,true,null],\"id\":\"libvirt-1\"}");
+    DO_TEST_STREAM("stream nested arrays",
+                   "[[1, [2, [3]]], {\"a\": [{}]}] [4]",
+                   "[[1,[2,[3]]],{\"a\":[{}]}][4]");
+    DO_TEST_STREAM("stream escaped strings",
+                   "{\"a\": \"\\\"\\r\\n}\"}\n",
+                   "{\"a\":\"\\\"\\r\\n}\"}");
+    DO_TEST_STREAM("stream incomplete", "{\"a\": [1, 2", NULL);
+    DO_TEST_STREAM_FAIL("stream garbage", "{\"a\": 1}\r\n}{");
+
+    DO_TEST_FULL("caps_5.1.0.x86_64", LookupBench, NULL, NULL, true);
+    DO_TEST_FULL("shared keys", StreamSharedKeys, NULL, NULL, true);
+
     DO_TEST_FULL("lookup on array", Lookup,
                  "[ 1 ]", NULL, false);
     DO_TEST_FULL("lookup on string", Lookup,
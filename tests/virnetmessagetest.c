@@ -520,6 +520,314 @@ static int testMessagePayloadStreamEncode(const void *args G_GNUC_UNUSED)
 }
 
 
+struct testMessageThroughputData {
+    size_t payload;         /* bytes of stream data per message, 0 for an error reply */
+    size_t count;           /* messages to encode and decode */
+};
+
+
+static virNetMessagePtr
+testMessageThroughputEncode(const struct testMessageThroughputData *data,
+                            const char *payload,
+                            virNetMessageErrorPtr err)
+{
+    virNetMessagePtr msg = virNetMessageNew(true);
+
+    msg->header.prog = 0x11223344;
+    msg->header.vers = 0x01;
+    msg->header.proc = 0x666;
+    msg->header.serial = 0x99;
+
+    if (data->payload) {
+        msg->header.type = VIR_NET_STREAM;
+        msg->header.status = VIR_NET_CONTINUE;
+    } else {
+        msg->header.type = VIR_NET_REPLY;
+        msg->header.status = VIR_NET_ERROR;
+    }
+
+    if (virNetMessageEncodeHeader(msg) < 0)
+        goto error;
+
+    if (data->payload) {
+        if (virNetMessageEncodePayloadRaw(msg, payload, data->payload) < 0)
+            goto error;
+    } else {
+        if (virNetMessageEncodePayload(msg, (xdrproc_t)xdr_virNetMessageError,
+                                       err) < 0)
+            goto error;
+    }
+
+    return msg;
+
+ error:
+    virNetMessageFree(msg);
+    return NULL;
+}
+
+
+/* Decodes @tx the way virNetServerClient reads it off the wire */
+static int
+testMessageThroughputDecode(const struct testMessageThroughputData *data,
+                            const char *payload,
+                            virNetMessagePtr tx)
+{
+    virNetMessagePtr msg = virNetMessageNew(true);
+    virNetMessageError err;
+    int ret = -1;
+
+    memset(&err, 0, sizeof(err));
+
+    virNetMessageResizeBuffer(msg, VIR_NET_MESSAGE_LEN_MAX);
+    memcpy(msg->buffer, tx->buffer, VIR_NET_MESSAGE_LEN_MAX);
+
+    if (virNetMessageDecodeLength(msg) < 0)
+        goto cleanup;
+
+    if (msg->bufferLength != tx->bufferLength) {
+        VIR_TEST_VERBOSE("Expect message length %zu got %zu",
+                         tx->bufferLength, msg->bufferLength);
+        goto cleanup;
+    }
+
+    memcpy(msg->buffer + msg->bufferOffset, tx->buffer + msg->bufferOffset,
+           msg->bufferLength - msg->bufferOffset);
+
+    if (virNetMessageDecodeHeader(msg) < 0)
+        goto cleanup;
+
+    if (msg->header.serial != tx->header.serial) {
+        VIR_TEST_VERBOSE("Expect serial %u got %u",
+                         tx->header.serial, msg->header.serial);
+        goto cleanup;
+    }
+
+    if (data->payload) {
+        if (msg->bufferLength - msg->bufferOffset != data->payload ||
+            memcmp(msg->buffer + msg->bufferOffset, payload,
+                   data->payload) != 0) {
+            VIR_TEST_VERBOSE("Stream data differ");
+            goto cleanup;
+        }
+    } else {
+        if (virNetMessageDecodePayload(msg, (xdrproc_t)xdr_virNetMessageError,
+                                       &err) < 0)
+            goto cleanup;
+
+        if (err.code != VIR_ERR_INTERNAL_ERROR) {
+            VIR_TEST_VERBOSE("Expect error code %d got %d",
+                             VIR_ERR_INTERNAL_ERROR, err.code);
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+ cleanup:
+    xdr_free((xdrproc_t)xdr_virNetMessageError, (void*)&err);
+    virNetMessageFree(msg);
+    return ret;
+}
+
+
+/*
+ * Encodes and decodes a stream of messages the way a client and the
+ * daemon handle them, allocating and freeing a message on each side.
+ * The throughput is printed with VIR_TEST_VERBOSE=1; VIR_TEST_EXPENSIVE=1
+ * increases the number of messages to get meaningful numbers.
+ */
+static int testMessageThroughput(const void *opaque)
+{
+    const struct testMessageThroughputData *data = opaque;
+    g_autofree char *payload = g_new0(char, data->payload + 1);
+    g_autofree char *message = g_strdup("Hello World");
+    virNetMessageError err;
+    size_t count = data->count;
+    size_t bytes = 0;
+    size_t i;
+    gint64 start;
+    gint64 elapsed;
+
+    if (virTestGetExpensive())
+        count *= 100;
+
+    for (i = 0; i < data->payload; i++)
+        payload[i] = 'a' + i % 26;
+
+    memset(&err, 0, sizeof(err));
+    err.code = VIR_ERR_INTERNAL_ERROR;
+    err.domain = VIR_FROM_RPC;
+    err.level = VIR_ERR_ERROR;
+    err.message = &message;
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < count; i++) {
+        virNetMessagePtr msg;
+        int rc;
+
+        if (!(msg = testMessageThroughputEncode(data, payload, &err)))
+            return -1;
+
+        bytes += msg->bufferLength;
+        rc = testMessageThroughputDecode(data, payload, msg);
+        virNetMessageFree(msg);
+
+        if (rc < 0)
+            return -1;
+    }
+    elapsed = g_get_monotonic_time() - start;
+
+    VIR_TEST_VERBOSE("%zu messages, %zu bytes in %lld us (%.0f msg/s, %.1f MiB/s)",
+                     count, bytes, (long long) elapsed,
+                     elapsed ? count / (elapsed / 1000000.0) : 0,
+                     elapsed ? bytes / (1024.0 * 1024.0) / (elapsed / 1000000.0) : 0);
+
+    return 0;
+}
+
+
+struct testStreamLimitsData {
+    bool largePackets;
+    size_t packetSize;
+    size_t txWindow;
+};
+
+
+/*
+ * Checks the stream packet size and the number of packets in flight the
+ * daemon uses depending on whether the client announced that it accepts
+ * large packets, and that a full packet makes it through the wire format
+ * within the limits of such a client.
+ */
+static int testStreamLimits(const void *opaque)
+{
+    const struct testStreamLimitsData *data = opaque;
+    struct testMessageThroughputData msgdata = { 0, 1 };
+    g_autofree char *payload = NULL;
+    virNetMessageError err;
+    virNetMessagePtr msg;
+    size_t packetSize;
+    size_t txWindow;
+    size_t maxPayload;
+    int rc;
+
+    virNetMessageGetStreamLimits(data->largePackets, &packetSize, &txWindow);
+
+    if (packetSize != data->packetSize || txWindow != data->txWindow) {
+        VIR_TEST_VERBOSE("Expect packet size %zu window %zu got %zu %zu",
+                         data->packetSize, data->txWindow,
+                         packetSize, txWindow);
+        return -1;
+    }
+
+    msgdata.payload = packetSize;
+    payload = g_new0(char, packetSize);
+    memset(payload, 'x', packetSize);
+    memset(&err, 0, sizeof(err));
+
+    if (!(msg = testMessageThroughputEncode(&msgdata, payload, &err)))
+        return -1;
+
+    maxPayload = data->largePackets ? VIR_NET_MESSAGE_PAYLOAD_MAX :
+                                      VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
+    if (msg->bufferLength - VIR_NET_MESSAGE_LEN_MAX -
+        VIR_NET_MESSAGE_HEADER_MAX > maxPayload) {
+        VIR_TEST_VERBOSE("Packet of %zu bytes exceeds the peer's limit of %zu",
+                         msg->bufferLength, maxPayload);
+        virNetMessageFree(msg);
+        return -1;
+    }
+
+    rc = testMessageThroughputDecode(&msgdata, payload, msg);
+    virNetMessageFree(msg);
+
+    return rc;
+}
+
+
+static int
+testStreamSendAllSource(virStreamPtr st G_GNUC_UNUSED,
+                        char *data G_GNUC_UNUSED,
+                        size_t nbytes,
+                        void *opaque)
+{
+    size_t *want = opaque;
+
+    *want = nbytes;
+    return 0;
+}
+
+
+/*
+ * Drivers which don't announce VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PACKETS,
+ * like the test driver or an older remote daemon, have to be sent legacy
+ * sized packets by virStream*All.
+ */
+static int testStreamPacketSizeFallback(const void *opaque G_GNUC_UNUSED)
+{
+    virConnectPtr conn = NULL;
+    virStreamPtr st = NULL;
+    size_t want = 0;
+    int ret = -1;
+
+    if (!(conn = virConnectOpen("test:///default")))
+        return -1;
+
+    if (!(st = virStreamNew(conn, 0)))
+        goto cleanup;
+
+    if (virStreamSendAll(st, testStreamSendAllSource, &want) < 0)
+        goto cleanup;
+
+    if (want != VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX) {
+        VIR_TEST_VERBOSE("Expect chunks of %d bytes got %zu",
+                         VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX, want);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    if (st)
+        virStreamFree(st);
+    virConnectClose(conn);
+    return ret;
+}
+
+
+/*
+ * Connections keep a buffer for the length word of the next packet
+ * around while idle, which must not take a full buffer from the pool.
+ */
+static int testMessageResizeSmall(const void *opaque G_GNUC_UNUSED)
+{
+    virNetMessagePtr msg = virNetMessageNew(false);
+    int ret = -1;
+
+    virNetMessageResizeBuffer(msg, VIR_NET_MESSAGE_LEN_MAX);
+    if (msg->bufferLength != VIR_NET_MESSAGE_LEN_MAX ||
+        msg->bufferAlloc != VIR_NET_MESSAGE_LEN_MAX) {
+        VIR_TEST_VERBOSE("Expect length word buffer of %d bytes got %zu/%zu",
+                         VIR_NET_MESSAGE_LEN_MAX,
+                         msg->bufferLength, msg->bufferAlloc);
+        goto cleanup;
+    }
+
+    memset(msg->buffer, 'x', VIR_NET_MESSAGE_LEN_MAX);
+    virNetMessageResizeBuffer(msg, VIR_NET_MESSAGE_INITIAL);
+    if (msg->bufferLength != VIR_NET_MESSAGE_INITIAL ||
+        msg->bufferAlloc < VIR_NET_MESSAGE_INITIAL ||
+        memcmp(msg->buffer, "xxxx", VIR_NET_MESSAGE_LEN_MAX) != 0) {
+        VIR_TEST_VERBOSE("Growing the length word buffer failed, got %zu/%zu",
+                         msg->bufferLength, msg->bufferAlloc);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    virNetMessageFree(msg);
+    return ret;
+}
+
+
 static int
 mymain(void)
 {
@@ -544,6 +852,36 @@ mymain(void)
     if (virTestRun("Message Payload Stream Encode", testMessagePayloadStreamEncode, NULL) < 0)
         ret = -1;
 
+    if (virTestRun("Message Resize Small", testMessageResizeSmall, NULL) < 0)
+        ret = -1;
+
+#define DO_THROUGHPUT_TEST(name, payload, count) \
+    do { \
+        struct testMessageThroughputData data = { payload, count }; \
+        if (virTestRun("Message Throughput " name, \
+                       testMessageThroughput, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_THROUGHPUT_TEST("Error Reply", 0, 10000);
+    DO_THROUGHPUT_TEST("Stream Legacy", VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX, 200);
+    DO_THROUGHPUT_TEST("Stream Large", VIR_NET_MESSAGE_STREAM_PAYLOAD, 20);
+
+#define DO_STREAM_LIMITS_TEST(name, largePackets, packetSize, txWindow) \
+    do { \
+        struct testStreamLimitsData data = { largePackets, packetSize, txWindow }; \
+        if (virTestRun("Stream Limits " name, testStreamLimits, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_STREAM_LIMITS_TEST("Legacy", false, VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX, 1);
+    DO_STREAM_LIMITS_TEST("Large", true, VIR_NET_MESSAGE_STREAM_PAYLOAD,
+                          VIR_NET_MESSAGE_STREAM_TX_WINDOW);
+
+    if (virTestRun("Stream Packet Size Fallback",
+                   testStreamPacketSizeFallback, NULL) < 0)
+        ret = -1;
+
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
@@ -52,6 +52,7 @@ static int testIdentity(const void *opaque G_GNUC_UNUSED)
     virNetSocketPtr sock = NULL;
     virNetServerClientPtr client = NULL;
     g_autoptr(virIdentity) ident = NULL;
+    g_autofree char *identityName = NULL;
     const char *gotUsername = NULL;
     uid_t gotUserID;
     const char *gotGroupname = NULL;
@@ -135,6 +136,13 @@ static int testIdentity(const void *opaque G_GNUC_UNUSED)
         goto cleanup;
     }
 
+    if (!(identityName = virNetServerClientGetIdentityName(client)) ||
+        STRNEQ(identityName, "uid:666")) {
+        fprintf(stderr, "Want identity name 'uid:666' got '%s'\n",
+                NULLSTR(identityName));
+        goto cleanup;
+    }
+
     ret = 0;
  cleanup:
     virObjectUnref(sock);
@@ -0,0 +1,194 @@
+/*
+ * virnetservertest.c: Test the scheduling of calls across clients
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "virerror.h"
+
+#define LIBVIRT_VIRNETSERVERPRIV_H_ALLOW
+#include "rpc/virnetserverpriv.h"
+
+#define VIR_FROM_THIS VIR_FROM_RPC
+
+struct testJob {
+    virNetServerJob job; /* must be first */
+    unsigned long long client;
+};
+
+struct testClient {
+    unsigned long long id;
+    bool readonly;
+    const char *identity;
+    size_t njobs;
+};
+
+struct testJobsData {
+    unsigned int rwWeight;
+    size_t clientWorkersMax;
+    size_t identityWorkersMax;
+    size_t workers;
+    const struct testClient *clients; /* terminated by id 0 */
+    const char *expect;
+};
+
+
+/*
+ * Queues the calls of all clients, one client after the other, and lets
+ * @workers run them. The calls are finished in the order they started.
+ * The order is recorded as a string where a digit is the ID of the client
+ * whose call got a worker and '|' marks a call finishing.
+ */
+static int
+testJobs(const void *opaque)
+{
+    const struct testJobsData *data = opaque;
+    virNetServerPtr srv = NULL;
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    g_autofree struct testJob *jobs = NULL;
+    g_autofree virNetServerJobPtr *running = NULL;
+    g_autofree char *actual = NULL;
+    size_t njobs = 0;
+    size_t nstarted = 0;
+    size_t first = 0;
+    size_t nrunning = 0;
+    size_t i;
+    size_t j;
+    int ret = -1;
+
+    for (i = 0; data->clients[i].id; i++)
+        njobs += data->clients[i].njobs;
+
+    jobs = g_new0(struct testJob, njobs);
+    running = g_new0(virNetServerJobPtr, njobs);
+
+    /* No workers, so that calls are only run by this test */
+    if (!(srv = virNetServerNew("test", 1, 0, 0, 0, 10, 5, 0, 0,
+                                NULL, NULL, NULL, NULL)))
+        goto cleanup;
+
+    if (virNetServerSetClientJobLimits(srv, data->clientWorkersMax,
+                                       data->identityWorkersMax,
+                                       data->rwWeight) < 0)
+        goto cleanup;
+
+    njobs = 0;
+    for (i = 0; data->clients[i].id; i++) {
+        const struct testClient *client = &data->clients[i];
+
+        for (j = 0; j < client->njobs; j++) {
+            jobs[njobs].client = client->id;
+            if (virNetServerJobQueuePush(srv, client->id, client->readonly,
+                                         client->identity,
+                                         &jobs[njobs].job) < 0)
+                goto cleanup;
+            njobs++;
+        }
+    }
+
+    while (1) {
+        virNetServerJobPtr job;
+
+        while ((job = virNetServerJobQueuePop(srv, data->workers))) {
+            virBufferAsprintf(&buf, "%llu", ((struct testJob *) job)->client);
+            running[first + nrunning++] = job;
+            nstarted++;
+        }
+
+        if (nrunning == 0)
+            break;
+
+        virBufferAddChar(&buf, '|');
+        virNetServerJobFinish(srv, running[first++]);
+        nrunning--;
+    }
+
+    if (nstarted != njobs) {
+        VIR_TEST_VERBOSE("only %zu of %zu calls were run", nstarted, njobs);
+        goto cleanup;
+    }
+
+    actual = virBufferContentAndReset(&buf);
+    if (STRNEQ_NULLABLE(data->expect, actual)) {
+        virTestDifference(stderr, data->expect, actual);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    /* Calls still queued would be discarded along with the server */
+    if (nstarted == njobs)
+        virObjectUnref(srv);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+#define DO_TEST(name, weight, clientMax, identityMax, workers, expect, ...) \
+    do { \
+        const struct testClient clients[] = { __VA_ARGS__, { 0 } }; \
+        struct testJobsData data = { weight, clientMax, identityMax, \
+                                     workers, clients, expect }; \
+        if (virTestRun("jobs " name, testJobs, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    /* Clients take turns, a read-write one runs its weight of calls
+     * per turn even though its calls were all queued first */
+    DO_TEST("weighted round robin", 3, 0, 0, 1,
+            "1|1|1|2|3|1|1|1|2|3|1|1|1|2|3|",
+            { 1, false, NULL, 9 },
+            { 2, true, NULL, 3 },
+            { 3, true, NULL, 3 });
+
+    /* Without a weight read-write clients are not preferred */
+    DO_TEST("round robin", 1, 0, 0, 2,
+            "12|1|2|1|2||",
+            { 1, false, NULL, 3 },
+            { 2, true, NULL, 3 });
+
+    /* Client 1 may only run two calls at once although workers are
+     * available */
+    DO_TEST("client limit", 1, 2, 0, 10,
+            "121|1||1||",
+            { 1, true, NULL, 4 },
+            { 2, true, NULL, 1 });
+
+    /* Clients 1 and 2 share an identity and may only run two calls at
+     * once between them, client 3 is not affected */
+    DO_TEST("identity limit", 1, 0, 2, 10,
+            "1233|1|2||||",
+            { 1, true, "uid:1000", 2 },
+            { 2, true, "uid:1000", 2 },
+            { 3, true, "uid:0", 2 });
+
+    /* Clients without identity are not limited */
+    DO_TEST("identity limit anonymous", 1, 0, 1, 10,
+            "1212||||",
+            { 1, true, NULL, 2 },
+            { 2, true, NULL, 2 });
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
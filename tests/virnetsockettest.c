@@ -446,6 +446,80 @@ static int testSocketCommandFail(const void *data G_GNUC_UNUSED)
     return ret;
 }
 
+/* Writes more buffers than virNetSocketWritev takes at once, including
+ * an empty one, and checks they arrive in order */
+static int testSocketWritev(const void *data G_GNUC_UNUSED)
+{
+    virNetSocketPtr csock = NULL; /* Client socket */
+    GOutputVector vec[VIR_NET_SOCKET_WRITEV_MAX + 4];
+    g_autofree char *expect = NULL;
+    g_autofree char *actual = NULL;
+    size_t total = 0;
+    size_t done = 0;
+    size_t i;
+    int fds[2] = { -1, -1 };
+    int ret = -1;
+
+    for (i = 0; i < G_N_ELEMENTS(vec); i++)
+        total += i == 3 ? 0 : i * 37 + 1;
+
+    expect = g_new0(char, total);
+    actual = g_new0(char, total);
+
+    for (i = 0; i < G_N_ELEMENTS(vec); i++) {
+        vec[i].buffer = expect + done;
+        vec[i].size = i == 3 ? 0 : i * 37 + 1;
+        memset(expect + done, 'a' + i, vec[i].size);
+        done += vec[i].size;
+    }
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+        goto cleanup;
+
+    if (virNetSocketNewConnectSockFD(fds[0], &csock) < 0)
+        goto cleanup;
+    fds[0] = -1;
+
+    virNetSocketSetBlocking(csock, true);
+
+    /* Advance through @vec the same way the RPC code does */
+    for (i = 0, done = 0; done < total;) {
+        ssize_t rv = virNetSocketWritev(csock, vec + i, G_N_ELEMENTS(vec) - i);
+        size_t left;
+
+        if (rv <= 0)
+            goto cleanup;
+
+        if (saferead(fds[1], actual + done, rv) != rv)
+            goto cleanup;
+
+        done += rv;
+        left = rv;
+        while (i < G_N_ELEMENTS(vec) && (left || vec[i].size == 0)) {
+            size_t len = MIN(left, vec[i].size);
+
+            vec[i].buffer = (const char *)vec[i].buffer + len;
+            vec[i].size -= len;
+            left -= len;
+            if (vec[i].size == 0)
+                i++;
+        }
+    }
+
+    if (memcmp(expect, actual, total) != 0) {
+        virTestDifferenceBin(stderr, expect, actual, total);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virObjectUnref(csock);
+    VIR_FORCE_CLOSE(fds[0]);
+    VIR_FORCE_CLOSE(fds[1]);
+    return ret;
+}
+
 struct testSSHData {
     const char *nodename;
     const char *service;
@@ -572,6 +646,9 @@ mymain(void)
     if (virTestRun("Socket External Command /dev/does-not-exist", testSocketCommandFail, NULL) < 0)
         ret = -1;
 
+    if (virTestRun("Socket Writev", testSocketWritev, NULL) < 0)
+        ret = -1;
+
     VIR_WARNINGS_NO_DECLARATION_AFTER_STATEMENT
     struct testSSHData sshData1 = {
         .nodename = "somehost",
@@ -29,6 +29,8 @@
 #include "virfile.h"
 #include "vircommand.h"
 #include "virsocket.h"
+#include "virthread.h"
+#include "rpc/virnetmessage.h"
 
 #if !defined WIN32 && HAVE_LIBTASN1_H && LIBGNUTLS_VERSION_NUMBER >= 0x020600
 
@@ -134,8 +136,8 @@ static int testTLSSessionInit(const void *opaque)
 
 
     /* Now the real part of the test, setup the sessions */
-    serverSess = virNetTLSSessionNew(serverCtxt, NULL);
-    clientSess = virNetTLSSessionNew(clientCtxt, data->hostname);
+    serverSess = virNetTLSSessionNew(serverCtxt, NULL, NULL);
+    clientSess = virNetTLSSessionNew(clientCtxt, data->hostname, NULL);
 
     if (!serverSess) {
         VIR_WARN("Unexpected failure using %s against %s",
@@ -233,6 +235,407 @@ static int testTLSSessionInit(const void *opaque)
 }
 
 
+struct testTLSResumeData {
+    const char *cacrt;
+    const char *servercrt;
+    const char *clientcrt;
+};
+
+
+/*
+ * Connects a client session for @service to the server, and saves
+ * the data for resuming it once the server sent its first record,
+ * which is when TLS 1.3 servers hand out their session tickets.
+ * Returns 1 if both sides resumed a previous session, 0 if they
+ * did a full handshake, -1 on error.
+ */
+static int
+testTLSResumeConnect(virNetTLSContextPtr serverCtxt,
+                     virNetTLSContextPtr clientCtxt,
+                     const char *service)
+{
+    virNetTLSSessionPtr serverSess = NULL;
+    virNetTLSSessionPtr clientSess = NULL;
+    int channel[2] = { -1, -1 };
+    bool clientShake = false;
+    bool serverShake = false;
+    char byte = 'x';
+    int ret = -1;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, channel) < 0)
+        abort();
+
+    ignore_value(virSetNonBlock(channel[0]));
+    ignore_value(virSetNonBlock(channel[1]));
+
+    if (!(serverSess = virNetTLSSessionNew(serverCtxt, NULL, NULL)) ||
+        !(clientSess = virNetTLSSessionNew(clientCtxt, "libvirt.org", service)))
+        goto cleanup;
+
+    virNetTLSSessionSetIOCallbacks(serverSess, testWrite, testRead, &channel[0]);
+    virNetTLSSessionSetIOCallbacks(clientSess, testWrite, testRead, &channel[1]);
+
+    do {
+        int rv;
+        if (!serverShake) {
+            if ((rv = virNetTLSSessionHandshake(serverSess)) < 0)
+                goto cleanup;
+            serverShake = rv == VIR_NET_TLS_HANDSHAKE_COMPLETE;
+        }
+        if (!clientShake) {
+            if ((rv = virNetTLSSessionHandshake(clientSess)) < 0)
+                goto cleanup;
+            clientShake = rv == VIR_NET_TLS_HANDSHAKE_COMPLETE;
+        }
+    } while (!clientShake || !serverShake);
+
+    if (virSetBlocking(channel[0], true) < 0 ||
+        virSetBlocking(channel[1], true) < 0)
+        goto cleanup;
+
+    if (virNetTLSSessionWrite(serverSess, &byte, 1) != 1 ||
+        virNetTLSSessionRead(clientSess, &byte, 1) != 1) {
+        VIR_WARN("Unable to exchange data over the TLS session");
+        goto cleanup;
+    }
+
+    virNetTLSSessionSaveResumeData(clientSess);
+
+    if (virNetTLSSessionIsResumed(clientSess) !=
+        virNetTLSSessionIsResumed(serverSess)) {
+        VIR_WARN("Client and server disagree about session resumption");
+        goto cleanup;
+    }
+
+    ret = virNetTLSSessionIsResumed(clientSess) ? 1 : 0;
+
+ cleanup:
+    virObjectUnref(serverSess);
+    virObjectUnref(clientSess);
+    VIR_FORCE_CLOSE(channel[0]);
+    VIR_FORCE_CLOSE(channel[1]);
+    return ret;
+}
+
+
+/*
+ * This tests that a client resumes its session with the same
+ * server using the session ticket, but not with a different
+ * port of the same host
+ */
+static int testTLSSessionResume(const void *opaque)
+{
+    const struct testTLSResumeData *data = opaque;
+    virNetTLSContextPtr serverCtxt = NULL;
+    virNetTLSContextPtr clientCtxt = NULL;
+    int ret = -1;
+    int rv;
+
+    if (!(serverCtxt = virNetTLSContextNewServer(data->cacrt, NULL,
+                                                 data->servercrt, KEYFILE,
+                                                 NULL, "NORMAL",
+                                                 false, true)) ||
+        !(clientCtxt = virNetTLSContextNewClient(data->cacrt, NULL,
+                                                 data->clientcrt, KEYFILE,
+                                                 "NORMAL", false, true)))
+        goto cleanup;
+
+    if (virNetTLSContextSetTicketKeyRotation(serverCtxt, 3600) < 0)
+        goto cleanup;
+
+    if ((rv = testTLSResumeConnect(serverCtxt, clientCtxt, "16514")) != 0) {
+        VIR_TEST_VERBOSE("first session %s", rv < 0 ? "failed" : "was resumed");
+        goto cleanup;
+    }
+
+    if ((rv = testTLSResumeConnect(serverCtxt, clientCtxt, "16514")) != 1) {
+        VIR_TEST_VERBOSE("second session %s",
+                         rv < 0 ? "failed" : "was not resumed");
+        goto cleanup;
+    }
+
+    if ((rv = testTLSResumeConnect(serverCtxt, clientCtxt, "16509")) != 0) {
+        VIR_TEST_VERBOSE("session to another port %s",
+                         rv < 0 ? "failed" : "was resumed");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virObjectUnref(serverCtxt);
+    virObjectUnref(clientCtxt);
+    return ret;
+}
+
+
+struct testTLSStreamData {
+    const char *cacrt;
+    const char *servercrt;
+    const char *clientcrt;
+    size_t packetSize;
+    bool kernel;            /* let the kernel encrypt the data sent */
+};
+
+struct testTLSStreamReceiver {
+    virNetTLSSessionPtr sess;
+    size_t total;
+    int ret;
+};
+
+
+static int
+testTLSStreamConnect(int *clientfd,
+                     int *serverfd)
+{
+    struct sockaddr_in addr;
+    socklen_t addrlen = sizeof(addr);
+    VIR_AUTOCLOSE listenfd = -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if ((listenfd = socket(AF_INET, SOCK_STREAM, 0)) < 0 ||
+        bind(listenfd, (struct sockaddr *)&addr, addrlen) < 0 ||
+        getsockname(listenfd, (struct sockaddr *)&addr, &addrlen) < 0 ||
+        listen(listenfd, 1) < 0)
+        return -1;
+
+    if ((*clientfd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+        return -1;
+
+    if (connect(*clientfd, (struct sockaddr *)&addr, addrlen) < 0 ||
+        (*serverfd = accept(listenfd, NULL, NULL)) < 0) {
+        VIR_FORCE_CLOSE(*clientfd);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+testTLSStreamWriteAll(virNetTLSSessionPtr sess,
+                      const char *buf,
+                      size_t len)
+{
+    while (len > 0) {
+        ssize_t rv = virNetTLSSessionWrite(sess, buf, len);
+
+        if (rv < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        buf += rv;
+        len -= rv;
+    }
+
+    return 0;
+}
+
+
+static int
+testTLSStreamReadAll(virNetTLSSessionPtr sess,
+                     char *buf,
+                     size_t len)
+{
+    while (len > 0) {
+        ssize_t rv = virNetTLSSessionRead(sess, buf, len);
+
+        if (rv <= 0) {
+            if (rv < 0 && errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        buf += rv;
+        len -= rv;
+    }
+
+    return 0;
+}
+
+
+/* Reads and decodes messages the same way virNetClient does */
+static void
+testTLSStreamReceive(void *opaque)
+{
+    struct testTLSStreamReceiver *data = opaque;
+    size_t received = 0;
+
+    while (received < data->total) {
+        virNetMessagePtr msg = virNetMessageNew(false);
+
+        msg->bufferLength = VIR_NET_MESSAGE_LEN_MAX;
+        msg->buffer = g_new0(char, msg->bufferLength);
+
+        if (testTLSStreamReadAll(data->sess, msg->buffer,
+                                 msg->bufferLength) < 0 ||
+            virNetMessageDecodeLength(msg) < 0 ||
+            testTLSStreamReadAll(data->sess,
+                                 msg->buffer + msg->bufferOffset,
+                                 msg->bufferLength - msg->bufferOffset) < 0 ||
+            virNetMessageDecodeHeader(msg) < 0) {
+            virNetMessageFree(msg);
+            return;
+        }
+
+        received += msg->bufferLength - msg->bufferOffset;
+        virNetMessageFree(msg);
+    }
+
+    data->ret = 0;
+}
+
+
+/*
+ * Measures how fast stream data packets of the given size can be
+ * pushed through a TLS session over a loopback TCP connection. The
+ * throughput is printed with VIR_TEST_VERBOSE=1; VIR_TEST_EXPENSIVE=1
+ * transfers 1 GiB instead of 16 MiB. With kernel TLS the data is
+ * written to the socket as is and still has to be decrypted by gnutls
+ * on the receiving side; the test is skipped if the host lacks it.
+ */
+static int testTLSSessionStream(const void *opaque)
+{
+    const struct testTLSStreamData *data = opaque;
+    virNetTLSContextPtr clientCtxt = NULL;
+    virNetTLSContextPtr serverCtxt = NULL;
+    virNetTLSSessionPtr clientSess = NULL;
+    virNetTLSSessionPtr serverSess = NULL;
+    struct testTLSStreamReceiver receiver = { 0 };
+    g_autofree char *payload = NULL;
+    virThread thread;
+    bool threadStarted = false;
+    size_t total = virTestGetExpensive() ? 1024 * 1024 * 1024 : 16 * 1024 * 1024;
+    size_t sent;
+    bool clientShake = false;
+    bool serverShake = false;
+    int channel[2] = { -1, -1 };
+    gint64 start;
+    gint64 elapsed;
+    int ret = -1;
+
+    if (testTLSStreamConnect(&channel[0], &channel[1]) < 0)
+        return EXIT_AM_SKIP;
+
+    ignore_value(virSetNonBlock(channel[0]));
+    ignore_value(virSetNonBlock(channel[1]));
+
+    if (!(serverCtxt = virNetTLSContextNewServer(data->cacrt, NULL,
+                                                 data->servercrt, KEYFILE,
+                                                 NULL, "NORMAL",
+                                                 false, true)) ||
+        !(clientCtxt = virNetTLSContextNewClient(data->cacrt, NULL,
+                                                 data->clientcrt, KEYFILE,
+                                                 "NORMAL", false, true)))
+        goto cleanup;
+
+    if (!(serverSess = virNetTLSSessionNew(serverCtxt, NULL, NULL)) ||
+        !(clientSess = virNetTLSSessionNew(clientCtxt, "libvirt.org", NULL)))
+        goto cleanup;
+
+    virNetTLSSessionSetIOCallbacks(serverSess, testWrite, testRead, &channel[1]);
+    virNetTLSSessionSetIOCallbacks(clientSess, testWrite, testRead, &channel[0]);
+
+    do {
+        int rv;
+        if (!serverShake) {
+            if ((rv = virNetTLSSessionHandshake(serverSess)) < 0)
+                goto cleanup;
+            serverShake = rv == VIR_NET_TLS_HANDSHAKE_COMPLETE;
+        }
+        if (!clientShake) {
+            if ((rv = virNetTLSSessionHandshake(clientSess)) < 0)
+                goto cleanup;
+            clientShake = rv == VIR_NET_TLS_HANDSHAKE_COMPLETE;
+        }
+    } while (!clientShake || !serverShake);
+
+    if (virSetBlocking(channel[0], true) < 0 ||
+        virSetBlocking(channel[1], true) < 0)
+        goto cleanup;
+
+    if (data->kernel &&
+        virNetTLSSessionSetKernelOffload(clientSess, channel[0]) <= 0) {
+        ret = EXIT_AM_SKIP;
+        goto cleanup;
+    }
+
+    total -= total % data->packetSize;
+    payload = g_new0(char, data->packetSize);
+
+    receiver.sess = serverSess;
+    receiver.total = total;
+    receiver.ret = -1;
+
+    if (virThreadCreate(&thread, true, testTLSStreamReceive, &receiver) < 0)
+        goto cleanup;
+    threadStarted = true;
+
+    start = g_get_monotonic_time();
+    for (sent = 0; sent < total; sent += data->packetSize) {
+        virNetMessagePtr msg = virNetMessageNew(false);
+
+        msg->header.prog = 0x11223344;
+        msg->header.vers = 1;
+        msg->header.proc = 1;
+        msg->header.type = VIR_NET_STREAM;
+        msg->header.status = VIR_NET_CONTINUE;
+
+        if (virNetMessageEncodeHeader(msg) < 0 ||
+            virNetMessageEncodePayloadRaw(msg, payload,
+                                          data->packetSize) < 0) {
+            virNetMessageFree(msg);
+            goto cleanup;
+        }
+
+        if (data->kernel) {
+            if (safewrite(channel[0], msg->buffer, msg->bufferLength) < 0) {
+                virNetMessageFree(msg);
+                goto cleanup;
+            }
+        } else if (testTLSStreamWriteAll(clientSess, msg->buffer,
+                                         msg->bufferLength) < 0) {
+            virNetMessageFree(msg);
+            goto cleanup;
+        }
+
+        virNetMessageFree(msg);
+    }
+
+    virThreadJoin(&thread);
+    threadStarted = false;
+    elapsed = g_get_monotonic_time() - start;
+
+    if (receiver.ret < 0)
+        goto cleanup;
+
+    VIR_TEST_VERBOSE("%zu bytes in %zu byte packets in %lld us (%.1f MiB/s)",
+                     total, data->packetSize, (long long) elapsed,
+                     elapsed ? total / (1024.0 * 1024.0) / (elapsed / 1000000.0) : 0);
+
+    ret = 0;
+
+ cleanup:
+    if (threadStarted) {
+        shutdown(channel[0], SHUT_RDWR);
+        virThreadJoin(&thread);
+    }
+    virObjectUnref(serverCtxt);
+    virObjectUnref(clientCtxt);
+    virObjectUnref(serverSess);
+    virObjectUnref(clientSess);
+
+    VIR_FORCE_CLOSE(channel[0]);
+    VIR_FORCE_CLOSE(channel[1]);
+    return ret;
+}
+
+
 static int
 mymain(void)
 {
@@ -340,6 +743,35 @@ mymain(void)
     DO_SESS_TEST_EXT(cacertreq.filename, altcacertreq.filename, servercertreq.filename,
                      clientcertaltreq.filename, true, true, "libvirt.org", NULL);
 
+    do {
+        static struct testTLSResumeData data;
+        data.cacrt = cacertreq.filename;
+        data.servercrt = servercertreq.filename;
+        data.clientcrt = clientcertreq.filename;
+        if (virTestRun("TLS Session resume", testTLSSessionResume, &data) < 0)
+            ret = -1;
+    } while (0);
+
+# define DO_STREAM_TEST_FULL(_packetSize, _kernel, _suffix) \
+    do { \
+        static struct testTLSStreamData data; \
+        data.cacrt = cacertreq.filename; \
+        data.servercrt = servercertreq.filename; \
+        data.clientcrt = clientcertreq.filename; \
+        data.packetSize = _packetSize; \
+        data.kernel = _kernel; \
+        if (virTestRun("TLS Session stream " #_packetSize _suffix, \
+                       testTLSSessionStream, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+# define DO_STREAM_TEST(_packetSize) \
+    DO_STREAM_TEST_FULL(_packetSize, false, "")
+
+    DO_STREAM_TEST(VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX);
+    DO_STREAM_TEST(VIR_NET_MESSAGE_STREAM_PAYLOAD);
+    DO_STREAM_TEST_FULL(VIR_NET_MESSAGE_STREAM_PAYLOAD, true, " kernel");
+
 
     /* When an altname is set, the CN is ignored, so it must be duplicated
      * as an altname for it to match */
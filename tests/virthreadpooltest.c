@@ -0,0 +1,178 @@
+/*
+ * virthreadpooltest.c: Test the thread pool implementation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "virthread.h"
+#include "virthreadpool.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+struct testThreadPoolInfo {
+    size_t minWorkers;
+    size_t maxWorkers;
+    size_t prioWorkers;
+    size_t njobs;
+    size_t prioEvery;       /* send every Nth job with priority */
+    bool ordered;           /* jobs must run in the order they were sent */
+};
+
+struct testThreadPoolData {
+    virMutex lock;
+    virCond cond;
+    size_t done;
+    size_t *order;
+};
+
+
+static void
+testThreadPoolJob(void *jobdata,
+                  void *opaque)
+{
+    struct testThreadPoolData *data = opaque;
+
+    virMutexLock(&data->lock);
+    data->order[data->done++] = GPOINTER_TO_SIZE(jobdata);
+    virCondSignal(&data->cond);
+    virMutexUnlock(&data->lock);
+}
+
+
+/**
+ * testThreadPool:
+ *
+ * Sends a bunch of jobs to a pool and checks that each of them was run
+ * exactly once and accounted for in the statistics. The job rate is printed
+ * with VIR_TEST_VERBOSE=1.
+ */
+static int
+testThreadPool(const void *opaque)
+{
+    const struct testThreadPoolInfo *info = opaque;
+    struct testThreadPoolData data = { .done = 0 };
+    virThreadPoolPtr pool = NULL;
+    g_autofree bool *seen = g_new0(bool, info->njobs);
+    unsigned long long deadline;
+    gint64 start;
+    gint64 elapsed;
+    size_t i;
+    int ret = -1;
+
+    data.order = g_new0(size_t, info->njobs);
+    if (virMutexInit(&data.lock) < 0 ||
+        virCondInit(&data.cond) < 0)
+        goto cleanup;
+
+    if (!(pool = virThreadPoolNew(info->minWorkers, info->maxWorkers,
+                                  info->prioWorkers, testThreadPoolJob,
+                                  &data)))
+        goto cleanup;
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < info->njobs; i++) {
+        unsigned int priority = info->prioEvery && i % info->prioEvery == 0;
+
+        if (virThreadPoolSendJob(pool, priority, GSIZE_TO_POINTER(i)) < 0)
+            goto cleanup;
+    }
+
+    deadline = g_get_real_time() / 1000 + 30 * 1000;
+    virMutexLock(&data.lock);
+    while (data.done < info->njobs) {
+        if (virCondWaitUntil(&data.cond, &data.lock, deadline) < 0) {
+            VIR_TEST_VERBOSE("only %zu of %zu jobs finished",
+                             data.done, info->njobs);
+            virMutexUnlock(&data.lock);
+            goto cleanup;
+        }
+    }
+    virMutexUnlock(&data.lock);
+    elapsed = g_get_monotonic_time() - start;
+
+    for (i = 0; i < info->njobs; i++) {
+        size_t id = data.order[i];
+
+        if (id >= info->njobs || seen[id]) {
+            VIR_TEST_VERBOSE("job %zu run more than once", id);
+            goto cleanup;
+        }
+        seen[id] = true;
+
+        if (info->ordered && id != i) {
+            VIR_TEST_VERBOSE("job %zu run as %zu", id, i);
+            goto cleanup;
+        }
+    }
+
+    if (virThreadPoolGetJobCount(pool) != info->njobs) {
+        VIR_TEST_VERBOSE("expected %zu jobs, pool counted %llu",
+                         info->njobs, virThreadPoolGetJobCount(pool));
+        goto cleanup;
+    }
+
+    if (virThreadPoolGetJobQueueDepth(pool) != 0) {
+        VIR_TEST_VERBOSE("%zu jobs left in the queue",
+                         virThreadPoolGetJobQueueDepth(pool));
+        goto cleanup;
+    }
+
+    VIR_TEST_VERBOSE("%zu jobs in %lld us, %llu stolen, %.1f us average wait",
+                     info->njobs, (long long) elapsed,
+                     virThreadPoolGetJobSteals(pool),
+                     (double) virThreadPoolGetJobWaitTime(pool) / info->njobs);
+
+    ret = 0;
+
+ cleanup:
+    virThreadPoolFree(pool);
+    virCondDestroy(&data.cond);
+    virMutexDestroy(&data.lock);
+    g_free(data.order);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+    size_t scale = virTestGetExpensive() ? 100 : 1;
+
+#define DO_TEST(name, min, max, prio, njobs, prioEvery, ordered) \
+    do { \
+        struct testThreadPoolInfo info = { min, max, prio, njobs, \
+                                           prioEvery, ordered }; \
+        if (virTestRun("threadpool " name, testThreadPool, &info) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_TEST("single worker", 1, 1, 0, 1000 * scale, 0, true);
+    DO_TEST("on demand single worker", 0, 1, 0, 1000 * scale, 0, true);
+    DO_TEST("many workers", 5, 20, 0, 10000 * scale, 0, false);
+    DO_TEST("on demand workers", 0, 20, 0, 10000 * scale, 0, false);
+    DO_TEST("priority", 5, 20, 2, 10000 * scale, 10, false);
+    DO_TEST("priority single worker", 1, 1, 1, 1000 * scale, 3, false);
+    /* without priority workers the jobs are run in the order they were
+     * sent regardless of their priority */
+    DO_TEST("priority jobs single worker", 1, 1, 0, 1000 * scale, 3, true);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
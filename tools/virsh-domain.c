@@ -6484,6 +6484,30 @@ cmdDomjobinfo(vshControl *ctl, const vshCmd *cmd)
         vshPrint(ctl, "%-17s %-13d\n", _("Auto converge throttle:"), ivalue);
     }
 
+    if ((rc = virTypedParamsGetULLong(params, nparams,
+                                      VIR_DOMAIN_JOB_CONVERGE_DOWNTIME,
+                                      &value)) < 0) {
+        goto save_error;
+    } else if (rc) {
+        vshPrint(ctl, "%-17s %-12llu ms\n", _("Downtime limit:"), value);
+    }
+
+    if ((rc = virTypedParamsGetInt(params, nparams,
+                                   VIR_DOMAIN_JOB_CONVERGE_THROTTLE_INCREMENT,
+                                   &ivalue)) < 0) {
+        goto save_error;
+    } else if (rc) {
+        vshPrint(ctl, "%-17s %-13d\n", _("Throttle step:"), ivalue);
+    }
+
+    if ((rc = virTypedParamsGetULLong(params, nparams,
+                                      VIR_DOMAIN_JOB_CONVERGE_ADJUSTMENTS,
+                                      &value)) < 0) {
+        goto save_error;
+    } else if (rc) {
+        vshPrint(ctl, "%-17s %-13llu\n", _("Adjustments:"), value);
+    }
+
     if ((rc = virTypedParamsGetULLong(params, nparams,
                                       VIR_DOMAIN_JOB_DISK_TEMP_USED,
                                       &value)) < 0) {
@@ -10699,6 +10723,14 @@ static const vshCmdOptDef opts_migrate[] = {
      .type = VSH_OT_STRING,
      .help = N_("override the destination host name used for TLS verification")
     },
+    {.name = "converge-time",
+     .type = VSH_OT_INT,
+     .help = N_("total time in ms migration is expected to finish in")
+    },
+    {.name = "converge-downtime",
+     .type = VSH_OT_INT,
+     .help = N_("maximum downtime in ms allowed to make migration converge")
+    },
     {.name = NULL}
 };
 
@@ -10930,6 +10962,24 @@ doMigrate(void *opaque)
                                 VIR_MIGRATE_PARAM_TLS_DESTINATION, opt) < 0)
         goto save_error;
 
+    if ((rv = vshCommandOptULongLong(ctl, cmd, "converge-time", &ullOpt)) < 0) {
+        goto out;
+    } else if (rv > 0) {
+        if (virTypedParamsAddULLong(&params, &nparams, &maxparams,
+                                    VIR_MIGRATE_PARAM_CONVERGE_TIME,
+                                    ullOpt) < 0)
+            goto save_error;
+    }
+
+    if ((rv = vshCommandOptULongLong(ctl, cmd, "converge-downtime", &ullOpt)) < 0) {
+        goto out;
+    } else if (rv > 0) {
+        if (virTypedParamsAddULLong(&params, &nparams, &maxparams,
+                                    VIR_MIGRATE_PARAM_CONVERGE_DOWNTIME,
+                                    ullOpt) < 0)
+            goto save_error;
+    }
+
     if (vshCommandOptBool(cmd, "live"))
         flags |= VIR_MIGRATE_LIVE;
     if (vshCommandOptBool(cmd, "p2p"))
@@ -428,8 +428,10 @@ cmdSrvThreadpoolInfo(vshControl *ctl, const vshCmd *cmd)
         goto cleanup;
     }
 
-    for (i = 0; i < nparams; i++)
-        vshPrint(ctl, "%-15s: %u\n", params[i].field, params[i].value.ui);
+    for (i = 0; i < nparams; i++) {
+        g_autofree char *str = vshGetTypedParamValue(ctl, &params[i]);
+        vshPrint(ctl, "%-15s: %s\n", params[i].field, str);
+    }
 
     ret = true;
 
@@ -851,6 +853,159 @@ cmdSrvClientsInfo(vshControl *ctl, const vshCmd *cmd)
     return ret;
 }
 
+/* -------------------------------
+ * Command server-procedure-stats
+ * -------------------------------
+ */
+
+static const vshCmdInfo info_srv_procedure_stats[] = {
+    {.name = "help",
+     .data = N_("get server's per-procedure call statistics")
+    },
+    {.name = "desc",
+     .data = N_("Retrieve the number of calls and their latencies for each "
+                "RPC procedure called on a server.")
+    },
+    {.name = NULL}
+};
+
+static const vshCmdOptDef opts_srv_procedure_stats[] = {
+    {.name = "server",
+     .type = VSH_OT_DATA,
+     .flags = VSH_OFLAG_REQ,
+     .completer = vshAdmServerCompleter,
+     .help = N_("Server to retrieve the statistics from."),
+    },
+    {.name = "program",
+     .type = VSH_OT_STRING,
+     .help = N_("Only show procedures of the given RPC program."),
+    },
+    {.name = NULL}
+};
+
+/* Number of latency histogram buckets reported by the daemon; the last one
+ * is unbounded. See virAdmServerGetProcedureStats. */
+#define VSH_ADM_PROCEDURE_STATS_BUCKETS 26
+
+/* Returns the upper bound in microseconds of the histogram bucket
+ * containing the 99th percentile of @calls or 0 if it is unbounded. */
+static unsigned long long
+vshAdmProcedureStatsP99(virTypedParameterPtr params,
+                        int nparams,
+                        unsigned int idx,
+                        const char *kind,
+                        unsigned long long calls)
+{
+    unsigned long long sum = 0;
+    size_t i;
+
+    for (i = 0; i < VSH_ADM_PROCEDURE_STATS_BUCKETS - 1; i++) {
+        g_autofree char *field = g_strdup_printf("proc.%u.%s.bucket.%zu",
+                                                 idx, kind, i);
+        unsigned long long bucket = 0;
+
+        if (virTypedParamsGetULLong(params, nparams, field, &bucket) < 0)
+            return 0;
+
+        sum += bucket;
+        if (sum * 100 >= calls * 99)
+            return 1ULL << i;
+    }
+
+    return 0;
+}
+
+static bool
+cmdSrvProcedureStats(vshControl *ctl, const vshCmd *cmd)
+{
+    bool ret = false;
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+    unsigned int count = 0;
+    unsigned int i;
+    const char *srvname = NULL;
+    const char *progname = NULL;
+    virAdmServerPtr srv = NULL;
+    vshAdmControlPtr priv = ctl->privData;
+    vshTablePtr table = NULL;
+
+    if (vshCommandOptStringReq(ctl, cmd, "server", &srvname) < 0 ||
+        vshCommandOptStringReq(ctl, cmd, "program", &progname) < 0)
+        return false;
+
+    if (!(srv = virAdmConnectLookupServer(priv->conn, srvname, 0)))
+        goto cleanup;
+
+    if (virAdmServerGetProcedureStats(srv, &params, &nparams, 0) < 0) {
+        vshError(ctl, "%s", _("Unable to retrieve procedure statistics"));
+        goto cleanup;
+    }
+
+    if (virTypedParamsGetUInt(params, nparams, "proc.count", &count) < 0)
+        goto cleanup;
+
+    table = vshTableNew(_("Program"), _("Procedure"), _("Calls"),
+                        _("Avg wait (us)"), _("Avg exec (us)"),
+                        _("p99 exec (us)"), NULL);
+    if (!table)
+        goto cleanup;
+
+    for (i = 0; i < count; i++) {
+        g_autofree char *program = g_strdup_printf("proc.%u.program", i);
+        g_autofree char *name = g_strdup_printf("proc.%u.name", i);
+        g_autofree char *calls = g_strdup_printf("proc.%u.calls", i);
+        g_autofree char *wait = g_strdup_printf("proc.%u.wait.total", i);
+        g_autofree char *exec = g_strdup_printf("proc.%u.exec.total", i);
+        g_autofree char *callsStr = NULL;
+        g_autofree char *waitStr = NULL;
+        g_autofree char *execStr = NULL;
+        g_autofree char *p99Str = NULL;
+        const char *programVal = NULL;
+        const char *nameVal = NULL;
+        unsigned long long callsVal = 0;
+        unsigned long long waitVal = 0;
+        unsigned long long execVal = 0;
+        unsigned long long p99;
+
+        if (virTypedParamsGetString(params, nparams, program, &programVal) < 0 ||
+            virTypedParamsGetString(params, nparams, name, &nameVal) < 0 ||
+            virTypedParamsGetULLong(params, nparams, calls, &callsVal) < 0 ||
+            virTypedParamsGetULLong(params, nparams, wait, &waitVal) < 0 ||
+            virTypedParamsGetULLong(params, nparams, exec, &execVal) < 0)
+            goto cleanup;
+
+        if (progname && STRNEQ_NULLABLE(progname, programVal))
+            continue;
+
+        if (callsVal == 0)
+            continue;
+
+        p99 = vshAdmProcedureStatsP99(params, nparams, i, "exec", callsVal);
+
+        callsStr = g_strdup_printf("%llu", callsVal);
+        waitStr = g_strdup_printf("%.1f", (double) waitVal / callsVal);
+        execStr = g_strdup_printf("%.1f", (double) execVal / callsVal);
+        if (p99)
+            p99Str = g_strdup_printf("< %llu", p99);
+        else
+            p99Str = g_strdup("-");
+
+        if (vshTableRowAppend(table, NULLSTR(programVal), NULLSTR(nameVal),
+                              callsStr, waitStr, execStr, p99Str, NULL) < 0)
+            goto cleanup;
+    }
+
+    vshTablePrintToStdout(table, ctl);
+
+    ret = true;
+
+ cleanup:
+    vshTableFree(table);
+    virTypedParamsFree(params, nparams);
+    virAdmServerFree(srv);
+    return ret;
+}
+
 /* --------------------------
  * Command server-clients-set
  * --------------------------
@@ -884,6 +1039,21 @@ static const vshCmdOptDef opts_srv_clients_set[] = {
      .help = N_("Change the upper limit to number of clients waiting for "
                 "authentication to be connected to the server"),
     },
+    {.name = "max-client-workers",
+     .type = VSH_OT_INT,
+     .help = N_("Change the upper limit to number of workers processing "
+                "calls of a single client at the same time."),
+    },
+    {.name = "max-identity-workers",
+     .type = VSH_OT_INT,
+     .help = N_("Change the upper limit to number of workers processing "
+                "calls of all clients of the same user at the same time."),
+    },
+    {.name = "rw-weight",
+     .type = VSH_OT_INT,
+     .help = N_("Change the number of calls of a read-write client processed "
+                "for every call of a read-only client."),
+    },
     {.name = NULL}
 };
 
@@ -915,12 +1085,17 @@ cmdSrvClientsSet(vshControl *ctl, const vshCmd *cmd)
 
     PARSE_CMD_TYPED_PARAM("max-clients", VIR_SERVER_CLIENTS_MAX);
     PARSE_CMD_TYPED_PARAM("max-unauth-clients", VIR_SERVER_CLIENTS_UNAUTH_MAX);
+    PARSE_CMD_TYPED_PARAM("max-client-workers", VIR_SERVER_CLIENT_WORKERS_MAX);
+    PARSE_CMD_TYPED_PARAM("max-identity-workers", VIR_SERVER_IDENTITY_WORKERS_MAX);
+    PARSE_CMD_TYPED_PARAM("rw-weight", VIR_SERVER_CLIENT_RW_WEIGHT);
 
 #undef PARSE_CMD_TYPED_PARAM
 
     if (!nparams) {
         vshError(ctl, "%s", _("At least one of options --max-clients, "
-                              "--max-unauth-clients is mandatory"));
+                              "--max-unauth-clients, --max-client-workers, "
+                              "--max-identity-workers, --rw-weight "
+                              "is mandatory"));
         goto cleanup;
     }
 
@@ -1454,6 +1629,12 @@ static const vshCmdDef monitoringCmds[] = {
      .info = info_srv_clients_info,
      .flags = 0
     },
+    {.name = "server-procedure-stats",
+     .handler = cmdSrvProcedureStats,
+     .opts = opts_srv_procedure_stats,
+     .info = info_srv_procedure_stats,
+     .flags = 0
+    },
     {.name = NULL}
 };
 